@@ -0,0 +1,23 @@
+#ifndef COMMON_IRRADIANCE_GLSL
+#define COMMON_IRRADIANCE_GLSL
+
+// Irradiance of the environment as 9 spherical harmonics coefficients, see IrradianceBlock in sphericalharmonics.hpp
+layout(std140, binding = 3) uniform IrradianceBlock {
+    vec4 uIrradianceSH[9]; // rgb of every basis function, already convolved with the clamped cosine and divided by pi
+};
+
+// Evaluate the diffuse irradiance(divided by pi) around a unit normal, all zeros when ibl is off
+vec3 SH_irradiance(vec3 n) {
+    vec3 irradiance = uIrradianceSH[0].rgb * 0.282095
+                    + uIrradianceSH[1].rgb * 0.488603 * n.y
+                    + uIrradianceSH[2].rgb * 0.488603 * n.z
+                    + uIrradianceSH[3].rgb * 0.488603 * n.x
+                    + uIrradianceSH[4].rgb * 1.092548 * n.x * n.y
+                    + uIrradianceSH[5].rgb * 1.092548 * n.y * n.z
+                    + uIrradianceSH[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0)
+                    + uIrradianceSH[7].rgb * 1.092548 * n.x * n.z
+                    + uIrradianceSH[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+    return max(irradiance, vec3(0.0)); // ringing of the truncated series may dip below zero opposite a bright sun
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef COMMON_MATERIAL_GLSL
+#define COMMON_MATERIAL_GLSL
+
+// Material factors and the textures replacing them, see MaterialBlock in material.hpp
+layout(std140, binding = 2) uniform MaterialBlock {
+    vec4 uAlbedoFactor; // albedo(rgb) and opacity(a)
+    vec4 uMRAOFactor;   // metallic, roughness and ao
+    uvec4 uMaterialMaps; // .x is the bitmask of sampled textures, .y of those sampled from texture pool
+    uvec4 uMaterialLayers; // texture pool handles(bucket << 16 | layer) of albedo, normal and mrao
+};
+
+// Buckets of texture pool bound once per pass, see TexturePool
+layout(binding = 3) uniform sampler2DArray tMaterialArrays[5];
+
+#define M_ALBEDO_MAP 1u
+#define M_NORMAL_MAP 2u
+#define M_MRAO_MAP   4u
+
+// Check whether a map is sampled, the textures of other maps are never fetched
+bool M_hasMap(uint map) {
+    return (uMaterialMaps.x & map) != 0u;
+}
+
+// Sample a map from its layer of texture pool, or from its own texture bound per draw
+// The handle comes from the material block, so indexing the sampler array is dynamically uniform
+vec4 M_sample(sampler2D map, uint bit, uint handle, vec2 uv) {
+    if ((uMaterialMaps.y & bit) != 0u) { return texture(tMaterialArrays[handle >> 16], vec3(uv, float(handle & 0xffffu))); }
+    return texture(map, uv);
+}
+
+// Get albedo from albedo texture or factor
+vec3 M_albedo(sampler2D albedoMap, vec2 uv) {
+    return M_hasMap(M_ALBEDO_MAP) ? M_sample(albedoMap, M_ALBEDO_MAP, uMaterialLayers.x, uv).rgb : uAlbedoFactor.rgb;
+}
+
+// Get tangent space normal xy from normal texture, only meaningful if M_hasMap(M_NORMAL_MAP)
+vec2 M_normal(sampler2D normalMap, vec2 uv) {
+    return M_sample(normalMap, M_NORMAL_MAP, uMaterialLayers.y, uv).xy;
+}
+
+// Get metallic, roughness and ao from mrao texture or factors
+vec3 M_mrao(sampler2D mraoMap, vec2 uv) {
+    return M_hasMap(M_MRAO_MAP) ? M_sample(mraoMap, M_MRAO_MAP, uMaterialLayers.z, uv).rgb : uMRAOFactor.rgb;
+}
+
+#endif
@@ -6,9 +6,9 @@ mat4 N_matrix(mat4 transformMatrix) {
     return mat4(transpose(inverse(mat3(transformMatrix))));
 }
 
-// Transform tangent-space normal from normal map to world space
-vec3 N_toWorld(vec3 N, vec3 T, vec3 TN) {
-    vec3 B = normalize(cross(N, T));
+// Transform tangent-space normal from normal map to world space, S is the bitangent sign(handedness of TBN)
+vec3 N_toWorld(vec3 N, vec3 T, vec3 TN, float S) {
+    vec3 B = normalize(cross(N, T)) * S;
 
     mat3 TBN = mat3(T, B, N);
     return normalize(TBN * TN);
@@ -19,6 +19,12 @@ vec3 N_decode(vec3 N) {
     return N * 2.0 - 1.0;
 }
 
+// Decode normal from two channel normal map(e.g. GL_RG8) to shader format[-1, 1], z is reconstructed since tangent space normals face outwards
+vec3 N_decodeXY(vec2 N) {
+    vec2 xy = N * 2.0 - 1.0;
+    return vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+}
+
 // Encode normal from shader format[-1, 1] to GBuffer/Texture storage format[0.0, 1.0]
 vec3 N_encode(vec3 N) {
     return N * 0.5 + 0.5;
@@ -0,0 +1,26 @@
+#ifndef COMMON_VERTEX_GLSL
+#define COMMON_VERTEX_GLSL
+
+// Decode octahedron encoded unit vector
+vec3 V_octDecode(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+    return normalize(v);
+}
+
+// Decode mesh vertex attributes into object space position, normal and tangent(w is bitangent sign)
+// Full float vertices pass through, packed vertices(see PackedVertex in mesh.hpp) are dequantized with the
+// mesh bounds(offset, scale), and scale.w tells which format the bound vertex buffer holds.
+void V_decode(vec4 pos, vec4 normal, vec4 tangent, vec4 offset, vec4 scale, out vec3 P, out vec3 N, out vec4 T) {
+    P = offset.xyz + pos.xyz * scale.xyz;
+    if (scale.w > 0.5) {
+        N = V_octDecode(normal.xy);
+        T = vec4(V_octDecode(tangent.xy), pos.w * 2.0 - 1.0);
+    } else {
+        N = normal.xyz;
+        T = tangent;
+    }
+}
+
+#endif
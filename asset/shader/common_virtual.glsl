@@ -0,0 +1,62 @@
+#ifndef COMMON_VIRTUAL_GLSL
+#define COMMON_VIRTUAL_GLSL
+
+// Software virtual texture(see VirtualTexture): the page table holds a texel per page of each level, which points to the
+// atlas slot of the page or of its nearest resident ancestor.
+layout(binding = 17) uniform sampler2D tVirtualPageTable; // RGBA8: slot x, slot y, resident level, valid
+layout(binding = 18) uniform sampler2D tVirtualAtlas;
+
+uniform ivec4 uVirtualInfo; // x, y: page count of level 0, z: mip levels, w: slots of atlas on each side
+uniform ivec2 uVirtualPage; // x: page size, y: page border in texels
+
+// Map a direction onto equirect uv, u wraps around at theta = ±π.
+vec2 EquirectUV(vec3 dir) {
+    const float PI = 3.14159265359;
+    return vec2(atan(dir.z, dir.x) / (2.0 * PI) + 0.5, asin(clamp(dir.y, -1.0, 1.0)) / PI + 0.5);
+}
+
+ivec2 VirtualPageCount(int level) {
+    return max(uVirtualInfo.xy >> level, ivec2(1));
+}
+
+// Select the mip level from uv derivatives in texels of level 0, derivatives across the u seam are unwrapped.
+float VirtualLevel(vec2 uv, float bias) {
+    vec2 dx = dFdx(uv), dy = dFdy(uv);
+    dx.x -= round(dx.x);
+    dy.x -= round(dy.x);
+    vec2 size = vec2(uVirtualInfo.xy * uVirtualPage.x);
+    dx *= size;
+    dy *= size;
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + bias;
+    return clamp(lod, 0.0, float(uVirtualInfo.z - 1));
+}
+
+ivec2 VirtualPageOf(vec2 uv, int level) {
+    ivec2 count = VirtualPageCount(level);
+    return clamp(ivec2(uv * vec2(count)), ivec2(0), count - 1);
+}
+
+// Pack the page requested at a level for the feedback target(RGBA8: page x, page y, level, requested).
+vec4 VirtualFeedback(vec2 uv, int level) {
+    return vec4(vec3(VirtualPageOf(uv, level), level) / 255.0, 1.0);
+}
+
+// Sample a level bilinearly, texels come from the resident page itself or from its nearest resident ancestor.
+vec4 VirtualSample(vec2 uv, int level) {
+    ivec4 entry = ivec4(texelFetch(tVirtualPageTable, VirtualPageOf(uv, level), level) * 255.0 + 0.5);
+    if (entry.w == 0) { return vec4(0.0); }
+
+    ivec2 count = VirtualPageCount(entry.z);
+    vec2 local  = clamp(uv * vec2(count) - vec2(VirtualPageOf(uv, entry.z)), 0.0, 1.0);
+    float slot  = float(uVirtualPage.x + 2 * uVirtualPage.y);
+    vec2 texel  = vec2(entry.xy) * slot + float(uVirtualPage.y) + local * float(uVirtualPage.x);
+    return textureLod(tVirtualAtlas, texel / (float(uVirtualInfo.w) * slot), 0.0);
+}
+
+// Sample trilinearly between the two levels around lod.
+vec4 VirtualSampleLod(vec2 uv, float lod) {
+    int level = int(lod);
+    return mix(VirtualSample(uv, level), VirtualSample(uv, min(level + 1, uVirtualInfo.z - 1)), fract(lod));
+}
+
+#endif
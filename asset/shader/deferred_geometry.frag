@@ -1,9 +1,10 @@
 #version 450
 
+#include "common_material.glsl"
 #include "common_normal.glsl"
 
 layout(location = 0) in vec3 iFragNormal;
-layout(location = 1) in vec3 iFragTangent;
+layout(location = 1) in vec4 iFragTangent;
 layout(location = 2) in vec2 iFragUV;
 
 layout(binding = 0) uniform sampler2D tAlbedoMap;
@@ -15,11 +16,16 @@ layout(location = 1) out vec4 oFragNormal;
 layout(location = 2) out vec4 oFragMRAO;
 
 void main() {
-    oFragAlbedo = vec4(texture(tAlbedoMap, iFragUV).rgb, 0.0);
-    oFragNormal = vec4(N_encode(N_toWorld(
-        iFragNormal, 
-        iFragTangent, 
-        N_decode(texture(tNormalMap, iFragUV).xyz)
-    )), 0.0);
-    oFragMRAO   = texture(tMRAOMap, iFragUV);
+    vec3 N = normalize(iFragNormal);
+    if (M_hasMap(M_NORMAL_MAP)) {
+        N = N_toWorld(
+            N, 
+            iFragTangent.xyz, 
+            N_decodeXY(M_normal(tNormalMap, iFragUV)),
+            iFragTangent.w
+        );
+    }
+    oFragAlbedo = vec4(M_albedo(tAlbedoMap, iFragUV), 0.0);
+    oFragNormal = vec4(N_encode(N), 0.0);
+    oFragMRAO   = vec4(M_mrao(tMRAOMap, iFragUV), 1.0);
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #version 450
 
 #include "common_brdf.glsl"
+#include "common_irradiance.glsl"
 #include "common_normal.glsl"
 #include "common_shadow.glsl"
 
@@ -36,7 +37,6 @@ layout(binding = 8) uniform sampler2D tAlbedoMap;
 layout(binding = 9) uniform sampler2D tNormalMap;
 layout(binding = 10) uniform sampler2D tMRAOMap;
 layout(binding = 11) uniform sampler2D tDepthMap; // GL_DEPTH_COMPONENT24, .x is the depth value
-layout(binding = 14) uniform samplerCube tIBLDiffuseMap;
 layout(binding = 15) uniform samplerCube tIBLSpecularMap;
 layout(binding = 26) uniform samplerCube tIBLBRDFLUTMap;
 layout(binding = 19) uniform sampler2D tShadowDepthMap; // GL_DEPTH_COMPONENT24, .x is the depth value
@@ -87,7 +87,7 @@ void main() {
     float NdotV = clamp(dot(N, V), 0.0, 1.0);
     vec3 kS = F_Schlick(NdotV, F0);
     vec3 kD = (vec3(1.0) - kS) * (1.0 - metallic);
-    vec3 irradiance = texture(tIBLDiffuseMap, N).rgb;
+    vec3 irradiance = SH_irradiance(N);
     vec3 indLightColor = kD * albedo * irradiance;
 
     oFragColor = vec4(dLightColor + indLightColor, 1.0);
@@ -1,12 +1,14 @@
 #version 450
 
 #include "common_brdf.glsl"
+#include "common_irradiance.glsl"
+#include "common_material.glsl"
 #include "common_normal.glsl"
 #include "common_shadow.glsl"
 
 layout(location = 0) in vec3 iFragPos;
 layout(location = 1) in vec3 iFragNormal;
-layout(location = 2) in vec3 iFragTangent;
+layout(location = 2) in vec4 iFragTangent;
 layout(location = 3) in vec2 iFragUV;
 layout(location = 4) in vec3 iFragView;
 
@@ -25,7 +27,6 @@ uniform int uLightCount;
 layout(binding = 0) uniform sampler2D tAlbedoMap;
 layout(binding = 1) uniform sampler2D tNormalMap;
 layout(binding = 2) uniform sampler2D tMRAOMap;
-layout(binding = 14) uniform samplerCube tIBLDiffuseMap;
 layout(binding = 15) uniform samplerCube tIBLSpecularMap;
 layout(binding = 16) uniform sampler2D tIBLBRDFLUTMap;
 layout(binding = 19) uniform sampler2D tShadowDepthMap; // GL_DEPTH_COMPONENT24, .x is the depth value;
@@ -35,8 +36,8 @@ layout(location = 0) out vec4 oFragColor;
 // layout(location = 2) out vec3 oFragMetallicRoughness;
 
 void main() {
-    vec3 albedo = texture(tAlbedoMap, iFragUV).rgb;
-    vec3 mrao   = texture(tMRAOMap, iFragUV).rgb;
+    vec3 albedo = M_albedo(tAlbedoMap, iFragUV);
+    vec3 mrao   = M_mrao(tMRAOMap, iFragUV);
     float metallic = mrao.r;
     float roughness = mrao.g;
     float ao        = mrao.b;
@@ -44,9 +45,11 @@ void main() {
     vec3 F0 =  mix(vec3(0.04), albedo, metallic);
     vec3 V = normalize(iFragView); // frag -> camera
     vec3 N = normalize(iFragNormal);
-    vec3 T = normalize(iFragTangent);
-    vec3 TN = N_decode(texture(tNormalMap, iFragUV).xyz);
-    N = N_toWorld(N, T, TN);
+    vec3 T = normalize(iFragTangent.xyz);
+    if (M_hasMap(M_NORMAL_MAP)) {
+        vec3 TN = N_decodeXY(M_normal(tNormalMap, iFragUV));
+        N = N_toWorld(N, T, TN, iFragTangent.w);
+    }
     float NdotV = clamp(dot(N, V), 0.0, 1.0);
 
     // ----------------------------------------------------------------
@@ -67,7 +70,7 @@ void main() {
     // ----------------------------------------------------------------
     // Evaluate indirect light color
     // ----------------------------------------------------------------
-    vec3 irradiance = texture(tIBLDiffuseMap, N).rgb;
+    vec3 irradiance = SH_irradiance(N);
     vec3 filteredColor = textureLod(tIBLSpecularMap, N, roughness * 5).rgb;
     vec2 brdf = texture(tIBLBRDFLUTMap, vec2(NdotV, roughness)).rg;
     vec3 kS = F0 * brdf.x + brdf.y;
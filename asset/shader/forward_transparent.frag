@@ -1,6 +1,7 @@
 #version 450
 
 #include "common_brdf.glsl"
+#include "common_material.glsl"
 #include "common_normal.glsl"
 #include "common_shadow.glsl"
 #include "common_sampling.glsl"
@@ -8,7 +9,7 @@
 
 layout(location = 0) in vec3 iFragPos;
 layout(location = 1) in vec3 iFragNormal;
-layout(location = 2) in vec3 iFragTangent;
+layout(location = 2) in vec4 iFragTangent;
 layout(location = 3) in vec2 iFragUV;
 layout(location = 4) in vec3 iFragView; // view direction from vertex to camera
 layout(location = 5) in vec3 iFragScreenUVDepth; // screen space uv and depth
@@ -41,7 +42,6 @@ uniform int uLightCount;
 layout(binding = 0) uniform sampler2D tAlbedoMap;
 layout(binding = 1) uniform sampler2D tNormalMap;
 layout(binding = 2) uniform sampler2D tMRAOMap;
-layout(binding = 14) uniform samplerCube tIBLDiffuseMap;
 layout(binding = 15) uniform samplerCube tIBLSpecularMap;
 layout(binding = 16) uniform sampler2D tIBLBRDFLUTMap;
 layout(binding = 19) uniform sampler2D tShadowDepthMap; // GL_DEPTH_COMPONENT24, .x is the depth value;
@@ -53,8 +53,8 @@ uniform float uDistortion = 1.0;
 out vec4 oFragColor;
 
 void main() {
-    vec3 albedo = texture(tAlbedoMap, iFragUV).rgb;
-    vec3 mrao   = texture(tMRAOMap, iFragUV).rgb;
+    vec3 albedo = M_albedo(tAlbedoMap, iFragUV);
+    vec3 mrao   = M_mrao(tMRAOMap, iFragUV);
     float metallic  = mrao.r;
     float roughness = mrao.g;
     float ao        = mrao.b;
@@ -62,9 +62,11 @@ void main() {
     vec3 F0 = mix(vec3(0.04), albedo, metallic);
     vec3 V = normalize(iFragView); // frag -> camera
     vec3 N = normalize(iFragNormal); // primitive normal in world space
-    vec3 T = normalize(iFragTangent);
-    vec3 TN = N_decode(texture(tNormalMap, iFragUV).xyz); // frag normal in tangent space
-    N = N_toWorld(N, T, TN);  // convert frag normal to world space with help of primitive normal and frag tangent
+    vec3 T = normalize(iFragTangent.xyz);
+    if (M_hasMap(M_NORMAL_MAP)) {
+        vec3 TN = N_decodeXY(M_normal(tNormalMap, iFragUV)); // frag normal in tangent space
+        N = N_toWorld(N, T, TN, iFragTangent.w);  // convert frag normal to world space with help of primitive normal and frag tangent
+    }
     float NdotV = clamp(dot(N, V), 0.0, 1.0);
 
     // ----------------------------------------------------------------
@@ -1,10 +1,11 @@
 #version 450
 
 #include "common_normal.glsl"
+#include "common_vertex.glsl"
 
-layout(location = 0) in vec3 iVertPos;
-layout(location = 1) in vec3 iVertNormal;
-layout(location = 2) in vec3 iVertTangent;
+layout(location = 0) in vec4 iVertPos;
+layout(location = 1) in vec4 iVertNormal;
+layout(location = 2) in vec4 iVertTangent;
 layout(location = 3) in vec2 iVertUV;
 
 layout(std140, binding = 0) uniform CameraBlock {
@@ -22,22 +23,29 @@ layout(std140, binding = 0) uniform CameraBlock {
 layout(std140, binding = 1) uniform ModelBlock {
     mat4 uModelMatrix;
     mat4 uNormalMatrix;
+    vec4 uPositionOffset;
+    vec4 uPositionScale;
+    vec4 uTexcoordTransform;
 };
 
 layout(location = 0) out vec3 oFragPos;
 layout(location = 1) out vec3 oFragNormal;
-layout(location = 2) out vec3 oFragTangent;
+layout(location = 2) out vec4 oFragTangent;
 layout(location = 3) out vec2 oFragUV;
 layout(location = 4) out vec3 oFragView; // view direction from vertex to camera
 layout(location = 5) out vec3 oFragScreenUVDepth; // screen space uv and depth
 
 void main() {
-    gl_Position = uProjMatrix * uViewMatrix * uModelMatrix * vec4(iVertPos, 1.0);
+    vec3 P, N;
+    vec4 T;
+    V_decode(iVertPos, iVertNormal, iVertTangent, uPositionOffset, uPositionScale, P, N, T);
 
-    oFragPos = (uModelMatrix * vec4(iVertPos, 1.0)).xyz;
-    oFragNormal = (uNormalMatrix * vec4(iVertNormal, 0.0)).xyz;
-    oFragTangent = (uModelMatrix * vec4(iVertTangent, 0.0)).xyz;
-    oFragUV = iVertUV;
-    oFragView = uCameraPos -iVertPos; 
+    gl_Position = uProjMatrix * uViewMatrix * uModelMatrix * vec4(P, 1.0);
+
+    oFragPos = (uModelMatrix * vec4(P, 1.0)).xyz;
+    oFragNormal = (uNormalMatrix * vec4(N, 0.0)).xyz;
+    oFragTangent = vec4((uModelMatrix * vec4(T.xyz, 0.0)).xyz, T.w);
+    oFragUV = iVertUV * uTexcoordTransform.xy + uTexcoordTransform.zw;
+    oFragView = uCameraPos -P; 
     oFragScreenUVDepth = gl_Position.xyz / gl_Position.w;
 }
\ No newline at end of file
@@ -1,13 +1,16 @@
 #version 450
 
-layout(location = 0) in vec3 iVertPos;
+layout(location = 0) in vec4 iVertPos;
 
 layout(std140, binding = 1) uniform ModelBlock {
     mat4 uModelMatrix;
     mat4 uNormalMatrix;
+    vec4 uPositionOffset;
+    vec4 uPositionScale;
 };
 uniform mat4 uLightViewProjMatrix;
 
 void main() {
-    gl_Position = uLightViewProjMatrix * uModelMatrix * vec4(iVertPos, 1.0);
+    vec3 P = uPositionOffset.xyz + iVertPos.xyz * uPositionScale.xyz; // dequantize packed position, identity for float vertices
+    gl_Position = uLightViewProjMatrix * uModelMatrix * vec4(P, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 450
+
+#include "common_virtual.glsl"
+
+layout(location = 0) in vec3 iFragDir;
+
+out vec4 oFragColor;
+
+void main() {
+    vec2 uv    = EquirectUV(normalize(iFragDir));
+    oFragColor = vec4(VirtualSampleLod(uv, VirtualLevel(uv, 0.0)).rgb, 1.0);
+}
@@ -0,0 +1,14 @@
+#version 450
+
+#include "common_virtual.glsl"
+
+layout(location = 0) in vec3 iFragDir;
+
+uniform float uVirtualBias; // the feedback target is smaller than the screen, -log2 of the ratio restores the level sampled on screen
+
+out vec4 oFragColor;
+
+void main() {
+    vec2 uv    = EquirectUV(normalize(iFragDir));
+    oFragColor = VirtualFeedback(uv, int(VirtualLevel(uv, uVirtualBias)));
+}
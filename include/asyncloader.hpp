@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tinyglrenderer {
+
+struct LoadRecord {
+    std::string name;          // asset name
+    bool done         = false; // uploaded on GL thread, or failed
+    bool failed       = false; // decode or upload threw, the placeholder resource is kept
+    double decodeTime = 0.0;   // time spent on worker thread in milliseconds
+    double uploadTime = 0.0;   // time spent on GL thread in milliseconds
+    std::string error;         // reason of failure
+};
+
+/**
+ * @brief Worker pool decoding assets off the GL thread, plus a bounded upload queue drained by the GL thread.
+ * @details A task runs on a worker thread and does all the CPU work(parsing, cooking, image decoding), then
+ * returns an upload closure which touches GL objects and therefore runs on the GL thread. Workers block once
+ * `capacity` decoded assets wait for upload, so decoded data does not pile up in memory faster than the GL
+ * thread consumes it. The GL thread drains uploads each frame within a time budget.
+ *
+ *   submit ──► task queue ──► worker 0..n ──► upload queue(bounded) ──► drain(budget) on GL thread
+ *              (GL thread)    parse, cook,     decoded CPU data          create buffers/textures,
+ *                             decode images                              swap out placeholders
+ *
+ * @note The parallelFor of a task is capped by the cores divided by the tasks running when it starts, a single large
+ * asset gets every core while concurrent loads do not oversubscribe them.
+ * @note Uploads may submit further tasks(e.g. the textures of a model's materials). Workers are started
+ * with the first task, so a loader which is never used costs no threads.
+ */
+class AsyncLoader {
+   public:
+    using Upload  = std::function<void()>;
+    using Task    = std::function<Upload()>;
+    using Failure = std::function<void(const std::string& error)>;
+
+    // @param threads The worker thread count, 0 means std::thread::hardware_concurrency() - 1(at least 1).
+    // @param capacity The count of decoded assets allowed to wait for upload.
+    explicit AsyncLoader(unsigned threads = 0, size_t capacity = 8);
+    ~AsyncLoader();
+
+    AsyncLoader(const AsyncLoader&)            = delete;
+    AsyncLoader& operator=(const AsyncLoader&) = delete;
+
+    // Queue a task, it runs on a worker thread and returns the upload to run on GL thread(an empty upload is skipped).
+    // @param name The asset name shown in load records.
+    // @param failure Called on GL thread(from drain) if the task or its upload throws, e.g. to forget a pending request.
+    void submit(const std::string& name, Task task, Failure failure = nullptr);
+    // Run decoded uploads on the calling(GL) thread until the time budget is spent, at least one upload runs if any.
+    // @param budget The time budget in milliseconds.
+    // @return The count of uploads run.
+    size_t drain(float budget);
+    // Drop queued tasks, uploads and records. Tasks already running on workers finish and their uploads are dropped.
+    void cancel();
+
+    bool isIdle() const;
+    size_t getDoneCount() const;
+    size_t getTotalCount() const;
+    std::vector<LoadRecord> getRecords() const;
+
+   private:
+    void work();
+
+    struct Job {
+        size_t id         = 0; // index in m_records
+        size_t generation = 0; // value of m_generation when queued, jobs of a cancelled generation are dropped
+        Task task;
+        Upload upload;
+        Failure failure;
+        std::string error; // reason the task threw, the failure is handed to GL thread instead of an upload
+    };
+
+    unsigned m_threads;
+    size_t m_capacity;
+    std::vector<std::thread> m_workers;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_taskReady;   // signals workers that a task is queued or loader stops
+    std::condition_variable m_uploadSpace; // signals workers that the upload queue has room or loader stops
+    std::deque<Job> m_tasks;
+    std::deque<Job> m_uploads;
+    std::vector<LoadRecord> m_records;
+    size_t m_running    = 0; // tasks running on workers
+    size_t m_done       = 0;
+    size_t m_generation = 0;
+    bool m_stop         = false;
+};
+
+} // namespace tinyglrenderer
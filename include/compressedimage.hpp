@@ -0,0 +1,105 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "image.hpp"
+#include "texture.hpp"
+
+namespace tinyglrenderer {
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Block compressed image with its mip chain, loaded from DDS/KTX2 containers or encoded from an Image.
+ * @details Texels are stored in 4x4 blocks which the GPU samples without decompressing them, so both video
+ * memory and sampling bandwidth shrink by the ratio of block size to 16 uncompressed texels.
+ *
+ *   ┌────────┬────────────┬─────────────┬───────────────────────────────┬──────┬────────┐
+ *   │ format │ block size │ bits/texel  │ channels                      │ load │ encode │
+ *   ├────────┼────────────┼─────────────┼───────────────────────────────┼──────┼────────┤
+ *   │ BC1    │ 8 bytes    │ 4           │ rgb(+1 bit alpha)             │ yes  │ yes    │
+ *   │ BC2    │ 16 bytes   │ 8           │ rgb + 4 bits alpha            │ yes  │ no     │
+ *   │ BC3    │ 16 bytes   │ 8           │ rgb + interpolated alpha      │ yes  │ yes    │
+ *   │ BC4    │ 8 bytes    │ 4           │ r                             │ yes  │ yes    │
+ *   │ BC5    │ 16 bytes   │ 8           │ rg(e.g. tangent space normal) │ yes  │ yes    │
+ *   │ BC6H   │ 16 bytes   │ 8           │ rgb half float                │ yes  │ no     │
+ *   │ BC7    │ 16 bytes   │ 8           │ rgba                          │ yes  │ no     │
+ *   └────────┴────────────┴─────────────┴───────────────────────────────┴──────┴────────┘
+ *
+ * Levels are stored back to back from level 0, each level is a row major grid of ceil(w/4) x ceil(h/4) blocks.
+ *
+ * @note Containers store the top row first while textures of the renderer hold the bottom row first(images are
+ * decoded with flip), blocks of BC1-BC5 can be flipped losslessly, BC6H/BC7 can not and are loaded as they are.
+ */
+class CompressedImage {
+   private:
+    CompressedImage() = default;
+
+   public:
+    CompressedImage(const CompressedImage&)            = delete;
+    CompressedImage& operator=(const CompressedImage&) = delete;
+    ~CompressedImage()                                 = default;
+
+    const std::string& getFilePath() const { return m_filepath; }
+    GLenum getInternalFormat() const { return m_internalFormat; }
+    GLsizei getMipLevels() const { return static_cast<GLsizei>(m_levels.size()); }
+    GLsizei getWidth(GLint level) const { return m_levels.at(level).width; }
+    GLsizei getHeight(GLint level) const { return m_levels.at(level).height; }
+    // Get the blocks of a mip level.
+    const uint8_t* getData(GLint level) const { return m_data.data() + m_levels.at(level).offset; }
+    // Get the byte size of blocks of a mip level.
+    size_t getSize(GLint level) const { return m_levels.at(level).size; }
+    // Get the byte size of all mip levels.
+    size_t getByteSize() const { return m_data.size(); }
+
+    // Load a DDS or KTX2 container holding a block compressed 2d texture, supercompressed(Basis/zstd) KTX2 files are not supported.
+    // @param path The path of .dds or .ktx2 file.
+    // @param flip Whether to flip rows vertically, like Image::create.
+    // @return The loaded image.
+    static std::shared_ptr<CompressedImage> create(const fs::path& path, bool flip = false);
+    // Encode an image into blocks, with a full mip chain box filtered from it(in linear space for sRGB formats).
+    // @param image The 8 or 16 bits image to encode, HDR images are not supported.
+    // @param internalFormat One of BC1, BC3, BC4 or BC5 formats, see Texture::getCompressedFormat.
+    // @param threads The count of threads encoding block rows, 0 means std::thread::hardware_concurrency()(see parallelFor).
+    // @return The encoded image, rows keep the order of source image.
+    static std::shared_ptr<CompressedImage> encode(const std::shared_ptr<Image>& image, GLenum internalFormat, unsigned threads = 0);
+    // Save into a DDS container with DX10 header, rows are written as stored(load it back with flip = false).
+    // @param path The path of .dds file.
+    void save(const fs::path& path) const;
+
+    // Check whether a file is a compressed texture container by its extension.
+    static bool isCompressed(const fs::path& path);
+    // Check whether an image has translucent texels, which needs BC3 instead of BC1.
+    static bool hasAlpha(const std::shared_ptr<Image>& image);
+
+   private:
+    struct Level {
+        GLsizei width  = 0;
+        GLsizei height = 0;
+        size_t offset  = 0; // offset of blocks in m_data
+        size_t size    = 0; // byte size of blocks
+    };
+
+    // Append a level of given size, blocks are left zeroed.
+    void push(GLsizei width, GLsizei height);
+    // Flip rows of all levels vertically by reordering block rows and the texel rows inside blocks.
+    // @return false if blocks of the format can not be flipped.
+    bool flip();
+
+    static std::shared_ptr<CompressedImage> loadDDS(const fs::path& path);
+    static std::shared_ptr<CompressedImage> loadKTX2(const fs::path& path);
+
+    std::string m_filepath;
+    GLenum m_internalFormat = 0;
+    std::vector<Level> m_levels;
+    std::vector<uint8_t> m_data;
+};
+
+} // namespace tinyglrenderer
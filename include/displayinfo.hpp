@@ -1,4 +1,5 @@
 #include <cstdint>
+#include <vector>
 
 namespace tinyglrenderer {
 
@@ -6,6 +7,11 @@ struct DisplayInfo {
     float framePerSecond = 0;
     float deltaTime      = 0;
     size_t drawCall      = 0;
+    size_t clusterTested = 0; // clusters tested by culling in last frame
+    size_t clusterDrawn  = 0; // clusters survived culling in last frame
+    size_t assetLoaded   = 0; // assets loaded asynchronously(including failed ones)
+    size_t assetTotal    = 0; // assets submitted to asynchronous loader
+    std::vector<size_t> lodTriangles; // triangles submitted per level of detail in last frame
 };
 
 } // namespace tinyglrenderer
\ No newline at end of file
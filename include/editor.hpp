@@ -9,9 +9,11 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "displayinfo.hpp"
 #include "editorsetting.hpp"
+#include "mappedfile.hpp"
 #include "renderersetting.hpp"
 #include "resourcemanager.hpp"
 #include "scene.hpp"
@@ -44,10 +46,15 @@ class Editor {
     void drawSideBar(Scene& scene);
     void drawResourcePanel(Scene& scene, ResourceManager& manager);
     void drawHUD(Scene& scene, const DisplayInfo& info);
+    // Draw a read-only view of a text file, only the visible lines are touched.
+    void drawFilePreview(const fs::path& path);
 
     std::unordered_map<std::string, std::function<bool()>> m_funcs;
     std::unordered_map<std::string, ImFont*> m_fonts; // no need RAII, ImGui::DestroyContext() is called in Application::shutdown()
 
+    std::unique_ptr<MappedFile> m_preview;  // memory mapped file under preview, released when nothing is previewed
+    std::vector<uint32_t> m_previewLines;   // start offset of every line in m_preview
+
     EditorSetting& m_setting;
     RendererSetting& m_rendererSetting;
 };
@@ -13,6 +13,8 @@ enum class ResourcePanelTab {
     RP_TAB_MESHES = 0,
     RP_TAB_SHADERS,
     RP_TAB_TEXTURES,
+    RP_TAB_LOADING,
+    RP_TAB_MEMORY,
 };
 
 enum class EditorTheme {
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <obj_loader/tiny_obj_loader.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mappedfile.hpp"
+#include "mesh.hpp"
+
+namespace tinyglrenderer {
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief glTF 2.0 importer for .gltf(external or base64 embedded buffers) and .glb(binary chunk) files.
+ * @details The file and its external buffers are memory mapped and accessors are resolved into pointers
+ * inside them. When every primitive already holds float position/normal/tangent/texcoord streams with
+ * tight strides and 16/32 bits indices, and no node transform needs baking, the mesh is direct: its
+ * buffers are created empty and each accessor range is uploaded in place, so no vertex is touched on
+ * the CPU. Other files are converted into tinyobj containers and cooked like obj models.
+ *
+ *   .glb ──mmap──► ┌ header ┬ JSON chunk ┬ BIN chunk ─────────────────────────────────────┐
+ *                  │        │ accessors, │ [ positions ][ normals ][ tangents ][ uvs ][ i ]│
+ *                  └────────┴ materials ─┴──────┬───────────┬──────────┬────────┬─────┬───┘
+ *                                               ▼ upload    ▼          ▼        ▼     ▼
+ *                  VertexBuffer  [ positions 0..n ][ normals 0..n ][ tangents 0..n ][ uvs 0..n ]
+ *                  IndexBuffer   [ indices of primitive 0 ][ indices of primitive 1 ] ...
+ *
+ * Primitives are appended to each stream in order and drawn with their first vertex as base vertex,
+ * a stream without data(e.g. no TEXCOORD_0) is bound with stride 0 to a zeroed element. glTF places
+ * the texture origin at the top left, see Mesh::getTexcoordTransform.
+ *
+ * @note Only triangle primitives are imported. Sparse accessors, morph targets, skins, cameras and
+ * embedded images are not supported, materials fall back to their factors for embedded images.
+ */
+class GltfParser {
+   public:
+    // Parse glTF file and map the buffers it references.
+    // @param path The path of .gltf or .glb file.
+    explicit GltfParser(const fs::path& path);
+    GltfParser(const GltfParser&)            = delete;
+    GltfParser& operator=(const GltfParser&) = delete;
+    ~GltfParser();
+
+    const fs::path& getFilePath() const { return m_filepath; }
+    // Check whether mesh is uploaded straight from buffers(see createMesh), otherwise it has to be cooked from load().
+    bool isDirect() const { return m_direct; }
+    const std::vector<tinyobj::material_t>& getMaterials() const { return m_materials; }
+    // Get the byte size of glTF file and the buffers it references.
+    size_t getSize() const;
+
+    // Convert triangles into tinyobj containers with node transforms baked, texcoords are flipped into obj convention(origin at bottom left).
+    void load(tinyobj::attrib_t* attributes, std::vector<tinyobj::shape_t>* shapes) const;
+    // Create mesh by uploading accessor ranges straight from the mapped buffers, only valid if isDirect().
+    std::shared_ptr<Mesh> createMesh() const;
+
+    // Hash the content of glTF file and the external buffers it references.
+    // @return The 64 bits FNV-1a hash of file contents, see MappedFile::hash.
+    uint64_t hash() const;
+
+    // Check whether a file is a glTF model by its extension.
+    static bool isGltf(const fs::path& path);
+
+   private:
+    struct Accessor {
+        const uint8_t* data = nullptr; // first element inside a mapped or decoded buffer
+        size_t count        = 0;       // element count
+        size_t stride       = 0;       // distance between elements in bytes
+        int componentType   = 0;       // GL_FLOAT, GL_UNSIGNED_SHORT, ...(glTF uses GL enums)
+        int components      = 0;       // 1 for SCALAR, 2 for VEC2, ... 16 for MAT4
+        bool normalized     = false;   // integer components are mapped to [0, 1] or [-1, 1]
+        bool bounded        = false;   // min and max are declared
+        glm::vec4 min       = glm::vec4(0.f);
+        glm::vec4 max       = glm::vec4(0.f);
+    };
+
+    struct Primitive {
+        int position = -1, normal = -1, tangent = -1, texcoord = -1, indices = -1; // accessor indices, -1 is absent
+        int material = -1;                                                         // material index, -1 is default material
+        glm::mat4 transform = glm::mat4(1.f);                                      // world transform of node
+    };
+
+    // Read element of accessor as float vector, normalized integers are mapped into floats.
+    glm::vec4 read(const Accessor& accessor, size_t index) const;
+    // Read index of accessor, a primitive without indices counts up from 0.
+    uint32_t readIndex(int accessor, size_t index) const;
+    // Check whether primitives are laid out as the streams of VertexFormat::VF_STREAMS with every index inside its primitive, and plan their uploads.
+    bool plan();
+
+    fs::path m_filepath;
+    std::vector<std::unique_ptr<MappedFile>> m_files;   // glTF file first, then external buffers
+    std::vector<std::vector<uint8_t>> m_decoded;        // buffers embedded as base64 data uri
+    std::vector<std::pair<const uint8_t*, size_t>> m_buffers; // bytes of each glTF buffer
+    std::vector<Accessor> m_accessors;
+    std::vector<Primitive> m_primitives;
+    std::vector<tinyobj::material_t> m_materials;
+    bool m_direct = false;
+
+    // Direct upload plan, see plan()
+    std::vector<MeshStream> m_streams;
+    std::vector<MeshUpload> m_vertexUploads;
+    std::vector<MeshUpload> m_indexUploads;
+    std::vector<SubMesh> m_submeshes;
+    std::pair<glm::vec3, glm::vec3> m_bounds = {glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)};
+    MeshStats m_stats;
+};
+
+} // namespace tinyglrenderer
@@ -5,7 +5,8 @@
 namespace tinyglrenderer {
 class GraphicBuffer {
    public:
-    GraphicBuffer(GLenum target, GLsizeiptr size, const void* data = nullptr);
+    // @param flags The storage flags of immutable storage, e.g. GL_MAP_PERSISTENT_BIT for buffers mapped for their whole lifetime.
+    GraphicBuffer(GLenum target, GLsizeiptr size, const void* data = nullptr, GLbitfield flags = GL_DYNAMIC_STORAGE_BIT);
     ~GraphicBuffer();
 
     GraphicBuffer(const GraphicBuffer&)            = delete;
@@ -29,6 +29,8 @@ class Image {
     int getWidth() const { return m_width; }
     int getHeight() const { return m_height; }
     int getChannels() const { return m_channels; }
+    // Get the size of pixel data in bytes, packed types(e.g. GL_UNSIGNED_INT_5_9_9_9_REV) hold a whole texel in one value
+    size_t getByteSize() const;
     // Get CPU memory data type (how pixel data is stored in RAM)
     GLenum getDataType() const { return m_type; }
     // Get CPU memory channel order (how pixel data is arranged in RAM)
@@ -48,11 +50,31 @@ class Image {
     // @param flip Whether to flip the image vertically.
     // @return The created image.
     static std::shared_ptr<Image> create(const std::filesystem::path& path, int desiredChannels = 0, bool flip = false);
+    // Create image objects from files, decoding them concurrently
+    // @param paths The image file paths to load.
+    // @param desiredChannels The desired channels of every image.
+    // @param flip Whether to flip the images vertically.
+    // @param threads The count of decoding threads, 0 means std::thread::hardware_concurrency(), at most one per image(see parallelFor).
+    // @return The created images in the order of paths, the first failure is rethrown after all threads finish.
+    static std::vector<std::shared_ptr<Image>> create(const std::vector<std::filesystem::path>& paths, int desiredChannels = 0, bool flip = false, unsigned threads = 0);
     // Merge multiple image objects into a single image object by channel packing
+    // @note Sources of narrower types are promoted to the widest source type(e.g. 8 bits 0xff to 16 bits 0xffff), channels left over are filled with the max value.
     // @param images The image objects to merge.
-    // @param channels The desired channels of the merged image.
+    // @param channels The desired channels of the merged image, at most 4.
+    // @param srcChannels The channel taken from each image(e.g. roughness is G of glTF metallicRoughnessTexture), -1 or absent takes all channels of the image.
     // @return The merged image.
-    static std::shared_ptr<Image> merge(const std::vector<std::shared_ptr<Image>>& images, int channels);
+    static std::shared_ptr<Image> merge(const std::vector<std::shared_ptr<Image>>& images, int channels, const std::vector<int>& srcChannels = {});
+    // Convert a float(HDR) image into a compact layout that uploads into GL_RGB9_E5 or 16 bits float textures without conversion by the driver
+    // @note The converted image is meant for Texture::upload only, its data type is a packed type which other image operations do not handle.
+    // @param image The float image to convert.
+    // @param type GL_UNSIGNED_INT_5_9_9_9_REV(shared exponent rgb, alpha is dropped) or GL_HALF_FLOAT.
+    // @return The converted image.
+    static std::shared_ptr<Image> convert(const std::shared_ptr<Image>& image, GLenum type);
+    // Extract one channel of an image object into a single channel image
+    // @param image The image object to extract from.
+    // @param channel The channel index to extract.
+    // @return The extracted image.
+    static std::shared_ptr<Image> extract(const std::shared_ptr<Image>& image, int channel);
     // Resize an image object to the specified width and height
     // @param image The image object to resize.
     // @param width The desired width of the resized image.
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace tinyglrenderer {
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Read-only memory mapped file.
+ * @note Pages are faulted in lazily by the OS on first access, so mapping a large file is cheap
+ * and only the touched ranges become resident. The mapping is released on destruction.
+ */
+class MappedFile {
+   public:
+    MappedFile(const fs::path& path);
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    const fs::path& getFilePath() const { return m_filepath; }
+    const uint8_t* getData() const { return m_data; }
+    size_t getSize() const { return m_size; }
+    std::string_view getView() const { return {reinterpret_cast<const char*>(m_data), m_size}; }
+
+    // Hash the whole content of mapped file.
+    // @return The 64 bits FNV-1a hash of file content.
+    uint64_t hash() const { return hash(m_data, m_size); }
+
+    // Hash a block of memory with 64 bits FNV-1a, chain calls by passing the previous result as seed.
+    // @param data The memory to hash.
+    // @param size The size of memory in bytes.
+    // @param seed The initial hash value.
+    static uint64_t hash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+   private:
+    fs::path m_filepath;
+    uint8_t* m_data = nullptr;
+    size_t m_size   = 0;
+};
+
+} // namespace tinyglrenderer
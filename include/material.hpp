@@ -2,7 +2,9 @@
 
 #include <obj_loader/tiny_obj_loader.h>
 
+#include <cstdint>
 #include <filesystem>
+#include <glm/glm.hpp>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
@@ -10,11 +12,38 @@
 #include <unordered_map>
 
 #include "texture.hpp"
+#include "texturepool.hpp"
+#include "uniformbuffer.hpp"
 
 namespace tinyglrenderer {
 
 namespace fs = std::filesystem;
 
+enum class MaterialMap : uint32_t {
+    MM_ALBEDO = 1 << 0, // sample "albedo" texture instead of albedo factor
+    MM_NORMAL = 1 << 1, // sample "normal" texture instead of vertex normal
+    MM_MRAO   = 1 << 2, // sample "mrao" texture instead of metallic, roughness and ao factors
+};
+
+struct alignas(16) MaterialBlock {
+    glm::vec4 albedo = glm::vec4(1.f);              // albedo factor(rgb) and opacity(a)
+    glm::vec4 mrao   = glm::vec4(0.f, 1.f, 1.f, 0.f); // metallic, roughness and ao factors
+    glm::uvec4 maps  = glm::uvec4(0);              // .x is the bitmask of sampled textures, .y of those sampled from texture pool, see MaterialMap
+    glm::uvec4 layers = glm::uvec4(0);             // texture pool handles of albedo, normal and mrao, see TexturePool::Layer
+};
+
+/**
+ * @brief Surface parameters of submeshes, constant factors plus the textures replacing them.
+ * @details Factors live in a MaterialBlock uploaded to a uniform buffer of the material(binding point 2),
+ * and shaders only sample the textures flagged in MaterialBlock::maps(see common_material.glsl). A map
+ * which is absent, or still being decoded, is bound to a shared 1x1 texture and never fetched, so an
+ * untextured material costs neither texture memory nor texture fetches. A map copied into the texture pool
+ * is sampled from its layer(MaterialBlock::layers) and needs no binding per draw.
+ *
+ *   albedo ─┬─ MM_ALBEDO ? texture(tAlbedoMap).rgb : albedo.rgb
+ *   mrao   ─┼─ MM_MRAO   ? texture(tMRAOMap).rgb   : mrao.rgb
+ *   normal ─┴─ MM_NORMAL ? texture(tNormalMap).xy  : vertex normal
+ */
 class Material {
    public:
     Material()  = default;
@@ -23,16 +52,29 @@ class Material {
     Material(const std::string& name, float opacity, const std::unordered_map<std::string, std::shared_ptr<Texture>>& textures);
 
     const std::string& getName() const { return m_name; }
-    bool isOpaque() const { return m_opacity > 0.90f; }
-    float getOpacity() const { return m_opacity; }
+    bool isOpaque() const { return m_block.albedo.w > 0.90f; }
+    float getOpacity() const { return m_block.albedo.w; }
+    const MaterialBlock& getMaterialBlock() const { return m_block; }
     std::shared_ptr<Texture> getTexture(const std::string& name) const;
-    void setOpacity(float opacity) { m_opacity = opacity; }
-    void setTexture(const std::string& name, const std::shared_ptr<Texture>& texture);
+    std::shared_ptr<TexturePool::Layer> getLayer(const std::string& name) const;
+    void setOpacity(float opacity);
+    // Set albedo(rgb), metallic, roughness and ao factors, used where no texture is sampled.
+    void setFactors(const glm::vec3& albedo, float metallic, float roughness, float ao = 1.f);
+    // Set texture of a map.
+    // @param sampled Whether shaders sample the texture, false binds it only(e.g. a shared default texture).
+    void setTexture(const std::string& name, const std::shared_ptr<Texture>& texture, bool sampled = true);
+    // Set texture pool layer of a map, the map is sampled from it and its own texture is dropped.
+    void setLayer(const std::string& name, const std::shared_ptr<TexturePool::Layer>& layer);
+    // Upload the material block if it changed, and bind it to shader binding point. Must be called on GL thread.
+    void bind(GLuint slot);
 
    private:
     std::string m_name;
-    float m_opacity = 1.0f;
+    MaterialBlock m_block;
+    bool m_dirty = true; // block changed since last upload
+    std::unique_ptr<UniformBuffer> m_buffer;
     std::unordered_map<std::string, std::shared_ptr<Texture>> m_textures;
+    std::unordered_map<std::string, std::shared_ptr<TexturePool::Layer>> m_layers;
 };
 
 } // namespace tinyglrenderer
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace tinyglrenderer {
+
+namespace fs = std::filesystem;
+
+enum class MemoryKind : uint32_t {
+    MK_TEXTURE     = 0, // video memory of texture storage
+    MK_BUFFER      = 1, // video memory of buffer storage
+    MK_FRAMEBUFFER = 2, // frame buffer objects, counted only since their attachments are textures
+    MK_IMAGE       = 3, // client memory of decoded images
+    MK_COUNT,
+};
+
+enum class MemoryTag : uint32_t {
+    MT_OTHER      = 0,
+    MT_ATTACHMENT = 1, // render targets of renderer passes
+    MT_MATERIAL   = 2, // material textures, texture pool arrays and their images
+    MT_MESH       = 3, // vertex and index buffers
+    MT_SKYBOX     = 4, // skybox textures, virtual texture page table and atlas
+    MT_IBL        = 5, // prefiltered and brdf lut maps
+    MT_STAGING    = 6, // upload rings and readback buffers
+    MT_UNIFORM    = 7, // uniform and shader storage buffers
+    MT_COUNT,
+};
+
+struct MemoryCounter {
+    size_t bytes = 0; // live bytes
+    size_t peak  = 0; // highest live bytes ever
+    size_t count = 0; // live objects
+};
+
+struct MemoryEntry {
+    MemoryKind kind;
+    MemoryTag tag;
+    std::string label;
+    size_t bytes;
+};
+
+/**
+ * @brief Accounting of the GPU and CPU memory held by every resource object, grouped by kind and owner.
+ * @details Texture, GraphicBuffer, FrameBuffer and Image register themselves in their constructors and leave in
+ * their destructors, the owner is not known there, so it is taken from the innermost Scope of the constructing
+ * thread. Moves keep the entry with the object that owns the storage: a moved-to object that is already tracked
+ * keeps its tag and label and takes the new size(e.g. a texture trimmed or a pool array grown in place).
+ *
+ * ┌──────────────┬──────────────────────────────────────────────────────────────┐
+ * │ kind         │ bytes                                                        │
+ * ├──────────────┼──────────────────────────────────────────────────────────────┤
+ * │ texture      │ Texture::getByteSize, all levels and layers                  │
+ * │ buffer       │ GraphicBuffer::getSize                                       │
+ * │ framebuffer  │ 0, attachments are counted as textures                       │
+ * │ image        │ Image::getByteSize, pixels in client memory                  │
+ * └──────────────┴──────────────────────────────────────────────────────────────┘
+ *
+ *   { MemoryRegistry::Scope scope(MemoryTag::MT_SKYBOX, "skybox_equirect"); texture = load(...); } ──► skybox/skybox_equirect
+ *
+ * @note All methods are thread safe, images are decoded on loader workers.
+ */
+class MemoryRegistry {
+   public:
+    // Tag the objects constructed on current thread while the scope is alive, scopes nest.
+    class Scope {
+       public:
+        // @param label The label of objects, empty keeps the label of enclosing scope.
+        Scope(MemoryTag tag, const std::string& label = "");
+        // Label the objects and keep the tag of enclosing scope, e.g. in loaders called by several owners.
+        explicit Scope(const std::string& label);
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope();
+
+       private:
+        MemoryTag m_prevTag;
+        std::string m_prevLabel;
+    };
+
+    // Get the tag of current scope on this thread, asynchronous loads capture it for their workers.
+    static MemoryTag getTag();
+
+    // Register an object with the tag and label of current scope, an object tracked already is replaced.
+    // @param object The address of object, the key of its entry.
+    static void track(MemoryKind kind, const void* object, size_t bytes);
+    // Unregister an object, nothing happens if it is not tracked.
+    static void untrack(const void* object);
+    // Move the entry of an object to another one it is moved into.
+    // @param from The moved-from object, it is untracked.
+    // @param to The moved-to object, it keeps its tag and label if tracked already.
+    static void transfer(const void* from, const void* to);
+
+    // Get the counter of a kind of objects with a tag, MemoryTag::MT_COUNT for all tags.
+    static MemoryCounter getCounter(MemoryKind kind, MemoryTag tag = MemoryTag::MT_COUNT);
+    // Get the entries of objects with a tag sorted by bytes from large to small, MemoryTag::MT_COUNT for all tags.
+    static void getEntries(std::vector<MemoryEntry>& entries, MemoryTag tag = MemoryTag::MT_COUNT);
+    static const char* getName(MemoryKind kind);
+    static const char* getName(MemoryTag tag);
+
+    // Write counters and entries into a JSON file.
+    // @return True if file is written, False otherwise.
+    static bool dump(const fs::path& path);
+};
+
+} // namespace tinyglrenderer
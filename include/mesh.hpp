@@ -19,41 +19,187 @@ namespace fs = std::filesystem;
 struct Vertex {
     glm::vec3 position; // position
     glm::vec3 normal;   // normal
-    glm::vec3 tangent;  // tangent
+    glm::vec4 tangent;  // tangent, w is the bitangent sign(bitangent = w * cross(normal, tangent))
     glm::vec2 texcoord; // texture coordinate
 };
 
+/**
+ * @brief Quantized vertex of 20 bytes, decoded in vertex shaders(see common_vertex.glsl).
+ *
+ * ┌──────────────┬────────────────────┬──────────────────────────────────────────────────┐
+ * │ attribute    │ storage            │ decoding                                         │
+ * ├──────────────┼────────────────────┼──────────────────────────────────────────────────┤
+ * │ position.xyz │ 3 x unorm16        │ mesh AABB min + value * AABB extent              │
+ * │ position.w   │ unorm16            │ bitangent sign, 0 is -1 and 65535 is +1          │
+ * │ normal       │ 2 x snorm16        │ octahedron encoded unit vector                   │
+ * │ tangent      │ 2 x snorm16        │ octahedron encoded unit vector                   │
+ * │ texcoord     │ 2 x half float     │ as is                                            │
+ * └──────────────┴────────────────────┴──────────────────────────────────────────────────┘
+ */
+struct PackedVertex {
+    uint16_t position[4]; // quantized position and bitangent sign
+    int16_t normal[2];    // octahedron encoded normal
+    int16_t tangent[2];   // octahedron encoded tangent
+    uint16_t texcoord[2]; // half float texture coordinate
+};
+
+enum class VertexFormat : uint32_t {
+    VF_FLOAT  = 0, // Vertex, 48 bytes
+    VF_PACKED = 1, // PackedVertex, 20 bytes
+    VF_STREAMS = 2, // separate position/normal/tangent/texcoord streams of float attributes, see MeshStream
+};
+
+struct MeshOptions {
+    VertexFormat format = VertexFormat::VF_FLOAT; // vertex buffer format
+    bool optimize       = false;                  // reorder triangles and vertices of submeshes, see MeshOptimizer
+    size_t lods         = 1;                      // level of detail count including full resolution, each level halves triangles
+
+    // Get the suffix which tells meshes(and mesh caches) cooked with different options apart.
+    std::string getKey() const {
+        return std::string(format == VertexFormat::VF_PACKED ? "_packed" : "") + (optimize ? "_opt" : "") + (lods > 1 ? "_lod" + std::to_string(lods) : "");
+    }
+};
+
 struct SubMesh {
-    int matid   = -1; // material id(index in m_materials vector of model) -1 represents default material
-    uint offset = 0;  // start index in indices vector
-    uint length = 0;  // length of indices in submesh
+    int matid   = -1;              // material id(index in m_materials vector of model) -1 represents default material
+    uint offset = 0;               // start of indices in index buffer in bytes
+    uint length = 0;               // length of indices in submesh
+    uint vertex = 0;               // base vertex added to every index of submesh
+    GLenum type = GL_UNSIGNED_INT; // index type, GL_UNSIGNED_SHORT if all vertices of submesh fit in 16 bits
+    uint cluster  = 0;             // first cluster of submesh in cluster table
+    uint clusters = 0;             // cluster count of submesh
+};
+
+/**
+ * @brief Small cluster(meshlet) of a submesh, the unit of per frame culling.
+ * @details A submesh is split into clusters of at most 64 vertices and 124 triangles along its triangle
+ * order, each cluster keeps the bounding sphere and normal cone of its triangles in object space.
+ * A cluster is back facing as a whole if dot(center - eye, axis) >= cutoff * |center - eye| + radius.
+ */
+struct MeshCluster {
+    glm::vec4 sphere = glm::vec4(0.f); // bounding sphere, xyz is center and w is radius
+    glm::vec4 cone   = glm::vec4(0.f, 0.f, 0.f, 1.f); // normal cone, xyz is axis and w is cutoff(sine of cone spread), axis 0 never culls
+    uint offset = 0; // start of indices in index buffer in bytes
+    uint length = 0; // length of indices in cluster
+};
+
+// Range of one attribute stream inside the vertex buffer, bound to the vertex buffer slot of the same index.
+struct MeshStream {
+    GLintptr offset = 0; // start of stream in vertex buffer in bytes
+    GLsizei stride  = 0; // distance between elements in bytes, 0 repeats the first element for every vertex
+};
+
+// Block of external memory uploaded into a graphic buffer at an offset.
+struct MeshUpload {
+    const void* data = nullptr;
+    size_t offset    = 0; // destination offset in bytes
+    size_t length    = 0; // length of data in bytes
+};
+
+struct MeshStats {
+    size_t srcVertexCount = 0; // vertex count before welding(3 per triangle)
+    size_t srcBytes       = 0; // vertex and index bytes before welding
+    size_t vertexCount    = 0; // vertex count after welding
+    size_t indexCount     = 0; // index count after welding
+    size_t vertexBytes    = 0; // vertex buffer bytes after welding
+    size_t indexBytes     = 0; // index buffer bytes after welding
+    size_t clusterCount   = 0; // cluster count of all submeshes(and levels)
+    size_t lodCount       = 1; // level of detail count including full resolution
+    float acmr            = 0; // average cache miss ratio(transformed vertices per triangle), see MeshOptimizer
+    float atvr            = 0; // average transform to vertex ratio(transformed vertices per vertex)
+};
+
+struct MeshData {
+    VertexFormat format = VertexFormat::VF_FLOAT;
+    std::vector<Vertex> vertices;   // welded vertices, each submesh owns a contiguous range
+    std::vector<PackedVertex> packed; // quantized vertices, only filled for VertexFormat::VF_PACKED
+    std::vector<uint8_t> indices;   // mixed 16/32 bits index data, each submesh aligned to its index size
+    std::vector<SubMesh> submeshes; // submesh table
+    std::vector<SubMesh> lods;      // coarser levels of submeshes, (lodCount - 1) entries per submesh
+    std::vector<MeshCluster> clusters; // cluster table, each submesh owns a contiguous range
+    std::pair<glm::vec3, glm::vec3> bounds = {glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)};
+    MeshStats stats;
+
+    const void* getVertexData() const { return format == VertexFormat::VF_PACKED ? static_cast<const void*>(packed.data()) : static_cast<const void*>(vertices.data()); }
 };
 
 class Mesh {
    public:
+    // Build mesh from tinyobj loading data.
+    // @param num The material count, triangles without material are grouped into a trailing submesh.
     Mesh(const fs::path& path, const tinyobj::attrib_t& attributes, const std::vector<tinyobj::shape_t>& shapes, size_t num);
+    // Build mesh from cooked geometry.
+    Mesh(const fs::path& path, const MeshData& data);
+    // Build mesh from cooked geometry held in external memory(e.g. a memory mapped cache), buffers are uploaded straight from it.
+    // @param vertices The vertex data of stats.vertexBytes bytes.
+    // @param indices The index data of stats.indexBytes bytes.
+    Mesh(const fs::path& path, VertexFormat format, const void* vertices, const void* indices, const std::vector<SubMesh>& submeshes, const std::vector<SubMesh>& lods,
+         const std::vector<MeshCluster>& clusters, const std::pair<glm::vec3, glm::vec3>& bounds, const MeshStats& stats);
+    // Build mesh of VertexFormat::VF_STREAMS from attribute streams scattered over external memory(e.g. memory mapped glTF buffers).
+    // @param streams The position, normal, tangent and texcoord streams inside vertex buffer of stats.vertexBytes bytes.
+    // @param vertices The blocks uploaded into vertex buffer.
+    // @param indices The blocks uploaded into index buffer of stats.indexBytes bytes.
+    Mesh(const fs::path& path, const std::vector<MeshStream>& streams, const std::vector<MeshUpload>& vertices, const std::vector<MeshUpload>& indices,
+         const std::vector<SubMesh>& submeshes, const std::pair<glm::vec3, glm::vec3>& bounds, const MeshStats& stats);
     Mesh(const Mesh&)            = delete;
     Mesh& operator=(const Mesh&) = delete;
     ~Mesh();
 
     const fs::path& getFilePath() const { return m_filepath; }
-    const std::string& getSource() const { return m_source; }
     size_t getSubMeshCount() const { return m_submeshes.size(); }
-    size_t getVertexCount() const { return m_bufferv ? m_bufferv->getSize() : 0; }
-    size_t getIndexCount() const { return m_bufferi ? m_bufferi->getSize() : 0; }
+    size_t getVertexCount() const { return m_stats.vertexCount; }
+    size_t getIndexCount() const { return m_stats.indexCount; }
+    const MeshStats& getStats() const { return m_stats; }
     const std::pair<glm::vec3, glm::vec3>& getBoundingBox() const { return m_bounds; }
+    VertexFormat getVertexFormat() const { return m_format; }
+    GLsizei getVertexStride() const { return getVertexStride(m_format); }
+    // Get the position dequantization(offset, scale) for vertex shaders, w of scale is 1 for packed vertices.
+    std::pair<glm::vec4, glm::vec4> getQuantization() const;
+    // Get the texture coordinate transform(scale xy, offset zw) for vertex shaders, flips v of glTF streams whose origin is top left.
+    glm::vec4 getTexcoordTransform() const { return m_format == VertexFormat::VF_STREAMS ? glm::vec4(1.f, -1.f, 0.f, 1.f) : glm::vec4(1.f, 1.f, 0.f, 0.f); }
+    // Get the vertex buffer ranges bound to vertex buffer slots, interleaved formats have a single stream.
+    const std::vector<MeshStream>& getStreams() const { return m_streams; }
     const std::vector<SubMesh>& getSubMeshes() const { return m_submeshes; }
+    size_t getLodCount() const { return m_stats.lodCount; }
+    // Get submesh at a level of detail, level 0 is full resolution.
+    const SubMesh& getSubMesh(size_t index, size_t level) const { return level == 0 ? m_submeshes[index] : m_lods[index * (m_stats.lodCount - 1) + level - 1]; }
+    const std::vector<MeshCluster>& getClusters() const { return m_clusters; }
     const std::shared_ptr<VertexLayout>& getVertexLayout() const { return m_layout; }
     const std::unique_ptr<VertexBuffer>& getVertexBuffer() const { return m_bufferv; }
     const std::unique_ptr<IndexBuffer>& getIndexBuffer() const { return m_bufferi; }
 
+    // Weld tinyobj loading data into cooked geometry, no graphic resource is touched.
+    static MeshData cook(const tinyobj::attrib_t& attributes, const std::vector<tinyobj::shape_t>& shapes, size_t num, const MeshOptions& options = {});
+    // Split the triangles of a submesh into clusters.
+    // @param indices The local indices of submesh in final triangle order.
+    // @param vertices The vertices of submesh.
+    // @param offset The start of submesh indices in index buffer in bytes.
+    // @param stride The index size of submesh in bytes.
+    static void clusterize(const std::vector<uint>& indices, const Vertex* vertices, size_t vertexCount, size_t offset, size_t stride, std::vector<MeshCluster>& clusters);
+    // Quantize welded vertices of cooked geometry into packed vertices.
+    static void pack(MeshData& data);
+
+    static constexpr size_t MAX_LOD_COUNT = 5;
+
+    static GLsizei getVertexStride(VertexFormat format) {
+        switch (format) {
+            case VertexFormat::VF_PACKED: return sizeof(PackedVertex);
+            case VertexFormat::VF_STREAMS: return sizeof(float) * 12; // position, normal, tangent and texcoord summed over streams
+            default: return sizeof(Vertex);
+        }
+    }
+
    private:
     fs::path m_filepath;
-    std::string m_source;
+    VertexFormat m_format = VertexFormat::VF_FLOAT;
     std::shared_ptr<VertexLayout> m_layout;            // vertex array object
     std::unique_ptr<VertexBuffer> m_bufferv = nullptr; // vertex buffer object
     std::unique_ptr<IndexBuffer> m_bufferi  = nullptr; // index buffer object
+    std::vector<MeshStream> m_streams;                 // vertex buffer ranges of binding slots
     std::vector<SubMesh> m_submeshes;
+    std::vector<SubMesh> m_lods; // coarser levels of submeshes
+    std::vector<MeshCluster> m_clusters;
+    MeshStats m_stats;
 
     std::pair<glm::vec3, glm::vec3> m_bounds = {glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)};
 };
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <obj_loader/tiny_obj_loader.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "mappedfile.hpp"
+#include "mesh.hpp"
+
+namespace tinyglrenderer {
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Cooked mesh cache(.tgmesh), skips obj parsing and vertex welding on later launches.
+ * @details The file is memory mapped and the vertex/index blocks are uploaded straight into
+ * VertexBuffer/IndexBuffer, so loading a cached mesh does no per-vertex work on the CPU.
+ *
+ * ┌──────────────────────────────────────────────────────────────────────────┐
+ * │                              .tgmesh layout                              │
+ * ├──────────────────────┬───────────────────────────────────────────────────┤
+ * │ header               │ magic, version, source hash, block offsets/sizes, │
+ * │                      │ bounds and welding stats                          │
+ * │ source path          │ canonical obj path, guards against key collisions │
+ * │ submesh table        │ SubMesh[submeshCount]                             │
+ * │ lod table            │ SubMesh[submeshCount * (lodCount - 1)]            │
+ * │ cluster table        │ MeshCluster[clusterCount]                         │
+ * │ material table       │ fields of tinyobj::material_t used by materials   │
+ * │ vertex block         │ Vertex/PackedVertex[vertexCount], 16 bytes aligned│
+ * │ index block          │ mixed 16/32 bits indices, 16 bytes aligned        │
+ * └──────────────────────┴───────────────────────────────────────────────────┘
+ *
+ * A cache is keyed by the obj path(file name), the cooking options and the content hash of the obj
+ * file and its mtl libraries(header), a cache whose hash, path, options or version differs is stale
+ * and gets re-cooked.
+ */
+class MeshCache {
+   public:
+    // Open the cooked mesh cache of an obj file, the cache is valid only if it matches the source.
+    // @param cachePath The path of cache file.
+    // @param meshPath The path of source obj file.
+    // @param hash The content hash of source files, see MeshCache::hash.
+    // @param options The cooking options the cache is expected to be cooked with.
+    MeshCache(const fs::path& cachePath, const fs::path& meshPath, uint64_t hash, const MeshOptions& options = {});
+    MeshCache(const MeshCache&)            = delete;
+    MeshCache& operator=(const MeshCache&) = delete;
+    ~MeshCache() = default;
+
+    bool isValid() const { return m_valid; }
+    const fs::path& getFilePath() const { return m_filepath; }
+    const std::vector<tinyobj::material_t>& getMaterials() const { return m_materials; }
+
+    // Create mesh by uploading vertex/index blocks straight from the mapped cache.
+    std::shared_ptr<Mesh> createMesh() const;
+
+    // Write cooked geometry and material bindings into a cache file.
+    // @return True if cache is written, False otherwise(e.g. cache directory is read-only).
+    static bool save(const fs::path& cachePath, const fs::path& meshPath, uint64_t hash, const MeshOptions& options, const MeshData& data,
+                     const std::vector<tinyobj::material_t>& materials);
+
+    // Hash the content of obj file and the mtl libraries it references.
+    // @param meshPath The path of source obj file.
+    // @param mtlDir The directory of mtl libraries.
+    static uint64_t hash(const fs::path& meshPath, const fs::path& mtlDir);
+
+    // Get the cache file path of an obj file, keyed by its file name, canonical path and cooking options.
+    static fs::path getCachePath(const fs::path& meshPath, const MeshOptions& options = {});
+
+   private:
+    fs::path m_filepath;
+    fs::path m_meshpath;
+    VertexFormat m_format;
+    std::optional<MappedFile> m_file;
+    bool m_valid = false;
+
+    const uint8_t* m_vertices = nullptr; // vertex block inside m_file
+    const uint8_t* m_indices  = nullptr; // index block inside m_file
+    std::vector<SubMesh> m_submeshes;
+    std::vector<SubMesh> m_lods;
+    std::vector<MeshCluster> m_clusters;
+    std::vector<tinyobj::material_t> m_materials;
+    std::pair<glm::vec3, glm::vec3> m_bounds;
+    MeshStats m_stats;
+};
+
+} // namespace tinyglrenderer
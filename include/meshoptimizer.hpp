@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "mesh.hpp"
+
+namespace tinyglrenderer {
+
+/**
+ * @brief Index and vertex reordering of welded submeshes, run while cooking.
+ * @details Every pass works on the local(zero based) indices of one submesh and keeps the triangle set unchanged.
+ *
+ * ┌──────────────────────┬──────────────────────────────────────────────────────────────────────┐
+ * │ pass                 │ effect                                                               │
+ * ├──────────────────────┼──────────────────────────────────────────────────────────────────────┤
+ * │ optimizeVertexCache  │ Tipsify(Sander et al. 2007), fans triangles around recently cached   │
+ * │                      │ vertices to cut post-transform cache misses, reports hard clusters   │
+ * │ optimizeOverdraw     │ splits clusters where cache efficiency allows, then draws clusters   │
+ * │                      │ facing outwards first so that early-z rejects more occluded pixels   │
+ * │ optimizeVertexFetch  │ renumbers vertices in first use order, vertex fetch becomes linear   │
+ * │ simplify             │ quadric error edge collapse(Garland-Heckbert 1997) onto existing     │
+ * │                      │ vertices, so a coarser level only needs a new index list             │
+ * └──────────────────────┴──────────────────────────────────────────────────────────────────────┘
+ *
+ * ACMR(average cache miss ratio) is the count of transformed vertices per triangle, 0.5 is the lower
+ * bound of a regular grid and 3 means no reuse at all. ATVR(average transform to vertex ratio) is the
+ * count of transformed vertices per vertex, 1 is optimal.
+ */
+class MeshOptimizer {
+   public:
+    // FIFO cache size simulated when analyzing and optimizing, between the post-transform caches of common GPUs
+    static constexpr size_t CACHE_SIZE = 16;
+
+    // Reorder triangles for post-transform vertex cache locality.
+    // @param indices The triangle list of a submesh.
+    // @param vertexCount The vertex count of submesh, every index is less than it.
+    // @param clusters The start(in triangles) of each cluster of adjacent triangles, filled if not null.
+    static void optimizeVertexCache(std::vector<uint>& indices, size_t vertexCount, std::vector<uint>* clusters = nullptr);
+    // Reorder clusters of a vertex cache optimized triangle list to reduce overdraw.
+    // @param clusters The clusters reported by optimizeVertexCache.
+    // @param vertices The vertices of submesh.
+    // @param threshold The ACMR a cluster may lose when it is split into smaller clusters, 1.05 allows 5 percent.
+    static void optimizeOverdraw(std::vector<uint>& indices, const std::vector<uint>& clusters, const Vertex* vertices, size_t vertexCount, float threshold = 1.05f);
+    // Reorder vertices in the order indices reference them, indices are remapped in place.
+    static void optimizeVertexFetch(std::vector<uint>& indices, Vertex* vertices, size_t vertexCount);
+
+    // Simplify a triangle list by collapsing edges with the least quadric error.
+    // @details Vertices sharing a position(seams of normal or uv) collapse together, the error of a collapse adds
+    // the attribute distance between the vertices it merges, and open borders are held by perpendicular planes.
+    // @param indices The triangle list of a submesh.
+    // @param vertices The vertices of submesh.
+    // @param targetIndexCount The index count to stop at, fewer indices are emitted if degenerate triangles vanish.
+    // @param result The simplified triangle list, referencing the same vertices.
+    static void simplify(const std::vector<uint>& indices, const Vertex* vertices, size_t vertexCount, size_t targetIndexCount, std::vector<uint>& result);
+
+    // Simulate a FIFO post-transform cache over a triangle list.
+    // @return ACMR and ATVR of triangle list.
+    static std::pair<float, float> analyzeVertexCache(const std::vector<uint>& indices, size_t vertexCount);
+};
+
+} // namespace tinyglrenderer
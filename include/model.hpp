@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <filesystem>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -16,10 +17,31 @@
 namespace tinyglrenderer {
 
 struct alignas(16) ModelBlock {
-    glm::mat4 transformMatrix; // translate, rotate, scale
-    glm::mat4 normalMatrix;    // transpose of inverse (roate * scale) matrix
-    // glm::mat4 padding1;
-    // glm::mat4 padding2;
+    glm::mat4 transformMatrix;   // translate, rotate, scale
+    glm::mat4 normalMatrix;      // transpose of inverse (roate * scale) matrix
+    glm::vec4 positionOffset;    // dequantization offset of packed vertex position(mesh AABB min)
+    glm::vec4 positionScale;     // dequantization scale of packed vertex position(mesh AABB extent), w is 1 for packed vertices
+    glm::vec4 texcoordTransform; // texture coordinate scale(xy) and offset(zw), flips v of glTF meshes
+    glm::vec4 padding[5] = {};   // pad block to 256 bytes, ubo range offsets must be multiples of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+};
+
+/**
+ * @brief Per frame view state shared by all models of a render queue.
+ * @details Frustum planes and camera position are moved into the object space of each model, so cluster
+ * bounds are tested as cooked. Clusters outside the frustum(or back facing as a whole when backface is set)
+ * are dropped and the surviving adjacent clusters of a submesh are merged into index ranges. Every model
+ * draws the level of detail chosen by Model::selectLod plus lodBias, so that a shadow view can fall back
+ * to coarser levels than the main view.
+ */
+struct RenderView {
+    glm::mat4 viewProjMatrix = glm::mat4(1.f); // camera projection * view matrix
+    glm::vec3 eye            = glm::vec3(0.f); // camera position in world space
+    bool culling             = true;           // cull clusters outside frustum
+    bool backface            = false;          // cull back facing clusters with normal cones, only valid with back face culling enabled
+    int lodBias              = 0;              // levels added to the selected level of detail, negative always draws full resolution
+    size_t tested            = 0;              // clusters tested
+    size_t drawn             = 0;              // clusters survived
+    std::array<size_t, Mesh::MAX_LOD_COUNT> triangles = {}; // triangles submitted per level of detail
 };
 
 class Model {
@@ -34,14 +56,23 @@ class Model {
     Model& operator=(Model&& other);
 
     bool isVisible() const { return m_visible; }
+    bool isReady() const { return m_mesh != nullptr; } // false while the mesh is being loaded
     const std::string& getName() const { return m_name; }
     const std::pair<glm::vec3, glm::vec3>& getBoundingBox() const { return m_bounds; }
     const ModelBlock& getModelBlock() const { return m_modelBlock; }
-    void getRenderQueue(std::vector<RenderItem>& queue, bool opaque) const;
+    // Get render items of submeshes matching opacity.
+    // @param view The view state, nullptr draws every submesh entirely at full resolution.
+    void getRenderQueue(std::vector<RenderItem>& queue, bool opaque, RenderView* view = nullptr) const;
+    size_t getLod() const { return m_lod; }
+    // Select level of detail from the projected size of bounding sphere, with hysteresis between levels.
+    // @param coverage The projected radius of bounding sphere in units of half screen height.
+    void selectLod(float coverage);
     const glm::vec3& getTranslate() const { return m_transforms.at("translate"); }
     const glm::vec3& getRotate() const { return m_transforms.at("rotate"); }
     const glm::vec3& getScale() const { return m_transforms.at("scale"); }
     void setVisible(bool visible) { m_visible = visible; }
+    // Attach a loaded mesh and its materials, bounding box and quantization follow the mesh.
+    void setMesh(const std::shared_ptr<Mesh>& mesh, const std::vector<std::shared_ptr<Material>>& materials);
     void setDefaultMaterial(const std::shared_ptr<Material>& material) { m_material = material; }
     void setTransform(const glm::vec3& translate, const glm::vec3& rotate, const glm::vec3& scale);
 
@@ -52,6 +83,7 @@ class Model {
     std::shared_ptr<Mesh> m_mesh;
 
     bool m_visible = true; // different from material transparency/opacity
+    size_t m_lod   = 0;    // level of detail selected for the current view
     std::pair<glm::vec3, glm::vec3> m_bounds = {
         glm::vec3(FLT_MAX),
         glm::vec3(-FLT_MAX),
@@ -62,8 +94,11 @@ class Model {
         {"scale", glm::vec3(1.0f)},
     };
     ModelBlock m_modelBlock = {
-        .transformMatrix = glm::mat4(1.f),
-        .normalMatrix    = glm::mat4(1.f),
+        .transformMatrix   = glm::mat4(1.f),
+        .normalMatrix      = glm::mat4(1.f),
+        .positionOffset    = glm::vec4(0.f),
+        .positionScale     = glm::vec4(1.f, 1.f, 1.f, 0.f),
+        .texcoordTransform = glm::vec4(1.f, 1.f, 0.f, 0.f),
     };
 };
 
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <obj_loader/tiny_obj_loader.h>
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tinyglrenderer {
+
+namespace fs = std::filesystem;
+
+struct ObjChunk;
+
+/**
+ * @brief Parallel, memory mapped obj parser producing tinyobj containers.
+ * @details The obj file is memory mapped and split into line aligned chunks, each chunk is tokenized
+ * by its own thread with string_views(v/vn/vt/f records plus the usemtl/g/o/mtllib events). Chunks
+ * are then merged in file order, so the result does not depend on thread scheduling.
+ *
+ *   obj file ──mmap──► ┌─chunk 0─┬─chunk 1─┬─ ... ─┬─chunk n─┐   split at '\n'
+ *                      │ thread  │ thread  │       │ thread  │   parse attributes, triangles, events
+ *                      └────┬────┴────┬────┴───────┴────┬────┘
+ *                           └─────────┴── merge ────────┘        prefix sums, relative indices,
+ *                                          │                      shapes and material ids
+ *                          attrib_t + shape_t[] + material_t[]
+ *
+ * @note Mirrors tinyobj::LoadObj(..., triangulate = true): polygons are fan triangulated, `g`/`o`
+ * start a new shape, `usemtl` sets per face material ids and negative indices are relative.
+ * Tags(`t`) are ignored, a shape is never dropped when `usemtl` directly precedes `g`/`o`.
+ * @note On a loader worker(ResourceManager::loadModel) chunks run on the share of cores AsyncLoader gives the task,
+ * every core when the model loads alone.
+ */
+class ObjParser {
+   public:
+    // Parse obj file and the mtl libraries it references.
+    // @param objPath The path of obj file.
+    // @param mtlDir The directory of mtl libraries.
+    // @param threads The worker thread count, 0 means std::thread::hardware_concurrency()(see parallelFor).
+    // @return True if obj file is parsed, False otherwise(reason is appended to err).
+    static bool load(tinyobj::attrib_t* attributes, std::vector<tinyobj::shape_t>* shapes, std::vector<tinyobj::material_t>* materials, std::string* err,
+                     const fs::path& objPath, const fs::path& mtlDir, unsigned threads = 0);
+
+   private:
+    // Tokenize a line aligned range of obj file into chunk.
+    // @param text The text of chunk, starting at a line beginning and ending after a '\n'(or at the end of file).
+    // @param chunk The chunk to fill.
+    static void parse(std::string_view text, ObjChunk& chunk);
+};
+
+} // namespace tinyglrenderer
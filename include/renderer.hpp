@@ -2,12 +2,14 @@
 #include <glad/glad.h>
 
 #include <glm/glm.hpp>
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
 
 #include "bindablebuffer.hpp"
 #include "framebuffer.hpp"
+#include "graphicbuffer.hpp"
 #include "pipelinestate.hpp"
 #include "renderersetting.hpp"
 #include "renderitem.hpp"
@@ -15,8 +17,11 @@
 #include "sampler.hpp"
 #include "scene.hpp"
 #include "shader.hpp"
+#include "sphericalharmonics.hpp"
+#include "texturepool.hpp"
 #include "vertexbuffer.hpp"
 #include "vertexlayout.hpp"
+#include "virtualtexture.hpp"
 
 namespace tinyglrenderer {
 
@@ -37,20 +42,38 @@ class Renderer {
 
     void setup(ResourceManager& manager);
     void shutdown();
-    // Convert .hdr skybox into cubemap if needed
+    // Convert .hdr skybox into cubemap if needed and precalculate ibl maps, a virtual skybox is sampled from its pages instead
+    // The maps and spherical harmonics irradiance are cached on disk by skybox contents, shader sources and sizes, later launches upload them and skip the passes
     void prepare(const Scene& scene);
     // Update ubo/ssbo and bake shadow map, and bake the IBL environment map if needed, also load the dirtmask
+    // The skybox is projected into spherical harmonics irradiance the first time ibl is on, unless prepare(...) found it cached
+    // Pages of the virtual skybox sampled in last feedback are streamed in as well
     void update(const Scene& scene, ResourceManager& manager);
     // Render scene
     void render(const Scene& scene);
 
     size_t getDrawCall() const { return m_drawCall; }
+    const RenderView& getView() const { return m_view; }
 
    private:
-    // draw mesh
+    // bind textures shared by every draw of a pass once
+    void bind(const std::vector<std::string>& textures);
+    void unbind(const std::vector<std::string>& textures);
+    // draw mesh, material textures not in texture pool are bound per draw
     void draw(const RenderItem& item, const std::vector<std::string>& textures);
     // draw quad or skybox
     void draw(const std::shared_ptr<VertexLayout>& layout, const std::vector<std::string>& textures, GLsizei count);
+    // Upload a map precomputed into an attachment from its cache, or compute it and cache it for later launches
+    // @param name The attachment holding the map.
+    // @param sources The files the map is computed from, e.g. the skybox images.
+    // @param shaders The shaders computing the map(and its inputs), their sources are part of the cache key.
+    // @param compute Renders the map into the attachment.
+    void precompute(const std::string& name, const std::vector<fs::path>& sources, const std::vector<std::string>& shaders, const std::function<void()>& compute);
+    // Hash the contents of source files and shader sources, the key of precomputed maps and coefficients.
+    uint64_t hash(const std::vector<fs::path>& sources, const std::vector<std::string>& shaders) const;
+    // Read the skybox cube map back, project it into m_irradiance and cache the coefficients, must be called on GL thread.
+    // @note Stalls until the whole level 0 is read back, runs once and only if ibl is on and prepare(...) found no cache.
+    void projectIrradiance();
 
     // input and output attachments
     std::unordered_map<std::string, RenderPass> m_passes;
@@ -63,6 +86,7 @@ class Renderer {
     std::unordered_map<std::string, std::shared_ptr<Texture>> m_textures;
     std::unordered_map<std::string, std::shared_ptr<FrameBuffer>> m_frames;
     std::unordered_map<std::string, std::shared_ptr<BindableBuffer>> m_buffers;
+    std::shared_ptr<TexturePool> m_texturePool; // arrays of material textures, bound once per pass
 
     /// name mappings
     std::unordered_multimap<std::string, std::string> m_pass2FrameNames;
@@ -71,6 +95,17 @@ class Renderer {
     /// renderer settings
     RendererSetting& m_setting;
     size_t m_drawCall = 0;
+    RenderView m_view; // main view state and culling/lod stats of last frame
+    IrradianceBlock m_irradiance{}; // spherical harmonics irradiance of the skybox, cached or projected once ibl is on
+    bool m_irradianceReady = false; // m_irradiance holds the coefficients of current skybox
+    fs::path m_irradiancePath;      // cache file of the coefficients, keyed in prepare(...)
+    uint64_t m_irradianceHash = 0;
+
+    // virtual skybox streamed by feedback, the feedback target is read back a frame later without stalling
+    std::shared_ptr<VirtualTexture> m_virtualSkybox;
+    std::unique_ptr<GraphicBuffer> m_feedbackBuffer;
+    const uint8_t* m_feedbackData = nullptr; // persistent mapping of m_feedbackBuffer
+    GLsync m_feedbackFence        = nullptr; // signals when the feedback copy of last frame landed in m_feedbackBuffer
 };
 
 } // namespace tinyglrenderer
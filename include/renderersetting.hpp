@@ -15,6 +15,9 @@ struct RendererSetting {
     bool ssr       = false; // screen space reflection enabled or not
     bool ssrefr    = false; // screen space refraction enabled or not
     bool taa       = false; // temporal anti aliasing enabled or not
+    bool culling   = true;  // cluster frustum culling enabled or not
+    bool backface  = false; // back face culling(rasterizer and cluster normal cones) of opaque objects enabled or not
+    bool lod       = true;  // level of detail selection enabled or not, full resolution is drawn otherwise
 
     int x                  = 0;
     int y                  = 0;
@@ -30,6 +33,7 @@ struct RendererSetting {
     int bloomMipLevels     = 4;    // number of mip levels for bloom map
     int lensflareMapSize   = 512;  // size of lensflare map using gaussian blur algorithm
     int lensflareBlurTimes = 2;    // number of gaussian blur times for lensflare map
+    int shadowLodBias      = 1;    // levels of detail coarser than main view drawn into shadow map
 };
 
 } // namespace tinyglrenderer
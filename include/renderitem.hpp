@@ -4,6 +4,8 @@
 
 #include <glm/glm.hpp>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "material.hpp"
 #include "mesh.hpp"
@@ -19,10 +21,13 @@ struct RenderItem {
     const std::shared_ptr<Mesh> mesh;
     const std::shared_ptr<Material> material;
 
-    uint ioffset = 0;   // vertex input data offset of vbo/ibo in vertex count
+    uint ioffset = 0;   // vertex input data offset of ibo in bytes(or vbo in vertex count)
     uint length  = 0;   // vertex input data length of vbo/ibo in vertex count
+    uint ibase   = 0;   // base vertex added to indices of ibo
+    GLenum itype = GL_UNSIGNED_INT; // index type of ibo
     float distance   = 0.f; // distance to the camera(for transparent objects sorting)
     uint uoffset = 0;   // model block index of ubo in bytes
+    std::vector<std::pair<uint, uint>> ranges = {}; // index ranges(offset in bytes, length) of surviving clusters merged into one multi draw, empty draws ioffset/length
 };
 
 } // namespace tinyglrenderer
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <functional>
 #include <format>
 #include <glm/glm.hpp>
 #include <obj_loader/tiny_obj_loader.h>
@@ -11,19 +13,36 @@
 #include <unordered_map>
 #include <filesystem>
 
+#include "asyncloader.hpp"
+#include "compressedimage.hpp"
+#include "gltfparser.hpp"
+#include "graphicbuffer.hpp"
 #include "image.hpp"
 #include "material.hpp"
 #include "mesh.hpp"
+#include "meshcache.hpp"
 #include "shader.hpp"
+#include "stagingbuffer.hpp"
 #include "texture.hpp"
+#include "texturecache.hpp"
+#include "texturepool.hpp"
 #include "vertexbuffer.hpp"
 #include "vertexlayout.hpp"
+#include "virtualtexture.hpp"
 #include "model.hpp"
 
 namespace tinyglrenderer {
 
 namespace fs = std::filesystem;
 
+// Video memory of textures against the budget, updated on GL thread.
+struct TextureResidencyStats {
+    size_t budget    = 0; // bytes, 0 means unlimited
+    size_t used      = 0; // bytes of live textures, texture pool arrays and virtual textures at last check
+    size_t evictions = 0; // free layers of texture pool released
+    size_t trims     = 0; // mip levels dropped from least recently used textures
+};
+
 class ResourceManager {
    public:
     ResourceManager()  = default;
@@ -45,19 +64,69 @@ class ResourceManager {
     void getAllTextureNames(std::vector<std::string>& names) const;
     void getAllShaderNames(std::vector<std::string>& names) const;
 
+    const AsyncLoader& getLoader() const { return m_loader; }
+    const TextureCacheStats& getTextureCacheStats() const { return m_textureCacheStats; }
+    const TextureResidencyStats& getTextureResidencyStats() const { return m_textureResidency; }
+    // Set the video memory budget of textures, checked in update().
+    // @param bytes The budget in bytes, 0 means unlimited.
+    void setTextureBudget(size_t bytes) { m_textureResidency.budget = bytes; }
+    // Get the staging ring asynchronous texture uploads go through, nullptr before initialize().
+    const StagingBuffer* getStagingBuffer() const { return m_staging.get(); }
+    // Get the texture pool material textures are copied into once uploaded, nullptr before initialize().
+    const std::shared_ptr<TexturePool>& getTexturePool() const { return m_texturePool; }
+    bool isTextureCompressed() const { return m_compressTextures; }
+    // Encode material textures decoded from now on into BC formats(see Texture::getCompressedFormat), DDS/KTX2 files are always uploaded compressed.
+    void setTextureCompressed(bool compressed) { m_compressTextures = compressed; }
+
     void initialize();
     void destroy();
+    // Upload assets decoded by loader workers and keep textures within their memory budget, must be called on GL thread once per frame.
+    // Mip chains read back since earlier frames are handed to loader workers for cooking once their copies landed.
+    // @param budget The time budget of uploads in milliseconds.
+    void update(float budget = 4.f);
 
-    std::shared_ptr<Model> loadModel(const std::string& modelName, const fs::path& objPath, const fs::path& mtlDir);
-    std::shared_ptr<Mesh> loadMesh(const std::string& meshName, const fs::path& meshPath, const tinyobj::attrib_t& attributes, const std::vector<tinyobj::shape_t>& shapes, size_t num);
+    // Load model asynchronously, the returned model has no mesh until it is uploaded(see Model::isReady).
+    // @details The obj(or glTF) file is parsed and cooked(or read from mesh cache) on a loader worker, mesh and materials are
+    // created on GL thread in update(). Material textures are decoded in turn and replace the material factors. glTF files
+    // whose buffers are drawable as they are skip cooking, their buffer views are uploaded straight(see GltfParser).
+    // @param objPath The path of .obj, .gltf or .glb file.
+    // @param mtlDir The directory of mtl libraries, glTF textures are looked up next to the glTF file instead.
+    std::shared_ptr<Model> loadModel(const std::string& modelName, const fs::path& objPath, const fs::path& mtlDir, const MeshOptions& options = {});
+    std::shared_ptr<Mesh> loadMesh(const std::string& meshName, const fs::path& meshPath, const MeshData& data);
+    std::shared_ptr<Mesh> loadMesh(const std::string& meshName, const MeshCache& cache);
+    std::shared_ptr<Mesh> loadMesh(const std::string& meshName, const GltfParser& parser);
     std::shared_ptr<Material> loadMaterial(const std::string& matName, const fs::path& matDir, const tinyobj::material_t& material);
     std::shared_ptr<Texture> load2DTexture(const std::string& texName, const fs::path& texPath, const glm::vec4& defaultValue, GLenum internalFormat = GL_RGBA8, GLsizei mipLevels = 1, int desiredChannels = 0, bool verticalFlip = true);
     std::shared_ptr<Texture> load2DTexture(const std::string& texName, const std::vector<fs::path>& texPaths, const glm::vec4& defaultValue, GLenum internalFormat = GL_RGBA8, GLsizei mipLevels = 1, int desiredChannels = 0, bool verticalFlip = true);
     std::shared_ptr<Texture> loadCubeTexture(const std::string& texName, const std::vector<fs::path>& texPaths, const glm::vec4& defaultValue, GLenum internalFormat = GL_RGBA8, GLsizei mipLevels = 1, int desiredChannels = 0, bool verticalFlip = true);
+    // Load a virtual texture, the image is cooked into a page file first if it changed since it was cooked(see VirtualTexture).
+    // @return The virtual texture, nullptr if the image is missing or can not be cut into pages.
+    std::shared_ptr<VirtualTexture> loadVirtualTexture(const std::string& texName, const fs::path& texPath);
+    // Read pages of a virtual texture on a loader worker, they are mapped into its atlas on GL thread in update().
+    // @param pages The pages returned by VirtualTexture::request.
+    void streamVirtualTexture(const std::string& texName, const std::shared_ptr<VirtualTexture>& texture, const std::vector<uint32_t>& pages);
     std::shared_ptr<Image> loadImage(const std::string& imageName, const fs::path& imagePath, int desiredChannels = 0, bool verticalFlip = true);
+    // Load the images of a texture, named "<texName>_<index>", images not loaded yet are decoded concurrently(see Image::create).
+    std::vector<std::shared_ptr<Image>> loadImages(const std::string& texName, const std::vector<fs::path>& imagePaths, int desiredChannels = 0, bool verticalFlip = true);
     std::shared_ptr<Shader> loadShader(const std::string& shaderName, const fs::path& vertexShaderPath, const fs::path& fragmentShaderPath);
 
    private:
+    // Decode images on a loader worker and create the texture on GL thread, callers fall back to constant factors until then.
+    // Cooked payloads(packed, flipped, all mips in the final format) are read from the texture cache instead when source files are unchanged(see TextureCache).
+    // The final payload is copied into the staging ring on the worker, so the GL thread only issues uploads from buffer offsets(see StagingBuffer).
+    // @param usage The usage of texture, the internal format is selected from it and the decoded data type(see Texture::getInternalFormat).
+    // @param onReady Called on GL thread with the uploaded texture.
+    // @param texChannels The channel taken from each image(e.g. roughness is G of glTF metallicRoughnessTexture), -1 keeps the image decoded with desiredChannels.
+    // @return The texture if it is loaded already, nullptr if it is being decoded or any image file is missing.
+    std::shared_ptr<Texture> load2DTextureAsync(const std::string& texName, const std::vector<fs::path>& texPaths, TextureUsage usage, int desiredChannels,
+                                                const std::function<void(const std::shared_ptr<Texture>&)>& onReady, const std::vector<int>& texChannels = {});
+    // Read every level of a texture filtered by the driver back into a pixel pack buffer, without waiting for the copy.
+    // update() hands the levels to a loader worker which writes them into the texture cache once the fence signals.
+    void readbackTexture(const std::string& texName, const Texture& texture, const fs::path& cachePath, uint64_t hash);
+    // Account the video memory of textures, and while it exceeds the budget release free layers of texture pool, then drop
+    // the top mip of least recently bound textures(see Texture::trim). Dropped levels come back when a texture is loaded again.
+    void trimTextures();
+
     static std::unordered_map<std::string, GLsizei> m_counts;
     static std::unordered_map<std::string, std::shared_ptr<VertexLayout>> m_layouts;
     static std::unordered_map<std::string, std::unique_ptr<VertexBuffer>> m_buffers;
@@ -66,11 +135,36 @@ class ResourceManager {
     std::unordered_map<std::string, std::weak_ptr<Mesh>> m_meshes;
     std::unordered_map<std::string, std::weak_ptr<Material>> m_materials;
     std::unordered_map<std::string, std::weak_ptr<Texture>> m_textures;
+    std::unordered_map<std::string, std::weak_ptr<VirtualTexture>> m_virtualTextures;
     std::unordered_map<std::string, std::weak_ptr<Image>> m_images;
     std::unordered_map<std::string, std::weak_ptr<Shader>> m_shaders;
+    std::unordered_map<std::string, std::vector<std::function<void(const std::shared_ptr<Texture>&)>>> m_pendingTextures; // textures being decoded, with the callbacks waiting for them
+
+    bool m_compressTextures = false; // encode material textures into blocks on loader workers
+    TextureCacheStats m_textureCacheStats;
+    TextureResidencyStats m_textureResidency;
+    std::unique_ptr<StagingBuffer> m_staging; // decoded texels are written into it on loader workers, see load2DTextureAsync
+
+    // Levels of a texture read back for the texture cache, see readbackTexture
+    struct TextureReadback {
+        std::string name;
+        fs::path cachePath;
+        uint64_t hash         = 0;
+        GLenum internalFormat = 0;
+        GLsizei width         = 0;
+        GLsizei height        = 0;
+        std::vector<size_t> sizes;             // payload size of each level, levels are packed in buffer from level 0
+        std::unique_ptr<GraphicBuffer> buffer; // persistently mapped pixel pack buffer, released on GL thread once cooked
+        const uint8_t* data = nullptr;         // mapping of buffer
+        GLsync fence        = nullptr;         // signals when the levels landed in buffer, reset once the cook task is queued
+        std::atomic<bool> cooked{false};       // set by the cook task once it no longer reads data
+    };
+    std::vector<std::shared_ptr<TextureReadback>> m_readbacks;
+    std::shared_ptr<TexturePool> m_texturePool; // material textures are sampled from its arrays, see loadMaterial
+    const GLsizei m_textureDefaultWidth = 1; // textures of constant value are sampled at a single texel
+    const GLsizei m_textureDefaultHeight = 1;
 
-    const GLsizei m_textureDefaultWidth = 256;
-    const GLsizei m_textureDefaultHeight = 256;
+    AsyncLoader m_loader; // declared last, workers are joined before the resources they refer to are destroyed
 };
 
 }; // namespace tinyglrenderer
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <filesystem>
 #include <memory>
 #include <string>
 #include <vector>
@@ -22,6 +23,10 @@ class Scene {
 
     const std::shared_ptr<Texture>& getSkyboxCubeMap() const { return m_skyboxCubemap; }
     const std::shared_ptr<Texture>& getSkyboxEquirect() const { return m_skyboxEquirect; }
+    // Get the equirect skybox streamed page by page, set instead of getSkyboxEquirect() when the scene asks for it.
+    const std::shared_ptr<VirtualTexture>& getSkyboxVirtual() const { return m_skyboxVirtual; }
+    // Get the source files of skybox, maps precomputed from the skybox are cached by their contents.
+    const std::vector<std::filesystem::path>& getSkyboxFilePaths() const { return m_skyboxPaths; }
     const std::shared_ptr<Camera>& getCamera() const { return m_camera; }
     const std::vector<std::shared_ptr<Light>>& getLights() const { return m_lights; }
     size_t getMaxLightCount() const { return m_lights.size(); }
@@ -32,7 +37,13 @@ class Scene {
     const std::pair<glm::vec3, glm::vec3>& getBoundingBox() const { return m_bounds; }
     void getModelBlocks(std::vector<ModelBlock>& blocks) const;
     void getLightBlocks(std::vector<LightBlock>& blocks) const;
-    void getRenderQueue(std::vector<RenderItem>& queue, bool opaque, bool reset = true) const;
+    // Get render items of visible models.
+    // @param view The view state, camera matrices are filled by scene, nullptr disables culling and draws full resolution.
+    void getRenderQueue(std::vector<RenderItem>& queue, bool opaque, bool reset = true, RenderView* view = nullptr) const;
+
+    // Refresh scene bounds once models finished loading, and select level of detail of visible models
+    // from the projected size of their bounding spheres.
+    void update();
 
     void initialize(const std::string& json, ResourceManager& manager);
     void destroy();
@@ -40,10 +51,21 @@ class Scene {
    private:
     std::shared_ptr<Texture> m_skyboxCubemap  = nullptr;
     std::shared_ptr<Texture> m_skyboxEquirect = nullptr;
+    std::shared_ptr<VirtualTexture> m_skyboxVirtual = nullptr;
+    std::vector<std::filesystem::path> m_skyboxPaths;
     std::shared_ptr<Camera> m_camera          = nullptr;
     std::vector<std::shared_ptr<Light>> m_lights;
     std::vector<std::shared_ptr<Model>> m_models;
     std::pair<glm::vec3, glm::vec3> m_bounds = {glm::vec3(0.0f), glm::vec3(0.0f)};
+    size_t m_readyModelCount = 0;     // models with mesh loaded when bounds were last updated
+    bool m_autoCamera        = false; // camera is not given by scene file and frames the scene bounds
+    glm::vec3 m_autoEye      = glm::vec3(0.0f); // pose the automatic camera was placed at, another pose means the user moved it
+    glm::vec3 m_autoTarget   = glm::vec3(0.0f);
+
+    // Merge bounding boxes of loaded models, light space matrices(and the automatic camera) follow the bounds.
+    void updateBounds();
+    // Place a camera looking at the scene bounds.
+    void frameCamera();
 };
 
 }  // namespace tinyglrenderer
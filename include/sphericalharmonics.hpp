@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <glm/glm.hpp>
+
+namespace tinyglrenderer {
+
+namespace fs = std::filesystem;
+
+// Irradiance of the environment, see IrradianceBlock in common_irradiance.glsl
+struct alignas(16) IrradianceBlock {
+    glm::vec4 coefficients[9]; // rgb of every basis function, convolved with the clamped cosine and divided by pi
+};
+
+/**
+ * @brief Order 2(9 coefficients) spherical harmonics projection of a cube map, the diffuse part of IBL.
+ * @details Irradiance is a very low frequency function of the normal, Ramamoorthi and Hanrahan 2001 show that the
+ * first 9 coefficients keep it within a few percent on average. The radiance of every texel is projected on the
+ * basis weighted by the solid angle of the texel, then each band is convolved with the clamped cosine:
+ *
+ * ┌──────┬──────────┬────────────────────────────────────────────┬───────────────┐
+ * │ band │ index    │ basis Y(x, y, z), unit direction           │ A_l / pi      │
+ * ├──────┼──────────┼────────────────────────────────────────────┼───────────────┤
+ * │ 0    │ 0        │ 0.282095                                   │ 1             │
+ * │ 1    │ 1~3      │ 0.488603 * (y, z, x)                       │ 2/3           │
+ * │ 2    │ 4~8      │ 1.092548 * (xy, yz, xz)                    │ 1/4           │
+ * │      │          │ 0.315392 * (3z^2 - 1), 0.546274 * (x^2-y^2)│               │
+ * └──────┴──────────┴────────────────────────────────────────────┴───────────────┘
+ *
+ *   E(n) / pi = sum(c_i * Y_i(n)) ──► the value the irradiance cube map used to store, 1 for a white environment
+ *
+ * Rows of faces are split among threads, 4 texels of a row are projected at once with SSE when it is available.
+ * The 9 coefficients(144 bytes) are cached on disk(.tgsh) next to the maps of the skybox, so later launches skip
+ * reading the cube map back.
+ */
+class SphericalHarmonics {
+   public:
+    // Project the texels of a cube map and convolve them into irradiance coefficients.
+    // @param texels The rgb float texels of the 6 faces(+X, -X, +Y, -Y, +Z, -Z) in GL order, faces are size * size.
+    // @param size The width and height of every face.
+    // @param threads The count of threads projecting rows, 0 means std::thread::hardware_concurrency()(see parallelFor).
+    static IrradianceBlock project(const float* texels, GLsizei size, unsigned threads = 0);
+
+    // Read coefficients cached by an earlier launch.
+    // @param hash The content hash the cache is keyed by, see Renderer::precompute.
+    // @return True if the cache exists and matches hash, False otherwise(block is left untouched).
+    static bool load(const fs::path& cachePath, uint64_t hash, IrradianceBlock& block);
+    // Write coefficients into a cache file.
+    // @return True if cache is written, False otherwise(e.g. cache directory is read-only).
+    static bool save(const fs::path& cachePath, uint64_t hash, const IrradianceBlock& block);
+};
+
+} // namespace tinyglrenderer
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "graphicbuffer.hpp"
+
+namespace tinyglrenderer {
+
+/**
+ * @brief Persistently mapped pixel unpack buffer used as a ring of staging regions for texture uploads.
+ * @details Loader workers copy decoded payloads straight into mapped regions, so the GL thread only issues
+ * glTextureSubImage* from buffer offsets and the driver transfers them by DMA without touching client memory.
+ * Each region is fenced after its uploads are issued and returns to the ring once the GPU has consumed it.
+ *
+ *   worker: stage ──► write into mapped region ──► upload closure
+ *   GL thread:        glTextureSubImage*(PBO offset) ──► fence ──► retire(fence signaled) ──► region reusable
+ *
+ *   ┌──────────────────────────────────────────────────────────────────────┐
+ *   │ tail ─► [in flight(fenced)] [written, not uploaded] ... ◄─ head      │
+ *   └──────────────────────────────────────────────────────────────────────┘
+ *
+ * Regions are reclaimed in allocation order, a region finished early waits for the regions before it.
+ * A request larger than the ring, or one that finds no room within the wait timeout, returns nullptr and
+ * the caller uploads from client memory as before.
+ *
+ * @note stage() and releasing regions are thread safe, fence() and retire() must be called on GL thread.
+ */
+class StagingBuffer : public GraphicBuffer {
+   public:
+    // A mapped range of the ring, it returns to the ring when the last reference is dropped(after the fence of its uploads signals).
+    class Region {
+       public:
+        Region(StagingBuffer& owner, uint64_t id, GLintptr offset, GLsizeiptr size, uint8_t* data) : m_owner(owner), m_id(id), m_offset(offset), m_size(size), m_data(data) {}
+        Region(const Region&)            = delete;
+        Region& operator=(const Region&) = delete;
+        ~Region() { m_owner.release(m_id); }
+
+        GLintptr getOffset() const { return m_offset; }
+        GLsizeiptr getSize() const { return m_size; }
+        uint8_t* getData() const { return m_data; }
+        // Get the buffer offset of each chunk written by StagingBuffer::stage.
+        const std::vector<GLintptr>& getChunkOffsets() const { return m_chunks; }
+
+       private:
+        friend class StagingBuffer;
+
+        StagingBuffer& m_owner;
+        uint64_t m_id;
+        GLintptr m_offset;
+        GLsizeiptr m_size;
+        uint8_t* m_data;
+        std::vector<GLintptr> m_chunks;
+    };
+
+    // @param size The capacity of the ring in bytes.
+    explicit StagingBuffer(GLsizeiptr size);
+    ~StagingBuffer();
+
+    // Copy chunks(e.g. the mip levels of a texture) into one region, each chunk starts at an aligned offset.
+    // @param chunks The payloads to copy.
+    // @param timeout The time to wait for room in milliseconds while regions in flight are retired.
+    // @return The region holding the chunks, nullptr if they do not fit.
+    std::shared_ptr<Region> stage(const std::vector<std::span<const uint8_t>>& chunks, int timeout = 100);
+
+    // Fence the uploads issued from a region, must be called on GL thread right after them.
+    void fence(const Region& region);
+    // Return regions whose uploads have completed to the ring, must be called on GL thread(e.g. once per frame).
+    void retire();
+
+    // Get the bytes of regions not yet returned to the ring.
+    GLsizeiptr getUsedSize() const;
+    // Get the count of stage requests which did not fit and fell back to client memory.
+    size_t getMissCount() const;
+
+   private:
+    struct Entry {
+        uint64_t id;
+        GLintptr offset;
+        GLsizeiptr size;
+        GLsync fence  = nullptr;
+        bool released = false; // no reference to the region is left
+    };
+
+    // Reserve a range of the ring, callers hold m_mutex.
+    // @return The offset of the range, -1 if there is no room.
+    GLintptr reserve(GLsizeiptr size);
+    void release(uint64_t id);
+
+    uint8_t* m_mapped = nullptr;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_retired; // signals workers waiting for room
+    std::deque<Entry> m_entries;       // live regions in allocation order
+    uint64_t m_nextID = 0;
+    GLintptr m_head   = 0; // end of the newest region
+    size_t m_misses   = 0;
+};
+
+} // namespace tinyglrenderer
@@ -2,15 +2,41 @@
 
 #include <glad/glad.h>
 
+#include <cstdint>
 #include <filesystem>
 #include <glm/glm.hpp>
 #include <memory>
+#include <utility>
 #include <vector>
 
+#include "graphicbuffer.hpp"
 #include "image.hpp"
 
+// S3TC formats come from EXT_texture_compression_s3tc and EXT_texture_sRGB, which every desktop driver exposes but core headers omit
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
 namespace tinyglrenderer {
 
+class CompressedImage;
+
+// What texels of a material texture mean, which decides its internal format(see Texture::getInternalFormat).
+enum class TextureUsage : uint32_t {
+    TU_COLOR  = 0, // sRGB encoded color(e.g. albedo), decoded to linear by sampler
+    TU_NORMAL = 1, // tangent space normal, only xy is stored and z is reconstructed in shaders
+    TU_DATA   = 2, // linear data(e.g. packed metallic, roughness and ambient occlusion)
+};
+
 /**
  * @brief Encapsulates a GPU texture resource managing layout and multi-dimensional image storage.
  * @note Acts as a dedicated memory container on the GPU (supporting 2D textures, mipmaps, and Cubemaps).
@@ -34,6 +60,12 @@ class Texture {
     GLenum getTarget() const { return m_target; }
     GLenum getInternalFormat() const { return m_internalFormat; }
     GLsizei getMipLevels() const { return m_mipLevels; }
+    // Get the video memory size of all mip levels(and faces/layers) in bytes.
+    size_t getByteSize() const;
+    // Get the size of one face/layer of a mip level in bytes, namely the payload of upload(data, size, level).
+    size_t getLevelSize(GLint level) const;
+    // Get the frame the texture was last bound in, see Texture::tick.
+    uint64_t getLastUsed() const { return m_lastUsed; }
 
     // Bind texture to a specific texture slot, namely the glsl binding index
     // @param slot The texture slot to bind to.
@@ -70,7 +102,50 @@ class Texture {
     // @param level The mip level to upload.
     void upload(const std::shared_ptr<Image>& img, GLint pos, GLint level);
 
+    // Upload block compressed data to existed 2d texture object, level by level
+    // @note The internal format must match up with the compressed image, levels beyond the texture's mip levels are skipped.
+    // @param img The compressed image to upload.
+    void upload(const std::shared_ptr<CompressedImage>& img);
+
+    // Upload a mip level of existed 2d or cube map texture object from texels(or blocks) laid out in its internal format, e.g. a cooked texture.
+    // @param data The texels of the whole level, see getPixelFormat for the layout of uncompressed formats. A cube map level holds its 6 faces from +X to -Z.
+    // @param size The size of data in bytes, must be getLevelSize(level), times 6 for a cube map.
+    // @param level The mip level to upload.
+    void upload(const void* data, size_t size, GLint level);
+
+    // Upload a mip level of existed 2d texture object from a pixel unpack buffer, the copy is done by the GPU without touching client memory.
+    // @param buffer The pixel unpack buffer holding the texels(or blocks), see StagingBuffer.
+    // @param offset The offset of texels in buffer.
+    // @param size The size of texels in bytes, must be getLevelSize(level) if format is 0.
+    // @param level The mip level to upload.
+    // @param format The pixel format of texels(e.g. of an image), 0 means the layout of upload(data, size, level).
+    // @param type The pixel type of texels, used with format.
+    void upload(const GraphicBuffer& buffer, GLintptr offset, size_t size, GLint level, GLenum format = 0, GLenum type = 0);
+
+    // Upload a rectangle of a mip level of existed 2d texture object, texels are laid out as upload(data, size, level) takes.
+    // @param data The texels of the rectangle, or their offset in buffer if buffer is given.
+    // @param x, y The offset of the rectangle in texels.
+    // @param width, height The size of the rectangle in texels.
+    // @param level The mip level to upload.
+    // @param buffer The pixel unpack buffer holding the texels, nullptr if they are in client memory.
+    void upload(const void* data, GLint x, GLint y, GLsizei width, GLsizei height, GLint level, const GraphicBuffer* buffer = nullptr);
+
+    // Read a mip level of 2d or cube map texture object back in the layout upload(data, size, level) takes.
+    // @note Stalls until the GPU has written the texture, meant for cooking rather than per frame use.
+    // @param data The texels(or blocks) of the level are appended to it.
+    // @param level The mip level to read.
+    // @param format, type The client format and type the driver converts texels into(e.g. GL_RGB, GL_FLOAT of a packed
+    // float map), 0 reads texels as stored. Only GL_RED~GL_RGBA of GL_UNSIGNED_BYTE, GL_HALF_FLOAT and GL_FLOAT are converted.
+    void download(std::vector<uint8_t>& data, GLint level, GLenum format = 0, GLenum type = 0) const;
+    // Read a mip level of 2d texture object into a pixel pack buffer, the copy is queued and the call does not stall.
+    // @note Fence the copy(glFenceSync) and wait for it before reading the buffer, e.g. feedback read back a frame later.
+    // @param buffer The pixel pack buffer receiving the texels, laid out as download(data, level) does.
+    // @param offset The offset of texels in buffer.
+    // @param level The mip level to read.
+    void download(const GraphicBuffer& buffer, GLintptr offset, GLint level) const;
+
     // Copy the texture data from one texture object to another.
+    // @note Targets must match, except a 2d texture copied into one layer(dstZ) of a 2d array texture.
     // @param src The source texture object to copy from.
     // @param srcLevel  The source mip level to copy from.
     // @param srcX      The source X coordinate to copy from.
@@ -93,6 +168,54 @@ class Texture {
     // Generate mipmaps for the texture object.
     void generate();
 
+    // Drop the largest mip levels of a 2d(or 2d array) texture to release video memory, e.g. under a memory budget.
+    // @note The remaining levels are copied into smaller storage on the GPU, so the ID changes and frame buffer attachments of the texture are not valid anymore.
+    // @param levels The count of levels to drop, less than the mip levels.
+    void trim(GLint levels);
+
+    // Advance the frame counter bound textures record, called once per frame.
+    static void tick() { s_frame++; }
+    static uint64_t getFrame() { return s_frame; }
+
+    // Get the level count of a full mip chain, namely floor(log2(max(width, height, depth))) + 1.
+    // @note Non power of two sizes are rounded down at each level, e.g. 300x200 has 9 levels ending at 1x1.
+    static GLsizei getMaxMipLevels(GLsizei width, GLsizei height = 1, GLsizei depth = 1);
+    // Select internal format from texture usage and source data type, so that texels are no larger than needed.
+    //
+    // ┌──────────────┬──────────────────────┬──────────────────────┬──────────────────────┐
+    // │ usage        │ GL_UNSIGNED_BYTE     │ GL_UNSIGNED_SHORT    │ GL_FLOAT(HDR)        │
+    // ├──────────────┼──────────────────────┼──────────────────────┼──────────────────────┤
+    // │ TU_COLOR     │ GL_SRGB8_ALPHA8      │ GL_SRGB8_ALPHA8      │ GL_RGBA16F           │
+    // │ TU_NORMAL    │ GL_RG8               │ GL_RG16              │ GL_RG16F             │
+    // │ TU_DATA      │ GL_RGB8              │ GL_RGB16             │ GL_RGB16F            │
+    // └──────────────┴──────────────────────┴──────────────────────┴──────────────────────┘
+    //
+    // @note 16 bits color is quantized to 8 bits since there is no 16 bits sRGB format, 8 bits sRGB keeps more dark tones than 8 bits linear.
+    // @param usage The usage of texture.
+    // @param type The data type of source image.
+    static GLenum getInternalFormat(TextureUsage usage, GLenum type);
+    // Select block compressed internal format from texture usage, see CompressedImage::encode.
+    //
+    // ┌──────────────┬──────────────────────────────────────────┬──────────────────────────────────────────┐
+    // │ usage        │ opaque                                   │ with alpha                               │
+    // ├──────────────┼──────────────────────────────────────────┼──────────────────────────────────────────┤
+    // │ TU_COLOR     │ BC1 GL_COMPRESSED_SRGB_S3TC_DXT1_EXT     │ BC3 GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT│
+    // │ TU_NORMAL    │ BC5 GL_COMPRESSED_RG_RGTC2               │ BC5 GL_COMPRESSED_RG_RGTC2               │
+    // │ TU_DATA      │ BC1 GL_COMPRESSED_RGB_S3TC_DXT1_EXT      │ BC1 GL_COMPRESSED_RGB_S3TC_DXT1_EXT      │
+    // └──────────────┴──────────────────────────────────────────┴──────────────────────────────────────────┘
+    //
+    // @param usage The usage of texture.
+    // @param alpha Whether the source image has translucent texels.
+    static GLenum getCompressedFormat(TextureUsage usage, bool alpha);
+    // Get the size of one texel of an uncompressed internal format in bytes, 0 if compressed(or unknown, which is logged once).
+    static size_t getTexelSize(GLenum internalFormat);
+    // Get the size of one 4x4 block of a block compressed internal format in bytes, 0 if uncompressed.
+    static size_t getBlockSize(GLenum internalFormat);
+    static bool isCompressed(GLenum internalFormat) { return getBlockSize(internalFormat) > 0; }
+    // Get the client format and type whose tightly packed texels match an uncompressed color internal format byte for byte(e.g. GL_RGB16F is GL_RGB, GL_HALF_FLOAT).
+    // @return The format and type, {0, 0} if the internal format is compressed or not a color format.
+    static std::pair<GLenum, GLenum> getPixelFormat(GLenum internalFormat);
+
    private:
     GLsizei m_width         = 0;
     GLsizei m_height        = 0;
@@ -101,6 +224,9 @@ class Texture {
     GLenum m_target         = GL_TEXTURE_2D; // texture target indicates the target to bind and upload texture data to, and also how the texture storage is organized in GPU memory (e.g., 2D array for GL_TEXTURE_2D, or 6-face cube for GL_TEXTURE_CUBE_MAP)
     GLenum m_internalFormat = GL_RGBA8;      // texture gpu format indicates both the channel ORDER and the data TYPE (e.g., GL_RGBA8 for 8-bit RGBA format, GL_RGB16F for 16-bit float RGB format, GL_R32F for 32-bit float R format, etc.)
     GLsizei m_mipLevels     = 1;
+    mutable uint64_t m_lastUsed = 0; // frame of last bind, least recently used textures are trimmed first
+
+    static inline uint64_t s_frame = 0;
 };
 
 } // namespace tinyglrenderer
\ No newline at end of file
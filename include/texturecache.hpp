@@ -0,0 +1,119 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "compressedimage.hpp"
+#include "mappedfile.hpp"
+#include "texture.hpp"
+
+namespace tinyglrenderer {
+
+namespace fs = std::filesystem;
+
+// Counters of cooked texture lookups, updated by loader workers.
+struct TextureCacheStats {
+    std::atomic<size_t> hits{0};   // textures uploaded from cache
+    std::atomic<size_t> misses{0}; // textures decoded from source files and cooked
+    std::atomic<size_t> stale{0};  // cooked files removed since their source files changed
+    std::atomic<size_t> bytes{0};  // payload bytes uploaded from cache
+};
+
+/**
+ * @brief Cooked texture cache(.tgtex), skips image decoding, channel packing and mip filtering on later launches.
+ * @details A cooked texture holds the final GPU payload: texels(or blocks) in the internal format of the texture,
+ * every mip level, channels already packed and rows already flipped. The file is memory mapped and each level is
+ * uploaded straight from the mapping, so loading a cooked texture never touches stb_image. Maps rendered by the
+ * GPU(e.g. the skybox cubemap and IBL maps of Renderer::prepare) are read back and cached the same way, a level
+ * of a cube map holds its 6 faces.
+ *
+ * ┌──────────────────────────────────────────────────────────────────────────┐
+ * │                              .tgtex layout                               │
+ * ├──────────────────────┬───────────────────────────────────────────────────┤
+ * │ header               │ magic, version, source hash, internal format,     │
+ * │                      │ size, mip levels, faces and level offsets/sizes   │
+ * │ level 0..n           │ texels or blocks of each level, 16 bytes aligned  │
+ * └──────────────────────┴───────────────────────────────────────────────────┘
+ *
+ * The file name is keyed by the source paths and the cooking options(usage, channels, compression) plus the
+ * content hash of the source files. Editing a source file changes its hash, the lookup misses and the
+ * cooked files left by older contents of the same sources are removed(see TextureCache::invalidate).
+ */
+class TextureCache {
+   public:
+    // Open the cooked texture, the cache is valid only if it matches the source contents.
+    // @param cachePath The path of cache file.
+    // @param hash The content hash of source files, see TextureCache::hash.
+    TextureCache(const fs::path& cachePath, uint64_t hash);
+    TextureCache(const TextureCache&)            = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+    ~TextureCache() = default;
+
+    bool isValid() const { return m_valid; }
+    const fs::path& getFilePath() const { return m_filepath; }
+    // Get GL_TEXTURE_CUBE_MAP if the cache holds 6 faces, GL_TEXTURE_2D otherwise.
+    GLenum getTarget() const { return m_faces == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D; }
+    GLenum getInternalFormat() const { return m_internalFormat; }
+    GLsizei getWidth() const { return m_width; }
+    GLsizei getHeight() const { return m_height; }
+    GLsizei getMipLevels() const { return static_cast<GLsizei>(m_levels.size()); }
+    // Get the payload of a mip level in the mapped cache.
+    std::span<const uint8_t> getLevel(GLint level) const;
+    // Get the payload size of all mip levels in bytes.
+    size_t getByteSize() const;
+
+    // Create texture by uploading every level straight from the mapped cache, must be called on GL thread.
+    std::shared_ptr<Texture> createTexture() const;
+    // Upload every level into an existed texture of the same target, size, internal format and mip levels, must be called on GL thread.
+    // @param texture The texture to upload, e.g. an attachment still bound to its frame buffer.
+    void upload(Texture& texture) const;
+
+    // Write cooked levels into a cache file.
+    // @param internalFormat The internal format levels are laid out in(see Texture::upload(data, size, level)).
+    // @param levels The payload of each mip level from level 0.
+    // @param target GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP whose levels hold 6 faces each.
+    // @return True if cache is written, False otherwise(e.g. cache directory is read-only).
+    static bool save(const fs::path& cachePath, uint64_t hash, GLenum internalFormat, GLsizei width, GLsizei height, const std::vector<std::span<const uint8_t>>& levels, GLenum target = GL_TEXTURE_2D);
+    static bool save(const fs::path& cachePath, uint64_t hash, const CompressedImage& image);
+    // Read every level of a 2d or cube map texture back and write them into a cache file, must be called on GL thread.
+    // @note Stalls until the GPU has written the texture, meant for maps computed once rather than per frame.
+    static bool save(const fs::path& cachePath, uint64_t hash, const Texture& texture);
+
+    // Hash the content of source image files.
+    static uint64_t hash(const std::vector<fs::path>& texPaths);
+
+    // Get the cache file path of a texture, keyed by canonical source paths, cooking options and content hash.
+    // @param options The cooking options folded into the key, textures cooked differently from the same files are cached apart.
+    static fs::path getCachePath(const std::vector<fs::path>& texPaths, const std::string& options, uint64_t hash);
+
+    // Remove cooked files of the same sources and options whose content hash differs from the given cache path.
+    // @note Any cache named "<stem>-<key hash>-<content hash>.<ext>" is matched, e.g. the page files of virtual textures.
+    // @return The count of removed files.
+    static size_t invalidate(const fs::path& cachePath);
+
+   private:
+    struct Level {
+        uint64_t offset = 0; // offset of payload in m_file
+        uint64_t size   = 0;
+    };
+
+    fs::path m_filepath;
+    std::optional<MappedFile> m_file;
+    bool m_valid = false;
+
+    GLenum m_internalFormat = 0;
+    GLsizei m_width         = 0;
+    GLsizei m_height        = 0;
+    GLsizei m_faces         = 1;
+    std::vector<Level> m_levels;
+};
+
+} // namespace tinyglrenderer
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "texture.hpp"
+
+namespace tinyglrenderer {
+
+/**
+ * @brief Material textures grouped into 2D texture arrays by size, format and mip levels, so a pass binds them once.
+ * @details Every bucket is a GL_TEXTURE_2D_ARRAY of one (width, height, internal format, mip levels), a material
+ * texture added to the pool is copied into a free layer of its bucket on the GPU and the standalone texture can
+ * be dropped. Shaders pick the bucket and layer from a handle in the material block(see common_material.glsl),
+ * so the draws of a pass only switch the material uniform buffer instead of binding and unbinding its textures.
+ *
+ * ┌──────────────────────────────────────────────────────────────────────────────────────────────┐
+ * │                          per draw texture binding vs texture pool                            │
+ * ├───────────────────────────────────────────────┬──────────────────────────────────────────────┤
+ * │              per draw binding                 │              texture pool                    │
+ * ├───────────────────────────────────────────────┼──────────────────────────────────────────────┤
+ * │ • Bind + unbind every map on every draw       │ • Buckets bound once per pass                │
+ * │ • Any size and format per texture             │ • Layers share size, format and mip levels   │
+ * │ • Texture units hold one texture each         │ • One unit holds all layers of a bucket      │
+ * └───────────────────────────────────────────────┴──────────────────────────────────────────────┘
+ *
+ *   handle = bucket << 16 | layer ──► texture(tMaterialArrays[bucket], vec3(uv, layer))
+ *
+ * A bucket starts with a few layers and doubles when it is full, old layers are copied by glCopyImageSubData.
+ * The buckets take MAX_BUCKETS texture units, a texture matching none of them once all are taken(or beyond the
+ * layer limit of the driver) is not pooled and keeps being bound per draw. Under a memory budget the array of
+ * a bucket may lose its largest mip levels(see Texture::trim), textures added later are copied from the same
+ * level down, and compact() returns the storage of released layers.
+ *
+ * @note ARB_bindless_texture would lift the bucket limit, but the GL loader of this project does not expose it.
+ * @note All methods must be called on GL thread, layers are released when their last reference is dropped.
+ */
+class TexturePool {
+   private:
+    struct Bucket;
+
+   public:
+    static constexpr GLsizei MAX_BUCKETS = 5; // texture units of buckets, slot 3~7 next to the material textures
+
+    // A layer of a bucket holding one texture, it returns to its bucket when the last reference is dropped.
+    class Layer {
+       public:
+        Layer(const std::shared_ptr<Bucket>& bucket, uint32_t bucketIndex, GLint index) : m_bucket(bucket), m_bucketIndex(bucketIndex), m_index(index) {}
+        Layer(const Layer&)            = delete;
+        Layer& operator=(const Layer&) = delete;
+        ~Layer();
+
+        uint32_t getBucket() const { return m_bucketIndex; }
+        GLint getIndex() const { return m_index; }
+        // Get the handle shaders decode, bucket in high 16 bits and layer in low 16 bits.
+        uint32_t getHandle() const { return m_bucketIndex << 16 | static_cast<uint32_t>(m_index); }
+
+       private:
+        std::shared_ptr<Bucket> m_bucket; // keeps the array alive while the layer is referenced
+        uint32_t m_bucketIndex;
+        GLint m_index;
+    };
+
+    TexturePool()                              = default;
+    TexturePool(const TexturePool&)            = delete;
+    TexturePool& operator=(const TexturePool&) = delete;
+    ~TexturePool()                             = default;
+
+    // Copy a 2d texture into a free layer of the bucket matching it, a bucket is created or grown if needed.
+    // @param texture The texture to copy, all of its mip levels are copied.
+    // @return The layer holding the copy, nullptr if no bucket can take it.
+    std::shared_ptr<Layer> add(const Texture& texture);
+
+    // Release the storage of empty buckets and of free layers at the end of buckets.
+    // @return The count of layers released.
+    size_t compact();
+
+    // Bind the arrays of buckets to consecutive texture slots.
+    // @param slot The texture slot of bucket 0, namely the binding of tMaterialArrays in shaders.
+    void bind(GLuint slot) const;
+
+    // Get the arrays of buckets holding layers, e.g. to trim them under a memory budget.
+    void getArrays(std::vector<std::shared_ptr<Texture>>& arrays) const;
+    size_t getBucketCount() const;
+    // Get the count of layers holding a texture.
+    size_t getLayerCount() const;
+    // Get the video memory size of all arrays in bytes, free layers included.
+    size_t getByteSize() const;
+
+   private:
+    struct Bucket {
+        GLsizei width     = 0; // size, format and mip levels of the textures in bucket, the array may have lost top levels
+        GLsizei height    = 0;
+        GLenum format     = 0;
+        GLsizei mipLevels = 0;
+        std::shared_ptr<Texture> array = nullptr; // nullptr once compacted empty, the bucket is reused by the next new key
+        std::vector<GLint> free        = {};      // released layers, reused before new ones
+        GLint next = 0;                 // first layer never used
+    };
+
+    std::vector<std::shared_ptr<Bucket>> m_buckets;
+};
+
+} // namespace tinyglrenderer
@@ -2,6 +2,10 @@
 
 #include <glad/glad.h>
 
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <glm/glm.hpp>
 #include <iostream>
 #include <string>
@@ -19,4 +23,22 @@ void glDebug(const char* msg);
 
 const char* glMacro2Str(GLenum value);
 
+// Get the count of threads parallelFor runs on the calling thread.
+// @param threads The wanted count, 0 means std::thread::hardware_concurrency().
+// @return The wanted count capped by the limit of calling thread, at least 1.
+unsigned getParallelThreads(unsigned threads = 0);
+// Cap the threads of parallelFor called on the calling thread, e.g. loader workers which already run side by side.
+// @param threads The cap, 0 removes it.
+// @return The previous cap.
+unsigned setParallelLimit(unsigned threads);
+// Run body for every item in [0, count), the calling thread and up to getParallelThreads(threads) - 1 helpers take the next item until none is left.
+// Nested calls from inside body run on their own thread only. The first exception thrown by body stops taking items and is rethrown once all threads finish.
+// @param threads The wanted thread count, 0 means std::thread::hardware_concurrency().
+void parallelFor(size_t count, unsigned threads, const std::function<void(size_t item)>& body);
+
+// Write a file through "<path>.tmp" renamed over path once complete, a crash or a failed write never leaves a truncated file behind.
+// @param writer Writes the content into the opened binary stream, returns false to abandon the file(it reports its own error).
+// @return True if the file is written, False otherwise(e.g. the directory is read-only).
+bool writeFileAtomically(const std::filesystem::path& path, const std::function<bool(std::ofstream& file)>& writer);
+
 }  // namespace tinyglrenderer
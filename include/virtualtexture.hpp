@@ -0,0 +1,143 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "graphicbuffer.hpp"
+#include "mappedfile.hpp"
+#include "texture.hpp"
+
+namespace tinyglrenderer {
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Software virtual texture, only the pages of a very large image that are actually sampled live in GPU memory.
+ * @details The image is cooked once into a page file(.tgvt): every mip level is cut into pages of PAGE_SIZE texels plus
+ * a border of PAGE_BORDER texels copied from the neighbouring pages, so bilinear filtering never reads across pages.
+ * The page file is memory mapped and pages are streamed into a physical atlas on demand. It relies on plain textures
+ * only, no ARB_sparse_texture, so it runs on any GL 4.5 driver including llvmpipe.
+ *
+ * ┌──────────────────────────────────────────────────────────────────────────┐
+ * │                              .tgvt layout                                │
+ * ├──────────────────────┬───────────────────────────────────────────────────┤
+ * │ header               │ magic, version, source hash, internal format,     │
+ * │                      │ page count of level 0, mip levels, page size      │
+ * │ pages                │ level by level, row by row, (size + 2 * border)^2 │
+ * │                      │ texels of 4 bytes each, 16 bytes aligned          │
+ * └──────────────────────┴───────────────────────────────────────────────────┘
+ *
+ *   feedback pass(low res) ──► requested pages ──► request() ──► missing pages ──► loader worker reads page file
+ *   page table ◄── commit() ◄── map(page into LRU slot of atlas) ◄── upload closure on GL thread
+ *
+ * Level L of the virtual texture is max(pageCount >> L, 1) pages on each side. The page table is a mip mapped texture
+ * of one RGBA8 texel per page: the atlas slot(x, y) and the level of the page actually resident, so a page not resident
+ * yet falls back to its nearest resident ancestor. The single page of the coarsest level is pinned and always resident.
+ * Page table and feedback encode page coordinates in 8 bits, level 0 holds at most 256 x 256 pages(32768 texels).
+ */
+class VirtualTexture {
+   public:
+    static constexpr GLsizei PAGE_SIZE   = 128; // texels of a page on each side, without border
+    static constexpr GLsizei PAGE_BORDER = 4;   // texels copied from neighbouring pages on each side
+
+    // Open the page file and create the page table and atlas, must be called on GL thread.
+    // @param cachePath The path of page file, see VirtualTexture::cook.
+    // @param hash The content hash of source image, the texture is valid only if the page file matches it.
+    // @param atlasSlots The count of physical pages on each side of the atlas.
+    VirtualTexture(const fs::path& cachePath, uint64_t hash, GLsizei atlasSlots = 16);
+    VirtualTexture(const VirtualTexture&)            = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+    ~VirtualTexture() = default;
+
+    bool isValid() const { return m_valid; }
+    const fs::path& getFilePath() const { return m_filepath; }
+    GLenum getInternalFormat() const { return m_internalFormat; }
+    GLsizei getMipLevels() const { return m_mipLevels; }
+    // Get the page count of level 0 on each side.
+    GLsizei getPageCountX() const { return m_pageCountX; }
+    GLsizei getPageCountY() const { return m_pageCountY; }
+    GLsizei getAtlasSlots() const { return m_atlasSlots; }
+    const std::shared_ptr<Texture>& getPageTable() const { return m_pageTable; }
+    const std::shared_ptr<Texture>& getAtlas() const { return m_atlas; }
+    size_t getResidentCount() const { return m_resident.size(); }
+    size_t getPendingCount() const { return m_pending.size(); }
+    // Get the bytes of a page in the page file and the atlas.
+    static size_t getPageByteSize();
+
+    // Get the texels of a page in the mapped page file, safe to call on loader workers.
+    // @param page The page id, see VirtualTexture::makePage.
+    std::span<const uint8_t> getPage(uint32_t page) const;
+
+    // Collect the pages sampled in a feedback image, and mark the missing ones pending.
+    // @param feedback RGBA8 texels written by the feedback pass(page x, page y, level, requested).
+    // @param count The count of texels.
+    // @param limit The count of missing pages returned at most, coarser levels first.
+    // @return The pages to stream, pass each of them to map() once it is read.
+    std::vector<uint32_t> request(const uint8_t* feedback, size_t count, size_t limit);
+    // Copy a page into the least recently used slot of atlas, must be called on GL thread.
+    // @param data The texels of the page(see getPage), or their offset in buffer if buffer is given.
+    // @param buffer The pixel unpack buffer holding the page, nullptr if it is in client memory.
+    void map(uint32_t page, const void* data, const GraphicBuffer* buffer = nullptr);
+    // Forget a pending page whose read was dropped, it is requested again by later feedback.
+    void cancel(uint32_t page) { m_pending.erase(page); }
+    // Upload the page table if pages were mapped since last commit, must be called on GL thread.
+    void commit();
+
+    static uint32_t makePage(GLint level, GLint x, GLint y) { return static_cast<uint32_t>(level) << 24 | static_cast<uint32_t>(y) << 12 | static_cast<uint32_t>(x); }
+    static GLint getPageLevel(uint32_t page) { return static_cast<GLint>(page >> 24); }
+    static GLint getPageX(uint32_t page) { return static_cast<GLint>(page & 0xfff); }
+    static GLint getPageY(uint32_t page) { return static_cast<GLint>(page >> 12 & 0xfff); }
+
+    // Cut an image into the pages of every mip level and write them into a page file.
+    // @note HDR images are stored in shared exponent rgb(GL_RGB9_E5), others in sRGB(GL_SRGB8_ALPHA8), 4 bytes per texel either way.
+    // @param imagePath The path of source image.
+    // @param flip Whether to flip the image vertically.
+    // @return True if page file is written, False otherwise.
+    static bool cook(const fs::path& imagePath, const fs::path& cachePath, uint64_t hash, bool flip = true);
+    // Get the page file path of an image, keyed by canonical source path and content hash.
+    static fs::path getCachePath(const fs::path& imagePath, uint64_t hash);
+
+   private:
+    struct Slot {
+        uint32_t page     = UINT32_MAX; // page held by slot, UINT32_MAX if free
+        uint64_t lastUsed = 0;          // frame of last request, the least recently used slot is evicted
+        bool pinned       = false;
+    };
+
+    GLsizei getPageCountX(GLint level) const { return std::max(m_pageCountX >> level, 1); }
+    GLsizei getPageCountY(GLint level) const { return std::max(m_pageCountY >> level, 1); }
+    size_t getPageIndex(uint32_t page) const;
+    // Mark a page and its resident ancestors used in current frame.
+    void touch(uint32_t page);
+
+    fs::path m_filepath;
+    std::optional<MappedFile> m_file;
+    bool m_valid = false;
+
+    GLenum m_internalFormat = 0;
+    GLsizei m_pageCountX    = 0;
+    GLsizei m_pageCountY    = 0;
+    GLsizei m_mipLevels     = 0;
+    GLsizei m_atlasSlots    = 0;
+    uint64_t m_dataOffset   = 0;
+    std::vector<size_t> m_levelPages; // index of first page of each level
+
+    std::shared_ptr<Texture> m_pageTable;
+    std::shared_ptr<Texture> m_atlas;
+    std::vector<Slot> m_slots;
+    std::unordered_map<uint32_t, size_t> m_resident; // page -> slot
+    std::unordered_set<uint32_t> m_pending;          // pages being read on loader workers
+    uint64_t m_frame = 0;
+    bool m_dirty     = false; // page table differs from resident pages
+};
+
+} // namespace tinyglrenderer
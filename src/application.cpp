@@ -11,6 +11,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <stdexcept>
 
+#include "memoryregistry.hpp"
 #include "resourcemanager.hpp"
 #include "utils.hpp"
 
@@ -40,6 +41,9 @@ Application::Application(int width, int height, const std::string& title)
 }
 
 Application::~Application() {
+    // dump live memory and peaks of the session before anything is released, to size deployments
+    MemoryRegistry::dump("../cache/memory.json");
+
     // clear renderer resources
     m_renderer.shutdown();
 
@@ -160,6 +164,10 @@ void Application::run() {
         // Process input
         processInput(deltaTime);
 
+        // Upload assets decoded by loader workers, then update the scene state(bounds and level of detail of models)
+        m_manager.update();
+        m_scene.update();
+
         // Update the renderer state according to renderer setting
         m_renderer.update(m_scene, m_manager); // must be called before render, otherwise resource might be not reset or updated
         
@@ -202,6 +210,11 @@ void Application::getDisplayInfo(float deltaTime) {
     m_info.framePerSecond = calculateFPS(deltaTime);
     m_info.deltaTime      = deltaTime;
     m_info.drawCall       = m_renderer.getDrawCall();
+    m_info.clusterTested  = m_renderer.getView().tested;
+    m_info.clusterDrawn   = m_renderer.getView().drawn;
+    m_info.assetLoaded    = m_manager.getLoader().getDoneCount();
+    m_info.assetTotal     = m_manager.getLoader().getTotalCount();
+    m_info.lodTriangles.assign(m_renderer.getView().triangles.begin(), m_renderer.getView().triangles.end());
 
     return;
 }
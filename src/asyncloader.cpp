@@ -0,0 +1,172 @@
+#include "asyncloader.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+
+#include "utils.hpp"
+
+namespace tinyglrenderer {
+
+AsyncLoader::AsyncLoader(unsigned threads, size_t capacity) {
+    m_threads  = threads ? threads : std::max(2u, std::thread::hardware_concurrency()) - 1; // leave a core to the GL thread
+    m_capacity = std::max<size_t>(1, capacity);
+}
+
+AsyncLoader::~AsyncLoader() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_taskReady.notify_all();
+    m_uploadSpace.notify_all();
+    for (auto& worker : m_workers) { worker.join(); }
+}
+
+void AsyncLoader::submit(const std::string& name, Task task, Failure failure) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_workers.empty()) {
+            for (unsigned i = 0; i < m_threads; i++) { m_workers.emplace_back(&AsyncLoader::work, this); }
+        }
+        LoadRecord record;
+        record.name = name;
+        m_records.push_back(std::move(record));
+
+        Job job;
+        job.id         = m_records.size() - 1;
+        job.generation = m_generation;
+        job.task       = std::move(task);
+        job.failure    = std::move(failure);
+        m_tasks.push_back(std::move(job));
+    }
+    m_taskReady.notify_one();
+}
+
+size_t AsyncLoader::drain(float budget) {
+    auto start   = std::chrono::steady_clock::now();
+    size_t count = 0;
+    while (true) {
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_uploads.empty()) { break; }
+            job = std::move(m_uploads.front());
+            m_uploads.pop_front();
+        }
+        m_uploadSpace.notify_one();
+
+        // Upload without holding the lock, an upload may submit further tasks
+        auto begin        = std::chrono::steady_clock::now();
+        bool decoded      = job.error.empty(); // false if the task threw and only its failure is handed over
+        std::string error = std::move(job.error);
+        try {
+            if (decoded) { job.upload(); }
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (!error.empty() && job.failure) { job.failure(error); }
+        auto end = std::chrono::steady_clock::now();
+        count++;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (job.generation == m_generation) {
+                LoadRecord& record = m_records[job.id];
+                record.uploadTime  = std::chrono::duration<double, std::milli>(end - begin).count();
+                record.failed      = !error.empty();
+                record.error       = error;
+                record.done        = true;
+                m_done++;
+                if (record.failed) { std::cout << "Failed to " << (decoded ? "upload" : "load") << " asset [" << record.name << "] " << error << "\n"; }
+            }
+        }
+        if (std::chrono::duration<double, std::milli>(end - start).count() >= budget) { break; }
+    }
+    return count;
+}
+
+void AsyncLoader::cancel() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.clear();
+    m_uploads.clear();
+    m_records.clear();
+    m_done = 0;
+    m_generation++;
+    m_uploadSpace.notify_all();
+}
+
+bool AsyncLoader::isIdle() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tasks.empty() && m_uploads.empty() && m_running == 0;
+}
+
+size_t AsyncLoader::getDoneCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_done;
+}
+
+size_t AsyncLoader::getTotalCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_records.size();
+}
+
+std::vector<LoadRecord> AsyncLoader::getRecords() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_records;
+}
+
+void AsyncLoader::work() {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    while (true) {
+        Job job;
+        unsigned share = 1;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_taskReady.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_stop) { return; }
+            job = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            m_running++;
+            share = std::max(1u, cores / static_cast<unsigned>(m_running));
+        }
+
+        // 1. Decode on this worker, a failed task keeps the placeholder resource. The parallelFor of a task(image decoding,
+        // block encoding, obj parsing) gets the cores divided by the tasks in flight, all of them if the task runs alone
+        setParallelLimit(share);
+        auto begin = std::chrono::steady_clock::now();
+        std::string error;
+        try {
+            job.upload = job.task();
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        job.task = nullptr; // release captured data early
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        // 2. Hand decoded data over to GL thread, wait while the upload queue is full
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_uploadSpace.wait(lock, [&]() { return m_stop || job.generation != m_generation || m_uploads.size() < m_capacity; });
+        m_running--;
+        if (m_stop) { return; }
+        if (job.generation != m_generation) { continue; }
+
+        LoadRecord& record = m_records[job.id];
+        record.decodeTime  = elapsed;
+        if (!error.empty() && job.failure) {
+            job.error = std::move(error); // the failure hook runs on GL thread like an upload
+            m_uploads.push_back(std::move(job));
+        } else if (!error.empty() || !job.upload) {
+            record.failed = !error.empty();
+            record.error  = error;
+            record.done   = true;
+            m_done++;
+            if (record.failed) { std::cout << "Failed to load asset [" << record.name << "] " << error << "\n"; }
+        } else {
+            m_uploads.push_back(std::move(job));
+        }
+    }
+}
+
+} // namespace tinyglrenderer
@@ -0,0 +1,499 @@
+#include "compressedimage.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "mappedfile.hpp"
+#include "utils.hpp"
+
+namespace tinyglrenderer {
+
+namespace fs = std::filesystem;
+
+// Compressed formats and their codes in DDS(DXGI_FORMAT) and KTX2(VkFormat) containers, the first match wins on lookup
+struct FormatCode {
+    GLenum format;
+    uint32_t dxgi;
+    uint32_t vk;
+};
+
+static constexpr std::array<FormatCode, 16> FORMAT_CODES = {{
+    {GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 71, 131},
+    {GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 71, 133},
+    {GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 72, 132},
+    {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 72, 134},
+    {GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 74, 135},
+    {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 75, 136},
+    {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 77, 137},
+    {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 78, 138},
+    {GL_COMPRESSED_RED_RGTC1, 80, 139},
+    {GL_COMPRESSED_SIGNED_RED_RGTC1, 81, 140},
+    {GL_COMPRESSED_RG_RGTC2, 83, 141},
+    {GL_COMPRESSED_SIGNED_RG_RGTC2, 84, 142},
+    {GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 95, 143},
+    {GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 96, 144},
+    {GL_COMPRESSED_RGBA_BPTC_UNORM, 98, 145},
+    {GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 99, 146},
+}};
+
+static constexpr uint32_t DDS_MAGIC        = 0x20534444; // "DDS "
+static constexpr size_t DDS_HEADER_SIZE    = 4 + 124;    // magic + DDS_HEADER
+static constexpr size_t DDS_DX10_SIZE      = 20;         // DDS_HEADER_DXT10
+static constexpr uint32_t DDS_FOURCC       = 0x4;        // DDPF_FOURCC
+static constexpr uint32_t DDS_CUBEMAP      = 0x200;      // DDSCAPS2_CUBEMAP
+static constexpr size_t KTX2_HEADER_SIZE   = 80;         // identifier, header and index
+static constexpr size_t KTX2_LEVEL_SIZE    = 24;         // byteOffset, byteLength, uncompressedByteLength
+static constexpr uint8_t KTX2_IDENTIFIER[] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+static constexpr uint32_t fourCC(const char* code) {
+    return static_cast<uint32_t>(code[0]) | (static_cast<uint32_t>(code[1]) << 8) | (static_cast<uint32_t>(code[2]) << 16) | (static_cast<uint32_t>(code[3]) << 24);
+}
+
+template <typename T>
+static T read(const uint8_t* data, size_t offset) {
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+static void write(std::vector<uint8_t>& data, size_t offset, T value) {
+    std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+// ----------------------------------------------------------------
+// Block encoders, a block is 16 RGBA8 texels in row major order
+// ----------------------------------------------------------------
+
+static uint16_t to565(const float c[3]) {
+    auto q = [](float v, int max) { return static_cast<uint16_t>(std::clamp(static_cast<int>(v / 255.f * max + 0.5f), 0, max)); };
+    return static_cast<uint16_t>((q(c[0], 31) << 11) | (q(c[1], 63) << 5) | q(c[2], 31));
+}
+
+static void from565(uint16_t c, int rgb[3]) {
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// BC1 color block in 4 color mode: endpoints span the principal axis of block colors(range fit), inset by 1/16 to cut rounding error
+static void encodeBC1(const uint8_t* texels, uint8_t* out) {
+    float mean[3] = {0.f, 0.f, 0.f};
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) { mean[c] += texels[i * 4 + c] / 16.f; }
+    }
+    float cov[6] = {0.f}; // xx, xy, xz, yy, yz, zz
+    for (int i = 0; i < 16; i++) {
+        float d[3] = {texels[i * 4] - mean[0], texels[i * 4 + 1] - mean[1], texels[i * 4 + 2] - mean[2]};
+        cov[0] += d[0] * d[0], cov[1] += d[0] * d[1], cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1], cov[4] += d[1] * d[2], cov[5] += d[2] * d[2];
+    }
+    float axis[3] = {1.f, 1.f, 1.f};
+    for (int iter = 0; iter < 4; iter++) { // power iteration converges to the principal axis
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float m = std::max({std::abs(x), std::abs(y), std::abs(z)});
+        if (m < 1e-6f) { break; }
+        axis[0] = x / m, axis[1] = y / m, axis[2] = z / m;
+    }
+    float length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float tmin = 0.f, tmax = 0.f;
+    for (int i = 0; i < 16; i++) {
+        float t = ((texels[i * 4] - mean[0]) * axis[0] + (texels[i * 4 + 1] - mean[1]) * axis[1] + (texels[i * 4 + 2] - mean[2]) * axis[2]) / length2;
+        tmin = std::min(tmin, t), tmax = std::max(tmax, t);
+    }
+    float inset = (tmax - tmin) / 16.f;
+    float e0[3], e1[3];
+    for (int c = 0; c < 3; c++) {
+        e0[c] = mean[c] + axis[c] * (tmax - inset);
+        e1[c] = mean[c] + axis[c] * (tmin + inset);
+    }
+    uint16_t c0 = to565(e0), c1 = to565(e1);
+    if (c0 < c1) { std::swap(c0, c1); } // c0 > c1 selects 4 color mode, c0 == c1 leaves every texel at index 0
+
+    int palette[4][3];
+    from565(c0, palette[0]);
+    from565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    uint32_t indices = 0;
+    for (int i = 0; i < 16 && c0 != c1; i++) {
+        int best = 0, bestError = INT32_MAX;
+        for (int p = 0; p < 4; p++) {
+            int dr = texels[i * 4] - palette[p][0], dg = texels[i * 4 + 1] - palette[p][1], db = texels[i * 4 + 2] - palette[p][2];
+            int error = dr * dr + dg * dg + db * db;
+            if (error < bestError) { best = p, bestError = error; }
+        }
+        indices |= static_cast<uint32_t>(best) << (i * 2);
+    }
+    std::memcpy(out, &c0, 2);
+    std::memcpy(out + 2, &c1, 2);
+    std::memcpy(out + 4, &indices, 4);
+}
+
+// BC4 block in 8 value mode: endpoints are the extremes of the channel, each texel takes the nearest of 8 interpolated values
+static void encodeBC4(const uint8_t* texels, int channel, uint8_t* out) {
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++) {
+        lo = std::min<int>(lo, texels[i * 4 + channel]);
+        hi = std::max<int>(hi, texels[i * 4 + channel]);
+    }
+    uint64_t bits = static_cast<uint64_t>(hi) | (static_cast<uint64_t>(lo) << 8);
+    for (int i = 0; i < 16 && hi > lo; i++) {
+        int step  = ((hi - texels[i * 4 + channel]) * 14 + (hi - lo)) / ((hi - lo) * 2); // round((hi - v) / (hi - lo) * 7)
+        int index = step == 0 ? 0 : (step == 7 ? 1 : step + 1);                         // index 0 is hi, 1 is lo, 2..7 lie in between
+        bits |= static_cast<uint64_t>(index) << (16 + i * 3);
+    }
+    std::memcpy(out, &bits, 8);
+}
+
+// ----------------------------------------------------------------
+// Mip chain filtering
+// ----------------------------------------------------------------
+
+static const std::array<float, 256>& srgbToLinear() {
+    static const std::array<float, 256> table = []() {
+        std::array<float, 256> t;
+        for (int i = 0; i < 256; i++) {
+            float c = i / 255.f;
+            t[i]    = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return t;
+    }();
+    return table;
+}
+
+static const std::array<uint8_t, 4096>& linearToSrgb() {
+    static const std::array<uint8_t, 4096> table = []() {
+        std::array<uint8_t, 4096> t;
+        for (int i = 0; i < 4096; i++) {
+            float c = i / 4095.f;
+            c       = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+            t[i]    = static_cast<uint8_t>(std::clamp(c * 255.f + 0.5f, 0.f, 255.f));
+        }
+        return t;
+    }();
+    return table;
+}
+
+// Halve an RGBA8 level with a 2x2 box filter, odd edges reuse their last texel
+static std::vector<uint8_t> downsample(const std::vector<uint8_t>& src, int width, int height, bool srgb) {
+    int w = std::max(width >> 1, 1), h = std::max(height >> 1, 1);
+    std::vector<uint8_t> dst(static_cast<size_t>(w) * h * 4);
+    auto& toLinear = srgbToLinear();
+    auto& toSrgb   = linearToSrgb();
+    for (int y = 0; y < h; y++) {
+        int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+        for (int x = 0; x < w; x++) {
+            int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            const uint8_t* p[4] = {&src[(static_cast<size_t>(y0) * width + x0) * 4], &src[(static_cast<size_t>(y0) * width + x1) * 4],
+                                   &src[(static_cast<size_t>(y1) * width + x0) * 4], &src[(static_cast<size_t>(y1) * width + x1) * 4]};
+            uint8_t* d = &dst[(static_cast<size_t>(y) * w + x) * 4];
+            for (int c = 0; c < 4; c++) {
+                if (srgb && c < 3) {
+                    float sum = toLinear[p[0][c]] + toLinear[p[1][c]] + toLinear[p[2][c]] + toLinear[p[3][c]];
+                    d[c]      = toSrgb[static_cast<int>(sum / 4.f * 4095.f + 0.5f)];
+                } else {
+                    d[c] = static_cast<uint8_t>((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+                }
+            }
+        }
+    }
+    return dst;
+}
+
+// ----------------------------------------------------------------
+// Block flipping, see CompressedImage::flip
+// ----------------------------------------------------------------
+
+// Color block of BC1-BC3, row y of 2 bits indices is byte 4 + y
+static void flipColorBlock(uint8_t* block, int rows) { std::reverse(block + 4, block + 4 + rows); }
+
+// Explicit alpha block of BC2, row y of 4 bits alphas is the 16 bits word y
+static void flipAlphaBlock(uint8_t* block, int rows) {
+    uint16_t words[4];
+    std::memcpy(words, block, 8);
+    std::reverse(words, words + rows);
+    std::memcpy(block, words, 8);
+}
+
+// Interpolated block of BC3 alpha and BC4/BC5 channels, row y of 3 bits indices is bits 16 + 12y of the block
+static void flipChannelBlock(uint8_t* block, int rows) {
+    uint64_t bits;
+    std::memcpy(&bits, block, 8);
+    uint64_t row[4];
+    for (int y = 0; y < 4; y++) { row[y] = (bits >> (16 + 12 * y)) & 0xFFF; }
+    std::reverse(row, row + rows);
+    bits &= 0xFFFF;
+    for (int y = 0; y < 4; y++) { bits |= row[y] << (16 + 12 * y); }
+    std::memcpy(block, &bits, 8);
+}
+
+// ----------------------------------------------------------------
+// CompressedImage
+// ----------------------------------------------------------------
+
+void CompressedImage::push(GLsizei width, GLsizei height) {
+    Level level{.width = width, .height = height, .offset = m_data.size()};
+    level.size = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * Texture::getBlockSize(m_internalFormat);
+    m_levels.push_back(level);
+    m_data.resize(m_data.size() + level.size);
+}
+
+bool CompressedImage::flip() {
+    size_t blockSize = Texture::getBlockSize(m_internalFormat);
+    std::vector<void (*)(uint8_t*, int)> flips; // flip of each 8 bytes half of a block
+    switch (m_internalFormat) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT: flips = {flipColorBlock}; break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT: flips = {flipAlphaBlock, flipColorBlock}; break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: flips = {flipChannelBlock, flipColorBlock}; break;
+        case GL_COMPRESSED_RED_RGTC1:
+        case GL_COMPRESSED_SIGNED_RED_RGTC1: flips = {flipChannelBlock}; break;
+        case GL_COMPRESSED_RG_RGTC2:
+        case GL_COMPRESSED_SIGNED_RG_RGTC2: flips = {flipChannelBlock, flipChannelBlock}; break;
+        default: return false; // BC6H/BC7 partitions and endpoints depend on texel positions
+    }
+
+    bool exact = true;
+    std::vector<uint8_t> row;
+    for (auto& level : m_levels) {
+        size_t cols = (level.width + 3) / 4, rows = (level.height + 3) / 4, pitch = cols * blockSize;
+        exact &= level.height <= 4 || level.height % 4 == 0;
+
+        // 1. Reverse block rows
+        uint8_t* data = m_data.data() + level.offset;
+        for (size_t y = 0; y < rows / 2; y++) {
+            row.assign(data + y * pitch, data + (y + 1) * pitch);
+            std::memcpy(data + y * pitch, data + (rows - 1 - y) * pitch, pitch);
+            std::memcpy(data + (rows - 1 - y) * pitch, row.data(), pitch);
+        }
+        // 2. Reverse texel rows inside blocks, a level shorter than a block only holds its first rows
+        int texelRows = std::min(level.height, 4);
+        for (size_t i = 0; i < cols * rows; i++) {
+            for (size_t half = 0; half < flips.size(); half++) { flips[half](data + i * blockSize + half * 8, texelRows); }
+        }
+    }
+    if (!exact) { std::cout << "CompressedImage::flip: level height of [" << m_filepath << "] is not a multiple of 4, rows are shifted by block padding\n"; }
+    return true;
+}
+
+std::shared_ptr<CompressedImage> CompressedImage::create(const fs::path& path, bool flip) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    std::shared_ptr<CompressedImage> image = extension == ".dds" ? loadDDS(path) : loadKTX2(path);
+    if (flip && !image->flip()) { std::cout << "CompressedImage::create: blocks of " << glMacro2Str(image->m_internalFormat) << " can not be flipped, [" << path << "] is loaded upside down\n"; }
+    return image;
+}
+
+std::shared_ptr<CompressedImage> CompressedImage::loadDDS(const fs::path& path) {
+    MappedFile file(path);
+    const uint8_t* data = file.getData();
+    if (file.getSize() < DDS_HEADER_SIZE || read<uint32_t>(data, 0) != DDS_MAGIC) { throw std::runtime_error("CompressedImage::loadDDS: Invalid DDS file " + path.string()); }
+
+    uint32_t height = read<uint32_t>(data, 12), width = read<uint32_t>(data, 16), levels = std::max(read<uint32_t>(data, 28), 1u);
+    uint32_t flags = read<uint32_t>(data, 80), code = read<uint32_t>(data, 84), caps2 = read<uint32_t>(data, 112);
+    if (!(flags & DDS_FOURCC)) { throw std::runtime_error("CompressedImage::loadDDS: Uncompressed DDS is not supported " + path.string()); }
+    if (caps2 & DDS_CUBEMAP) { throw std::runtime_error("CompressedImage::loadDDS: Cubemap DDS is not supported " + path.string()); }
+
+    auto image              = std::shared_ptr<CompressedImage>(new CompressedImage());
+    image->m_filepath       = fs::canonical(path).string();
+    size_t offset           = DDS_HEADER_SIZE;
+    uint32_t dxgi           = 0;
+    if (code == fourCC("DX10")) {
+        if (file.getSize() < DDS_HEADER_SIZE + DDS_DX10_SIZE) { throw std::runtime_error("CompressedImage::loadDDS: Invalid DDS file " + path.string()); }
+        dxgi = read<uint32_t>(data, DDS_HEADER_SIZE);
+        if (read<uint32_t>(data, DDS_HEADER_SIZE + 12) > 1) { throw std::runtime_error("CompressedImage::loadDDS: Texture array DDS is not supported " + path.string()); }
+        offset += DDS_DX10_SIZE;
+    } else if (code == fourCC("DXT1")) {
+        dxgi = 71;
+    } else if (code == fourCC("DXT2") || code == fourCC("DXT3")) {
+        dxgi = 74;
+    } else if (code == fourCC("DXT4") || code == fourCC("DXT5")) {
+        dxgi = 77;
+    } else if (code == fourCC("ATI1") || code == fourCC("BC4U")) {
+        dxgi = 80;
+    } else if (code == fourCC("BC4S")) {
+        dxgi = 81;
+    } else if (code == fourCC("ATI2") || code == fourCC("BC5U")) {
+        dxgi = 83;
+    } else if (code == fourCC("BC5S")) {
+        dxgi = 84;
+    }
+    auto it = std::find_if(FORMAT_CODES.begin(), FORMAT_CODES.end(), [dxgi](const FormatCode& f) { return f.dxgi == dxgi; });
+    if (it == FORMAT_CODES.end()) { throw std::runtime_error(std::format("CompressedImage::loadDDS: Unsupported DDS format {} in {}", dxgi, path.string())); }
+    image->m_internalFormat = it->format;
+
+    // Levels follow the header back to back
+    for (uint32_t level = 0; level < std::min<uint32_t>(levels, Texture::getMaxMipLevels(width, height)); level++) {
+        image->push(std::max<GLsizei>(width >> level, 1), std::max<GLsizei>(height >> level, 1));
+    }
+    if (offset + image->m_data.size() > file.getSize()) { throw std::runtime_error("CompressedImage::loadDDS: Truncated DDS file " + path.string()); }
+    std::memcpy(image->m_data.data(), data + offset, image->m_data.size());
+    return image;
+}
+
+std::shared_ptr<CompressedImage> CompressedImage::loadKTX2(const fs::path& path) {
+    MappedFile file(path);
+    const uint8_t* data = file.getData();
+    if (file.getSize() < KTX2_HEADER_SIZE || std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) { throw std::runtime_error("CompressedImage::loadKTX2: Invalid KTX2 file " + path.string()); }
+
+    uint32_t vkFormat = read<uint32_t>(data, 12), width = read<uint32_t>(data, 20), height = read<uint32_t>(data, 24), depth = read<uint32_t>(data, 28);
+    uint32_t layers = read<uint32_t>(data, 32), faces = read<uint32_t>(data, 36), levels = std::max(read<uint32_t>(data, 40), 1u), scheme = read<uint32_t>(data, 44);
+    if (scheme != 0) { throw std::runtime_error("CompressedImage::loadKTX2: Supercompressed KTX2 is not supported " + path.string()); }
+    if (depth > 1 || layers > 1 || faces != 1) { throw std::runtime_error("CompressedImage::loadKTX2: Only 2d KTX2 textures are supported " + path.string()); }
+    auto it = std::find_if(FORMAT_CODES.begin(), FORMAT_CODES.end(), [vkFormat](const FormatCode& f) { return f.vk == vkFormat; });
+    if (it == FORMAT_CODES.end()) { throw std::runtime_error(std::format("CompressedImage::loadKTX2: Unsupported KTX2 format {} in {}", vkFormat, path.string())); }
+    if (file.getSize() < KTX2_HEADER_SIZE + levels * KTX2_LEVEL_SIZE) { throw std::runtime_error("CompressedImage::loadKTX2: Truncated KTX2 file " + path.string()); }
+
+    auto image              = std::shared_ptr<CompressedImage>(new CompressedImage());
+    image->m_filepath       = fs::canonical(path).string();
+    image->m_internalFormat = it->format;
+
+    // Level index lists level 0 first, while level data is laid out from the smallest level
+    for (uint32_t level = 0; level < std::min<uint32_t>(levels, Texture::getMaxMipLevels(width, height)); level++) {
+        image->push(std::max<GLsizei>(width >> level, 1), std::max<GLsizei>(height >> level, 1));
+        const Level& dst = image->m_levels.back();
+        uint64_t offset  = read<uint64_t>(data, KTX2_HEADER_SIZE + level * KTX2_LEVEL_SIZE);
+        uint64_t length  = read<uint64_t>(data, KTX2_HEADER_SIZE + level * KTX2_LEVEL_SIZE + 8);
+        if (length < dst.size || offset + dst.size > file.getSize()) { throw std::runtime_error(std::format("CompressedImage::loadKTX2: Truncated level {} in {}", level, path.string())); }
+        std::memcpy(image->m_data.data() + dst.offset, data + offset, dst.size);
+    }
+    return image;
+}
+
+std::shared_ptr<CompressedImage> CompressedImage::encode(const std::shared_ptr<Image>& image, GLenum internalFormat, unsigned threads) {
+    if (image == nullptr || image->getData() == nullptr) { throw std::runtime_error("CompressedImage::encode: Null image"); }
+    if (image->getDataType() == GL_FLOAT) { throw std::runtime_error("CompressedImage::encode: HDR image is not supported " + image->getFilePath()); }
+
+    bool srgb = false;
+    void (*encodeBlock)(const uint8_t*, uint8_t*) = nullptr;
+    switch (internalFormat) {
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT: srgb = true; [[fallthrough]];
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: encodeBlock = [](const uint8_t* texels, uint8_t* out) { encodeBC1(texels, out); }; break;
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: srgb = true; [[fallthrough]];
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: encodeBlock = [](const uint8_t* texels, uint8_t* out) { encodeBC4(texels, 3, out), encodeBC1(texels, out + 8); }; break;
+        case GL_COMPRESSED_RED_RGTC1: encodeBlock = [](const uint8_t* texels, uint8_t* out) { encodeBC4(texels, 0, out); }; break;
+        case GL_COMPRESSED_RG_RGTC2: encodeBlock = [](const uint8_t* texels, uint8_t* out) { encodeBC4(texels, 0, out), encodeBC4(texels, 1, out + 8); }; break;
+        default: throw std::runtime_error(std::format("CompressedImage::encode: Unsupported encode format {}", glMacro2Str(internalFormat)));
+    }
+
+    // 1. Expand source into RGBA8, gray replicates into rgb and missing alpha is opaque
+    int width = image->getWidth(), height = image->getHeight(), channels = image->getChannels();
+    bool wide = image->getDataType() == GL_UNSIGNED_SHORT;
+    std::vector<uint8_t> texels(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; i++) {
+        for (int c = 0; c < 4; c++) {
+            int src = channels == 1 && c < 3 ? 0 : c;
+            if (src >= channels) {
+                texels[i * 4 + c] = c == 3 ? 255 : 0;
+            } else {
+                texels[i * 4 + c] = wide ? static_cast<const uint16_t*>(image->getData())[i * channels + src] >> 8 : static_cast<const uint8_t*>(image->getData())[i * channels + src];
+            }
+        }
+    }
+
+    // 2. Filter mip chain, and allocate blocks of every level
+    auto result              = std::shared_ptr<CompressedImage>(new CompressedImage());
+    result->m_filepath       = image->getFilePath();
+    result->m_internalFormat = internalFormat;
+    std::vector<std::vector<uint8_t>> levels;
+    levels.push_back(std::move(texels));
+    for (GLsizei level = 0; level < Texture::getMaxMipLevels(width, height); level++) {
+        GLsizei w = std::max(width >> level, 1), h = std::max(height >> level, 1);
+        result->push(w, h);
+        if (level > 0) { levels.push_back(downsample(levels.back(), std::max(width >> (level - 1), 1), std::max(height >> (level - 1), 1), srgb)); }
+    }
+
+    // 3. Encode block rows of all levels in parallel, blocks crossing the edge repeat the last row or column
+    std::vector<std::pair<GLint, GLsizei>> jobs; // (level, block row)
+    for (GLint level = 0; level < result->getMipLevels(); level++) {
+        for (GLsizei y = 0; y < (result->getHeight(level) + 3) / 4; y++) { jobs.emplace_back(level, y); }
+    }
+    size_t blockSize = Texture::getBlockSize(internalFormat);
+    unsigned count = std::min(getParallelThreads(threads), static_cast<unsigned>(std::max<size_t>(jobs.size() / 16, 1))); // a thread takes 16 block rows at least
+    parallelFor(jobs.size(), count, [&](size_t job) {
+        uint8_t block[64];
+        auto [level, by] = jobs[job];
+        GLsizei w = result->getWidth(level), h = result->getHeight(level);
+        const uint8_t* src = levels[level].data();
+        uint8_t* dst       = result->m_data.data() + result->m_levels[level].offset + static_cast<size_t>(by) * ((w + 3) / 4) * blockSize;
+        for (GLsizei bx = 0; bx < (w + 3) / 4; bx++) {
+            for (int i = 0; i < 16; i++) {
+                size_t x = std::min(bx * 4 + i % 4, w - 1), y = std::min(by * 4 + i / 4, h - 1);
+                std::memcpy(block + i * 4, src + (y * w + x) * 4, 4);
+            }
+            encodeBlock(block, dst + bx * blockSize);
+        }
+    });
+
+    return result;
+}
+
+void CompressedImage::save(const fs::path& path) const {
+    auto it = std::find_if(FORMAT_CODES.begin(), FORMAT_CODES.end(), [this](const FormatCode& f) { return f.format == m_internalFormat; });
+    if (it == FORMAT_CODES.end() || m_levels.empty()) { throw std::runtime_error("CompressedImage::save: Invalid compressed image " + m_filepath); }
+
+    std::vector<uint8_t> header(DDS_HEADER_SIZE + DDS_DX10_SIZE, 0);
+    write<uint32_t>(header, 0, DDS_MAGIC);
+    write<uint32_t>(header, 4, 124);                               // dwSize
+    write<uint32_t>(header, 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000); // caps, height, width, pixel format, mip count, linear size
+    write<uint32_t>(header, 12, m_levels[0].height);
+    write<uint32_t>(header, 16, m_levels[0].width);
+    write<uint32_t>(header, 20, static_cast<uint32_t>(m_levels[0].size));
+    write<uint32_t>(header, 28, static_cast<uint32_t>(m_levels.size()));
+    write<uint32_t>(header, 76, 32);                               // ddspf.dwSize
+    write<uint32_t>(header, 80, DDS_FOURCC);
+    write<uint32_t>(header, 84, fourCC("DX10"));
+    write<uint32_t>(header, 108, 0x1000 | (m_levels.size() > 1 ? 0x400008 : 0)); // texture, mipmap and complex
+    write<uint32_t>(header, DDS_HEADER_SIZE, it->dxgi);
+    write<uint32_t>(header, DDS_HEADER_SIZE + 4, 3);               // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+    write<uint32_t>(header, DDS_HEADER_SIZE + 12, 1);              // array size
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) { throw std::runtime_error("CompressedImage::save: Failed to open file " + path.string()); }
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    file.write(reinterpret_cast<const char*>(m_data.data()), m_data.size());
+    if (!file) { throw std::runtime_error("CompressedImage::save: Failed to write file " + path.string()); }
+}
+
+bool CompressedImage::isCompressed(const fs::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".dds" || extension == ".ktx2";
+}
+
+bool CompressedImage::hasAlpha(const std::shared_ptr<Image>& image) {
+    if (image == nullptr || image->getChannels() != 4) { return false; }
+    size_t pixels = static_cast<size_t>(image->getWidth()) * image->getHeight();
+    for (size_t i = 0; i < pixels; i++) {
+        switch (image->getDataType()) {
+            case GL_FLOAT:
+                if (static_cast<const float*>(image->getData())[i * 4 + 3] < 1.f) { return true; }
+                break;
+            case GL_UNSIGNED_SHORT:
+                if (static_cast<const uint16_t*>(image->getData())[i * 4 + 3] < 65535) { return true; }
+                break;
+            default:
+                if (static_cast<const uint8_t*>(image->getData())[i * 4 + 3] < 255) { return true; }
+                break;
+        }
+    }
+    return false;
+}
+
+} // namespace tinyglrenderer
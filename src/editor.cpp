@@ -1,13 +1,16 @@
 #include "editor.hpp"
 
+#include <algorithm>
 #include <string>
 #include <array>
+#include <unordered_set>
 #include <format>
 
 #include <icon/IconsFontAwesome6.h>
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_opengl3.h>
 
+#include "memoryregistry.hpp"
 #include "utils.hpp"
 
 namespace tinyglrenderer {
@@ -335,6 +338,9 @@ void Editor::drawSideBar(Scene& scene) {
                     ImGui::Checkbox("Screen Space Refraction", &m_rendererSetting.ssrefr);
                     ImGui::Checkbox("Screen Space Ambient Occlussion", &m_rendererSetting.ssao);
                     ImGui::Checkbox("Temporal Anti-Aliasing", &m_rendererSetting.taa);
+                    ImGui::Checkbox("Cluster Culling", &m_rendererSetting.culling);
+                    ImGui::Checkbox("Back Face Culling", &m_rendererSetting.backface);
+                    ImGui::Checkbox("Level of Detail", &m_rendererSetting.lod);
                 }
                 ImGui::Separator();
 
@@ -471,10 +477,12 @@ void Editor::drawResourcePanel(Scene& scene, ResourceManager& manager) {
     float resourcePanelPosX    = (m_setting.currSBTab == SideBarTab::SB_TAB_NONE ? 0 : m_setting.sideBarWidth) + m_setting.activityBarWidth;
     float resourcePanelPosY    = m_setting.height - m_setting.resourcePanelHeight;
     ImVec2 resourcePanelSize   = ImVec2(m_setting.width - resourcePanelPosX, m_setting.resourcePanelHeight);
-    auto resourcePanelTab2Name = std::array<std::pair<ResourcePanelTab, const char*>, 3>{{
+    auto resourcePanelTab2Name = std::array<std::pair<ResourcePanelTab, const char*>, 5>{{
         { ResourcePanelTab::RP_TAB_MESHES,   "Loaded Meshes##ResourcePanelTab_Meshes"     },
         { ResourcePanelTab::RP_TAB_SHADERS,  "Loaded Shaders##ResourcePanelTab_SHADERS"   },
         { ResourcePanelTab::RP_TAB_TEXTURES, "Loaded Textures##ResourcePanelTab_TEXTURES" },
+        { ResourcePanelTab::RP_TAB_LOADING,  "Loading Queue##ResourcePanelTab_LOADING"    },
+        { ResourcePanelTab::RP_TAB_MEMORY,   "Memory Usage##ResourcePanelTab_MEMORY"      },
     }};
     ImGuiWindowFlags flags = ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoTitleBar;
 
@@ -490,7 +498,7 @@ void Editor::drawResourcePanel(Scene& scene, ResourceManager& manager) {
         if (selected) { ImGui::PushStyleColor(ImGuiCol_Button, ImGui::GetStyle().Colors[ImGuiCol_Header]); }
         if (ImGui::Button(label)) { m_setting.currRPTab = tab; }
         if (selected) { ImGui::PopStyleColor(); }
-        if (tab != ResourcePanelTab::RP_TAB_TEXTURES) { ImGui::SameLine(); } // only keep the same line if the tab button is not the last one, otherwise separator will cross the tab button
+        if (tab != ResourcePanelTab::RP_TAB_MEMORY) { ImGui::SameLine(); } // only keep the same line if the tab button is not the last one, otherwise separator will cross the tab button
     }
     ImGui::Separator();
 
@@ -501,6 +509,7 @@ void Editor::drawResourcePanel(Scene& scene, ResourceManager& manager) {
     float innerPanelHeight = ImGui::GetContentRegionAvail().y;
 
     std::vector<std::string> currRPItemNames;
+    std::vector<LoadRecord> records;
     switch (m_setting.currRPTab) {
         case ResourcePanelTab::RP_TAB_MESHES: {
             manager.getAllMeshNames(currRPItemNames);
@@ -511,6 +520,13 @@ void Editor::drawResourcePanel(Scene& scene, ResourceManager& manager) {
         case ResourcePanelTab::RP_TAB_TEXTURES: {
             manager.getAllTextureNames(currRPItemNames);
         } break;
+        case ResourcePanelTab::RP_TAB_LOADING: {
+            records = manager.getLoader().getRecords();
+            for (auto& record : records) { currRPItemNames.push_back(record.name); }
+        } break;
+        case ResourcePanelTab::RP_TAB_MEMORY: {
+            for (uint32_t tag = 0; tag <= static_cast<uint32_t>(MemoryTag::MT_COUNT); tag++) { currRPItemNames.push_back(MemoryRegistry::getName(static_cast<MemoryTag>(tag))); } // the last one is all tags
+        } break;
     }
 
     // =========================================================================
@@ -539,7 +555,19 @@ void Editor::drawResourcePanel(Scene& scene, ResourceManager& manager) {
                 ImGui::Text("ref count: %ld", mesh.use_count() - 1);
                 ImGui::Text("submesh count: %ld", mesh->getSubMeshCount());
                 ImGui::Text("vertex count: %ld", mesh->getVertexCount());
-                ImGui::TextWrapped("obj file path: %s", mesh->getFilePath().c_str());
+                ImGui::Text("index count: %ld", mesh->getIndexCount());
+                ImGui::Text("ACMR: %.3f, ATVR: %.3f", mesh->getStats().acmr, mesh->getStats().atvr);
+                ImGui::Text("cluster count: %ld", mesh->getStats().clusterCount);
+                for (size_t l = 0; l < mesh->getLodCount(); l++) {
+                    size_t triangles = 0;
+                    for (size_t i = 0; i < mesh->getSubMeshCount(); i++) { triangles += mesh->getSubMesh(i, l).length / 3; }
+                    ImGui::Text("lod %ld: %ld triangles", l, triangles);
+                }
+                const char* formats[] = {"float", "packed", "streams"};
+                ImGui::Text("vertex format: %s(%d bytes)", formats[static_cast<uint32_t>(mesh->getVertexFormat())], mesh->getVertexStride());
+                ImGui::Text("welded: %ld -> %ld vertices", mesh->getStats().srcVertexCount, mesh->getStats().vertexCount);
+                ImGui::Text("memory: %ld KB -> %ld KB", mesh->getStats().srcBytes / 1024, (mesh->getStats().vertexBytes + mesh->getStats().indexBytes) / 1024);
+                ImGui::TextWrapped("file path: %s", mesh->getFilePath().c_str());
             } break;
             case ResourcePanelTab::RP_TAB_TEXTURES: {
                 const auto& texture = manager.getTexture(name);
@@ -551,6 +579,50 @@ void Editor::drawResourcePanel(Scene& scene, ResourceManager& manager) {
                 ImGui::Text("width: %d", texture->getWidth(0));
                 ImGui::Text("height: %d", texture->getHeight(0));
                 ImGui::Text("depth: %d", texture->getDepth(0));
+                ImGui::Text("memory: %ld KB", texture->getByteSize() / 1024);
+
+                // Several names may alias one texture(e.g. placeholders of equal factors), count each texture once
+                std::unordered_set<const Texture*> textures;
+                size_t totalBytes = 0;
+                for (auto& other : currRPItemNames) {
+                    const auto& item = manager.getTexture(other);
+                    if (item && textures.insert(item.get()).second) { totalBytes += item->getByteSize(); }
+                }
+                ImGui::Text("memory of all textures: %.2f MB", static_cast<double>(totalBytes) / (1024.0 * 1024.0));
+
+                const auto& stats = manager.getTextureCacheStats();
+                ImGui::Text("texture cache: %ld hits, %ld misses, %ld stale", stats.hits.load(), stats.misses.load(), stats.stale.load());
+                ImGui::Text("cooked memory uploaded: %.2f MB", static_cast<double>(stats.bytes.load()) / (1024.0 * 1024.0));
+                if (const auto* staging = manager.getStagingBuffer()) {
+                    ImGui::Text("staging ring: %.2f / %.2f MB in flight, %ld uploads from client memory", static_cast<double>(staging->getUsedSize()) / (1024.0 * 1024.0), static_cast<double>(staging->getSize()) / (1024.0 * 1024.0), staging->getMissCount());
+                }
+                if (const auto& pool = manager.getTexturePool()) {
+                    ImGui::Text("texture pool: %ld layers in %ld buckets, %.2f MB", pool->getLayerCount(), pool->getBucketCount(), static_cast<double>(pool->getByteSize()) / (1024.0 * 1024.0));
+                }
+                const auto& residency = manager.getTextureResidencyStats();
+                ImGui::Text("texture residency: %.2f MB, %ld layers evicted, %ld mips trimmed", static_cast<double>(residency.used) / (1024.0 * 1024.0), residency.evictions, residency.trims);
+                int budget = static_cast<int>(residency.budget >> 20);
+                if (ImGui::SliderInt("texture budget(MB, 0 unlimited)", &budget, 0, 8192)) { manager.setTextureBudget(static_cast<size_t>(budget) << 20); }
+            } break;
+            case ResourcePanelTab::RP_TAB_LOADING: {
+                const auto& record = records[m_setting.currRPItemIndex];
+
+                ImGui::Text("state: %s", record.failed ? "failed" : (record.done ? "loaded" : "pending"));
+                ImGui::Text("decode time: %.1f ms(worker thread)", record.decodeTime);
+                ImGui::Text("upload time: %.1f ms(GL thread)", record.uploadTime);
+                if (record.failed) { ImGui::TextWrapped("error: %s", record.error.c_str()); }
+            } break;
+            case ResourcePanelTab::RP_TAB_MEMORY: {
+                auto tag = static_cast<MemoryTag>(m_setting.currRPItemIndex);
+
+                for (uint32_t kind = 0; kind < static_cast<uint32_t>(MemoryKind::MK_COUNT); kind++) {
+                    auto counter = MemoryRegistry::getCounter(static_cast<MemoryKind>(kind), tag);
+                    ImGui::Text("%s: %.2f MB(peak %.2f MB), %ld objects", MemoryRegistry::getName(static_cast<MemoryKind>(kind)), static_cast<double>(counter.bytes) / (1024.0 * 1024.0), static_cast<double>(counter.peak) / (1024.0 * 1024.0), counter.count);
+                }
+                ImGui::Separator();
+                if (ImGui::Button("Dump##MemoryDump")) { MemoryRegistry::dump("../cache/memory.json"); }
+                ImGui::SameLine();
+                ImGui::TextUnformatted("../cache/memory.json");
             } break;
             default: { // ResourcePanelTab::RP_TAB_SHADERS
                 const auto& shader = manager.getShader(name);
@@ -568,17 +640,65 @@ void Editor::drawResourcePanel(Scene& scene, ResourceManager& manager) {
     // =========================================================================
     ImGui::SameLine();
     ImGui::BeginChild("##RightPreview", ImVec2(innerPanelWidth * 0.5f, innerPanelHeight), true);
+    if (currRPItemNames.empty() || m_setting.currRPTab != ResourcePanelTab::RP_TAB_MESHES) { m_preview.reset(); } // release mapped obj file once no mesh is previewed
     if (!currRPItemNames.empty() && m_setting.currRPItemIndex < currRPItemNames.size()) {
         std::string name = currRPItemNames[m_setting.currRPItemIndex];
         switch(m_setting.currRPTab) {
             case ResourcePanelTab::RP_TAB_MESHES: {
                 const auto& mesh = manager.getMesh(name);
                 
-                ImGui::Text("OBJ File Preview");
+                bool gltf = GltfParser::isGltf(mesh->getFilePath());
+                ImGui::Text(gltf ? "glTF File Preview" : "OBJ File Preview");
                 ImGui::Separator();
-                const auto& textContent = mesh->getSource();
-                ImVec2 textRegionSize = ImGui::GetContentRegionAvail();
-                ImGui::InputTextMultiline("##TextShaderPreview", const_cast<char*>(textContent.c_str()), textContent.size() + 1, textRegionSize, ImGuiInputTextFlags_ReadOnly);
+                if (mesh->getFilePath().extension() == ".glb") {
+                    ImGui::TextUnformatted("[ No Preview For Binary glTF ]");
+                } else {
+                    drawFilePreview(mesh->getFilePath());
+                }
+            } break;
+            case ResourcePanelTab::RP_TAB_LOADING: {
+                size_t done = std::count_if(records.begin(), records.end(), [](const LoadRecord& record) { return record.done; });
+                ImGui::ProgressBar(static_cast<float>(done) / static_cast<float>(records.size()), ImVec2(-FLT_MIN, 0), std::format("{} / {} assets", done, records.size()).c_str());
+                ImGui::Separator();
+                if (ImGui::BeginTable("##LoadingTable", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY)) {
+                    ImGui::TableSetupColumn("asset");
+                    ImGui::TableSetupColumn("decode(ms)");
+                    ImGui::TableSetupColumn("upload(ms)");
+                    ImGui::TableHeadersRow();
+                    for (auto& record : records) {
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(record.name.c_str());
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.1f", record.decodeTime);
+                        ImGui::TableNextColumn();
+                        if (record.done) { ImGui::Text("%.1f", record.uploadTime); } else { ImGui::TextUnformatted("-"); }
+                    }
+                    ImGui::EndTable();
+                }
+            } break;
+            case ResourcePanelTab::RP_TAB_MEMORY: {
+                std::vector<MemoryEntry> entries;
+                MemoryRegistry::getEntries(entries, static_cast<MemoryTag>(m_setting.currRPItemIndex));
+                if (ImGui::BeginTable("##MemoryTable", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY)) {
+                    ImGui::TableSetupColumn("object");
+                    ImGui::TableSetupColumn("kind");
+                    ImGui::TableSetupColumn("tag");
+                    ImGui::TableSetupColumn("memory(KB)");
+                    ImGui::TableHeadersRow();
+                    for (auto& entry : entries) {
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(entry.label.empty() ? "-" : entry.label.c_str());
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(MemoryRegistry::getName(entry.kind));
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(MemoryRegistry::getName(entry.tag));
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.1f", static_cast<double>(entry.bytes) / 1024.0);
+                    }
+                    ImGui::EndTable();
+                }
             } break;
             case ResourcePanelTab::RP_TAB_SHADERS: {
                 const auto& shader = manager.getShader(name);
@@ -644,6 +764,11 @@ void Editor::drawHUD(Scene& scene, const DisplayInfo& info) {
         ImGui::Text("FPS       : %.1f", info.framePerSecond);
         ImGui::Text("Frame Time: %.2f ms", info.deltaTime * 1000.0f);
         ImGui::Text("Draw Call: %ld draw calls", currDrawCall - prevDrawCall);
+        ImGui::Text("Clusters : %ld drawn / %ld tested", info.clusterDrawn, info.clusterTested);
+        if (info.assetLoaded < info.assetTotal) { ImGui::Text("Loading : %ld / %ld assets", info.assetLoaded, info.assetTotal); }
+        for (size_t l = 0; l < info.lodTriangles.size(); l++) {
+            if (info.lodTriangles[l] > 0) { ImGui::Text("LOD %ld : %ld triangles", l, info.lodTriangles[l]); }
+        }
 
         ImGui::Spacing();
         ImGui::Text("STATE");
@@ -664,10 +789,43 @@ void Editor::drawHUD(Scene& scene, const DisplayInfo& info) {
         ImGui::Text("Screen Space Refraction : %s", m_rendererSetting.ssrefr ? "On" : "Off");
         ImGui::Text("Screen Space Ambient Occlusion : %s", m_rendererSetting.ssao ? "On" : "Off");
         ImGui::Text("Temporal Anti-Aliasing : %s", m_rendererSetting.taa ? "On" : "Off");
+        ImGui::Text("Cluster Culling : %s", m_rendererSetting.culling ? "On" : "Off");
+        ImGui::Text("Back Face Culling : %s", m_rendererSetting.backface ? "On" : "Off");
+        ImGui::Text("Level of Detail : %s", m_rendererSetting.lod ? "On" : "Off");
     }
     ImGui::End();
 
     prevDrawCall = currDrawCall;
 }
 
+void Editor::drawFilePreview(const fs::path& path) {
+    // 1. Map the file and index its lines once per previewed file, the previous mapping is released
+    if (!m_preview || m_preview->getFilePath() != path) {
+        m_preview = std::make_unique<MappedFile>(path);
+        m_previewLines.clear();
+        std::string_view text = m_preview->getView();
+        for (size_t pos = 0; pos < text.size();) {
+            m_previewLines.push_back(static_cast<uint32_t>(pos));
+            size_t end = text.find('\n', pos);
+            pos = (end == std::string_view::npos) ? text.size() : end + 1;
+        }
+    }
+
+    // 2. Draw only the lines inside the visible region with list clipper
+    std::string_view text = m_preview->getView();
+    ImGui::BeginChild("##TextFilePreview", ImGui::GetContentRegionAvail(), false, ImGuiWindowFlags_HorizontalScrollbar);
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(m_previewLines.size()));
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+            size_t begin = m_previewLines[i];
+            size_t end   = (i + 1 < static_cast<int>(m_previewLines.size())) ? m_previewLines[i + 1] : text.size();
+            while (end > begin && (text[end - 1] == '\n' || text[end - 1] == '\r')) { end--; }
+            ImGui::TextUnformatted(text.data() + begin, text.data() + end);
+        }
+    }
+    clipper.End();
+    ImGui::EndChild();
+}
+
 }; // namespace tinyglrenderer
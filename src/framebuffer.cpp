@@ -4,6 +4,7 @@
 #include <iostream>
 #include <vector>
 
+#include "memoryregistry.hpp"
 #include "utils.hpp"
 
 namespace tinyglrenderer {
@@ -31,12 +32,14 @@ FrameBuffer::FrameBuffer(bool screen, GLsizei w, GLsizei h)
         // Key insight:  glGenFramebuffers  = "allocate ID only" (need bind to use)
         //               glCreateFramebuffers = "allocate + initialize" (ready to use immediately)
         glCreateFramebuffers(1, &m_id);
+        MemoryRegistry::track(MemoryKind::MK_FRAMEBUFFER, this, 0); // attachments are counted as textures
     }
 }
 
 FrameBuffer::~FrameBuffer() {
     if (m_id) { glDeleteFramebuffers(1, &m_id); }
     m_attachments.clear();
+    MemoryRegistry::untrack(this);
 }
 
 FrameBuffer::FrameBuffer(FrameBuffer&& other) {
@@ -54,6 +57,7 @@ FrameBuffer::FrameBuffer(FrameBuffer&& other) {
     other.m_width  = 0;
     other.m_height = 0;
     other.m_attachments.clear();
+    MemoryRegistry::transfer(&other, this);
 }
 
 FrameBuffer& FrameBuffer::operator=(FrameBuffer&& other) {
@@ -71,6 +75,7 @@ FrameBuffer& FrameBuffer::operator=(FrameBuffer&& other) {
     other.m_width  = 0;
     other.m_height = 0;
     other.m_attachments.clear();
+    MemoryRegistry::transfer(&other, this);
     return *this;
 };
 
@@ -0,0 +1,509 @@
+#include "gltfparser.hpp"
+
+#include <rapidjson/document.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+
+namespace tinyglrenderer {
+
+static constexpr uint32_t GLTF_GLB_MAGIC      = 0x46546C67; // "glTF"
+static constexpr uint32_t GLTF_GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+static constexpr uint32_t GLTF_GLB_CHUNK_BIN  = 0x004E4942; // "BIN\0"
+static constexpr int GLTF_MODE_TRIANGLES      = 4;
+static constexpr int GLTF_MAX_NODE_DEPTH      = 64; // guards against cyclic node hierarchies
+
+static const uint8_t GLTF_ZERO_ELEMENT[16] = {}; // element of streams a primitive does not provide
+
+// Decode a base64 payload of data uri, characters outside the alphabet(e.g. line breaks) are skipped.
+static std::vector<uint8_t> decodeBase64(std::string_view text) {
+    std::vector<uint8_t> bytes;
+    bytes.reserve(text.size() / 4 * 3);
+    uint32_t bits = 0;
+    int count     = 0;
+    for (char c : text) {
+        int value = (c >= 'A' && c <= 'Z') ? c - 'A' : (c >= 'a' && c <= 'z') ? c - 'a' + 26 : (c >= '0' && c <= '9') ? c - '0' + 52 : (c == '+') ? 62 : (c == '/') ? 63 : -1;
+        if (c == '=') { break; }
+        if (value < 0) { continue; }
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        if ((count += 6) >= 8) {
+            count -= 8;
+            bytes.push_back(static_cast<uint8_t>(bits >> count));
+        }
+    }
+    return bytes;
+}
+
+// Decode percent encoded characters of relative uri(e.g. "%20" is a space).
+static std::string decodeUri(std::string_view uri) {
+    std::string path;
+    for (size_t i = 0; i < uri.size(); i++) {
+        if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i + 1])) && std::isxdigit(static_cast<unsigned char>(uri[i + 2]))) {
+            path.push_back(static_cast<char>(std::stoi(std::string(uri.substr(i + 1, 2)), nullptr, 16)));
+            i += 2;
+        } else {
+            path.push_back(uri[i]);
+        }
+    }
+    return path;
+}
+
+static size_t getComponentSize(int componentType) {
+    switch (componentType) {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE: return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT:
+        case GL_FLOAT: return 4;
+        default: return 0;
+    }
+}
+
+static int getComponentCount(std::string_view type) {
+    if (type == "SCALAR") { return 1; }
+    if (type == "VEC2") { return 2; }
+    if (type == "VEC3") { return 3; }
+    if (type == "VEC4") { return 4; }
+    if (type == "MAT2") { return 4; }
+    if (type == "MAT3") { return 9; }
+    if (type == "MAT4") { return 16; }
+    return 0;
+}
+
+static int getInt(const rapidjson::Value& object, const char* name, int defaultValue) {
+    return object.HasMember(name) && object[name].IsNumber() ? object[name].GetInt() : defaultValue;
+}
+
+static float getFloat(const rapidjson::Value& object, const char* name, float defaultValue) {
+    return object.HasMember(name) && object[name].IsNumber() ? object[name].GetFloat() : defaultValue;
+}
+
+GltfParser::GltfParser(const fs::path& path) {
+    m_filepath = path;
+    m_files.push_back(std::make_unique<MappedFile>(path));
+    const MappedFile& file = *m_files.front();
+
+    // 1. Locate JSON(and BIN chunk of .glb), chunks are 4 bytes aligned
+    std::string_view json = file.getView();
+    std::pair<const uint8_t*, size_t> bin = {nullptr, 0};
+    if (file.getSize() >= 12 && *reinterpret_cast<const uint32_t*>(file.getData()) == GLTF_GLB_MAGIC) {
+        uint32_t header[3];
+        std::memcpy(header, file.getData(), sizeof(header));
+        if (header[1] != 2) { throw std::runtime_error(std::format("GltfParser::GltfParser: Unsupported glb version {} of [{}]", header[1], path.string())); }
+
+        size_t length = std::min<size_t>(header[2], file.getSize());
+        json          = {};
+        for (size_t offset = 12; offset + 8 <= length;) {
+            uint32_t chunk[2];
+            std::memcpy(chunk, file.getData() + offset, sizeof(chunk));
+            if (offset + 8 + chunk[0] > length) { throw std::runtime_error("GltfParser::GltfParser: Truncated glb chunk of [" + path.string() + "]"); }
+            if (chunk[1] == GLTF_GLB_CHUNK_JSON && json.empty()) { json = {reinterpret_cast<const char*>(file.getData() + offset + 8), chunk[0]}; }
+            if (chunk[1] == GLTF_GLB_CHUNK_BIN && bin.first == nullptr) { bin = {file.getData() + offset + 8, chunk[0]}; }
+            offset += 8 + ((chunk[0] + 3) & ~3u);
+        }
+        if (json.empty()) { throw std::runtime_error("GltfParser::GltfParser: Missing JSON chunk of [" + path.string() + "]"); }
+    }
+
+    rapidjson::Document document;
+    document.Parse(json.data(), json.size());
+    if (document.HasParseError() || !document.IsObject()) { throw std::runtime_error("GltfParser::GltfParser: Failed to parse JSON of [" + path.string() + "]"); }
+    if (!document.HasMember("asset") || !document["asset"].HasMember("version") || document["asset"]["version"].GetString()[0] != '2') {
+        throw std::runtime_error("GltfParser::GltfParser: Only glTF 2.0 is supported [" + path.string() + "]");
+    }
+
+    // 2. Resolve buffers: glb binary chunk, base64 data uri or external file next to the glTF file
+    if (document.HasMember("buffers")) {
+        const rapidjson::Value& buffers = document["buffers"];
+        for (rapidjson::SizeType i = 0; i < buffers.Size(); i++) {
+            const rapidjson::Value& buffer = buffers[i];
+            size_t length = static_cast<size_t>(buffer["byteLength"].GetUint64());
+            std::pair<const uint8_t*, size_t> bytes;
+            if (!buffer.HasMember("uri")) {
+                if (i != 0 || bin.first == nullptr) { throw std::runtime_error(std::format("GltfParser::GltfParser: Buffer {} has no data [{}]", i, path.string())); }
+                bytes = bin;
+            } else if (std::string_view uri = buffer["uri"].GetString(); uri.starts_with("data:")) {
+                size_t comma = uri.find(',');
+                if (comma == std::string_view::npos || uri.substr(0, comma).find(";base64") == std::string_view::npos) { throw std::runtime_error(std::format("GltfParser::GltfParser: Buffer {} is not base64 encoded [{}]", i, path.string())); }
+                m_decoded.push_back(decodeBase64(uri.substr(comma + 1)));
+                bytes = {m_decoded.back().data(), m_decoded.back().size()};
+            } else {
+                m_files.push_back(std::make_unique<MappedFile>(path.parent_path() / decodeUri(uri)));
+                bytes = {m_files.back()->getData(), m_files.back()->getSize()};
+            }
+            if (bytes.second < length) { throw std::runtime_error(std::format("GltfParser::GltfParser: Buffer {} is shorter than {} bytes [{}]", i, length, path.string())); }
+            m_buffers.emplace_back(bytes.first, length);
+        }
+    }
+
+    // 3. Resolve accessors into pointers, every element must lie inside its buffer view
+    if (document.HasMember("accessors")) {
+        const rapidjson::Value& accessors = document["accessors"];
+        const rapidjson::Value& views     = document["bufferViews"];
+        for (rapidjson::SizeType i = 0; i < accessors.Size(); i++) {
+            const rapidjson::Value& accessor = accessors[i];
+            if (accessor.HasMember("sparse")) { throw std::runtime_error(std::format("GltfParser::GltfParser: Sparse accessor {} is not supported [{}]", i, path.string())); }
+            if (!accessor.HasMember("bufferView")) { throw std::runtime_error(std::format("GltfParser::GltfParser: Accessor {} has no buffer view [{}]", i, path.string())); }
+
+            int viewIndex = accessor["bufferView"].GetInt();
+            if (viewIndex < 0 || viewIndex >= static_cast<int>(views.Size())) { throw std::runtime_error(std::format("GltfParser::GltfParser: Invalid buffer view of accessor {} [{}]", i, path.string())); }
+            const rapidjson::Value& view = views[viewIndex];
+            int bufferIndex = view["buffer"].GetInt();
+            if (bufferIndex < 0 || bufferIndex >= static_cast<int>(m_buffers.size())) { throw std::runtime_error(std::format("GltfParser::GltfParser: Invalid buffer of view {} [{}]", viewIndex, path.string())); }
+
+            Accessor result;
+            result.count         = static_cast<size_t>(accessor["count"].GetUint64());
+            result.componentType = accessor["componentType"].GetInt();
+            result.components    = getComponentCount(accessor["type"].GetString());
+            result.normalized    = accessor.HasMember("normalized") && accessor["normalized"].GetBool();
+            size_t elementSize   = getComponentSize(result.componentType) * result.components;
+            if (elementSize == 0) { throw std::runtime_error(std::format("GltfParser::GltfParser: Invalid type of accessor {} [{}]", i, path.string())); }
+
+            size_t viewOffset = static_cast<size_t>(getInt(view, "byteOffset", 0));
+            size_t viewLength = static_cast<size_t>(view["byteLength"].GetUint64());
+            size_t offset     = static_cast<size_t>(getInt(accessor, "byteOffset", 0));
+            result.stride     = static_cast<size_t>(getInt(view, "byteStride", 0));
+            result.stride     = result.stride ? result.stride : elementSize;
+            if (viewOffset + viewLength > m_buffers[bufferIndex].second || (result.count && offset + result.stride * (result.count - 1) + elementSize > viewLength)) {
+                throw std::runtime_error(std::format("GltfParser::GltfParser: Accessor {} is out of buffer range [{}]", i, path.string()));
+            }
+            result.data = m_buffers[bufferIndex].first + viewOffset + offset;
+            if (accessor.HasMember("min") && accessor.HasMember("max") && result.components <= 4) {
+                result.bounded = true;
+                for (int c = 0; c < result.components; c++) {
+                    result.min[c] = accessor["min"][c].GetFloat();
+                    result.max[c] = accessor["max"][c].GetFloat();
+                }
+            }
+            m_accessors.push_back(result);
+        }
+    }
+
+    // 4. Collect primitives of every node with its world transform, a file without nodes draws each mesh once
+    auto addMesh = [&](int meshIndex, const glm::mat4& transform) {
+        const rapidjson::Value& meshes = document["meshes"];
+        if (meshIndex < 0 || meshIndex >= static_cast<int>(meshes.Size())) { throw std::runtime_error(std::format("GltfParser::GltfParser: Invalid mesh {} [{}]", meshIndex, path.string())); }
+        const rapidjson::Value& primitives = meshes[meshIndex]["primitives"];
+        for (rapidjson::SizeType i = 0; i < primitives.Size(); i++) {
+            const rapidjson::Value& primitive = primitives[i];
+            if (getInt(primitive, "mode", GLTF_MODE_TRIANGLES) != GLTF_MODE_TRIANGLES) {
+                std::cout << std::format("Skipping primitive {} of mesh {}, only triangles are supported [{}]", i, meshIndex, path.string()) << "\n";
+                continue;
+            }
+
+            const rapidjson::Value& attributes = primitive["attributes"];
+            Primitive result;
+            result.position  = getInt(attributes, "POSITION", -1);
+            result.normal    = getInt(attributes, "NORMAL", -1);
+            result.tangent   = getInt(attributes, "TANGENT", -1);
+            result.texcoord  = getInt(attributes, "TEXCOORD_0", -1);
+            result.indices   = getInt(primitive, "indices", -1);
+            result.material  = getInt(primitive, "material", -1);
+            result.transform = transform;
+            for (int accessor : {result.position, result.normal, result.tangent, result.texcoord, result.indices}) {
+                if (accessor >= static_cast<int>(m_accessors.size())) { throw std::runtime_error(std::format("GltfParser::GltfParser: Invalid accessor {} [{}]", accessor, path.string())); }
+            }
+            if (result.position < 0) { continue; }
+            for (int accessor : {result.normal, result.tangent, result.texcoord}) {
+                if (accessor >= 0 && m_accessors[accessor].count != m_accessors[result.position].count) { throw std::runtime_error(std::format("GltfParser::GltfParser: Attribute counts differ in primitive {} of mesh {} [{}]", i, meshIndex, path.string())); }
+            }
+            m_primitives.push_back(result);
+        }
+    };
+
+    std::function<void(int, const glm::mat4&, int)> addNode = [&](int nodeIndex, const glm::mat4& parent, int depth) {
+        const rapidjson::Value& nodes = document["nodes"];
+        if (nodeIndex < 0 || nodeIndex >= static_cast<int>(nodes.Size()) || depth > GLTF_MAX_NODE_DEPTH) { throw std::runtime_error(std::format("GltfParser::GltfParser: Invalid node {} [{}]", nodeIndex, path.string())); }
+        const rapidjson::Value& node = nodes[nodeIndex];
+
+        // Local transform is either a column major matrix or translation * rotation * scale
+        glm::mat4 local = glm::mat4(1.f);
+        if (node.HasMember("matrix")) {
+            float matrix[16];
+            for (int i = 0; i < 16; i++) { matrix[i] = node["matrix"][i].GetFloat(); }
+            local = glm::make_mat4(matrix);
+        } else {
+            if (node.HasMember("translation")) {
+                const rapidjson::Value& t = node["translation"];
+                local = glm::translate(local, glm::vec3(t[0].GetFloat(), t[1].GetFloat(), t[2].GetFloat()));
+            }
+            if (node.HasMember("rotation")) {
+                const rapidjson::Value& r = node["rotation"]; // x, y, z, w
+                local = local * glm::mat4_cast(glm::quat(r[3].GetFloat(), r[0].GetFloat(), r[1].GetFloat(), r[2].GetFloat()));
+            }
+            if (node.HasMember("scale")) {
+                const rapidjson::Value& s = node["scale"];
+                local = glm::scale(local, glm::vec3(s[0].GetFloat(), s[1].GetFloat(), s[2].GetFloat()));
+            }
+        }
+
+        glm::mat4 world = parent * local;
+        if (node.HasMember("mesh")) { addMesh(node["mesh"].GetInt(), world); }
+        if (node.HasMember("children")) {
+            for (rapidjson::SizeType i = 0; i < node["children"].Size(); i++) { addNode(node["children"][i].GetInt(), world, depth + 1); }
+        }
+    };
+
+    if (document.HasMember("nodes") && document.HasMember("scenes") && document["scenes"].Size() > 0) {
+        int sceneIndex = std::clamp(getInt(document, "scene", 0), 0, static_cast<int>(document["scenes"].Size()) - 1);
+        const rapidjson::Value& scene = document["scenes"][sceneIndex];
+        if (scene.HasMember("nodes")) {
+            for (rapidjson::SizeType i = 0; i < scene["nodes"].Size(); i++) { addNode(scene["nodes"][i].GetInt(), glm::mat4(1.f), 0); }
+        }
+    } else if (document.HasMember("meshes")) {
+        for (rapidjson::SizeType i = 0; i < document["meshes"].Size(); i++) { addMesh(static_cast<int>(i), glm::mat4(1.f)); }
+    }
+    if (m_primitives.empty()) { throw std::runtime_error("GltfParser::GltfParser: No triangle primitive found in [" + path.string() + "]"); }
+
+    // 5. Translate pbrMetallicRoughness materials, names are prefixed by file name since materials are shared by name
+    //
+    // ┌──────────────────────────────────────┬───────────────────────────────────────────────────────────┐
+    // │ glTF                                 │ tinyobj::material_t                                       │
+    // ├──────────────────────────────────────┼───────────────────────────────────────────────────────────┤
+    // │ baseColorFactor                      │ diffuse, and dissolve if alphaMode is BLEND               │
+    // │ baseColorTexture                     │ diffuse_texname                                           │
+    // │ metallicFactor, roughnessFactor      │ metallic, roughness                                       │
+    // │ metallicRoughnessTexture(B, G)       │ metallic_texname and roughness_texname, the same file     │
+    // │ occlusionTexture(R)                  │ ambient_texname                                           │
+    // │ normalTexture                        │ normal_texname                                            │
+    // └──────────────────────────────────────┴───────────────────────────────────────────────────────────┘
+    auto getImage = [&](const rapidjson::Value& material, const char* name) -> std::string {
+        if (!material.HasMember(name) || !material[name].HasMember("index")) { return ""; }
+        int textureIndex = material[name]["index"].GetInt();
+        if (!document.HasMember("textures") || textureIndex < 0 || textureIndex >= static_cast<int>(document["textures"].Size())) { return ""; }
+        int imageIndex = getInt(document["textures"][textureIndex], "source", -1);
+        if (!document.HasMember("images") || imageIndex < 0 || imageIndex >= static_cast<int>(document["images"].Size())) { return ""; }
+        const rapidjson::Value& image = document["images"][imageIndex];
+        if (!image.HasMember("uri") || std::string_view(image["uri"].GetString()).starts_with("data:")) {
+            std::cout << std::format("Skipping embedded image {} of [{}], only external images are supported", imageIndex, path.string()) << "\n";
+            return "";
+        }
+        return decodeUri(image["uri"].GetString());
+    };
+
+    if (document.HasMember("materials")) {
+        const rapidjson::Value& materials = document["materials"];
+        for (rapidjson::SizeType i = 0; i < materials.Size(); i++) {
+            const rapidjson::Value& material = materials[i];
+            tinyobj::material_t result;
+            std::string name = material.HasMember("name") && material["name"].GetStringLength() > 0 ? material["name"].GetString() : std::to_string(i);
+            result.name      = std::format("{}_{}", path.stem().string(), name);
+            result.metallic  = 1.f;
+            result.roughness = 1.f;
+            result.dissolve  = 1.f;
+            for (int c = 0; c < 3; c++) { result.diffuse[c] = 1.f; }
+
+            if (material.HasMember("pbrMetallicRoughness")) {
+                const rapidjson::Value& pbr = material["pbrMetallicRoughness"];
+                if (pbr.HasMember("baseColorFactor")) {
+                    for (int c = 0; c < 3; c++) { result.diffuse[c] = pbr["baseColorFactor"][c].GetFloat(); }
+                    if (material.HasMember("alphaMode") && std::string_view(material["alphaMode"].GetString()) == "BLEND") { result.dissolve = pbr["baseColorFactor"][3].GetFloat(); }
+                }
+                result.metallic          = getFloat(pbr, "metallicFactor", 1.f);
+                result.roughness         = getFloat(pbr, "roughnessFactor", 1.f);
+                result.diffuse_texname   = getImage(pbr, "baseColorTexture");
+                result.metallic_texname  = getImage(pbr, "metallicRoughnessTexture");
+                result.roughness_texname = result.metallic_texname;
+            }
+            result.normal_texname  = getImage(material, "normalTexture");
+            result.ambient_texname = getImage(material, "occlusionTexture");
+            m_materials.push_back(result);
+        }
+    }
+
+    // 6. Plan direct uploads if the buffers can be drawn as they are
+    m_direct = plan();
+}
+
+GltfParser::~GltfParser() = default;
+
+size_t GltfParser::getSize() const {
+    size_t size = 0;
+    for (auto& file : m_files) { size += file->getSize(); }
+    return size;
+}
+
+uint64_t GltfParser::hash() const {
+    uint64_t hash = m_files.front()->hash();
+    for (size_t i = 1; i < m_files.size(); i++) { hash = MappedFile::hash(m_files[i]->getData(), m_files[i]->getSize(), hash); }
+    return hash;
+}
+
+bool GltfParser::isGltf(const fs::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".gltf" || extension == ".glb";
+}
+
+glm::vec4 GltfParser::read(const Accessor& accessor, size_t index) const {
+    glm::vec4 value(0.f);
+    const uint8_t* element = accessor.data + index * accessor.stride;
+    for (int c = 0; c < std::min(accessor.components, 4); c++) {
+        switch (accessor.componentType) {
+            case GL_FLOAT: { float v; std::memcpy(&v, element + c * 4, 4); value[c] = v; break; }
+            case GL_UNSIGNED_INT: { uint32_t v; std::memcpy(&v, element + c * 4, 4); value[c] = static_cast<float>(v); break; }
+            case GL_UNSIGNED_SHORT: { uint16_t v; std::memcpy(&v, element + c * 2, 2); value[c] = accessor.normalized ? v / 65535.f : v; break; }
+            case GL_SHORT: { int16_t v; std::memcpy(&v, element + c * 2, 2); value[c] = accessor.normalized ? std::max(v / 32767.f, -1.f) : v; break; }
+            case GL_UNSIGNED_BYTE: { value[c] = accessor.normalized ? element[c] / 255.f : element[c]; break; }
+            case GL_BYTE: { int8_t v = static_cast<int8_t>(element[c]); value[c] = accessor.normalized ? std::max(v / 127.f, -1.f) : v; break; }
+        }
+    }
+    return value;
+}
+
+uint32_t GltfParser::readIndex(int accessor, size_t index) const {
+    if (accessor < 0) { return static_cast<uint32_t>(index); }
+    const Accessor& indices = m_accessors[accessor];
+    const uint8_t* element  = indices.data + index * indices.stride;
+    switch (indices.componentType) {
+        case GL_UNSIGNED_INT: { uint32_t v; std::memcpy(&v, element, 4); return v; }
+        case GL_UNSIGNED_SHORT: { uint16_t v; std::memcpy(&v, element, 2); return v; }
+        default: return element[0];
+    }
+}
+
+void GltfParser::load(tinyobj::attrib_t* attributes, std::vector<tinyobj::shape_t>* shapes) const {
+    attributes->vertices.clear();
+    attributes->normals.clear();
+    attributes->texcoords.clear();
+    shapes->clear();
+
+    for (size_t p = 0; p < m_primitives.size(); p++) {
+        const Primitive& primitive = m_primitives[p];
+        const Accessor& positions  = m_accessors[primitive.position];
+        int vertex   = static_cast<int>(attributes->vertices.size() / 3);
+        int normal   = primitive.normal >= 0 ? static_cast<int>(attributes->normals.size() / 3) : -1;
+        int texcoord = primitive.texcoord >= 0 ? static_cast<int>(attributes->texcoords.size() / 2) : -1;
+
+        // 1. Bake node transform into attributes, a mirroring transform flips the winding of triangles
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(primitive.transform)));
+        bool mirrored          = glm::determinant(glm::mat3(primitive.transform)) < 0.f;
+        for (size_t i = 0; i < positions.count; i++) {
+            glm::vec3 position = glm::vec3(primitive.transform * glm::vec4(glm::vec3(read(positions, i)), 1.f));
+            attributes->vertices.insert(attributes->vertices.end(), {position.x, position.y, position.z});
+            if (normal >= 0) {
+                glm::vec3 n = normalMatrix * glm::vec3(read(m_accessors[primitive.normal], i));
+                n           = glm::dot(n, n) > 0.f ? glm::normalize(n) : n;
+                attributes->normals.insert(attributes->normals.end(), {n.x, n.y, n.z});
+            }
+            if (texcoord >= 0) {
+                glm::vec4 uv = read(m_accessors[primitive.texcoord], i);
+                attributes->texcoords.insert(attributes->texcoords.end(), {uv.x, 1.f - uv.y});
+            }
+        }
+
+        // 2. Every primitive becomes a shape, corners share the same index for all attributes
+        tinyobj::shape_t shape;
+        shape.name    = std::format("primitive_{}", p);
+        size_t count  = primitive.indices >= 0 ? m_accessors[primitive.indices].count : positions.count;
+        int materialId = primitive.material >= 0 && primitive.material < static_cast<int>(m_materials.size()) ? primitive.material : -1;
+        for (size_t i = 0; i + 2 < count; i += 3) {
+            uint32_t corners[3] = {readIndex(primitive.indices, i), readIndex(primitive.indices, i + 1), readIndex(primitive.indices, i + 2)};
+            if (mirrored) { std::swap(corners[1], corners[2]); }
+            if (corners[0] >= positions.count || corners[1] >= positions.count || corners[2] >= positions.count) { continue; }
+            for (uint32_t corner : corners) {
+                int index = static_cast<int>(corner);
+                shape.mesh.indices.push_back(tinyobj::index_t{vertex + index, normal >= 0 ? normal + index : -1, texcoord >= 0 ? texcoord + index : -1});
+            }
+            shape.mesh.num_face_vertices.push_back(3);
+            shape.mesh.material_ids.push_back(materialId);
+        }
+        shapes->push_back(std::move(shape));
+    }
+}
+
+bool GltfParser::plan() {
+    // 1. Every primitive must provide float streams with tight strides, and either all or none provide texcoords.
+    // Tangents are required since shaders build TBN from them, meshes without tangents are cooked(which derives them).
+    auto isStream = [&](int accessor, int components) {
+        return accessor >= 0 && m_accessors[accessor].componentType == GL_FLOAT && m_accessors[accessor].components == components &&
+               m_accessors[accessor].stride == sizeof(float) * components;
+    };
+    bool texcoords = m_primitives.front().texcoord >= 0;
+    for (auto& primitive : m_primitives) {
+        if (primitive.transform != glm::mat4(1.f) || (primitive.texcoord >= 0) != texcoords) { return false; }
+        if (!isStream(primitive.position, 3) || !isStream(primitive.normal, 3) || !isStream(primitive.tangent, 4) || (texcoords && !isStream(primitive.texcoord, 2))) { return false; }
+        if (primitive.indices < 0) { return false; }
+        const Accessor& indices = m_accessors[primitive.indices];
+        if ((indices.componentType != GL_UNSIGNED_SHORT && indices.componentType != GL_UNSIGNED_INT) || indices.stride != getComponentSize(indices.componentType) || indices.count % 3 != 0) { return false; }
+
+        // The GPU fetches vertices by these indices as they are, an index past the vertices of its primitive would read outside the
+        // vertex buffer. Declared max may lie, so indices are scanned and such files are cooked(which drops the broken triangles)
+        uint32_t largest = 0;
+        for (size_t i = 0; i < indices.count; i++) { largest = std::max(largest, readIndex(primitive.indices, i)); }
+        if (indices.count > 0 && largest >= m_accessors[primitive.position].count) { return false; }
+    }
+
+    // 2. Lay streams out one after another, primitive by primitive, so each primitive draws with its first vertex as base vertex
+    size_t vertexCount = 0;
+    for (auto& primitive : m_primitives) { vertexCount += m_accessors[primitive.position].count; }
+    size_t offsets[4] = {0, vertexCount * sizeof(glm::vec3), vertexCount * sizeof(glm::vec3) * 2, vertexCount * (sizeof(glm::vec3) * 2 + sizeof(glm::vec4))};
+    m_streams = {
+        MeshStream{.offset = static_cast<GLintptr>(offsets[0]), .stride = sizeof(glm::vec3)},
+        MeshStream{.offset = static_cast<GLintptr>(offsets[1]), .stride = sizeof(glm::vec3)},
+        MeshStream{.offset = static_cast<GLintptr>(offsets[2]), .stride = sizeof(glm::vec4)},
+        MeshStream{.offset = static_cast<GLintptr>(offsets[3]), .stride = texcoords ? static_cast<GLsizei>(sizeof(glm::vec2)) : 0},
+    };
+    m_stats.vertexBytes = offsets[3] + (texcoords ? vertexCount * sizeof(glm::vec2) : sizeof(GLTF_ZERO_ELEMENT));
+    if (!texcoords) { m_vertexUploads.push_back(MeshUpload{.data = GLTF_ZERO_ELEMENT, .offset = offsets[3], .length = sizeof(GLTF_ZERO_ELEMENT)}); }
+
+    size_t base = 0, indexBytes = 0;
+    for (auto& primitive : m_primitives) {
+        const Accessor& positions = m_accessors[primitive.position];
+        const Accessor& indices   = m_accessors[primitive.indices];
+        int streams[4]            = {primitive.position, primitive.normal, primitive.tangent, texcoords ? primitive.texcoord : -1};
+        for (int s = 0; s < 4; s++) {
+            if (streams[s] < 0) { continue; }
+            const Accessor& accessor = m_accessors[streams[s]];
+            m_vertexUploads.push_back(MeshUpload{.data = accessor.data, .offset = offsets[s] + base * accessor.stride, .length = accessor.count * accessor.stride});
+        }
+
+        // Mixed 16/32 bits indices, each primitive is aligned to its index size
+        indexBytes = (indexBytes + indices.stride - 1) / indices.stride * indices.stride;
+        m_indexUploads.push_back(MeshUpload{.data = indices.data, .offset = indexBytes, .length = indices.count * indices.stride});
+        m_submeshes.push_back(SubMesh{
+            .matid  = primitive.material >= 0 && primitive.material < static_cast<int>(m_materials.size()) ? primitive.material : -1,
+            .offset = static_cast<uint>(indexBytes),
+            .length = static_cast<uint>(indices.count),
+            .vertex = static_cast<uint>(base),
+            .type   = static_cast<GLenum>(indices.componentType),
+        });
+        indexBytes += indices.count * indices.stride;
+        m_stats.indexCount += indices.count;
+
+        // Bounds come from min/max of POSITION accessor(required by glTF), positions are scanned only if they are missing
+        if (positions.bounded) {
+            m_bounds.first  = glm::min(m_bounds.first, glm::vec3(positions.min));
+            m_bounds.second = glm::max(m_bounds.second, glm::vec3(positions.max));
+        } else {
+            for (size_t i = 0; i < positions.count; i++) {
+                glm::vec3 position = glm::vec3(read(positions, i));
+                m_bounds.first     = glm::min(m_bounds.first, position);
+                m_bounds.second    = glm::max(m_bounds.second, position);
+            }
+        }
+        base += positions.count;
+    }
+
+    m_stats.vertexCount    = vertexCount;
+    m_stats.indexBytes     = indexBytes;
+    m_stats.srcVertexCount = vertexCount;
+    m_stats.srcBytes       = m_stats.vertexBytes + m_stats.indexBytes;
+    m_stats.lodCount       = 1;
+    return true;
+}
+
+std::shared_ptr<Mesh> GltfParser::createMesh() const {
+    if (!m_direct) { throw std::runtime_error("GltfParser::createMesh: Buffers of [" + m_filepath.string() + "] can not be drawn directly"); }
+    return std::make_shared<Mesh>(m_filepath, m_streams, m_vertexUploads, m_indexUploads, m_submeshes, m_bounds, m_stats);
+}
+
+} // namespace tinyglrenderer
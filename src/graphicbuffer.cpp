@@ -2,8 +2,10 @@
 
 #include <stdexcept>
 
+#include "memoryregistry.hpp"
+
 namespace tinyglrenderer {
-GraphicBuffer::GraphicBuffer(GLenum target, GLsizeiptr size, const void* data) : m_target(target), m_size(size) {
+GraphicBuffer::GraphicBuffer(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags) : m_target(target), m_size(size) {
     if (size <= 0) {
         // by the way, data can be nullptr when construting a new buffer, which means only allocating memory without initializing
         throw std::invalid_argument("GraphicBuffer::GraphicBuffer: size must be greater than 0");
@@ -57,13 +59,15 @@ GraphicBuffer::GraphicBuffer(GLenum target, GLsizeiptr size, const void* data) :
     //   Legacy:   glBindBuffer(GL_ARRAY_BUFFER, id); glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
     //   Modern:   glNamedBufferData(id, size, data, GL_STATIC_DRAW);
     //   Immutable:glNamedBufferStorage(id, size, data, GL_DYNAMIC_STORAGE_BIT);  // Size cannot change!
-    glNamedBufferStorage(m_id, size, data, GL_DYNAMIC_STORAGE_BIT);
+    glNamedBufferStorage(m_id, size, data, flags);
+    MemoryRegistry::track(MemoryKind::MK_BUFFER, this, static_cast<size_t>(size));
 }
 
 GraphicBuffer::~GraphicBuffer() {
     if (m_id != 0) {
         glDeleteBuffers(1, &m_id);
     }
+    MemoryRegistry::untrack(this);
 }
 
 void GraphicBuffer::upload(GLintptr offset, GLsizeiptr length, const void* data) {
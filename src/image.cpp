@@ -1,11 +1,34 @@
 #include "image.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+
+#include "mappedfile.hpp"
+#include "memoryregistry.hpp"
+#include "utils.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
 
 namespace tinyglrenderer {
 
 namespace fs = std::filesystem;
 
+// One channel of a source image, packed into one channel of a merged image
+struct PackPlane {
+    const void* data;
+    GLenum type;
+    int stride;  // channels of source image
+    int channel; // channel index in source image
+};
+
 Image::Image(const std::string& filepath, void* data, GLenum type, int width, int height, int channels) {
     m_filepath = filepath;
     m_data     = data;
@@ -13,6 +36,7 @@ Image::Image(const std::string& filepath, void* data, GLenum type, int width, in
     m_width    = width;
     m_height   = height;
     m_channels = channels;
+    MemoryRegistry::track(MemoryKind::MK_IMAGE, this, getByteSize());
 }
 
 Image::Image(Image&& other) {
@@ -30,6 +54,7 @@ Image::Image(Image&& other) {
     other.m_width    = 0;
     other.m_height   = 0;
     other.m_channels = 0;
+    MemoryRegistry::transfer(&other, this);
 }
 
 Image& Image::operator=(Image&& other) {
@@ -47,6 +72,7 @@ Image& Image::operator=(Image&& other) {
     other.m_width    = 0;
     other.m_height   = 0;
     other.m_channels = 0;
+    MemoryRegistry::transfer(&other, this);
     return *this;
 }
 
@@ -54,30 +80,36 @@ Image::~Image() {
     if (m_data) {
         stbi_image_free(m_data);
     }
+    MemoryRegistry::untrack(this);
 }
 
 std::shared_ptr<Image> Image::create(const fs::path& path, int desiredChannels, bool flip) {
-    stbi_set_flip_vertically_on_load(flip);
+    stbi_set_flip_vertically_on_load_thread(flip); // per thread flag, images are decoded on loader workers concurrently
     std::string filepath = fs::canonical(path).string();
     void* data  = nullptr;
     GLenum type = GL_UNSIGNED_BYTE;
     int width = 0, height = 0, channels = 0;
 
-    if (!stbi_info(path.c_str(), &width, &height, &channels)) {
+    // Map the file once, probing and decoding from memory does not reopen and reparse the file for each query
+    MappedFile file(path);
+    const stbi_uc* buffer = file.getData();
+    int length            = static_cast<int>(file.getSize());
+
+    if (buffer == nullptr || !stbi_info_from_memory(buffer, length, &width, &height, &channels)) {
         const char* reason = stbi_failure_reason();
         // std::cerr << "[STBI ERROR] Invalid image or format not supported: " << path.string()
         //           << "\n  Reason: " << (reason ? reason : "Unknown") << std::endl;
         throw std::runtime_error("Image::create: stbi load failed " + path.string() + " (" + (reason ? reason : "unknown") + ")");
     }
 
-    if (stbi_is_hdr(path.c_str())) {
-        data = stbi_loadf(path.c_str(), &width, &height, &channels, desiredChannels);
+    if (stbi_is_hdr_from_memory(buffer, length)) {
+        data = stbi_loadf_from_memory(buffer, length, &width, &height, &channels, desiredChannels);
         type = GL_FLOAT;
-    } else if (stbi_is_16_bit(path.c_str())) {
-        data = stbi_load_16(path.c_str(), &width, &height, &channels, desiredChannels);
+    } else if (stbi_is_16_bit_from_memory(buffer, length)) {
+        data = stbi_load_16_from_memory(buffer, length, &width, &height, &channels, desiredChannels);
         type = GL_UNSIGNED_SHORT;
     } else {
-        data = stbi_load(path.c_str(), &width, &height, &channels, desiredChannels);
+        data = stbi_load_from_memory(buffer, length, &width, &height, &channels, desiredChannels);
         type = GL_UNSIGNED_BYTE;
     }
 
@@ -92,16 +124,263 @@ std::shared_ptr<Image> Image::create(const fs::path& path, int desiredChannels,
     return std::shared_ptr<Image>(new Image(filepath, data, type, width, height, desiredChannels == 0 ? channels : desiredChannels));
 }
 
-std::shared_ptr<Image> Image::merge(const std::vector<std::shared_ptr<Image>>& images, int channels) {
+std::vector<std::shared_ptr<Image>> Image::create(const std::vector<fs::path>& paths, int desiredChannels, bool flip, unsigned threads) {
+    std::vector<std::shared_ptr<Image>> images(paths.size());
+    std::vector<std::exception_ptr> errors(paths.size());
+
+    // Each thread takes the next undecoded image, stb_image keeps no shared state once the flip flag is per thread
+    parallelFor(paths.size(), threads, [&](size_t i) {
+        try {
+            images[i] = create(paths[i], desiredChannels, flip);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+
+    for (auto& error : errors) {
+        if (error) { std::rethrow_exception(error); }
+    }
+    return images;
+}
+
+// ----------------------------------------------------------------
+// Channel packing kernels, see Image::merge
+// ----------------------------------------------------------------
+
+// Pixels packed per chunk, planes which need conversion are staged in a chunk sized scratch buffer that stays in L1
+static constexpr size_t PACK_CHUNK_SIZE = 256;
+
+// Promote a value to a wider type of the same normalized range, e.g. 8 bits 0xff is 16 bits 0xffff and 1.0f
+template <typename Dst, typename Src>
+static inline Dst promote(Src value) {
+    if constexpr (std::is_same_v<Dst, Src>) {
+        return value;
+    } else if constexpr (std::is_same_v<Dst, float>) {
+        return static_cast<float>(value) * (1.f / static_cast<float>(std::numeric_limits<Src>::max()));
+    } else { // uint8_t to uint16_t
+        return static_cast<Dst>(value * 257u);
+    }
+}
+
+template <typename T>
+static constexpr GLenum typeOf() {
+    return std::is_same_v<T, float> ? GL_FLOAT : (std::is_same_v<T, uint16_t> ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE);
+}
+
+template <typename Dst>
+static constexpr Dst opaque() {
+    if constexpr (std::is_same_v<Dst, float>) {
+        return 1.f;
+    } else {
+        return std::numeric_limits<Dst>::max();
+    }
+}
+
+// Gather one channel of a chunk into a contiguous plane of destination type
+template <typename Dst>
+static void stage(const PackPlane& plane, size_t begin, size_t count, Dst* out) {
+    auto gather = [&]<typename Src>(const Src* src) {
+        src += begin * plane.stride + plane.channel;
+        for (size_t i = 0; i < count; i++) { out[i] = promote<Dst>(src[i * plane.stride]); }
+    };
+    switch (plane.type) {
+        case GL_FLOAT: gather(static_cast<const float*>(plane.data)); break;
+        case GL_UNSIGNED_SHORT: gather(static_cast<const uint16_t*>(plane.data)); break;
+        default: gather(static_cast<const uint8_t*>(plane.data)); break;
+    }
+}
+
+// Interleave 4 planes into RGBA texels, SSE2 is part of x86-64 so no target flags are needed
+template <typename Dst>
+static void interleave4(const Dst* const src[4], Dst* dst, size_t count) {
+    size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    if constexpr (std::is_same_v<Dst, uint8_t>) {
+        for (; i + 16 <= count; i += 16) { // 16 texels, bytes are zipped into pairs and pairs into quads
+            __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[0] + i)), g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[1] + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[2] + i)), a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[3] + i));
+            __m128i rgLo = _mm_unpacklo_epi8(r, g), rgHi = _mm_unpackhi_epi8(r, g);
+            __m128i baLo = _mm_unpacklo_epi8(b, a), baHi = _mm_unpackhi_epi8(b, a);
+            __m128i* out = reinterpret_cast<__m128i*>(dst + i * 4);
+            _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(rgLo, baLo));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(rgLo, baLo));
+            _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(rgHi, baHi));
+            _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(rgHi, baHi));
+        }
+    } else if constexpr (std::is_same_v<Dst, uint16_t>) {
+        for (; i + 8 <= count; i += 8) { // 8 texels, shorts are zipped into pairs and pairs into quads
+            __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[0] + i)), g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[1] + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[2] + i)), a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[3] + i));
+            __m128i rgLo = _mm_unpacklo_epi16(r, g), rgHi = _mm_unpackhi_epi16(r, g);
+            __m128i baLo = _mm_unpacklo_epi16(b, a), baHi = _mm_unpackhi_epi16(b, a);
+            __m128i* out = reinterpret_cast<__m128i*>(dst + i * 4);
+            _mm_storeu_si128(out + 0, _mm_unpacklo_epi32(rgLo, baLo));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi32(rgLo, baLo));
+            _mm_storeu_si128(out + 2, _mm_unpacklo_epi32(rgHi, baHi));
+            _mm_storeu_si128(out + 3, _mm_unpackhi_epi32(rgHi, baHi));
+        }
+    } else {
+        for (; i + 4 <= count; i += 4) { // 4 texels, a 4x4 transpose
+            __m128 r = _mm_loadu_ps(src[0] + i), g = _mm_loadu_ps(src[1] + i), b = _mm_loadu_ps(src[2] + i), a = _mm_loadu_ps(src[3] + i);
+            _MM_TRANSPOSE4_PS(r, g, b, a);
+            _mm_storeu_ps(dst + i * 4 + 0, r);
+            _mm_storeu_ps(dst + i * 4 + 4, g);
+            _mm_storeu_ps(dst + i * 4 + 8, b);
+            _mm_storeu_ps(dst + i * 4 + 12, a);
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        for (int c = 0; c < 4; c++) { dst[i * 4 + c] = src[c][i]; }
+    }
+}
+
+template <typename Dst>
+static void pack(const std::vector<PackPlane>& planes, Dst* dst, int channels, size_t pixels) {
+    alignas(16) Dst scratch[4][PACK_CHUNK_SIZE];
+    alignas(16) Dst fill[PACK_CHUNK_SIZE];
+    std::fill_n(fill, PACK_CHUNK_SIZE, opaque<Dst>());
+
+    const Dst* src[4];
+    for (size_t begin = 0; begin < pixels; begin += PACK_CHUNK_SIZE) {
+        size_t count = std::min(PACK_CHUNK_SIZE, pixels - begin);
+
+        // Single channel planes of destination type are read in place, the others are converted into scratch
+        for (int c = 0; c < channels; c++) {
+            if (c >= static_cast<int>(planes.size())) {
+                src[c] = fill;
+            } else if (planes[c].stride == 1 && planes[c].type == typeOf<Dst>()) {
+                src[c] = static_cast<const Dst*>(planes[c].data) + begin;
+            } else {
+                stage(planes[c], begin, count, scratch[c]);
+                src[c] = scratch[c];
+            }
+        }
+
+        Dst* out = dst + begin * channels;
+        if (channels == 4) {
+            interleave4(src, out, count);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                for (int c = 0; c < channels; c++) { out[i * channels + c] = src[c][i]; }
+            }
+        }
+    }
+}
+
+static void pack(const std::vector<PackPlane>& planes, void* dst, GLenum type, int channels, size_t pixels) {
+    switch (type) {
+        case GL_FLOAT: pack(planes, static_cast<float*>(dst), channels, pixels); break;
+        case GL_UNSIGNED_SHORT: pack(planes, static_cast<uint16_t*>(dst), channels, pixels); break;
+        default: pack(planes, static_cast<uint8_t*>(dst), channels, pixels); break;
+    }
+}
+
+// ----------------------------------------------------------------
+// HDR conversion kernels, see Image::convert
+// ----------------------------------------------------------------
+
+static constexpr float RGB9E5_MAX = 65408.f; // (2^9 - 1) / 2^9 * 2^(31 - 15)
+
+static inline uint32_t floatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline float bitsFloat(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Shared exponent encoding of EXT_texture_shared_exponent, the exponent and its reciprocal are read from float bits instead of log2/pow
+static inline uint32_t toRGB9E5(float r, float g, float b) {
+    r = r >= 0.f ? std::min(r, RGB9E5_MAX) : 0.f; // NaN fails the comparison and maps to 0
+    g = g >= 0.f ? std::min(g, RGB9E5_MAX) : 0.f;
+    b = b >= 0.f ? std::min(b, RGB9E5_MAX) : 0.f;
+
+    int exponent   = std::max(static_cast<int>(floatBits(std::max({r, g, b})) >> 23) - 127, -16); // floor(log2(max)), zero and denormals clamp to -16
+    float scale    = bitsFloat(static_cast<uint32_t>(127 + 8 - exponent) << 23);                  // 2^(9 - (exponent + 1)), the reciprocal of one mantissa step
+    uint32_t maxm  = static_cast<uint32_t>(std::max({r, g, b}) * scale + 0.5f);
+    if (maxm == 512) { // rounding overflowed the mantissa, step up the exponent
+        exponent++;
+        scale *= 0.5f;
+    }
+    uint32_t rm = static_cast<uint32_t>(r * scale + 0.5f), gm = static_cast<uint32_t>(g * scale + 0.5f), bm = static_cast<uint32_t>(b * scale + 0.5f);
+    return rm | (gm << 9) | (bm << 18) | (static_cast<uint32_t>(exponent + 16) << 27);
+}
+
+// Round to nearest even half float, out of range values become infinity and denormals are kept
+static inline uint16_t toHalf(float value) {
+    uint32_t bits = floatBits(value);
+    uint32_t sign = (bits >> 16) & 0x8000;
+    bits &= 0x7fffffff;
+    if (bits >= 0x47800000) { return static_cast<uint16_t>(sign | (bits > 0x7f800000 ? 0x7e00 : 0x7c00)); } // NaN, or infinity from 65536 up
+    if (bits < 0x38800000) { // denormal half, let the float adder do the rounding
+        return static_cast<uint16_t>(sign | (floatBits(bitsFloat(bits) + 0.5f) - floatBits(0.5f)));
+    }
+    uint32_t odd = (bits >> 13) & 1;
+    bits += 0xc8000fff + odd; // rebias exponent by (15 - 127) and round
+    return static_cast<uint16_t>(sign | (bits >> 13));
+}
+
+// Encode RGB texels into RGB9E5, 4 texels per iteration, 3 channels are deinterleaved with shuffles
+static void convertRGB9E5(const float* src, int channels, uint32_t* dst, size_t pixels) {
+    size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    if (channels == 3) {
+        const __m128 zero = _mm_setzero_ps(), limit = _mm_set1_ps(RGB9E5_MAX), half = _mm_set1_ps(0.5f);
+        const __m128i minExponent = _mm_set1_epi32(-16), overflow = _mm_set1_epi32(512);
+        for (; i + 4 <= pixels; i += 4) {
+            __m128 x0 = _mm_loadu_ps(src + i * 3), x1 = _mm_loadu_ps(src + i * 3 + 4), x2 = _mm_loadu_ps(src + i * 3 + 8); // r0g0b0r1 g1b1r2g2 b2r3g3b3
+            __m128 r = _mm_shuffle_ps(_mm_shuffle_ps(x0, x0, _MM_SHUFFLE(3, 3, 0, 0)), _mm_shuffle_ps(x1, x2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 g = _mm_shuffle_ps(_mm_shuffle_ps(x0, x1, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(x1, x2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 b = _mm_shuffle_ps(_mm_shuffle_ps(x0, x1, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(x2, x2, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+            r = _mm_min_ps(_mm_max_ps(r, zero), limit); // max returns its second operand for NaN
+            g = _mm_min_ps(_mm_max_ps(g, zero), limit);
+            b = _mm_min_ps(_mm_max_ps(b, zero), limit);
+
+            __m128 maxc       = _mm_max_ps(_mm_max_ps(r, g), b);
+            __m128i exponent  = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(maxc), 23), _mm_set1_epi32(127));
+            __m128i small     = _mm_cmplt_epi32(exponent, minExponent);
+            exponent          = _mm_or_si128(_mm_and_si128(small, minExponent), _mm_andnot_si128(small, exponent));
+            __m128 scale      = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127 + 8), exponent), 23));
+            __m128i maxm      = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(maxc, scale), half));
+            __m128i rounded   = _mm_cmpeq_epi32(maxm, overflow); // -1 where rounding overflowed
+            exponent          = _mm_sub_epi32(exponent, rounded);
+            scale             = _mm_mul_ps(scale, _mm_or_ps(_mm_and_ps(_mm_castsi128_ps(rounded), half), _mm_andnot_ps(_mm_castsi128_ps(rounded), _mm_set1_ps(1.f))));
+
+            __m128i rm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, scale), half));
+            __m128i gm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, scale), half));
+            __m128i bm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half));
+            __m128i packed = _mm_or_si128(_mm_or_si128(rm, _mm_slli_epi32(gm, 9)), _mm_or_si128(_mm_slli_epi32(bm, 18), _mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(16)), 27)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+        }
+    }
+#endif
+    for (; i < pixels; i++) {
+        const float* texel = src + i * channels;
+        dst[i] = toRGB9E5(texel[0], channels > 1 ? texel[1] : 0.f, channels > 2 ? texel[2] : 0.f);
+    }
+}
+
+std::shared_ptr<Image> Image::merge(const std::vector<std::shared_ptr<Image>>& images, int channels, const std::vector<int>& srcChannels) {
     if (images.empty() || images[0] == nullptr) {
         throw std::runtime_error("Image::merge: Empty image list or null image");
     }
+    if (channels < 1 || channels > 4) {
+        throw std::runtime_error("Image::merge: Desired channels must be in [1 - 4]");
+    }
 
+    // 1. Split sources into planes, a plane is one channel of a source image, the widest source type is kept
     std::stringstream filepaths;
     std::vector<std::shared_ptr<Image>> resizedImages;
-    int width = images[0]->getWidth(), height = images[0]->getHeight(), totChannels = 0;
+    std::vector<PackPlane> planes;
+    int width = images[0]->getWidth(), height = images[0]->getHeight();
     GLenum type = GL_UNSIGNED_BYTE;
-    for (auto& image : images) {
+    for (size_t i = 0; i < images.size(); i++) {
+        auto& image = images[i];
         if (image == nullptr) {
             throw std::runtime_error("Image::merge: Null image");
         }
@@ -117,68 +396,29 @@ std::shared_ptr<Image> Image::merge(const std::vector<std::shared_ptr<Image>>& i
         } else if (image->getDataType() == GL_UNSIGNED_SHORT && type == GL_UNSIGNED_BYTE) {
             type = GL_UNSIGNED_SHORT;
         }
-        totChannels += image->getChannels();
+
+        int srcChannel = i < srcChannels.size() ? srcChannels[i] : -1;
+        if (srcChannel >= image->getChannels()) {
+            throw std::runtime_error("Image::merge: Source channel out of range");
+        }
+        for (int c = std::max(srcChannel, 0); c < (srcChannel >= 0 ? srcChannel + 1 : image->getChannels()); c++) {
+            planes.push_back(PackPlane{resizedImages.back()->getData(), image->getDataType(), image->getChannels(), c});
+        }
     }
-    if (totChannels > channels) {
+    if (planes.size() > static_cast<size_t>(channels)) {
         throw std::runtime_error("Image::merge: Total channels must be less than or equal to desired channels");
     }
 
     int bytes = type == GL_FLOAT ? 4 : (type == GL_UNSIGNED_SHORT ? 2 : 1);
     //! WARNING: Must use STBI_MALLOC, since desturctor use STBI_FREE.
     // #define STBI_MALLOC malloc
-    void* data = malloc(width * height * channels * bytes);
+    void* data = malloc(static_cast<size_t>(width) * height * channels * bytes);
     if (data == nullptr) {
         throw std::runtime_error("Image::merge: Failed to allocate memory for merged image");
     }
 
-    int dstChannel  = 0;  // current channel index of destination image
-    int srcChannels = 0;  // number of source image channels
-    if (type == GL_FLOAT) {
-        float* dst = static_cast<float*>(data);
-        std::fill_n(dst, width * height * channels, 1.0f);
-
-        for (const auto& image : resizedImages) {
-            float* src  = static_cast<float*>(image->getData());
-            srcChannels = image->getChannels();
-
-            for (int i = 0; i < width * height; ++i) {
-                for (int c = 0; c < srcChannels; ++c) {
-                    dst[i * channels + (dstChannel + c)] = src[i * srcChannels + c];
-                }
-            }
-            dstChannel += srcChannels;
-        }
-    } else if (type == GL_UNSIGNED_SHORT) {
-        uint16_t* dst = static_cast<uint16_t*>(data);
-        std::fill_n(dst, width * height * channels, 65535);
-
-        for (const auto& image : resizedImages) {
-            uint16_t* src = static_cast<uint16_t*>(image->getData());
-            srcChannels   = image->getChannels();
-
-            for (int i = 0; i < width * height; ++i) {
-                for (int c = 0; c < srcChannels; ++c) {
-                    dst[i * channels + (dstChannel + c)] = src[i * srcChannels + c];
-                }
-            }
-            dstChannel += srcChannels;
-        }
-    } else {  // GL_UNSIGNED_BYTE
-        uint8_t* dst = static_cast<uint8_t*>(data);
-        std::fill_n(dst, width * height * channels, 255);
-
-        for (const auto& image : resizedImages) {
-            uint8_t* src = static_cast<uint8_t*>(image->getData());
-            srcChannels  = image->getChannels();
-
-            for (int i = 0; i < width * height; ++i) {
-                for (int c = 0; c < srcChannels; ++c) {
-                    dst[i * channels + (dstChannel + c)] = src[i * srcChannels + c];
-                }
-            }
-            dstChannel += srcChannels;
-        }
-    }
+    // 2. Interleave planes into the destination in one pass, channels without a plane are filled with the max value(opaque alpha)
+    pack(planes, data, type, channels, static_cast<size_t>(width) * height);
     return std::shared_ptr<Image>(new Image(filepaths.str(), data, type, width, height, channels));
 }
 
@@ -224,4 +464,71 @@ std::shared_ptr<Image> Image::resize(const std::shared_ptr<Image>& image, int wi
     return std::shared_ptr<Image>(new Image(filepath, data, type, width, height, channels));
 }
 
-}  // namespace tinyglrenderer
\ No newline at end of file
+size_t Image::getByteSize() const {
+    size_t pixels = static_cast<size_t>(m_width) * m_height;
+    switch (m_type) {
+        case GL_UNSIGNED_INT_5_9_9_9_REV: return pixels * 4;
+        case GL_FLOAT: return pixels * m_channels * 4;
+        case GL_HALF_FLOAT:
+        case GL_UNSIGNED_SHORT: return pixels * m_channels * 2;
+        default: return pixels * m_channels;
+    }
+}
+
+std::shared_ptr<Image> Image::convert(const std::shared_ptr<Image>& image, GLenum type) {
+    if (image == nullptr || image->getData() == nullptr) {
+        throw std::runtime_error("Image::convert: Null image");
+    }
+    if (image->getDataType() != GL_FLOAT) {
+        throw std::runtime_error("Image::convert: Only float images can be converted");
+    }
+
+    size_t pixels  = static_cast<size_t>(image->getWidth()) * image->getHeight();
+    int channels   = image->getChannels();
+    const float* src = static_cast<const float*>(image->getData());
+    void* data     = nullptr;
+    if (type == GL_UNSIGNED_INT_5_9_9_9_REV) {
+        data = malloc(pixels * sizeof(uint32_t));
+        if (data) { convertRGB9E5(src, channels, static_cast<uint32_t*>(data), pixels); }
+        channels = 3; // alpha is dropped, the texel is read as GL_RGB
+    } else if (type == GL_HALF_FLOAT) {
+        data = malloc(pixels * channels * sizeof(uint16_t));
+        if (data) {
+            uint16_t* dst = static_cast<uint16_t*>(data);
+            for (size_t i = 0; i < pixels * channels; i++) { dst[i] = toHalf(src[i]); }
+        }
+    } else {
+        throw std::runtime_error(std::string("Image::convert: Unsupported type ") + glMacro2Str(type));
+    }
+    if (data == nullptr) {
+        throw std::runtime_error("Image::convert: Failed to allocate memory for converted image");
+    }
+    return std::shared_ptr<Image>(new Image(image->getFilePath(), data, type, image->getWidth(), image->getHeight(), channels));
+}
+
+std::shared_ptr<Image> Image::extract(const std::shared_ptr<Image>& image, int channel) {
+    if (image == nullptr) {
+        throw std::runtime_error("Image::extract: Null image");
+    }
+    if (channel < 0 || channel >= image->getChannels()) {
+        throw std::runtime_error("Image::extract: Channel out of range");
+    }
+
+    int channels = image->getChannels(), pixels = image->getWidth() * image->getHeight();
+    GLenum type  = image->getDataType();
+    int bytes    = type == GL_FLOAT ? 4 : (type == GL_UNSIGNED_SHORT ? 2 : 1);
+    //! WARNING: Must use STBI_MALLOC, since desturctor use STBI_FREE.
+    void* data = malloc(pixels * bytes);
+    if (data == nullptr) {
+        throw std::runtime_error("Image::extract: Failed to allocate memory for extracted image");
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(image->getData()) + channel * bytes;
+    uint8_t* dst       = static_cast<uint8_t*>(data);
+    for (int i = 0; i < pixels; ++i) {
+        std::memcpy(dst + i * bytes, src + i * channels * bytes, bytes);
+    }
+    return std::shared_ptr<Image>(new Image(image->getFilePath(), data, type, image->getWidth(), image->getHeight(), 1));
+}
+
+}  // namespace tinyglrenderer
@@ -0,0 +1,62 @@
+#include "mappedfile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <utility>
+
+namespace tinyglrenderer {
+
+MappedFile::MappedFile(const fs::path& path) : m_filepath(path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) { throw std::runtime_error("MappedFile::MappedFile: Could not open file: " + path.string()); }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("MappedFile::MappedFile: Could not stat file: " + path.string());
+    }
+
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size > 0) { // mapping zero bytes is an error, leave empty files unmapped
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("MappedFile::MappedFile: Could not map file: " + path.string());
+        }
+        m_data = static_cast<uint8_t*>(data);
+    }
+    close(fd); // the mapping keeps its own reference to the file
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_filepath(std::move(other.m_filepath)), m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        if (m_data) { munmap(m_data, m_size); }
+        m_filepath = std::move(other.m_filepath);
+        m_data     = std::exchange(other.m_data, nullptr);
+        m_size     = std::exchange(other.m_size, 0);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    if (m_data) { munmap(m_data, m_size); }
+}
+
+uint64_t MappedFile::hash(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+} // namespace tinyglrenderer
@@ -1,17 +1,25 @@
 #include "material.hpp"
 
+#include <bit>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "memoryregistry.hpp"
 #include "utils.hpp"
 
 namespace tinyglrenderer {
 
 namespace fs = std::filesystem;
 
+static const std::unordered_map<std::string, MaterialMap> MATERIAL_MAPS = {
+    {"albedo", MaterialMap::MM_ALBEDO},
+    {"normal", MaterialMap::MM_NORMAL},
+    {"mrao", MaterialMap::MM_MRAO},
+};
+
 Material::Material(const std::string& name, float opacity, const std::unordered_map<std::string, std::shared_ptr<Texture>>& textures) {
     m_name = name;
-    m_opacity = opacity;
-    m_textures = textures;
+    m_block.albedo.w = opacity;
+    for (auto& [texName, texture] : textures) { setTexture(texName, texture); }
 }
 
 std::shared_ptr<Texture> Material::getTexture(const std::string& name) const {
@@ -21,8 +29,57 @@ std::shared_ptr<Texture> Material::getTexture(const std::string& name) const {
     return nullptr;
 }
 
-void Material::setTexture(const std::string& name, const std::shared_ptr<Texture>& texture) {
+std::shared_ptr<TexturePool::Layer> Material::getLayer(const std::string& name) const {
+    if (m_layers.count(name)) {
+        return m_layers.at(name);
+    }
+    return nullptr;
+}
+
+void Material::setOpacity(float opacity) {
+    m_block.albedo.w = opacity;
+    m_dirty = true;
+}
+
+void Material::setFactors(const glm::vec3& albedo, float metallic, float roughness, float ao) {
+    m_block.albedo = glm::vec4(albedo, m_block.albedo.w);
+    m_block.mrao   = glm::vec4(metallic, roughness, ao, 0.f);
+    m_dirty = true;
+}
+
+void Material::setTexture(const std::string& name, const std::shared_ptr<Texture>& texture, bool sampled) {
     m_textures[name] = texture;
+    m_layers.erase(name);
+    if (MATERIAL_MAPS.count(name)) {
+        uint32_t bit = static_cast<uint32_t>(MATERIAL_MAPS.at(name));
+        m_block.maps.x = (sampled && texture != nullptr) ? (m_block.maps.x | bit) : (m_block.maps.x & ~bit);
+        m_block.maps.y &= ~bit;
+        m_dirty = true;
+    }
+}
+
+void Material::setLayer(const std::string& name, const std::shared_ptr<TexturePool::Layer>& layer) {
+    if (layer == nullptr || MATERIAL_MAPS.count(name) == 0) { return; }
+    m_textures.erase(name); // the copy in texture pool is sampled, the texture itself is released unless shared
+    m_layers[name] = layer;
+
+    uint32_t bit = static_cast<uint32_t>(MATERIAL_MAPS.at(name));
+    m_block.maps.x |= bit;
+    m_block.maps.y |= bit;
+    m_block.layers[std::countr_zero(bit)] = layer->getHandle();
+    m_dirty = true;
+}
+
+void Material::bind(GLuint slot) {
+    if (m_buffer == nullptr) {
+        MemoryRegistry::Scope scope(MemoryTag::MT_UNIFORM, m_name);
+        m_buffer = std::make_unique<UniformBuffer>(sizeof(MaterialBlock));
+    }
+    if (m_dirty) {
+        m_buffer->upload(0, sizeof(MaterialBlock), &m_block);
+        m_dirty = false;
+    }
+    m_buffer->bind(slot);
 }
 
 } // namespace tinyglrenderer
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include "memoryregistry.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+namespace tinyglrenderer {
+
+static constexpr size_t MEMORY_KIND_COUNT = static_cast<size_t>(MemoryKind::MK_COUNT);
+static constexpr size_t MEMORY_TAG_COUNT  = static_cast<size_t>(MemoryTag::MT_COUNT);
+
+// Tag and label of objects constructed on this thread, set by MemoryRegistry::Scope
+static thread_local MemoryTag t_tag = MemoryTag::MT_OTHER;
+static thread_local std::string t_label;
+
+namespace {
+struct MemoryState {
+    std::mutex mutex;
+    std::unordered_map<const void*, MemoryEntry> entries;
+    std::array<std::array<MemoryCounter, MEMORY_TAG_COUNT + 1>, MEMORY_KIND_COUNT> counters; // the last tag counts all tags
+
+    void add(const MemoryEntry& entry) {
+        for (size_t tag : {static_cast<size_t>(entry.tag), MEMORY_TAG_COUNT}) {
+            auto& counter = counters[static_cast<size_t>(entry.kind)][tag];
+            counter.bytes += entry.bytes;
+            counter.peak = std::max(counter.peak, counter.bytes);
+            counter.count++;
+        }
+    }
+    void remove(const MemoryEntry& entry) {
+        for (size_t tag : {static_cast<size_t>(entry.tag), MEMORY_TAG_COUNT}) {
+            auto& counter = counters[static_cast<size_t>(entry.kind)][tag];
+            counter.bytes -= entry.bytes;
+            counter.count--;
+        }
+    }
+};
+
+// Never destroyed, resources held by static objects are untracked after main returns
+MemoryState& getState() {
+    static MemoryState* state = new MemoryState();
+    return *state;
+}
+} // namespace
+
+MemoryRegistry::Scope::Scope(MemoryTag tag, const std::string& label) : m_prevTag(t_tag), m_prevLabel(t_label) {
+    t_tag = tag;
+    if (!label.empty()) { t_label = label; }
+}
+
+MemoryRegistry::Scope::Scope(const std::string& label) : Scope(t_tag, label) {}
+
+MemoryRegistry::Scope::~Scope() {
+    t_tag   = m_prevTag;
+    t_label = std::move(m_prevLabel);
+}
+
+MemoryTag MemoryRegistry::getTag() { return t_tag; }
+
+void MemoryRegistry::track(MemoryKind kind, const void* object, size_t bytes) {
+    auto& state = getState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    auto [it, inserted] = state.entries.try_emplace(object);
+    if (!inserted) { state.remove(it->second); }
+    it->second = MemoryEntry{kind, t_tag, t_label, bytes};
+    state.add(it->second);
+}
+
+void MemoryRegistry::untrack(const void* object) {
+    auto& state = getState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    auto it = state.entries.find(object);
+    if (it == state.entries.end()) { return; }
+    state.remove(it->second);
+    state.entries.erase(it);
+}
+
+void MemoryRegistry::transfer(const void* from, const void* to) {
+    if (from == to) { return; }
+    auto& state = getState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    auto it = state.entries.find(from);
+    if (it == state.entries.end()) { return; }
+    MemoryEntry entry = std::move(it->second);
+    state.remove(entry);
+    state.entries.erase(it);
+
+    // The moved-to object keeps its owner, only its storage is replaced
+    auto jt = state.entries.find(to);
+    if (jt != state.entries.end()) {
+        entry.tag   = jt->second.tag;
+        entry.label = std::move(jt->second.label);
+        state.remove(jt->second);
+        state.entries.erase(jt);
+    }
+    state.add(entry);
+    state.entries.emplace(to, std::move(entry));
+}
+
+MemoryCounter MemoryRegistry::getCounter(MemoryKind kind, MemoryTag tag) {
+    auto& state = getState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.counters[static_cast<size_t>(kind)][std::min(static_cast<size_t>(tag), MEMORY_TAG_COUNT)];
+}
+
+void MemoryRegistry::getEntries(std::vector<MemoryEntry>& entries, MemoryTag tag) {
+    auto& state = getState();
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        for (auto& [object, entry] : state.entries) {
+            if (tag == MemoryTag::MT_COUNT || entry.tag == tag) { entries.push_back(entry); }
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const MemoryEntry& a, const MemoryEntry& b) { return a.bytes > b.bytes; });
+}
+
+const char* MemoryRegistry::getName(MemoryKind kind) {
+    switch (kind) {
+        case MemoryKind::MK_TEXTURE: return "texture";
+        case MemoryKind::MK_BUFFER: return "buffer";
+        case MemoryKind::MK_FRAMEBUFFER: return "framebuffer";
+        case MemoryKind::MK_IMAGE: return "image";
+        default: return "unknown";
+    }
+}
+
+const char* MemoryRegistry::getName(MemoryTag tag) {
+    switch (tag) {
+        case MemoryTag::MT_OTHER: return "other";
+        case MemoryTag::MT_ATTACHMENT: return "attachment";
+        case MemoryTag::MT_MATERIAL: return "material";
+        case MemoryTag::MT_MESH: return "mesh";
+        case MemoryTag::MT_SKYBOX: return "skybox";
+        case MemoryTag::MT_IBL: return "ibl";
+        case MemoryTag::MT_STAGING: return "staging";
+        case MemoryTag::MT_UNIFORM: return "uniform";
+        default: return "all";
+    }
+}
+
+bool MemoryRegistry::dump(const fs::path& path) {
+    std::vector<MemoryEntry> entries;
+    getEntries(entries);
+
+    // Labels are resource names and file paths, quotes, backslashes and control characters are escaped
+    auto quote = [](const std::string& text) {
+        std::string quoted = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+                quoted += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                quoted += ' ';
+            } else {
+                quoted += c;
+            }
+        }
+        return quoted + "\"";
+    };
+    auto counter = [](const MemoryCounter& c) { return "{\"bytes\": " + std::to_string(c.bytes) + ", \"peak\": " + std::to_string(c.peak) + ", \"count\": " + std::to_string(c.count) + "}"; };
+
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    std::ofstream file{path, std::ios::trunc};
+    if (!file.is_open()) {
+        std::cout << "Could not write memory dump [" << path << "]\n";
+        return false;
+    }
+
+    // 1. Counters of every kind, in total and by tag
+    file << "{\n  \"kinds\": {\n";
+    for (size_t kind = 0; kind < MEMORY_KIND_COUNT; kind++) {
+        file << "    " << quote(getName(static_cast<MemoryKind>(kind))) << ": {\n";
+        file << "      \"total\": " << counter(getCounter(static_cast<MemoryKind>(kind))) << ",\n      \"tags\": {\n";
+        for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+            file << "        " << quote(getName(static_cast<MemoryTag>(tag))) << ": " << counter(getCounter(static_cast<MemoryKind>(kind), static_cast<MemoryTag>(tag)));
+            file << (tag + 1 < MEMORY_TAG_COUNT ? ",\n" : "\n");
+        }
+        file << "      }\n    }" << (kind + 1 < MEMORY_KIND_COUNT ? ",\n" : "\n");
+    }
+
+    // 2. Live objects, the largest first
+    file << "  },\n  \"entries\": [\n";
+    for (size_t i = 0; i < entries.size(); i++) {
+        auto& entry = entries[i];
+        file << "    {\"kind\": " << quote(getName(entry.kind)) << ", \"tag\": " << quote(getName(entry.tag)) << ", \"label\": " << quote(entry.label) << ", \"bytes\": " << entry.bytes << "}";
+        file << (i + 1 < entries.size() ? ",\n" : "\n");
+    }
+    file << "  ]\n}\n";
+    if (!file.good()) {
+        std::cout << "Could not write memory dump [" << path << "]\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace tinyglrenderer
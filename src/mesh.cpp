@@ -1,33 +1,85 @@
 #include "mesh.hpp"
 
 #include <glm/glm.hpp>
-#include <fstream>
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
 
+#include "meshoptimizer.hpp"
 #include "resourcemanager.hpp"
 
 namespace tinyglrenderer {
 
-Mesh::Mesh(const fs::path& path, const tinyobj::attrib_t& attributes, const std::vector<tinyobj::shape_t>& shapes, size_t num) {
-    // 0. Initialize obj file source
-    std::ifstream file{path};
-    std::stringstream buffer;
-    if (!file.is_open()) { 
-        throw std::runtime_error("Mesh::Mesh: Could not open file: " + path.string());
-    } else {
-        buffer << file.rdbuf();
-    }
+static constexpr size_t MESH_CLUSTER_MAX_VERTICES  = 64;
+static constexpr size_t MESH_CLUSTER_MAX_TRIANGLES = 124;
+static constexpr size_t MESH_LOD_MIN_INDICES       = 3 * 64; // submeshes below 64 triangles are not simplified further
+
+Mesh::Mesh(const fs::path& path, const tinyobj::attrib_t& attributes, const std::vector<tinyobj::shape_t>& shapes, size_t num)
+    : Mesh(path, cook(attributes, shapes, num)) {}
+
+Mesh::Mesh(const fs::path& path, const MeshData& data)
+    : Mesh(path, data.format, data.getVertexData(), data.indices.data(), data.submeshes, data.lods, data.clusters, data.bounds, data.stats) {}
+
+Mesh::Mesh(const fs::path& path, VertexFormat format, const void* vertices, const void* indices, const std::vector<SubMesh>& submeshes, const std::vector<SubMesh>& lods,
+           const std::vector<MeshCluster>& clusters, const std::pair<glm::vec3, glm::vec3>& bounds, const MeshStats& stats) {
+    // 0. Keep only the obj file path, editor previews the source lazily from disk
+    if (!fs::is_regular_file(path)) { throw std::runtime_error("Mesh::Mesh: Could not open file: " + path.string()); }
+
+    m_filepath  = fs::canonical(path);
+    m_format    = format;
+    m_submeshes = submeshes;
+    m_lods      = lods;
+    m_clusters  = clusters;
+    m_bounds    = bounds;
+    m_stats     = stats;
+
+    // 1.Create VAO/VBO/IBO and configure vertex attributes
+    m_layout  = ResourceManager::getLayout(m_format == VertexFormat::VF_PACKED ? "mesh_packed" : "mesh");
+    m_bufferv = std::make_unique<VertexBuffer>(m_stats.vertexBytes, vertices);
+    m_bufferi = std::make_unique<IndexBuffer>(m_stats.indexBytes, indices);
+    m_streams = {MeshStream{.offset = 0, .stride = getVertexStride()}};
+}
+
+Mesh::Mesh(const fs::path& path, const std::vector<MeshStream>& streams, const std::vector<MeshUpload>& vertices, const std::vector<MeshUpload>& indices,
+           const std::vector<SubMesh>& submeshes, const std::pair<glm::vec3, glm::vec3>& bounds, const MeshStats& stats) {
+    if (!fs::is_regular_file(path)) { throw std::runtime_error("Mesh::Mesh: Could not open file: " + path.string()); }
 
-    m_filepath = fs::canonical(path);
-    m_source = buffer.str();
+    m_filepath  = fs::canonical(path);
+    m_format    = VertexFormat::VF_STREAMS;
+    m_streams   = streams;
+    m_submeshes = submeshes;
+    m_bounds    = bounds;
+    m_stats     = stats;
 
-    // 1. Traverse tinyobj loading data and initialize vertices
-    std::vector<Vertex> vertices;
-    std::vector<uint> indices;
-    std::vector<std::vector<uint>> submeshes(num + 1); // num is material count
+    // Allocate buffers empty and copy each block in place, the source memory is read exactly once
+    m_layout  = ResourceManager::getLayout("mesh_streams");
+    m_bufferv = std::make_unique<VertexBuffer>(m_stats.vertexBytes);
+    m_bufferi = std::make_unique<IndexBuffer>(m_stats.indexBytes);
+    for (auto& block : vertices) { m_bufferv->upload(block.offset, block.length, block.data); }
+    for (auto& block : indices) { m_bufferi->upload(block.offset, block.length, block.data); }
+}
+
+std::pair<glm::vec4, glm::vec4> Mesh::getQuantization() const {
+    if (m_format != VertexFormat::VF_PACKED) { return {glm::vec4(0.f), glm::vec4(1.f, 1.f, 1.f, 0.f)}; }
+    return {glm::vec4(m_bounds.first, 0.f), glm::vec4(m_bounds.second - m_bounds.first, 1.f)};
+}
+
+MeshData Mesh::cook(const tinyobj::attrib_t& attributes, const std::vector<tinyobj::shape_t>& shapes, size_t num, const MeshOptions& options) {
+    MeshData data;
+    auto& [format, vertices, packed, indices, submeshes, lods, clusters, bounds, stats] = data;
+    size_t lodCount = std::clamp<size_t>(options.lods, 1, MAX_LOD_COUNT);
+
+    // 1. Traverse tinyobj loading data and initialize triangle corners(with face bitangent) of each submesh
+    std::vector<std::vector<std::pair<Vertex, glm::vec3>>> corners(num + 1); // num is material count
     for (auto& shape : shapes) {
         for (int i = 0; i < shape.mesh.material_ids.size(); i++) { // i is triangle index
             bool vn = true, vt = true;
-            glm::vec3 vertex[3], normal[3], tangent;
+            glm::vec3 vertex[3], normal[3], tangent, bitangent;
             glm::vec2 uv[3];
 
             for (int j = 0; j < 3; ++j) { // j is vertex index
@@ -39,8 +91,8 @@ Mesh::Mesh(const fs::path& path, const tinyobj::attrib_t& attributes, const std:
                 if (t >= 0) { uv[j] = glm::vec2(attributes.texcoords[2 * t], attributes.texcoords[2 * t + 1]); }
                 vn = (n >= 0) && vn;
                 vt = (t >= 0) && vt;
-                m_bounds.first  = glm::min(m_bounds.first, vertex[j]);
-                m_bounds.second = glm::max(m_bounds.second, vertex[j]);
+                bounds.first  = glm::min(bounds.first, vertex[j]);
+                bounds.second = glm::max(bounds.second, vertex[j]);
             }
 
             if (!vn) {
@@ -69,33 +121,260 @@ Mesh::Mesh(const fs::path& path, const tinyobj::attrib_t& attributes, const std:
                 tangent.x = df * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
                 tangent.y = df * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
                 tangent.z = df * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-                tangent   = glm::normalize(tangent);
+                bitangent = df * (deltaUV1.x * edge2 - deltaUV2.x * edge1);
+                tangent   = glm::dot(tangent, tangent) > 0.f ? glm::normalize(tangent) : tangent;
+                bitangent = glm::dot(bitangent, bitangent) > 0.f ? glm::normalize(bitangent) : bitangent;
             }
 
             int id = shape.mesh.material_ids[i]; // id is material index
-            for (int j = 0; j < 3; ++j) {
-                vertices.emplace_back(vertex[j], normal[j], tangent, uv[j]);
-                if (id >= -1 && id < static_cast<int>(num)) { 
-                    // id == -1 means no material assigned, retain these vertices into the trailing
-                    submeshes[(id == -1 ? num : id)].push_back(static_cast<uint>(vertices.size() - 1));
-                }
+            if (id >= -1 && id < static_cast<int>(num)) { 
+                // id == -1 means no material assigned, retain these vertices into the trailing
+                for (int j = 0; j < 3; ++j) { corners[(id == -1 ? num : id)].emplace_back(Vertex{vertex[j], normal[j], glm::vec4(tangent, 1.f), uv[j]}, bitangent); }
             }
         }
     }
 
-    // 2. Group geometry into submeshes by material, and concatenate all index data into indices
+    // 2. Weld identical corners of each submesh into shared vertices
+    // Corners are identical when position, normal and uv are bitwise equal; the submesh is part of the key
+    // since every submesh owns a contiguous vertex range, which lets its indices start from zero. The per-face
+    // tangents of all welded corners are accumulated and orthogonalized against the normal afterwards, the
+    // accumulated bitangents only decide the handedness stored in tangent.w.
+    auto hash = [](const Vertex& v) {
+        const float values[8] = {v.position.x, v.position.y, v.position.z, v.normal.x, v.normal.y, v.normal.z, v.texcoord.x, v.texcoord.y};
+        size_t seed = 0;
+        for (float value : values) {
+            uint32_t bits = std::bit_cast<uint32_t>(value == 0.f ? 0.f : value); // -0.f and 0.f weld together
+            seed ^= std::hash<uint32_t>{}(bits) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    };
+    auto equal = [](const Vertex& a, const Vertex& b) {
+        return a.position == b.position && a.normal == b.normal && a.texcoord == b.texcoord;
+    };
+
+    std::unordered_map<Vertex, uint, decltype(hash), decltype(equal)> welded;
+    std::vector<uint> local, groups;
+    std::vector<glm::vec3> bitangents;
+    float transforms[2] = {0.f, 0.f}; // transformed vertices before and after optimizing
     for (int id = 0; id <= static_cast<int>(num); id++) { // id is material index
-        auto& submesh = submeshes[id];
-        if (!submesh.empty()) {
-            m_submeshes.emplace_back(id == static_cast<int>(num) ? -1 : id, static_cast<uint>(indices.size()), static_cast<uint>(submesh.size()));
-            indices.insert(indices.end(), submesh.begin(), submesh.end());
+        auto& submesh = corners[id];
+        if (submesh.empty()) { continue; }
+
+        uint base = static_cast<uint>(vertices.size());
+        welded.clear();
+        welded.reserve(submesh.size());
+        local.clear();
+        local.reserve(submesh.size());
+        bitangents.clear();
+        for (auto& [corner, bitangent] : submesh) {
+            auto [it, inserted] = welded.try_emplace(corner, static_cast<uint>(vertices.size()) - base);
+            if (inserted) {
+                vertices.push_back(corner);
+                bitangents.push_back(bitangent);
+            } else {
+                vertices[base + it->second].tangent += corner.tangent;
+                bitangents[it->second] += bitangent;
+            }
+            local.push_back(it->second);
+        }
+        for (size_t i = base; i < vertices.size(); i++) {
+            glm::vec3 n = vertices[i].normal, t = glm::vec3(vertices[i].tangent);
+            t = t - n * glm::dot(n, t);
+            if (glm::dot(t, t) < 1e-12f) { t = glm::cross(n, std::abs(n.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f)); }
+            float sign = glm::dot(glm::cross(n, t), bitangents[i - base]) < 0.f ? -1.f : 1.f;
+            vertices[i].tangent = glm::vec4(glm::normalize(t), sign);
+        }
+
+        // 3. Reorder triangles for vertex cache and overdraw, then vertices for fetch locality
+        size_t count = vertices.size() - base;
+        transforms[0] += MeshOptimizer::analyzeVertexCache(local, count).first * static_cast<float>(local.size() / 3);
+        if (options.optimize) {
+            MeshOptimizer::optimizeVertexCache(local, count, &groups);
+            MeshOptimizer::optimizeOverdraw(local, groups, vertices.data() + base, count);
+            MeshOptimizer::optimizeVertexFetch(local, vertices.data() + base, count);
+        }
+        transforms[1] += MeshOptimizer::analyzeVertexCache(local, count).first * static_cast<float>(local.size() / 3);
+
+        // 4. Emit compact indices(16 bits if the vertex range of submesh fits) and split them into clusters along triangle order
+        auto emit = [&](const std::vector<uint>& list) {
+            bool compact  = count <= std::numeric_limits<uint16_t>::max() + 1;
+            size_t stride = compact ? sizeof(uint16_t) : sizeof(uint32_t);
+            size_t offset = (indices.size() + stride - 1) / stride * stride;
+            indices.resize(offset + list.size() * stride);
+            for (size_t i = 0; i < list.size(); i++) {
+                if (compact) {
+                    uint16_t index = static_cast<uint16_t>(list[i]);
+                    std::memcpy(indices.data() + offset + i * stride, &index, stride);
+                } else {
+                    std::memcpy(indices.data() + offset + i * stride, &list[i], stride);
+                }
+            }
+
+            uint cluster = static_cast<uint>(clusters.size());
+            clusterize(list, vertices.data() + base, count, offset, stride, clusters);
+            return SubMesh{
+                .matid    = id == static_cast<int>(num) ? -1 : id,
+                .offset   = static_cast<uint>(offset),
+                .length   = static_cast<uint>(list.size()),
+                .vertex   = base,
+                .type     = static_cast<GLenum>(compact ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT),
+                .cluster  = cluster,
+                .clusters = static_cast<uint>(clusters.size()) - cluster,
+            };
+        };
+        submeshes.push_back(emit(local));
+
+        // 5. Simplify every level from the previous one, levels share the vertices of submesh and only add indices
+        // A level that cannot be reduced any further is repeated, so each submesh owns (lodCount - 1) entries of lod table
+        std::vector<uint> level = local;
+        for (size_t l = 1; l < lodCount; l++) {
+            if (level.size() > MESH_LOD_MIN_INDICES) {
+                std::vector<uint> coarse;
+                MeshOptimizer::simplify(level, vertices.data() + base, count, level.size() / 2 / 3 * 3, coarse);
+                if (coarse.size() < level.size() && !coarse.empty()) {
+                    MeshOptimizer::optimizeVertexCache(coarse, count);
+                    level.swap(coarse);
+                    lods.push_back(emit(level));
+                    continue;
+                }
+            }
+            lods.push_back(l == 1 ? submeshes.back() : lods.back());
         }
+        stats.srcVertexCount += submesh.size();
+        stats.indexCount     += local.size();
+        std::vector<std::pair<Vertex, glm::vec3>>().swap(submesh); // release corners early, they may be large
     }
-    
-    // 3.Create VAO/VBO/IBO and configure vertex attributes
-    m_layout  = ResourceManager::getLayout("mesh");
-    m_bufferv = std::make_unique<VertexBuffer>(vertices.size() * sizeof(Vertex), vertices.data());
-    m_bufferi = std::make_unique<IndexBuffer>(indices.size() * sizeof(uint32_t), indices.data());
+    stats.srcBytes    = stats.srcVertexCount * (sizeof(Vertex) + sizeof(uint32_t));
+    stats.vertexCount = vertices.size();
+    stats.vertexBytes = vertices.size() * sizeof(Vertex);
+    stats.indexBytes  = indices.size();
+    stats.clusterCount = clusters.size();
+    stats.lodCount    = lodCount;
+    stats.acmr        = stats.indexCount ? transforms[1] / static_cast<float>(stats.indexCount / 3) : 0.f;
+    stats.atvr        = stats.vertexCount ? transforms[1] / static_cast<float>(stats.vertexCount) : 0.f;
+
+    std::cout << "Welding mesh [" << stats.srcVertexCount << " -> " << stats.vertexCount << " vertices, "
+              << stats.srcBytes / 1024 << " KB -> " << (stats.vertexBytes + stats.indexBytes) / 1024 << " KB]\n";
+
+    if (options.optimize && stats.indexCount) {
+        std::cout << "Optimizing mesh " << std::format("[ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}]\n", transforms[0] / static_cast<float>(stats.indexCount / 3),
+                                                       stats.acmr, transforms[0] / static_cast<float>(stats.vertexCount), stats.atvr);
+    }
+
+    if (lodCount > 1) {
+        std::vector<size_t> triangles(lodCount, 0);
+        for (size_t i = 0; i < submeshes.size(); i++) {
+            triangles[0] += submeshes[i].length / 3;
+            for (size_t l = 1; l < lodCount; l++) { triangles[l] += lods[i * (lodCount - 1) + l - 1].length / 3; }
+        }
+        std::cout << "Simplifying mesh [";
+        for (size_t l = 0; l < lodCount; l++) { std::cout << (l ? " -> " : "") << triangles[l]; }
+        std::cout << " triangles]\n";
+    }
+
+    // 6. Quantize vertices if packed format is requested
+    if (options.format == VertexFormat::VF_PACKED) { pack(data); }
+
+    return data;
+}
+
+void Mesh::clusterize(const std::vector<uint>& indices, const Vertex* vertices, size_t vertexCount, size_t offset, size_t stride, std::vector<MeshCluster>& clusters) {
+    std::vector<uint> stamps(vertexCount, 0); // vertex is in current cluster if its stamp equals cluster number
+    uint stamp = 0;
+    size_t begin = 0, unique = 0;
+
+    auto emit = [&](size_t end) {
+        // Bounding sphere centered at the AABB center of cluster vertices
+        glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+        for (size_t i = begin; i < end; i++) {
+            lo = glm::min(lo, vertices[indices[i]].position);
+            hi = glm::max(hi, vertices[indices[i]].position);
+        }
+        glm::vec3 center = (lo + hi) * 0.5f;
+        float radius = 0.f;
+        for (size_t i = begin; i < end; i++) { radius = std::max(radius, glm::length(vertices[indices[i]].position - center)); }
+
+        // Normal cone around the average face normal, wide cones(spread over ~84 degrees) can never be culled
+        glm::vec3 axis(0.f);
+        std::vector<glm::vec3> normals;
+        for (size_t i = begin; i + 2 < end; i += 3) {
+            const glm::vec3& p0 = vertices[indices[i]].position;
+            glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+            float length = glm::length(normal);
+            if (length <= 0.f) { continue; }
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+        glm::vec4 cone(0.f, 0.f, 0.f, 1.f);
+        if (glm::length(axis) > 0.f) {
+            axis = glm::normalize(axis);
+            float spread = 1.f;
+            for (auto& normal : normals) { spread = std::min(spread, glm::dot(axis, normal)); }
+            if (spread > 0.1f) { cone = glm::vec4(axis, std::sqrt(1.f - spread * spread)); }
+        }
+
+        clusters.push_back(MeshCluster{
+            .sphere = glm::vec4(center, radius),
+            .cone   = cone,
+            .offset = static_cast<uint>(offset + begin * stride),
+            .length = static_cast<uint>(end - begin),
+        });
+        begin  = end;
+        unique = 0;
+        stamp++;
+    };
+
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        size_t added = 0;
+        for (int j = 0; j < 3; j++) { added += (stamps[indices[i + j]] != stamp + 1) ? 1 : 0; }
+        if (i > begin && (unique + added > MESH_CLUSTER_MAX_VERTICES || (i - begin) / 3 >= MESH_CLUSTER_MAX_TRIANGLES)) { emit(i); }
+        for (int j = 0; j < 3; j++) {
+            if (stamps[indices[i + j]] != stamp + 1) {
+                stamps[indices[i + j]] = stamp + 1;
+                unique++;
+            }
+        }
+    }
+    if (begin < indices.size()) { emit(indices.size()); }
+}
+
+void Mesh::pack(MeshData& data) {
+    // Octahedron encoding, maps the unit sphere onto a square by folding the lower hemisphere over the diagonals
+    auto octahedron = [](const glm::vec3& v, int16_t* out) {
+        float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+        glm::vec3 n = l1 > 0.f ? v / l1 : glm::vec3(0.f, 0.f, 1.f); // degenerate vectors decode as +z
+        glm::vec2 e = glm::vec2(n.x, n.y);
+        if (n.z < 0.f) {
+            e = glm::vec2((1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f));
+        }
+        out[0] = static_cast<int16_t>(std::round(glm::clamp(e.x, -1.f, 1.f) * 32767.f));
+        out[1] = static_cast<int16_t>(std::round(glm::clamp(e.y, -1.f, 1.f) * 32767.f));
+    };
+
+    glm::vec3 extent = data.bounds.second - data.bounds.first;
+    glm::vec3 scale  = glm::vec3(extent.x > 0.f ? 65535.f / extent.x : 0.f, extent.y > 0.f ? 65535.f / extent.y : 0.f, extent.z > 0.f ? 65535.f / extent.z : 0.f);
+
+    data.packed.resize(data.vertices.size());
+    for (size_t i = 0; i < data.vertices.size(); i++) {
+        const Vertex& vertex = data.vertices[i];
+        PackedVertex& packed = data.packed[i];
+
+        glm::vec3 q = glm::clamp(glm::round((vertex.position - data.bounds.first) * scale), 0.f, 65535.f);
+        packed.position[0] = static_cast<uint16_t>(q.x);
+        packed.position[1] = static_cast<uint16_t>(q.y);
+        packed.position[2] = static_cast<uint16_t>(q.z);
+        packed.position[3] = vertex.tangent.w < 0.f ? 0 : 65535;
+        octahedron(vertex.normal, packed.normal);
+        octahedron(glm::vec3(vertex.tangent), packed.tangent);
+        packed.texcoord[0] = glm::packHalf1x16(vertex.texcoord.x);
+        packed.texcoord[1] = glm::packHalf1x16(vertex.texcoord.y);
+    }
+
+    size_t bytes = data.stats.vertexBytes;
+    data.format = VertexFormat::VF_PACKED;
+    data.stats.vertexBytes = data.packed.size() * sizeof(PackedVertex);
+    std::cout << "Packing mesh [" << sizeof(Vertex) << " -> " << sizeof(PackedVertex) << " bytes per vertex, "
+              << bytes / 1024 << " KB -> " << data.stats.vertexBytes / 1024 << " KB]\n";
 }
 
 Mesh::~Mesh() {
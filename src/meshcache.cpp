@@ -0,0 +1,263 @@
+#include "meshcache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#include "utils.hpp"
+
+namespace tinyglrenderer {
+
+static_assert(std::is_trivially_copyable_v<Vertex> && std::is_trivially_copyable_v<PackedVertex> && std::is_trivially_copyable_v<SubMesh> &&
+              std::is_trivially_copyable_v<MeshCluster>, "Vertex, PackedVertex, SubMesh and MeshCluster are written into cache as raw bytes");
+
+struct MeshCacheHeader {
+    char magic[8];          // "TGMESH\0\0"
+    uint32_t version;       // bumped when the layout or cooking changes
+    uint32_t vertexStride;  // sizeof(Vertex) or sizeof(PackedVertex)
+    uint32_t format;        // VertexFormat of vertex block
+    uint32_t optimized;     // whether triangles and vertices are reordered by MeshOptimizer
+    uint64_t hash;          // content hash of source files
+    uint64_t pathOffset;    // source path block
+    uint64_t pathLength;
+    uint64_t submeshOffset; // submesh table
+    uint64_t submeshCount;
+    uint64_t lodOffset;     // lod table, (lodCount - 1) submeshes per submesh
+    uint64_t lodCount;
+    uint64_t clusterOffset; // cluster table
+    uint64_t clusterCount;
+    uint64_t materialOffset; // material table
+    uint64_t materialLength;
+    uint64_t vertexOffset;  // vertex block
+    uint64_t indexOffset;   // index block
+    float bounds[6];
+    uint64_t srcVertexCount; // welding stats
+    uint64_t srcBytes;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t vertexBytes;
+    uint64_t indexBytes;
+    float acmr;
+    float atvr;
+};
+
+static constexpr char MESH_CACHE_MAGIC[8] = {'T', 'G', 'M', 'E', 'S', 'H', '\0', '\0'};
+static constexpr uint32_t MESH_CACHE_VERSION = 5;
+static constexpr size_t MESH_CACHE_ALIGNMENT = 16;
+
+MeshCache::MeshCache(const fs::path& cachePath, const fs::path& meshPath, uint64_t hash, const MeshOptions& options)
+    : m_filepath(cachePath), m_meshpath(meshPath), m_format(options.format) {
+    std::error_code ec;
+    if (!fs::is_regular_file(cachePath, ec) || fs::file_size(cachePath, ec) < sizeof(MeshCacheHeader)) { return; }
+
+    m_file.emplace(cachePath);
+    const uint8_t* data = m_file->getData();
+    size_t size = m_file->getSize();
+
+    // 1. Check header against source and file size
+    MeshCacheHeader header;
+    std::memcpy(&header, data, sizeof(MeshCacheHeader));
+    auto inside = [size](uint64_t offset, uint64_t length) { return offset <= size && length <= size - offset; };
+    auto table  = [size, &inside](uint64_t offset, uint64_t count, size_t stride) { return count <= size / stride && inside(offset, count * stride); }; // count * stride must not wrap
+    if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 || header.version != MESH_CACHE_VERSION) { return; }
+    if (header.format != static_cast<uint32_t>(options.format) || header.vertexStride != static_cast<uint32_t>(Mesh::getVertexStride(options.format))) { return; }
+    if (header.optimized != static_cast<uint32_t>(options.optimize) || header.lodCount != std::clamp<size_t>(options.lods, 1, Mesh::MAX_LOD_COUNT) || header.hash != hash) { return; }
+    if (!inside(header.pathOffset, header.pathLength) || !inside(header.materialOffset, header.materialLength) ||
+        !table(header.submeshOffset, header.submeshCount, sizeof(SubMesh)) || !table(header.clusterOffset, header.clusterCount, sizeof(MeshCluster)) ||
+        !table(header.lodOffset, header.submeshCount * (header.lodCount - 1), sizeof(SubMesh)) ||
+        !inside(header.vertexOffset, header.vertexBytes) || !inside(header.indexOffset, header.indexBytes) || header.vertexBytes != header.vertexCount * header.vertexStride) {
+        return;
+    }
+    std::string_view path(reinterpret_cast<const char*>(data + header.pathOffset), header.pathLength);
+    if (path != fs::weakly_canonical(meshPath).string()) { return; }
+
+    // 2. Read submesh, cluster and material tables
+    m_submeshes.resize(header.submeshCount);
+    std::memcpy(m_submeshes.data(), data + header.submeshOffset, header.submeshCount * sizeof(SubMesh));
+    m_lods.resize(header.submeshCount * (header.lodCount - 1));
+    std::memcpy(m_lods.data(), data + header.lodOffset, m_lods.size() * sizeof(SubMesh));
+    m_clusters.resize(header.clusterCount);
+    std::memcpy(m_clusters.data(), data + header.clusterOffset, header.clusterCount * sizeof(MeshCluster));
+
+    const uint8_t* cursor = data + header.materialOffset;
+    const uint8_t* end    = cursor + header.materialLength;
+    auto readString = [&cursor, end](std::string& value) {
+        uint32_t length;
+        if (end - cursor < static_cast<ptrdiff_t>(sizeof(length))) { return false; }
+        std::memcpy(&length, cursor, sizeof(length));
+        cursor += sizeof(length);
+        if (end - cursor < static_cast<ptrdiff_t>(length)) { return false; }
+        value.assign(reinterpret_cast<const char*>(cursor), length);
+        cursor += length;
+        return true;
+    };
+    auto readFloats = [&cursor, end](float* values, size_t count) {
+        if (end - cursor < static_cast<ptrdiff_t>(count * sizeof(float))) { return false; }
+        std::memcpy(values, cursor, count * sizeof(float));
+        cursor += count * sizeof(float);
+        return true;
+    };
+    while (cursor < end) {
+        tinyobj::material_t material = {};
+        bool ok = readString(material.name) && readString(material.diffuse_texname) && readString(material.normal_texname) &&
+                  readString(material.metallic_texname) && readString(material.roughness_texname) && readString(material.ambient_texname) &&
+                  readFloats(material.diffuse, 3) && readFloats(&material.metallic, 1) && readFloats(&material.roughness, 1) && readFloats(&material.dissolve, 1);
+        if (!ok) { return; }
+        m_materials.push_back(std::move(material));
+    }
+
+    // 3. Check index ranges of submeshes, levels and clusters against the blocks, buffers and culling read them without bounds
+    auto ranged = [&](uint64_t offset, uint64_t length, GLenum type) {
+        uint64_t bytes = type == GL_UNSIGNED_SHORT ? 2 : 4;
+        return offset % bytes == 0 && offset <= header.indexBytes && length <= (header.indexBytes - offset) / bytes;
+    };
+    auto valid = [&](const SubMesh& submesh) {
+        if (submesh.type != GL_UNSIGNED_SHORT && submesh.type != GL_UNSIGNED_INT) { return false; }
+        if (submesh.matid < -1 || submesh.matid >= static_cast<int>(m_materials.size()) || submesh.vertex >= std::max<uint64_t>(header.vertexCount, 1)) { return false; }
+        if (!ranged(submesh.offset, submesh.length, submesh.type) || submesh.cluster > header.clusterCount || submesh.clusters > header.clusterCount - submesh.cluster) { return false; }
+        for (uint i = submesh.cluster; i < submesh.cluster + submesh.clusters; i++) {
+            if (!ranged(m_clusters[i].offset, m_clusters[i].length, submesh.type)) { return false; }
+        }
+        return true;
+    };
+    if (!std::all_of(m_submeshes.begin(), m_submeshes.end(), valid) || !std::all_of(m_lods.begin(), m_lods.end(), valid)) { return; }
+
+    m_vertices = data + header.vertexOffset;
+    m_indices  = data + header.indexOffset;
+    m_bounds   = {glm::vec3(header.bounds[0], header.bounds[1], header.bounds[2]), glm::vec3(header.bounds[3], header.bounds[4], header.bounds[5])};
+    m_stats    = MeshStats{
+        .srcVertexCount = header.srcVertexCount,
+        .srcBytes       = header.srcBytes,
+        .vertexCount    = header.vertexCount,
+        .indexCount     = header.indexCount,
+        .vertexBytes    = header.vertexBytes,
+        .indexBytes     = header.indexBytes,
+        .clusterCount   = header.clusterCount,
+        .lodCount       = header.lodCount,
+        .acmr           = header.acmr,
+        .atvr           = header.atvr,
+    };
+    m_valid = true;
+}
+
+std::shared_ptr<Mesh> MeshCache::createMesh() const {
+    if (!m_valid) { throw std::runtime_error("MeshCache::createMesh: Invalid mesh cache: " + m_filepath.string()); }
+    return std::make_shared<Mesh>(m_meshpath, m_format, m_vertices, m_indices, m_submeshes, m_lods, m_clusters, m_bounds, m_stats);
+}
+
+bool MeshCache::save(const fs::path& cachePath, const fs::path& meshPath, uint64_t hash, const MeshOptions& options, const MeshData& data,
+                     const std::vector<tinyobj::material_t>& materials) {
+    // 1. Serialize material table
+    std::vector<uint8_t> table;
+    auto writeString = [&table](const std::string& value) {
+        uint32_t length = static_cast<uint32_t>(value.size());
+        table.insert(table.end(), reinterpret_cast<const uint8_t*>(&length), reinterpret_cast<const uint8_t*>(&length) + sizeof(length));
+        table.insert(table.end(), value.begin(), value.end());
+    };
+    auto writeFloats = [&table](const float* values, size_t count) {
+        table.insert(table.end(), reinterpret_cast<const uint8_t*>(values), reinterpret_cast<const uint8_t*>(values + count));
+    };
+    for (auto& material : materials) {
+        writeString(material.name);
+        writeString(material.diffuse_texname);
+        writeString(material.normal_texname);
+        writeString(material.metallic_texname);
+        writeString(material.roughness_texname);
+        writeString(material.ambient_texname);
+        writeFloats(material.diffuse, 3);
+        writeFloats(&material.metallic, 1);
+        writeFloats(&material.roughness, 1);
+        writeFloats(&material.dissolve, 1);
+    }
+
+    // 2. Lay out blocks after header
+    std::string path = fs::weakly_canonical(meshPath).string();
+    auto align = [](uint64_t offset) { return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT; };
+
+    MeshCacheHeader header = {};
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version        = MESH_CACHE_VERSION;
+    header.vertexStride   = static_cast<uint32_t>(Mesh::getVertexStride(data.format));
+    header.format         = static_cast<uint32_t>(data.format);
+    header.optimized      = static_cast<uint32_t>(options.optimize);
+    header.hash           = hash;
+    header.pathOffset     = sizeof(MeshCacheHeader);
+    header.pathLength     = path.size();
+    header.submeshOffset  = align(header.pathOffset + header.pathLength);
+    header.submeshCount   = data.submeshes.size();
+    header.lodOffset      = align(header.submeshOffset + header.submeshCount * sizeof(SubMesh));
+    header.lodCount       = data.stats.lodCount;
+    header.clusterOffset  = align(header.lodOffset + data.lods.size() * sizeof(SubMesh));
+    header.clusterCount   = data.clusters.size();
+    header.materialOffset = align(header.clusterOffset + header.clusterCount * sizeof(MeshCluster));
+    header.materialLength = table.size();
+    header.vertexOffset   = align(header.materialOffset + header.materialLength);
+    header.indexOffset    = align(header.vertexOffset + data.stats.vertexBytes);
+    header.bounds[0] = data.bounds.first.x;  header.bounds[1] = data.bounds.first.y;  header.bounds[2] = data.bounds.first.z;
+    header.bounds[3] = data.bounds.second.x; header.bounds[4] = data.bounds.second.y; header.bounds[5] = data.bounds.second.z;
+    header.srcVertexCount = data.stats.srcVertexCount;
+    header.srcBytes       = data.stats.srcBytes;
+    header.vertexCount    = data.stats.vertexCount;
+    header.indexCount     = data.stats.indexCount;
+    header.vertexBytes    = data.stats.vertexBytes;
+    header.indexBytes     = data.stats.indexBytes;
+    header.acmr           = data.stats.acmr;
+    header.atvr           = data.stats.atvr;
+
+    // 3. Write the header and every block at its aligned offset
+    return writeFileAtomically(cachePath, [&](std::ofstream& file) {
+        auto writeAt = [&file](uint64_t offset, const void* bytes, uint64_t length) {
+            static const char zeros[MESH_CACHE_ALIGNMENT] = {};
+            file.write(zeros, offset - static_cast<uint64_t>(file.tellp())); // padding up to aligned offset
+            file.write(static_cast<const char*>(bytes), length);
+        };
+        writeAt(0, &header, sizeof(MeshCacheHeader));
+        writeAt(header.pathOffset, path.data(), header.pathLength);
+        writeAt(header.submeshOffset, data.submeshes.data(), header.submeshCount * sizeof(SubMesh));
+        writeAt(header.lodOffset, data.lods.data(), data.lods.size() * sizeof(SubMesh));
+        writeAt(header.clusterOffset, data.clusters.data(), header.clusterCount * sizeof(MeshCluster));
+        writeAt(header.materialOffset, table.data(), header.materialLength);
+        writeAt(header.vertexOffset, data.getVertexData(), header.vertexBytes);
+        writeAt(header.indexOffset, data.indices.data(), header.indexBytes);
+        return true;
+    });
+}
+
+uint64_t MeshCache::hash(const fs::path& meshPath, const fs::path& mtlDir) {
+    MappedFile file(meshPath);
+    uint64_t hash = file.hash();
+
+    // Fold every mtl library referenced by `mtllib` into the key, editing a material invalidates the cache as well
+    std::string_view source = file.getView();
+    for (size_t pos = source.find("mtllib"); pos != std::string_view::npos; pos = source.find("mtllib", pos + 6)) {
+        if (pos != 0 && source[pos - 1] != '\n') { continue; }
+        size_t end = source.find_first_of("\r\n", pos);
+        std::string_view line = source.substr(pos + 6, end == std::string_view::npos ? std::string_view::npos : end - pos - 6);
+        while (!line.empty()) {
+            size_t begin = line.find_first_not_of(" \t");
+            if (begin == std::string_view::npos) { break; }
+            line.remove_prefix(begin);
+            std::string_view name = line.substr(0, line.find_first_of(" \t"));
+            line.remove_prefix(name.size());
+
+            std::error_code ec;
+            fs::path mtlPath = mtlDir / std::string(name);
+            if (fs::is_regular_file(mtlPath, ec)) {
+                MappedFile mtlFile(mtlPath);
+                hash = MappedFile::hash(name.data(), name.size(), hash);
+                hash = MappedFile::hash(mtlFile.getData(), mtlFile.getSize(), hash);
+            }
+        }
+    }
+    return hash;
+}
+
+fs::path MeshCache::getCachePath(const fs::path& meshPath, const MeshOptions& options) {
+    std::string path = fs::weakly_canonical(meshPath).string();
+    return fs::path("../cache/mesh") / std::format("{}{}-{:016x}.tgmesh", meshPath.stem().string(), options.getKey(), MappedFile::hash(path.data(), path.size()));
+}
+
+} // namespace tinyglrenderer
@@ -0,0 +1,398 @@
+#include "meshoptimizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+
+namespace tinyglrenderer {
+
+// Symmetric 4x4 matrix summing squared distances to planes, error(p) = (p, 1)^T Q (p, 1)
+struct MeshQuadric {
+    double a[10] = {}; // xx, xy, xz, xw, yy, yz, yw, zz, zw, ww
+
+    void add(const glm::vec3& n, float d, double weight) {
+        const double x = n.x, y = n.y, z = n.z, w = d;
+        a[0] += weight * x * x, a[1] += weight * x * y, a[2] += weight * x * z, a[3] += weight * x * w;
+        a[4] += weight * y * y, a[5] += weight * y * z, a[6] += weight * y * w;
+        a[7] += weight * z * z, a[8] += weight * z * w;
+        a[9] += weight * w * w;
+    }
+    void add(const MeshQuadric& other) {
+        for (int i = 0; i < 10; i++) { a[i] += other.a[i]; }
+    }
+    double error(const glm::vec3& p) const {
+        const double x = p.x, y = p.y, z = p.z;
+        return a[0] * x * x + 2.0 * (a[1] * x * y + a[2] * x * z + a[3] * x) + a[4] * y * y + 2.0 * (a[5] * y * z + a[6] * y) + a[7] * z * z + 2.0 * a[8] * z + a[9];
+    }
+};
+
+struct MeshCollapse {
+    double cost = 0.0;
+    uint from   = 0; // position group which moves
+    uint to     = 0; // position group which stays
+    uint versions[2] = {0, 0}; // versions of both groups when the collapse was evaluated
+
+    bool operator>(const MeshCollapse& other) const { return cost > other.cost; }
+};
+
+static constexpr double MESH_SIMPLIFY_BORDER_WEIGHT    = 10.0;  // weight of planes holding open borders in place
+static constexpr double MESH_SIMPLIFY_ATTRIBUTE_WEIGHT = 0.002; // weight of squared normal/uv distance, relative to squared extent of submesh
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint>& indices, size_t vertexCount, std::vector<uint>* clusters) {
+    size_t triangleCount = indices.size() / 3;
+    if (clusters) { clusters->clear(); }
+    if (triangleCount == 0) { return; }
+
+    // 1. Build vertex to triangle adjacency, live counts the triangles of a vertex which are not emitted yet
+    std::vector<uint> live(vertexCount, 0), offsets(vertexCount + 1, 0), adjacency(indices.size());
+    for (uint index : indices) { live[index]++; }
+    for (size_t v = 0; v < vertexCount; v++) { offsets[v + 1] = offsets[v] + live[v]; }
+    std::vector<uint> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) { adjacency[cursor[indices[i]]++] = static_cast<uint>(i / 3); }
+
+    // 2. Tipsify, emit all live triangles around the fanning vertex, then fan around the candidate which is
+    // still cached after its own triangles are emitted, fall back to the dead end stack and input order
+    std::vector<uint> timestamps(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint> deadEnd, candidates, result;
+    deadEnd.reserve(indices.size());
+    result.reserve(indices.size());
+    uint time   = CACHE_SIZE + 1;
+    size_t scan = 0;
+    long fan    = indices[0];
+    if (clusters) { clusters->push_back(0); }
+    while (fan >= 0) {
+        candidates.clear();
+        for (uint k = offsets[fan]; k < offsets[fan + 1]; k++) {
+            uint triangle = adjacency[k];
+            if (emitted[triangle]) { continue; }
+            for (int j = 0; j < 3; j++) {
+                uint v = indices[3 * triangle + j];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - timestamps[v] > CACHE_SIZE) { timestamps[v] = time++; }
+            }
+            emitted[triangle] = true;
+        }
+
+        long next = -1;
+        long best = -1;
+        for (uint v : candidates) {
+            if (live[v] == 0) { continue; }
+            long age      = static_cast<long>(time - timestamps[v]);
+            long priority = (age + 2 * static_cast<long>(live[v]) <= static_cast<long>(CACHE_SIZE)) ? age : 0;
+            if (priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+        if (next < 0) { // dead end, the triangles emitted next are not adjacent to the current cluster
+            while (next < 0 && !deadEnd.empty()) {
+                uint v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0) { next = v; }
+            }
+            while (next < 0 && scan < vertexCount) {
+                if (live[scan] > 0) {
+                    next = static_cast<long>(scan);
+                } else {
+                    scan++;
+                }
+            }
+            if (next >= 0 && clusters) { clusters->push_back(static_cast<uint>(result.size() / 3)); }
+        }
+        fan = next;
+    }
+    indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint>& indices, const std::vector<uint>& clusters, const Vertex* vertices, size_t vertexCount, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || clusters.empty()) { return; }
+
+    // 1. Split hard clusters wherever the ACMR of the prefix is within threshold of the ACMR of whole cluster
+    std::vector<uint> timestamps(vertexCount, 0);
+    uint time = CACHE_SIZE + 1;
+    auto misses = [&](size_t triangle) {
+        size_t count = 0;
+        for (int j = 0; j < 3; j++) {
+            uint v = indices[3 * triangle + j];
+            if (time - timestamps[v] > CACHE_SIZE) {
+                timestamps[v] = time++;
+                count++;
+            }
+        }
+        return count;
+    };
+    auto flush = [&time]() { time += CACHE_SIZE + 1; }; // every cached vertex becomes stale
+
+    std::vector<uint> soft;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        size_t begin = clusters[c], end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+        size_t total = 0;
+        flush();
+        for (size_t t = begin; t < end; t++) { total += misses(t); }
+        float limit = threshold * static_cast<float>(total) / static_cast<float>(end - begin);
+
+        size_t start = begin, count = 0;
+        soft.push_back(static_cast<uint>(begin));
+        flush();
+        for (size_t t = begin; t < end; t++) {
+            count += misses(t);
+            if (t + 1 < end && static_cast<float>(count) <= limit * static_cast<float>(t + 1 - start)) {
+                soft.push_back(static_cast<uint>(t + 1));
+                start = t + 1;
+                count = 0;
+                flush();
+            }
+        }
+    }
+
+    // 2. Sort clusters by how much they face away from the mesh center, outer clusters occlude inner ones
+    glm::vec3 center(0.f);
+    float area = 0.f;
+    std::vector<float> keys(soft.size());
+    std::vector<std::pair<glm::vec3, glm::vec3>> sums(soft.size(), {glm::vec3(0.f), glm::vec3(0.f)}); // area weighted centroid and normal
+    for (size_t c = 0; c < soft.size(); c++) {
+        size_t begin = soft[c], end = (c + 1 < soft.size()) ? soft[c + 1] : triangleCount;
+        for (size_t t = begin; t < end; t++) {
+            const glm::vec3& p0 = vertices[indices[3 * t]].position;
+            const glm::vec3& p1 = vertices[indices[3 * t + 1]].position;
+            const glm::vec3& p2 = vertices[indices[3 * t + 2]].position;
+            glm::vec3 normal   = glm::cross(p1 - p0, p2 - p0);
+            float weight       = glm::length(normal);
+            sums[c].first     += (p0 + p1 + p2) * (weight / 3.f);
+            sums[c].second    += normal;
+            center            += (p0 + p1 + p2) * (weight / 3.f);
+            area              += weight;
+        }
+    }
+    center = area > 0.f ? center / area : glm::vec3(0.f);
+    for (size_t c = 0; c < soft.size(); c++) {
+        float weight = glm::length(sums[c].second);
+        keys[c] = weight > 0.f ? glm::dot(sums[c].first / weight - center, sums[c].second / weight) : 0.f;
+    }
+
+    std::vector<uint> order(soft.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&keys](uint a, uint b) { return keys[a] > keys[b]; });
+
+    std::vector<uint> result;
+    result.reserve(indices.size());
+    for (uint c : order) {
+        size_t begin = soft[c], end = (c + 1 < soft.size()) ? soft[c + 1] : triangleCount;
+        result.insert(result.end(), indices.begin() + 3 * begin, indices.begin() + 3 * end);
+    }
+    indices.swap(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<uint>& indices, Vertex* vertices, size_t vertexCount) {
+    constexpr uint unused = std::numeric_limits<uint>::max();
+    std::vector<uint> remap(vertexCount, unused);
+    uint next = 0;
+    for (uint& index : indices) {
+        if (remap[index] == unused) { remap[index] = next++; }
+        index = remap[index];
+    }
+    for (uint& v : remap) { // unreferenced vertices go last
+        if (v == unused) { v = next++; }
+    }
+
+    std::vector<Vertex> copy(vertices, vertices + vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) { vertices[remap[v]] = copy[v]; }
+}
+
+void MeshOptimizer::simplify(const std::vector<uint>& indices, const Vertex* vertices, size_t vertexCount, size_t targetIndexCount, std::vector<uint>& result) {
+    result.clear();
+    size_t triangleCount = indices.size() / 3;
+
+    // 1. Group vertices by position, groups are the vertices of position only topology and their vertices are wedges
+    auto hash = [](const glm::vec3& p) {
+        size_t seed = 0;
+        for (float value : {p.x, p.y, p.z}) { seed ^= std::hash<uint32_t>{}(std::bit_cast<uint32_t>(value == 0.f ? 0.f : value)) + 0x9e3779b9 + (seed << 6) + (seed >> 2); }
+        return seed;
+    };
+    std::unordered_map<glm::vec3, uint, decltype(hash)> lookup(vertexCount, hash);
+    std::vector<uint> group(vertexCount);
+    std::vector<glm::vec3> positions;
+    std::vector<std::vector<uint>> wedges;
+    for (size_t v = 0; v < vertexCount; v++) {
+        auto [it, inserted] = lookup.try_emplace(vertices[v].position, static_cast<uint>(positions.size()));
+        if (inserted) {
+            positions.push_back(vertices[v].position);
+            wedges.emplace_back();
+        }
+        group[v] = it->second;
+        wedges[it->second].push_back(static_cast<uint>(v));
+    }
+    size_t groupCount = positions.size();
+
+    // 2. Collect live triangles, their plane quadrics and the perpendicular planes of open border edges
+    std::vector<std::array<uint, 3>> triangles(triangleCount);
+    std::vector<bool> live(triangleCount, false);
+    std::vector<std::vector<uint>> adjacency(groupCount);
+    std::vector<MeshQuadric> quadrics(groupCount);
+    std::unordered_map<uint64_t, uint> edges; // undirected edge to its triangle count
+    auto key = [](uint a, uint b) { return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b); };
+    size_t liveCount = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        auto& triangle = triangles[t];
+        for (int j = 0; j < 3; j++) { triangle[j] = group[indices[3 * t + j]]; }
+        if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) { continue; }
+
+        glm::vec3 normal = glm::cross(positions[triangle[1]] - positions[triangle[0]], positions[triangle[2]] - positions[triangle[0]]);
+        float length = glm::length(normal);
+        if (length > 0.f) {
+            normal /= length;
+            for (int j = 0; j < 3; j++) { quadrics[triangle[j]].add(normal, -glm::dot(normal, positions[triangle[0]]), 1.0); }
+        }
+        for (int j = 0; j < 3; j++) {
+            adjacency[triangle[j]].push_back(static_cast<uint>(t));
+            edges[key(triangle[j], triangle[(j + 1) % 3])]++;
+        }
+        live[t] = true;
+        liveCount++;
+    }
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (!live[t]) { continue; }
+        auto& triangle = triangles[t];
+        glm::vec3 normal = glm::cross(positions[triangle[1]] - positions[triangle[0]], positions[triangle[2]] - positions[triangle[0]]);
+        for (int j = 0; j < 3; j++) {
+            uint a = triangle[j], b = triangle[(j + 1) % 3];
+            if (edges[key(a, b)] != 1) { continue; }
+            glm::vec3 border = glm::cross(positions[b] - positions[a], normal);
+            float length = glm::length(border);
+            if (length <= 0.f) { continue; }
+            border /= length;
+            quadrics[a].add(border, -glm::dot(border, positions[a]), MESH_SIMPLIFY_BORDER_WEIGHT);
+            quadrics[b].add(border, -glm::dot(border, positions[a]), MESH_SIMPLIFY_BORDER_WEIGHT);
+        }
+    }
+
+    // 3. Evaluate every edge in its cheaper direction, a collapse moves one group onto the other
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for (auto& position : positions) {
+        lo = glm::min(lo, position);
+        hi = glm::max(hi, position);
+    }
+    double attributeWeight = groupCount ? MESH_SIMPLIFY_ATTRIBUTE_WEIGHT * glm::dot(hi - lo, hi - lo) : 0.0;
+    auto distance = [vertices](uint a, uint b) {
+        glm::vec3 dn = vertices[a].normal - vertices[b].normal;
+        glm::vec2 dt = vertices[a].texcoord - vertices[b].texcoord;
+        return static_cast<double>(glm::dot(dn, dn) + glm::dot(dt, dt));
+    };
+    auto nearest = [&](uint v, uint g) { // the wedge of group g whose attributes are closest to vertex v
+        uint best = wedges[g][0];
+        for (uint w : wedges[g]) { best = distance(v, w) < distance(v, best) ? w : best; }
+        return best;
+    };
+
+    std::vector<uint> versions(groupCount, 0), parents(groupCount);
+    std::iota(parents.begin(), parents.end(), 0);
+    std::priority_queue<MeshCollapse, std::vector<MeshCollapse>, std::greater<MeshCollapse>> queue;
+    auto evaluate = [&](uint a, uint b) {
+        MeshQuadric quadric = quadrics[a];
+        quadric.add(quadrics[b]);
+        double ab = quadric.error(positions[b]), ba = quadric.error(positions[a]);
+        for (uint w : wedges[a]) { ab += attributeWeight * distance(w, nearest(w, b)); }
+        for (uint w : wedges[b]) { ba += attributeWeight * distance(w, nearest(w, a)); }
+        if (ab <= ba) {
+            queue.push(MeshCollapse{.cost = ab, .from = a, .to = b, .versions = {versions[a], versions[b]}});
+        } else {
+            queue.push(MeshCollapse{.cost = ba, .from = b, .to = a, .versions = {versions[b], versions[a]}});
+        }
+    };
+    for (auto& [edge, count] : edges) { evaluate(static_cast<uint>(edge >> 32), static_cast<uint>(edge & 0xffffffffu)); }
+
+    // 4. Collapse the cheapest edges until the target is met, skipping stale entries and collapses that flip triangles
+    std::vector<uint> neighbors;
+    while (liveCount * 3 > targetIndexCount && !queue.empty()) {
+        MeshCollapse collapse = queue.top();
+        queue.pop();
+        uint from = collapse.from, to = collapse.to;
+        if (parents[from] != from || parents[to] != to || versions[from] != collapse.versions[0] || versions[to] != collapse.versions[1]) { continue; }
+
+        bool flip = false;
+        for (uint t : adjacency[from]) {
+            auto& triangle = triangles[t];
+            if (!live[t] || std::find(triangle.begin(), triangle.end(), to) != triangle.end()) { continue; }
+            glm::vec3 p[3], q[3];
+            for (int j = 0; j < 3; j++) {
+                p[j] = positions[triangle[j]];
+                q[j] = triangle[j] == from ? positions[to] : p[j];
+            }
+            if (glm::dot(glm::cross(p[1] - p[0], p[2] - p[0]), glm::cross(q[1] - q[0], q[2] - q[0])) <= 0.f) {
+                flip = true;
+                break;
+            }
+        }
+        if (flip) { continue; }
+
+        for (uint t : adjacency[from]) {
+            auto& triangle = triangles[t];
+            if (!live[t]) { continue; }
+            if (std::find(triangle.begin(), triangle.end(), to) != triangle.end()) {
+                live[t] = false;
+                liveCount--;
+                continue;
+            }
+            std::replace(triangle.begin(), triangle.end(), from, to);
+            adjacency[to].push_back(t);
+        }
+        std::vector<uint>().swap(adjacency[from]);
+        quadrics[to].add(quadrics[from]);
+        parents[from] = to;
+        versions[to]++;
+
+        // drop dead triangles around the kept group and re-evaluate the edges to its neighbors
+        auto& around = adjacency[to];
+        around.erase(std::remove_if(around.begin(), around.end(), [&live](uint t) { return !live[t]; }), around.end());
+        neighbors.clear();
+        for (uint t : around) {
+            for (uint g : triangles[t]) {
+                if (g != to) { neighbors.push_back(g); }
+            }
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for (uint g : neighbors) { evaluate(to, g); }
+    }
+
+    // 5. Emit live triangles, a corner whose group collapsed takes the closest wedge of the group it moved onto
+    result.reserve(liveCount * 3);
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (!live[t]) { continue; }
+        for (int j = 0; j < 3; j++) {
+            uint v = indices[3 * t + j];
+            result.push_back(group[v] == triangles[t][j] ? v : nearest(v, triangles[t][j]));
+        }
+    }
+}
+
+std::pair<float, float> MeshOptimizer::analyzeVertexCache(const std::vector<uint>& indices, size_t vertexCount) {
+    if (indices.empty()) { return {0.f, 0.f}; }
+
+    std::vector<uint> timestamps(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    uint time = CACHE_SIZE + 1;
+    size_t misses = 0, unique = 0;
+    for (uint v : indices) {
+        if (time - timestamps[v] > CACHE_SIZE) { // a vertex stays cached until CACHE_SIZE later misses push it out
+            timestamps[v] = time++;
+            misses++;
+        }
+        if (!used[v]) {
+            used[v] = true;
+            unique++;
+        }
+    }
+    return {static_cast<float>(misses) / static_cast<float>(indices.size() / 3), static_cast<float>(misses) / static_cast<float>(unique)};
+}
+
+} // namespace tinyglrenderer
@@ -1,7 +1,11 @@
 #include "model.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
@@ -11,6 +15,9 @@ namespace tinyglrenderer {
 
 namespace fs = std::filesystem;
 
+static constexpr float MODEL_LOD_COVERAGE   = 0.5f;  // projected radius(in half screen heights) below which level 1 is drawn, every further halving adds a level
+static constexpr float MODEL_LOD_HYSTERESIS = 0.25f; // fraction of a level the projected size must pass beyond a boundary before switching
+
 Model::Model() {}
 
 Model::Model(const std::string& name, const std::shared_ptr<Mesh>& mesh, const std::vector<std::shared_ptr<Material>>& materials, const std::shared_ptr<Material>& defaultMaterial) {
@@ -18,6 +25,11 @@ Model::Model(const std::string& name, const std::shared_ptr<Mesh>& mesh, const s
     m_mesh      = std::move(mesh);
     m_materials = materials;
     m_material  = defaultMaterial;
+
+    if (m_mesh) {
+        std::tie(m_modelBlock.positionOffset, m_modelBlock.positionScale) = m_mesh->getQuantization();
+        m_modelBlock.texcoordTransform = m_mesh->getTexcoordTransform();
+    }
 }
 
 Model::~Model() {
@@ -40,21 +52,105 @@ Model& Model::operator=(Model&& other) {
     return *this;
 }
 
-void Model::getRenderQueue(std::vector<RenderItem>& queue, bool opaque) const {
-    if (!m_visible) { return; }
+void Model::getRenderQueue(std::vector<RenderItem>& queue, bool opaque, RenderView* view) const {
+    if (!m_visible || !m_mesh) { return; }
+
+    size_t level = 0;
+    if (view && view->lodBias >= 0) { level = std::min(m_lod + view->lodBias, m_mesh->getLodCount() - 1); }
+
+    // 1. Extract frustum planes(Gribb-Hartmann) of projection * view * model and move camera into object space
+    std::array<glm::vec4, 6> planes;
+    glm::vec3 eye(0.f);
+    bool backface = false;
+    bool culling  = view && view->culling;
+    if (culling) {
+        glm::mat4 mvp = view->viewProjMatrix * m_modelBlock.transformMatrix;
+        glm::vec4 w   = glm::vec4(mvp[0][3], mvp[1][3], mvp[2][3], mvp[3][3]);
+        for (int i = 0; i < 3; i++) {
+            glm::vec4 row = glm::vec4(mvp[0][i], mvp[1][i], mvp[2][i], mvp[3][i]);
+            planes[2 * i]     = (w + row) / glm::length(glm::vec3(w + row));
+            planes[2 * i + 1] = (w - row) / glm::length(glm::vec3(w - row));
+        }
+        eye      = glm::vec3(glm::inverse(m_modelBlock.transformMatrix) * glm::vec4(view->eye, 1.f));
+        backface = view->backface && glm::determinant(glm::mat3(m_modelBlock.transformMatrix)) > 0.f; // mirrored models flip winding
+    }
 
-    for (auto& sm : m_mesh->getSubMeshes()) {
+    for (size_t i = 0; i < m_mesh->getSubMeshes().size(); i++) {
+        const SubMesh& sm = m_mesh->getSubMesh(i, level);
         auto material = sm.matid != -1 ? m_materials[sm.matid] : m_material;
         if (material == nullptr) { throw std::runtime_error("Model::getRenderQueue}: Invalid material for submesh!"); }
         if (material->isOpaque() != opaque) { continue; }
-        queue.emplace_back(
-            RenderItem{
-                .mesh     = m_mesh,
-                .material = material,
-                .ioffset  = sm.offset,
-                .length   = sm.length,
+
+        RenderItem item{
+            .mesh     = m_mesh,
+            .material = material,
+            .ioffset  = sm.offset,
+            .length   = sm.length,
+            .ibase    = sm.vertex,
+            .itype    = sm.type,
+        };
+
+        // 2. Test clusters of submesh against frustum and normal cone, merge adjacent survivors into index ranges
+        if (culling && sm.clusters > 0) {
+            const auto& clusters = m_mesh->getClusters();
+            uint stride = (sm.type == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+            for (uint c = sm.cluster; c < sm.cluster + sm.clusters; c++) {
+                const MeshCluster& cluster = clusters[c];
+                glm::vec3 center = glm::vec3(cluster.sphere);
+                float radius     = cluster.sphere.w;
+                bool visible     = std::all_of(planes.begin(), planes.end(), [&](const glm::vec4& plane) { return glm::dot(glm::vec3(plane), center) + plane.w >= -radius; });
+                if (visible && backface) {
+                    glm::vec3 view = center - eye;
+                    visible = glm::dot(view, glm::vec3(cluster.cone)) < cluster.cone.w * glm::length(view) + radius;
+                }
+                view->tested++;
+                if (!visible) { continue; }
+
+                view->drawn++;
+                if (!item.ranges.empty() && item.ranges.back().first + item.ranges.back().second * stride == cluster.offset) {
+                    item.ranges.back().second += cluster.length;
+                } else {
+                    item.ranges.emplace_back(cluster.offset, cluster.length);
+                }
             }
-        );
+            if (item.ranges.empty()) { continue; }
+
+            item.ioffset = item.ranges.front().first;
+            item.length  = item.ranges.front().second;
+            if (item.ranges.size() == 1) { item.ranges.clear(); } // a single range is a plain draw
+        }
+
+        if (view) {
+            size_t length = item.length;
+            for (size_t r = 1; r < item.ranges.size(); r++) { length += item.ranges[r].second; }
+            view->triangles[level] += length / 3;
+        }
+        queue.emplace_back(std::move(item));
+    }
+}
+
+void Model::setMesh(const std::shared_ptr<Mesh>& mesh, const std::vector<std::shared_ptr<Material>>& materials) {
+    m_mesh      = mesh;
+    m_materials = materials;
+    m_lod       = 0;
+
+    std::tie(m_modelBlock.positionOffset, m_modelBlock.positionScale) = m_mesh->getQuantization();
+    m_modelBlock.texcoordTransform = m_mesh->getTexcoordTransform();
+    setTransform(getTranslate(), getRotate(), getScale()); // update bounding box
+}
+
+void Model::selectLod(float coverage) {
+    size_t count = m_mesh ? m_mesh->getLodCount() : 1;
+    if (count <= 1) {
+        m_lod = 0;
+        return;
+    }
+
+    // Level l covers [MODEL_LOD_COVERAGE / 2^l, MODEL_LOD_COVERAGE / 2^(l-1)), keep current level until the ideal one is clearly past its borders
+    float ideal = std::log2(MODEL_LOD_COVERAGE / std::max(coverage, 1e-6f));
+    float level = static_cast<float>(m_lod);
+    if (ideal < level - MODEL_LOD_HYSTERESIS || ideal > level + 1.f + MODEL_LOD_HYSTERESIS) {
+        m_lod = static_cast<size_t>(std::clamp(std::floor(ideal), 0.f, static_cast<float>(count - 1)));
     }
 }
 
@@ -77,6 +173,7 @@ void Model::setTransform(const glm::vec3& translate, const glm::vec3& rotate, co
     m_modelBlock.normalMatrix    = glm::mat4(glm::transpose(glm::inverse(glm::mat3(transform))));
 
     // update bounding box
+    if (!m_mesh) { return; }
     auto [xyz1, xyz2] = m_mesh->getBoundingBox();
     xyz1              = glm::vec3(transform * glm::vec4(xyz1, 1.f));
     xyz2              = glm::vec3(transform * glm::vec4(xyz2, 1.f));
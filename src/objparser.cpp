@@ -0,0 +1,238 @@
+#include "objparser.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <map>
+
+#include "mappedfile.hpp"
+#include "utils.hpp"
+
+namespace tinyglrenderer {
+
+struct ObjEvent {
+    size_t triangle = 0; // triangle count of chunk when event occurs
+    char type = 'u';     // 'u' usemtl, 'g' group/object, 'm' mtllib
+    std::string name;    // material, group/object name or mtl file names
+};
+
+struct ObjChunk {
+    std::vector<tinyobj::real_t> vertices;  // 'v'
+    std::vector<tinyobj::real_t> normals;   // 'vn'
+    std::vector<tinyobj::real_t> texcoords; // 'vt'
+    std::vector<tinyobj::index_t> indices;  // 3 per triangle, relative indices are resolved against chunk local counts
+    std::vector<std::pair<size_t, uint8_t>> relatives; // (position in indices, mask of v/vt/vn components which are relative)
+    std::vector<ObjEvent> events;
+};
+
+static constexpr size_t OBJ_CHUNK_MIN_SIZE = 64 * 1024;
+
+bool ObjParser::load(tinyobj::attrib_t* attributes, std::vector<tinyobj::shape_t>* shapes, std::vector<tinyobj::material_t>* materials, std::string* err,
+                     const fs::path& objPath, const fs::path& mtlDir, unsigned threads) {
+    std::error_code ec;
+    if (!fs::is_regular_file(objPath, ec)) {
+        if (err) { *err += "Cannot open file [" + objPath.string() + "]\n"; }
+        return false;
+    }
+    attributes->vertices.clear();
+    attributes->normals.clear();
+    attributes->texcoords.clear();
+    shapes->clear();
+    materials->clear();
+
+    // 1. Split mapped file into line aligned chunks, and tokenize every chunk on its own thread
+    MappedFile file(objPath);
+    std::string_view text = file.getView();
+    size_t count = std::max<size_t>(1, std::min<size_t>(getParallelThreads(threads), text.size() / OBJ_CHUNK_MIN_SIZE));
+    std::vector<std::string_view> ranges;
+    for (size_t begin = 0, i = 1; begin < text.size(); i++) {
+        size_t end = (i >= count) ? text.size() : std::max(begin, text.size() * i / count);
+        end = (end >= text.size()) ? text.size() : text.find('\n', end);
+        end = (end == std::string_view::npos) ? text.size() : end + 1;
+        ranges.push_back(text.substr(begin, end - begin));
+        begin = end;
+    }
+
+    std::vector<ObjChunk> chunks(ranges.size());
+    parallelFor(ranges.size(), static_cast<unsigned>(count), [&](size_t i) { parse(ranges[i], chunks[i]); });
+
+    // 2. Concatenate attributes in file order, relative indices of a chunk are offset by the attribute counts before it
+    size_t nv = 0, nn = 0, nt = 0;
+    for (auto& chunk : chunks) {
+        for (auto& [position, mask] : chunk.relatives) {
+            tinyobj::index_t& index = chunk.indices[position];
+            if (mask & 1) { index.vertex_index += static_cast<int>(nv); }
+            if (mask & 2) { index.texcoord_index += static_cast<int>(nt); }
+            if (mask & 4) { index.normal_index += static_cast<int>(nn); }
+        }
+        nv += chunk.vertices.size() / 3;
+        nn += chunk.normals.size() / 3;
+        nt += chunk.texcoords.size() / 2;
+    }
+    attributes->vertices.reserve(nv * 3);
+    attributes->normals.reserve(nn * 3);
+    attributes->texcoords.reserve(nt * 2);
+    for (auto& chunk : chunks) {
+        attributes->vertices.insert(attributes->vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+        attributes->normals.insert(attributes->normals.end(), chunk.normals.begin(), chunk.normals.end());
+        attributes->texcoords.insert(attributes->texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+        std::vector<tinyobj::real_t>().swap(chunk.vertices);
+        std::vector<tinyobj::real_t>().swap(chunk.normals);
+        std::vector<tinyobj::real_t>().swap(chunk.texcoords);
+    }
+
+    // 3. Replay triangles and events in file order to build shapes and per face material ids
+    std::map<std::string, int> materialMap;
+    tinyobj::shape_t shape;
+    std::string name;
+    int material = -1;
+    for (auto& chunk : chunks) {
+        size_t triangle = 0;
+        auto flush = [&](size_t until) {
+            shape.mesh.indices.insert(shape.mesh.indices.end(), chunk.indices.begin() + 3 * triangle, chunk.indices.begin() + 3 * until);
+            shape.mesh.num_face_vertices.insert(shape.mesh.num_face_vertices.end(), until - triangle, 3);
+            shape.mesh.material_ids.insert(shape.mesh.material_ids.end(), until - triangle, material);
+            triangle = until;
+        };
+
+        for (auto& event : chunk.events) {
+            flush(event.triangle);
+            if (event.type == 'u') {
+                auto it = materialMap.find(event.name);
+                material = (it != materialMap.end()) ? it->second : -1;
+            } else if (event.type == 'g') {
+                if (!shape.mesh.indices.empty()) {
+                    shape.name = name;
+                    shapes->push_back(std::move(shape));
+                }
+                shape = tinyobj::shape_t();
+                name  = event.name;
+            } else { // 'm', the first mtl library that can be opened wins like tinyobj
+                std::string_view names = event.name;
+                bool found = false;
+                while (!names.empty() && !found) {
+                    std::string_view filename = names.substr(0, names.find(' '));
+                    names.remove_prefix(std::min(names.size(), filename.size() + 1));
+                    if (filename.empty()) { continue; }
+
+                    std::ifstream stream{mtlDir / std::string(filename)};
+                    if (stream.is_open()) {
+                        std::string warning;
+                        tinyobj::LoadMtl(&materialMap, materials, &stream, &warning);
+                        if (err) { *err += warning; }
+                        found = true;
+                    }
+                }
+                if (!found && err) { *err += "WARN: Failed to load material file(s). Use default material.\n"; }
+            }
+        }
+        flush(chunk.indices.size() / 3);
+        std::vector<tinyobj::index_t>().swap(chunk.indices);
+    }
+    if (!shape.mesh.indices.empty()) {
+        shape.name = name;
+        shapes->push_back(std::move(shape));
+    }
+
+    return true;
+}
+
+void ObjParser::parse(std::string_view text, ObjChunk& chunk) {
+    auto skip = [](std::string_view& line) {
+        size_t begin = line.find_first_not_of(" \t");
+        line.remove_prefix(begin == std::string_view::npos ? line.size() : begin);
+    };
+    auto token = [&skip](std::string_view& line) {
+        skip(line);
+        std::string_view value = line.substr(0, line.find_first_of(" \t"));
+        line.remove_prefix(value.size());
+        return value;
+    };
+    auto real = [&token](std::string_view& line) {
+        std::string_view value = token(line);
+        if (!value.empty() && value[0] == '+') { value.remove_prefix(1); }
+        tinyobj::real_t result = 0;
+        std::from_chars(value.data(), value.data() + value.size(), result);
+        return result;
+    };
+    // Resolve obj index(1 based, negative is relative to the current count) into 0 based index, like tinyobj fixIndex
+    auto resolve = [](std::string_view value, size_t count, uint8_t bit, uint8_t& mask) {
+        int index = 0;
+        std::from_chars(value.data(), value.data() + value.size(), index);
+        if (index > 0) { return index - 1; }
+        if (index == 0) { return 0; }
+        mask |= bit;
+        return static_cast<int>(count) + index;
+    };
+
+    size_t estimate = text.size() / 32; // a typical record is around 30 bytes long
+    chunk.vertices.reserve(estimate);
+    chunk.indices.reserve(estimate);
+
+    for (size_t pos = 0; pos < text.size();) {
+        size_t end = text.find('\n', pos);
+        end = (end == std::string_view::npos) ? text.size() : end;
+        std::string_view line = text.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (!line.empty() && line.back() == '\r') { line.remove_suffix(1); }
+        skip(line);
+        if (line.size() < 2 || line[0] == '#') { continue; }
+
+        if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t')) { // vertex
+            line.remove_prefix(2);
+            tinyobj::real_t x = real(line), y = real(line), z = real(line);
+            chunk.vertices.insert(chunk.vertices.end(), {x, y, z});
+        } else if (line[0] == 'v' && line[1] == 'n' && line.size() > 2 && (line[2] == ' ' || line[2] == '\t')) { // normal
+            line.remove_prefix(2);
+            tinyobj::real_t x = real(line), y = real(line), z = real(line);
+            chunk.normals.insert(chunk.normals.end(), {x, y, z});
+        } else if (line[0] == 'v' && line[1] == 't' && line.size() > 2 && (line[2] == ' ' || line[2] == '\t')) { // texcoord
+            line.remove_prefix(2);
+            tinyobj::real_t x = real(line), y = real(line);
+            chunk.texcoords.insert(chunk.texcoords.end(), {x, y});
+        } else if (line[0] == 'f' && (line[1] == ' ' || line[1] == '\t')) { // face, triangulated as fan
+            line.remove_prefix(2);
+            tinyobj::index_t first, prev;
+            uint8_t firstMask = 0, prevMask = 0;
+            for (int k = 0;; k++) {
+                std::string_view value = token(line);
+                if (value.empty()) { break; }
+
+                // v, v/vt, v//vn or v/vt/vn
+                tinyobj::index_t index = {-1, -1, -1};
+                uint8_t mask = 0;
+                size_t slash1 = value.find('/');
+                index.vertex_index = resolve(value.substr(0, slash1), chunk.vertices.size() / 3, 1, mask);
+                if (slash1 != std::string_view::npos) {
+                    std::string_view rest = value.substr(slash1 + 1);
+                    size_t slash2 = rest.find('/');
+                    if (slash2 != 0) { index.texcoord_index = resolve(rest.substr(0, slash2), chunk.texcoords.size() / 2, 2, mask); }
+                    if (slash2 != std::string_view::npos) { index.normal_index = resolve(rest.substr(slash2 + 1), chunk.normals.size() / 3, 4, mask); }
+                }
+
+                if (k == 0) {
+                    first = index, firstMask = mask;
+                } else if (k >= 2) {
+                    for (auto [corner, cornerMask] : {std::pair{first, firstMask}, std::pair{prev, prevMask}, std::pair{index, mask}}) {
+                        if (cornerMask) { chunk.relatives.emplace_back(chunk.indices.size(), cornerMask); }
+                        chunk.indices.push_back(corner);
+                    }
+                }
+                prev = index, prevMask = mask;
+            }
+        } else if (line.starts_with("usemtl") && line.size() > 6 && (line[6] == ' ' || line[6] == '\t')) {
+            line.remove_prefix(6);
+            chunk.events.push_back(ObjEvent{chunk.indices.size() / 3, 'u', std::string(token(line))});
+        } else if (line.starts_with("mtllib") && line.size() > 6 && (line[6] == ' ' || line[6] == '\t')) {
+            line.remove_prefix(7);
+            chunk.events.push_back(ObjEvent{chunk.indices.size() / 3, 'm', std::string(line)});
+        } else if ((line[0] == 'g' || line[0] == 'o') && (line[1] == ' ' || line[1] == '\t')) { // group or object
+            line.remove_prefix(2);
+            chunk.events.push_back(ObjEvent{chunk.indices.size() / 3, 'g', std::string(token(line))});
+        }
+        // Ignore unknown command.
+    }
+}
+
+} // namespace tinyglrenderer
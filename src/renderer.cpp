@@ -1,5 +1,6 @@
 #include "renderer.hpp"
 
+#include <cmath>
 #include <format>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -10,21 +11,25 @@
 #include <vector>
 
 #include "camera.hpp"
+#include "memoryregistry.hpp"
 #include "model.hpp"
 #include "renderitem.hpp"
 #include "resourcemanager.hpp"
 #include "shaderstoragebuffer.hpp"
+#include "texturecache.hpp"
 #include "uniformbuffer.hpp"
 #include "utils.hpp"
 
 namespace tinyglrenderer {
 
+static constexpr int VIRTUAL_FEEDBACK_DIVISOR = 8;     // feedback target is 1/8 of frame size on each side
+static constexpr size_t VIRTUAL_PAGES_PER_FRAME = 16;  // pages requested from the loader per feedback at most
+
 void Renderer::setup(ResourceManager& manager) {
     // 0. Define name mappings
     {
         m_pass2FrameNames = {
             {"skybox_equirect2cubemap", "skybox"},
-            {"ibl_irradiance", "ibl_diffuse"},
             {"ibl_prefiltered", "ibl_specular"},
             {"ibl_brdf_lut", "ibl_brdf_lut"},
             {"shadow_mapping", "shadow"},
@@ -33,6 +38,7 @@ void Renderer::setup(ResourceManager& manager) {
             {"forward_opaque", "hdr_screen"},
             {"forward_transparent", "hdr_screen_ss"},
             {"skybox_mapping", "hdr_screen"},
+            {"skybox_virtual_feedback", "vt_feedback"},
             {"postprocess_highlight", "highlight"},
             {"postprocess_kawase_down", "blur_down"},
             {"postprocess_kawase_up", "blur_up"},
@@ -46,6 +52,11 @@ void Renderer::setup(ResourceManager& manager) {
             {"albedo", 0},
             {"normal", 1},
             {"mrao", 2},
+            {"texture_pool.0", 3}, // texture_pool.* are the buckets of m_texturePool, bound by the pool itself
+            {"texture_pool.1", 4},
+            {"texture_pool.2", 5},
+            {"texture_pool.3", 6},
+            {"texture_pool.4", 7},
 
             // 8~11: gbuffer textures
             {"gbuffer.albedo", 8},
@@ -56,9 +67,11 @@ void Renderer::setup(ResourceManager& manager) {
             // 12~19: ibl textures and shadow textures
             {"skybox.cubemap", 12},
             {"skybox.equirect", 13}, // skybox.equirect is registered in m_textures by scene.m_skyboxEquirect when prepare(...) is called
-            {"ibl_diffuse", 14},
             {"ibl_specular", 15},
             {"ibl_brdf_lut", 16},
+            {"vt.page_table", 17}, // vt.* are registered in m_textures by scene.m_skyboxVirtual when prepare(...) is called
+            {"vt.atlas", 18},
+            {"vt_feedback", -1},
 
             {"shadow", 19},
 
@@ -90,20 +103,7 @@ void Renderer::setup(ResourceManager& manager) {
                     .name   = "cubemap",
                     .target = GL_COLOR,
                     .type   = GL_TEXTURE_CUBE_MAP,
-                    .format = GL_RGBA32F,
-                    .slot   = GL_COLOR_ATTACHMENT0,
-                    .loadOp = LoadOp::LOAD_OP_CLEAR,
-                    .value  = {.color = {0.0f, 0.0f, 0.0f, 1.0f}},
-                },
-            },
-        };
-        m_passes["ibl_irradiance"] = RenderPass{
-            .attachments = {
-                AttachmentDesc{
-                    .name   = "", // use frame buffer name as ouput attachment name
-                    .target = GL_COLOR,
-                    .type   = GL_TEXTURE_CUBE_MAP,
-                    .format = GL_RGBA32F,
+                    .format = GL_R11F_G11F_B10F, // packed float rgb in 4 bytes, GL_RGB9_E5 is more precise but not color renderable
                     .slot   = GL_COLOR_ATTACHMENT0,
                     .loadOp = LoadOp::LOAD_OP_CLEAR,
                     .value  = {.color = {0.0f, 0.0f, 0.0f, 1.0f}},
@@ -116,7 +116,7 @@ void Renderer::setup(ResourceManager& manager) {
                     .name      = "", // use frame buffer name as ouput attachment name
                     .target    = GL_COLOR,
                     .type      = GL_TEXTURE_CUBE_MAP,
-                    .format    = GL_RGBA32F,
+                    .format    = GL_R11F_G11F_B10F,
                     .slot      = GL_COLOR_ATTACHMENT0,
                     .mipLevels = 7,
                     .loadOp    = LoadOp::LOAD_OP_CLEAR,
@@ -309,6 +309,19 @@ void Renderer::setup(ResourceManager& manager) {
                 },
             },
         };
+        m_passes["skybox_virtual_feedback"] = RenderPass{
+            .attachments = {
+                AttachmentDesc{
+                    .name   = "", // use frame buffer name as ouput attachment name
+                    .target = GL_COLOR,
+                    .type   = GL_TEXTURE_2D,
+                    .format = GL_RGBA8, // page x, page y, level, requested
+                    .slot   = GL_COLOR_ATTACHMENT0,
+                    .loadOp = LoadOp::LOAD_OP_CLEAR,
+                    .value  = {.color = {0.0f, 0.0f, 0.0f, 0.0f}},
+                },
+            },
+        };
         m_passes["postprocess_highlight"] = RenderPass{
             .attachments = {
                 AttachmentDesc{
@@ -402,14 +415,6 @@ void Renderer::setup(ResourceManager& manager) {
             .depthTestEnable  = GL_FALSE,
             .depthWriteEnable = GL_FALSE,
         };
-        m_states["ibl_irradiance"] = PipelineState{
-            .viewX            = 0,
-            .viewY            = 0,
-            .viewW            = (GLsizei)m_setting.skyboxSize,
-            .viewH            = (GLsizei)m_setting.skyboxSize,
-            .depthTestEnable  = GL_FALSE,
-            .depthWriteEnable = GL_FALSE,
-        };
         m_states["ibl_prefiltered"] = PipelineState{
             .viewX            = 0,
             .viewY            = 0,
@@ -476,6 +481,14 @@ void Renderer::setup(ResourceManager& manager) {
             .depthWriteEnable = GL_FALSE,
             .depthFunc        = GL_LEQUAL,
         };
+        m_states["skybox_virtual_feedback"] = PipelineState{
+            .viewX            = 0,
+            .viewY            = 0,
+            .viewW            = (GLsizei)m_setting.frameWidth / VIRTUAL_FEEDBACK_DIVISOR,
+            .viewH            = (GLsizei)m_setting.frameHeight / VIRTUAL_FEEDBACK_DIVISOR,
+            .depthTestEnable  = GL_FALSE,
+            .depthWriteEnable = GL_FALSE,
+        };
         m_states["postprocess_highlight"] = PipelineState{
             .viewX            = 0,
             .viewY            = 0,
@@ -520,7 +533,6 @@ void Renderer::setup(ResourceManager& manager) {
     // 3. Compile and link shaders
     {
         m_shaders["skybox_equirect2cubemap"]       = manager.loadShader("skybox_equirect2cubemap", "../asset/shader/skybox_equirect2cubemap.vert", "../asset/shader/skybox_equirect2cubemap.frag");
-        m_shaders["ibl_irradiance"]            = manager.loadShader("ibl_irradiance", "../asset/shader/ibl_irradiance.vert", "../asset/shader/ibl_irradiance.frag");
         m_shaders["ibl_prefiltered"]           = manager.loadShader("ibl_prefiltered", "../asset/shader/ibl_prefiltered.vert", "../asset/shader/ibl_prefiltered.frag");
         m_shaders["ibl_brdf_lut"]              = manager.loadShader("ibl_brdf_lut", "../asset/shader/ibl_brdf_lut.vert", "../asset/shader/ibl_brdf_lut.frag");
         m_shaders["shadow_mapping"]            = manager.loadShader("shadow_mapping", "../asset/shader/shadow_mapping.vert", "../asset/shader/shadow_mapping.frag");
@@ -529,6 +541,8 @@ void Renderer::setup(ResourceManager& manager) {
         m_shaders["forward_opaque"]            = manager.loadShader("forward_opaque", "../asset/shader/forward_opaque.vert", "../asset/shader/forward_opaque.frag");
         m_shaders["forward_transparent"]       = manager.loadShader("forward_transparent", "../asset/shader/forward_transparent.vert", "../asset/shader/forward_transparent.frag");
         m_shaders["skybox_mapping"]            = manager.loadShader("skybox", "../asset/shader/skybox.vert", "../asset/shader/skybox.frag");
+        m_shaders["skybox_virtual"]            = manager.loadShader("skybox_virtual", "../asset/shader/skybox.vert", "../asset/shader/skybox_virtual.frag");
+        m_shaders["skybox_virtual_feedback"]   = manager.loadShader("skybox_virtual_feedback", "../asset/shader/skybox.vert", "../asset/shader/skybox_virtual_feedback.frag");
         m_shaders["postprocess_highlight"]     = manager.loadShader("postprocess_highlight", "../asset/shader/postprocess_highlight.vert", "../asset/shader/postprocess_highlight.frag");
         m_shaders["postprocess_kawase_down"]   = manager.loadShader("postprocess_kawase_down", "../asset/shader/postprocess_kawase_down.vert", "../asset/shader/postprocess_kawase_down.frag");
         m_shaders["postprocess_kawase_up"]     = manager.loadShader("postprocess_kawase_up", "../asset/shader/postprocess_kawase_up.vert", "../asset/shader/postprocess_kawase_up.frag");    
@@ -539,12 +553,13 @@ void Renderer::setup(ResourceManager& manager) {
 
     // 4. Create framebuffers
     {
-        m_frames["ibl_diffuse"]  = std::make_shared<FrameBuffer>(false, m_setting.skyboxSize, m_setting.skyboxSize);
+        MemoryRegistry::Scope scope(MemoryTag::MT_ATTACHMENT);
         m_frames["ibl_specular"] = std::make_shared<FrameBuffer>(false, m_setting.skyboxSize, m_setting.skyboxSize);
         m_frames["ibl_brdf_lut"] = std::make_shared<FrameBuffer>(false, m_setting.brdfLUTSize, m_setting.brdfLUTSize);
         m_frames["shadow"]       = std::make_shared<FrameBuffer>(false, m_setting.shadowMapSize, m_setting.shadowMapSize);
         m_frames["gbuffer"]      = std::make_shared<FrameBuffer>(false, m_setting.frameWidth, m_setting.frameHeight);
         m_frames["skybox"]       = std::make_shared<FrameBuffer>(false, m_setting.skyboxSize, m_setting.skyboxSize);
+        m_frames["vt_feedback"]  = std::make_shared<FrameBuffer>(false, m_setting.frameWidth / VIRTUAL_FEEDBACK_DIVISOR, m_setting.frameHeight / VIRTUAL_FEEDBACK_DIVISOR);
         m_frames["hdr_screen"]   = std::make_shared<FrameBuffer>(false, m_setting.frameWidth, m_setting.frameHeight); // hdr_screen is the temporary frame buffer for shading pass, so that later can use it for postprocess(convert hdr into sdr/ldr)
         m_frames["hdr_screen_ss"]   = std::make_shared<FrameBuffer>(false, m_setting.frameWidth, m_setting.frameHeight); 
         m_frames["highlight"]    = std::make_shared<FrameBuffer>(false, m_setting.highlightMapSize, m_setting.highlightMapSize);
@@ -567,6 +582,9 @@ void Renderer::setup(ResourceManager& manager) {
             for (auto attachment : pass.attachments) {
                 auto attachmentName = attachment.name.empty() ? frameName : frameName + "." + attachment.name;
                 std::cout << attachmentName << ", ";
+                // Skybox and ibl maps are rendered into attachments too, they are accounted to their owners
+                MemoryTag tag = frameName.starts_with("ibl_") ? MemoryTag::MT_IBL : frameName.starts_with("skybox") ? MemoryTag::MT_SKYBOX : MemoryTag::MT_ATTACHMENT;
+                MemoryRegistry::Scope scope(tag, attachmentName);
                 if (m_texture2SlotIndexs.count(attachmentName) == 0) { throw std::runtime_error(format("Renderer::setup(): Attachment {} of pass {} not found in frame {}.", attachmentName, passName, frameName)); }
                 if (m_textures.count(attachmentName) == 0) { m_textures[attachmentName] = std::make_shared<Texture>(m_frames[frameName]->getWidth(), m_frames[frameName]->getHeight(), attachment.type, attachment.format, attachment.mipLevels); }
                 m_frames[frameName]->attach(attachment.slot, m_textures[attachmentName]); // attach texture level 0 to frame buffer
@@ -627,9 +645,19 @@ void Renderer::setup(ResourceManager& manager) {
             }
         }
     }
+
+    // 7. Share the texture pool material textures are copied into
+    m_texturePool = manager.getTexturePool();
 }
 
 void Renderer::shutdown() {
+    if (m_feedbackFence) { glDeleteSync(m_feedbackFence); }
+    if (m_feedbackBuffer) { glUnmapNamedBuffer(m_feedbackBuffer->getID()); }
+    m_feedbackFence = nullptr;
+    m_feedbackData  = nullptr;
+    m_feedbackBuffer.reset();
+    m_virtualSkybox.reset();
+    m_texturePool.reset();
     m_shaders.clear();
     m_frames.clear();
     m_buffers.clear();
@@ -643,47 +671,69 @@ void Renderer::prepare(const Scene& scene) {
     GLsizei cubeCount = ResourceManager::getCount("cube");
     GLsizei quadCount = ResourceManager::getCount("quad");
 
-    // 1. Convert equirect skybox into cube map skybox if needed
+    // 1. Convert equirect skybox into cube map skybox if needed, or load the cube map converted by an earlier launch
     const auto& cubemap  = scene.getSkyboxCubeMap();
     const auto& equirect = scene.getSkyboxEquirect();
+    const auto& sources  = scene.getSkyboxFilePaths();
+    m_virtualSkybox      = nullptr;
+    m_irradiance         = IrradianceBlock{};
+    m_irradianceReady    = false;
     if (cubemap == nullptr && equirect != nullptr) {
         m_textures["skybox.equirect"] = equirect; // register equirect texture in m_textures, so that can bind it in draw()
 
-        m_states["skybox_equirect2cubemap"].apply();
-        m_shaders["skybox_equirect2cubemap"]->use();
-        for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; face++) {
-            GLint index = face - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
-            auto matrix = ResourceManager::getCaptureMatrix(index);
-            m_shaders["skybox_equirect2cubemap"]->setUniformValue("uViewProjMatrix", matrix);
-            m_frames["skybox"]->attach(GL_COLOR_ATTACHMENT0, m_textures["skybox.cubemap"], 0, index);
-            m_passes["skybox_equirect2cubemap"].begin(m_frames["skybox"]);
-            draw(cubeLayout, {"skybox.equirect"}, cubeCount);
-            m_passes["skybox_equirect2cubemap"].end();
+        precompute("skybox.cubemap", sources, {"skybox_equirect2cubemap"}, [&]() {
+            m_states["skybox_equirect2cubemap"].apply();
+            m_shaders["skybox_equirect2cubemap"]->use();
+            for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; face++) {
+                GLint index = face - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+                auto matrix = ResourceManager::getCaptureMatrix(index);
+                m_shaders["skybox_equirect2cubemap"]->setUniformValue("uViewProjMatrix", matrix);
+                m_frames["skybox"]->attach(GL_COLOR_ATTACHMENT0, m_textures["skybox.cubemap"], 0, index);
+                m_passes["skybox_equirect2cubemap"].begin(m_frames["skybox"]);
+                draw(cubeLayout, {"skybox.equirect"}, cubeCount);
+                m_passes["skybox_equirect2cubemap"].end();
+            }
+        });
+    } else if (cubemap == nullptr && scene.getSkyboxVirtual() != nullptr) {
+        // The virtual skybox is sampled from its pages directly, the whole image never lives in GPU memory
+        m_virtualSkybox              = scene.getSkyboxVirtual();
+        m_textures["skybox.cubemap"] = nullptr;
+        m_textures["vt.page_table"]  = m_virtualSkybox->getPageTable();
+        m_textures["vt.atlas"]       = m_virtualSkybox->getAtlas();
+
+        glm::ivec4 info(m_virtualSkybox->getPageCountX(), m_virtualSkybox->getPageCountY(), m_virtualSkybox->getMipLevels(), m_virtualSkybox->getAtlasSlots());
+        for (auto name : {"skybox_virtual", "skybox_virtual_feedback"}) {
+            m_shaders[name]->setUniformValue("uVirtualInfo", info);
+            m_shaders[name]->setUniformValue("uVirtualPage", glm::ivec2(VirtualTexture::PAGE_SIZE, VirtualTexture::PAGE_BORDER));
         }
+        m_shaders["skybox_virtual_feedback"]->setUniformValue("uVirtualBias", -std::log2(static_cast<float>(VIRTUAL_FEEDBACK_DIVISOR)));
     } else {
         m_textures["skybox.cubemap"] = cubemap;
     }
 
-    // 2. Precalculate environment map
-    if (0) {
-    // if (cubemap != nullptr || equirect != nullptr) {
-        // 2.1 Precalculate irradiance map
+    // 2. Precalculate environment map, maps cached by an earlier launch skip their passes
+    if (cubemap != nullptr || equirect != nullptr) {
+        // The converted cube map is the input of ibl passes, its shader is part of their key
+        std::vector<std::string> inputs = cubemap != nullptr ? std::vector<std::string>{} : std::vector<std::string>{"skybox_equirect2cubemap"};
+        auto with = [&](const std::string& shader) {
+            auto shaders = inputs;
+            shaders.push_back(shader);
+            return shaders;
+        };
+
+        // 2.1 Load spherical harmonics of the skybox cached by an earlier launch, shading evaluates diffuse irradiance from 9 coefficients
+        // They are keyed like the maps of the skybox, a miss is projected the first time ibl is on(see projectIrradiance)
         {
-            m_states["ibl_irradiance"].apply();
-            m_shaders["ibl_irradiance"]->use();
-            for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; face++) {
-                GLint index = face - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
-                auto matrix = ResourceManager::getCaptureMatrix(index);
-                m_shaders["ibl_irradiance"]->setUniformValue("uViewProjMatrix", matrix);
-                m_frames["ibl_diffuse"]->attach(GL_COLOR_ATTACHMENT0, m_textures["ibl_diffuse"], 0, index);
-                m_passes["ibl_irradiance"].begin(m_frames["ibl_diffuse"]);
-                draw(cubeLayout, {"skybox.cubemap"}, cubeCount);
-                m_passes["ibl_irradiance"].end();
-            }
+            const auto& skybox  = m_textures["skybox.cubemap"];
+            std::string options = std::format("irradiance_sh-{}x{}-{}", skybox->getWidth(0), skybox->getHeight(0), glMacro2Str(skybox->getInternalFormat()));
+            m_irradianceHash    = hash(sources, inputs);
+            m_irradiancePath    = TextureCache::getCachePath(sources, options, m_irradianceHash).replace_extension(".tgsh");
+            m_irradianceReady   = SphericalHarmonics::load(m_irradiancePath, m_irradianceHash, m_irradiance);
+            if (m_irradianceReady) { std::cout << "Loading irradiance from cache [" << m_irradiancePath << "]\n"; }
         }
 
         // 2.2 Precalculate prefiltered environment map
-        {
+        precompute("ibl_specular", sources, with("ibl_prefiltered"), [&]() {
             m_states["ibl_prefiltered"].apply();
             m_shaders["ibl_prefiltered"]->use();
             for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; face++) {
@@ -703,21 +753,20 @@ void Renderer::prepare(const Scene& scene) {
                     m_passes["ibl_prefiltered"].end();
                 }
             }
-        }
+        });
 
-        // 2.3 Precalculate BRDF LUT
-        {
+        // 2.3 Precalculate BRDF LUT, it does not depend on the skybox
+        precompute("ibl_brdf_lut", {}, {"ibl_brdf_lut"}, [&]() {
             m_states["ibl_brdf_lut"].apply();
             m_shaders["ibl_brdf_lut"]->use();
             m_passes["ibl_brdf_lut"].begin(m_frames["ibl_brdf_lut"]);
             draw(quadLayout, {}, quadCount);
             m_passes["ibl_brdf_lut"].end();
-        }
+        });
 
         // 2.4 Rename the precalculated result
         {
             std::vector<std::pair<std::string, std::string>> name2name = {
-                { "ibl_diffuse",  "ibl_irradiance_map"  },
                 { "ibl_specular", "ibl_prefiltered_map" },
                 { "ibl_brdf_lut", "ibl_brdf_map"    }
             };
@@ -729,9 +778,50 @@ void Renderer::prepare(const Scene& scene) {
     }
 }
 
+void Renderer::precompute(const std::string& name, const std::vector<fs::path>& sources, const std::vector<std::string>& shaders, const std::function<void()>& compute) {
+    // 1. Key the map by the contents of skybox files and shader sources, and by the size and format of its attachment
+    const auto& texture = m_textures[name];
+    uint64_t hash       = this->hash(sources, shaders);
+    std::string options = std::format("{}-{}x{}-{}-{}", name, texture->getWidth(0), texture->getHeight(0), glMacro2Str(texture->getInternalFormat()), texture->getMipLevels());
+    fs::path cachePath  = TextureCache::getCachePath(sources, options, hash);
+
+    // 2. Upload the map cached by an earlier launch into the attachment, otherwise render it and read it back once
+    TextureCache cache(cachePath, hash);
+    if (cache.isValid()) {
+        std::cout << "Loading texture(" << glMacro2Str(cache.getTarget()) << ") from cache [" << cachePath << "] as " << name << "\n";
+        cache.upload(*texture);
+        return;
+    }
+    TextureCache::invalidate(cachePath);
+    compute();
+    TextureCache::save(cachePath, hash, *texture);
+}
+
+uint64_t Renderer::hash(const std::vector<fs::path>& sources, const std::vector<std::string>& shaders) const {
+    uint64_t hash = TextureCache::hash(sources);
+    for (const auto& shader : shaders) {
+        const auto& [vert, frag] = m_shaders.at(shader)->getSource();
+        hash = MappedFile::hash(vert.data(), vert.size(), hash);
+        hash = MappedFile::hash(frag.data(), frag.size(), hash);
+    }
+    return hash;
+}
+
+void Renderer::projectIrradiance() {
+    std::vector<uint8_t> texels;
+    const auto& skybox = m_textures["skybox.cubemap"];
+    skybox->download(texels, 0, GL_RGB, GL_FLOAT); // packed float texels are unpacked by the driver
+    m_irradiance      = SphericalHarmonics::project(reinterpret_cast<const float*>(texels.data()), skybox->getWidth(0));
+    m_irradianceReady = true;
+
+    TextureCache::invalidate(m_irradiancePath);
+    SphericalHarmonics::save(m_irradiancePath, m_irradianceHash, m_irradiance);
+}
+
 void Renderer::update(const Scene& scene, ResourceManager& manager) {
     // 1. Update uniform/shaderstorage buffers with scene data, and bind them to shader binding points
     {
+        MemoryRegistry::Scope scope(MemoryTag::MT_UNIFORM, "scene_blocks");
         // 1.1 Camera uniform block
         const auto& camera = scene.getCamera();
         if (m_buffers["camera"] == nullptr) { m_buffers["camera"] = std::make_shared<UniformBuffer>(sizeof(CameraBlock)); }
@@ -763,6 +853,16 @@ void Renderer::update(const Scene& scene, ResourceManager& manager) {
             m_buffers["light"]->clear(0, maxLightSSBOSize); // reset the light ssbo if no light is rendered
         }
         m_buffers["light"]->bind(0);
+
+        // 1.4 Irradiance uniform block, zeros turn diffuse ibl off. The skybox is read back and projected only once ibl is on
+        IrradianceBlock irradiance{};
+        if (m_setting.ibl && m_textures["skybox.cubemap"] != nullptr) {
+            if (!m_irradianceReady) { projectIrradiance(); }
+            irradiance = m_irradiance;
+        }
+        if (m_buffers["irradiance"] == nullptr) { m_buffers["irradiance"] = std::make_shared<UniformBuffer>(sizeof(IrradianceBlock)); }
+        m_buffers["irradiance"]->upload(0, sizeof(IrradianceBlock), &irradiance);
+        m_buffers["irradiance"]->bind(3);
     }
 
     // 2. Render shadow map and update the light shader storage buffer if needed
@@ -772,8 +872,9 @@ void Renderer::update(const Scene& scene, ResourceManager& manager) {
         std::vector<int> rects;
         std::vector<float> remaps;
         std::vector<RenderItem> items;
-        
-        scene.getRenderQueue(items, true);
+        RenderView view{.culling = false, .lodBias = m_setting.lod ? m_setting.shadowLodBias : -1}; // lights see the whole scene
+
+        scene.getRenderQueue(items, true, true, &view);
         m_frames["shadow"]->divide(rects, remaps, lights.size());
         m_states["shadow_mapping"].apply();
         m_shaders["shadow_mapping"]->use();
@@ -801,17 +902,30 @@ void Renderer::update(const Scene& scene, ResourceManager& manager) {
     // 3. Load precalculated environment map or default white map depending on m_setting.ibl
     if (m_setting.ibl && m_textures["skybox.cubemap"] != nullptr) {
         // only ibl is enabled and skybox is set
-        m_textures["ibl_diffuse"] = m_textures["ibl_irradiance_map"];
         m_textures["ibl_specular"] = m_textures["ibl_prefiltered_map"];
         m_textures["ibl_brdf_lut"] = m_textures["ibl_brdf_map"];
     } else {
         // do not use clear, otherwise the cahced texture in resource manager will be cleared also.
-        m_textures["ibl_diffuse"] = manager.loadCubeTexture("default_black_cube", {}, glm::vec4(0.0f), GL_RGBA32F, 1); 
+        MemoryRegistry::Scope scope(MemoryTag::MT_IBL);
         m_textures["ibl_specular"] = manager.loadCubeTexture("default_black_cube", {}, glm::vec4(0.0f), GL_RGBA32F, 1); 
         m_textures["ibl_brdf_lut"] = manager.load2DTexture("default_black_2d", "", glm::vec4(0.0f), GL_RGBA32F, 1);
     }
 
-    // 4. Load or reset dirt mask
+    // 4. Stream pages of virtual skybox requested by the feedback of last frame, once its read back has landed
+    if (m_virtualSkybox != nullptr) {
+        if (m_feedbackFence != nullptr) {
+            GLenum status = glClientWaitSync(m_feedbackFence, 0, 0); // poll, never block the frame
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+                glDeleteSync(m_feedbackFence);
+                m_feedbackFence = nullptr;
+                auto pages      = m_virtualSkybox->request(m_feedbackData, m_feedbackBuffer->getSize() / 4, VIRTUAL_PAGES_PER_FRAME);
+                manager.streamVirtualTexture("skybox_virtual", m_virtualSkybox, pages);
+            }
+        }
+        m_virtualSkybox->commit(); // pages mapped by loader uploads since last frame
+    }
+
+    // 5. Load or reset dirt mask
     if (m_setting.dirtmask) {
         m_textures["dirtmask"] = manager.load2DTexture("dirtmask", "../asset/static/dirtmask.png", glm::vec4(1.0f), GL_RGBA32F, 1);
     } else {
@@ -822,15 +936,20 @@ void Renderer::update(const Scene& scene, ResourceManager& manager) {
 
 void Renderer::render(const Scene& scene) {
     std::vector<RenderItem> items;
-    scene.getRenderQueue(items, true); // get opaque objects
+    m_view = RenderView{.culling = m_setting.culling, .backface = m_setting.backface, .lodBias = m_setting.lod ? 0 : -1};
+    scene.getRenderQueue(items, true, true, &m_view); // get opaque objects
+    m_states["deferred_geometry"].cullEnable = m_setting.backface ? GL_TRUE : GL_FALSE;
+    m_states["forward_opaque"].cullEnable    = m_setting.backface ? GL_TRUE : GL_FALSE;
 
     if (m_setting.deferred) {
         {
             m_states["deferred_geometry"].apply();
             m_shaders["deferred_geometry"]->use();
             m_passes["deferred_geometry"].begin(m_frames["gbuffer"]);
+            if (m_texturePool) { m_texturePool->bind(m_texture2SlotIndexs["texture_pool.0"]); }
             for (const auto& item : items) {
                 m_buffers["model"]->bind(1, item.uoffset, sizeof(ModelBlock));
+                item.material->bind(2); // material factors and sampled maps
                 draw(item, {"albedo", "normal", "mrao"});
             }
             m_passes["deferred_geometry"].end();
@@ -847,7 +966,7 @@ void Renderer::render(const Scene& scene) {
             m_shaders["deferred_shading"]->use();
             m_shaders["deferred_shading"]->setUniformValue("uLightCount", (int)scene.getVisibleLightCount());
             m_passes["deferred_shading"].begin(m_frames["hdr_screen"]);
-            draw(layout, {"gbuffer.albedo", "gbuffer.normal", "gbuffer.mrao", "shadow", "ibl_diffuse", "ibl_specular", "ibl_brdf_lut"}, count);
+            draw(layout, {"gbuffer.albedo", "gbuffer.normal", "gbuffer.mrao", "shadow", "ibl_specular", "ibl_brdf_lut"}, count);
             m_passes["deferred_shading"].end();
         }
     } else {
@@ -855,10 +974,14 @@ void Renderer::render(const Scene& scene) {
         m_shaders["forward_opaque"]->use();
         m_shaders["forward_opaque"]->setUniformValue("uLightCount", (int)scene.getVisibleLightCount());
         m_passes["forward_opaque"].begin(m_frames["hdr_screen"]);
+        bind({"shadow", "ibl_specular", "ibl_brdf_lut"});
+        if (m_texturePool) { m_texturePool->bind(m_texture2SlotIndexs["texture_pool.0"]); }
         for (const auto& item : items) {
             m_buffers["model"]->bind(1, item.uoffset, sizeof(ModelBlock));
-            draw(item, {"albedo", "normal", "mrao", "shadow", "ibl_diffuse", "ibl_specular", "ibl_brdf_lut"});
+            item.material->bind(2); // material factors and sampled maps
+            draw(item, {"albedo", "normal", "mrao"});
         }
+        unbind({"shadow", "ibl_specular", "ibl_brdf_lut"});
         m_passes["forward_opaque"].end();
     }
 
@@ -871,13 +994,43 @@ void Renderer::render(const Scene& scene) {
         m_passes["skybox_mapping"].begin(m_frames["hdr_screen"]);
         draw(layout, {"skybox.cubemap"}, count);
         m_passes["skybox_mapping"].end();
+    } else if (m_virtualSkybox != nullptr) {
+        GLsizei count = ResourceManager::getCount("cube");
+        auto& layout  = ResourceManager::getLayout("cube");
+
+        m_states["skybox_mapping"].apply();
+        m_shaders["skybox_virtual"]->use();
+        m_passes["skybox_mapping"].begin(m_frames["hdr_screen"]);
+        draw(layout, {"vt.page_table", "vt.atlas"}, count);
+        m_passes["skybox_mapping"].end();
+
+        // Record the pages sampled from the skybox into a small target, and copy it into a pixel pack buffer read back next frame
+        // Geometry does not occlude the feedback, pages behind models are requested as well
+        if (m_feedbackFence == nullptr) {
+            m_states["skybox_virtual_feedback"].apply();
+            m_shaders["skybox_virtual_feedback"]->use();
+            m_passes["skybox_virtual_feedback"].begin(m_frames["vt_feedback"]);
+            draw(layout, {}, count);
+            m_passes["skybox_virtual_feedback"].end();
+
+            const auto& feedback = m_textures["vt_feedback"];
+            if (m_feedbackBuffer == nullptr) {
+                GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                MemoryRegistry::Scope scope(MemoryTag::MT_STAGING, "vt_feedback");
+                m_feedbackBuffer = std::make_unique<GraphicBuffer>(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(feedback->getLevelSize(0)), nullptr, flags);
+                m_feedbackData   = static_cast<const uint8_t*>(glMapNamedBufferRange(m_feedbackBuffer->getID(), 0, m_feedbackBuffer->getSize(), flags));
+            }
+            feedback->download(*m_feedbackBuffer, 0, 0);
+            m_feedbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
     }
 
     // TODO: screen space reflection
     if (m_setting.ssr) {}
 
     if (m_setting.ssrefr) {
-        scene.getRenderQueue(items, false); // get transparent objects
+        m_view.backface = false; // both sides of transparent objects are visible
+        scene.getRenderQueue(items, false, true, &m_view); // get transparent objects
 
         {
             m_frames["hdr_screen_ss"]->copy(*m_frames["hdr_screen"], GL_COLOR_BUFFER_BIT); // copy hdr_screen.color
@@ -888,10 +1041,14 @@ void Renderer::render(const Scene& scene) {
         m_shaders["forward_transparent"]->use();
         m_shaders["forward_transparent"]->setUniformValue("uLightCount", (int)scene.getVisibleLightCount());
         m_passes["forward_transparent"].begin(m_frames["hdr_screen_ss"]);
-        for (const auto& item : items) {            
+        bind({"shadow", "ibl_specular", "ibl_brdf_lut", "hdr_screen.color", "hdr_screen.depth"});
+        if (m_texturePool) { m_texturePool->bind(m_texture2SlotIndexs["texture_pool.0"]); }
+        for (const auto& item : items) {
             m_buffers["model"]->bind(1, item.uoffset, sizeof(ModelBlock));
-            draw(item, {"albedo", "normal", "mrao", "shadow", "ibl_diffuse", "ibl_specular", "ibl_brdf_lut", "hdr_screen.color", "hdr_screen.depth"});
+            item.material->bind(2); // material factors and sampled maps
+            draw(item, {"albedo", "normal", "mrao"});
         }
+        unbind({"shadow", "ibl_specular", "ibl_brdf_lut", "hdr_screen.color", "hdr_screen.depth"});
         m_passes["forward_transparent"].end();
 
         {
@@ -1042,34 +1199,65 @@ void Renderer::render(const Scene& scene) {
     }
 }
 
+void Renderer::bind(const std::vector<std::string>& textures) {
+    for (auto name : textures) {
+        if (m_texture2SlotIndexs.count(name) == 0) { throw std::runtime_error("Renderer::bind: Texture slot index not found: " + name); }
+        if (m_textures.count(name) == 0 || m_textures.at(name) == nullptr) { throw std::runtime_error("Renderer::bind: Texture not found: " + name); }
+        m_textures[name]->bind(m_texture2SlotIndexs[name]);
+    }
+}
+
+void Renderer::unbind(const std::vector<std::string>& textures) {
+    for (auto name : textures) { m_textures[name]->unbind(m_texture2SlotIndexs[name]); }
+}
+
 void Renderer::draw(const RenderItem& item, const std::vector<std::string>& textures) {
     const std::shared_ptr<VertexLayout>& layout  = item.mesh->getVertexLayout();
     const std::unique_ptr<VertexBuffer>& bufferv = item.mesh->getVertexBuffer();
     const std::unique_ptr<IndexBuffer>& bufferi  = item.mesh->getIndexBuffer();
 
-    for (auto name : textures) {
+    // Maps in texture pool are sampled from the arrays bound by the pass, only the others are bound per draw
+    auto lookup = [&](const std::string& name) -> std::shared_ptr<Texture> {
         if (m_texture2SlotIndexs.count(name) == 0) { throw std::runtime_error("Renderer::draw: Texture slot index not found: " + name); }
         if (item.material == nullptr) { throw std::runtime_error("Renderer::draw: Invalid render item material!"); }
+        if (item.material->getLayer(name) != nullptr) { return nullptr; }
         if (item.material->getTexture(name) == nullptr && (m_textures.count(name) == 0 || m_textures.at(name) == nullptr)) { throw std::runtime_error("Renderer::draw: Texture not found: " + name); }
-        std::shared_ptr<Texture> texture = item.material->getTexture(name) != nullptr ? item.material->getTexture(name) : m_textures[name];
-        texture->bind(m_texture2SlotIndexs[name]);
+        return item.material->getTexture(name) != nullptr ? item.material->getTexture(name) : m_textures[name];
+    };
+    for (auto name : textures) {
+        if (auto texture = lookup(name)) { texture->bind(m_texture2SlotIndexs[name]); }
     }
 
     layout->bind();
-    if (!layout->attach(0, bufferv, 0, sizeof(Vertex))) { //! WARNING: slot 0 and stride sizeof(Vertex) are hardcoded since all meshes share the same vertex format, but can be easily extended in the future if needed
-        return;
+    const std::vector<MeshStream>& streams = item.mesh->getStreams();
+    for (GLuint slot = 0; slot < streams.size(); slot++) { // interleaved formats bind slot 0 only, glTF streams bind a slot per attribute
+        if (!layout->attach(slot, bufferv, streams[slot].offset, streams[slot].stride)) { return; }
     }
     if (layout->attach(bufferi)) {
         // std::cout << "Mesh IBO Draw: index count " << item.length << " offset " << item.ioffset << std::endl;
-        // !WARNING: The last parameter is the index buffer offset in bytes.
-        glDrawElements(GL_TRIANGLES, item.length, GL_UNSIGNED_INT, (void*)(sizeof(GLuint) * item.ioffset));
+        // !WARNING: The fourth parameter is the index buffer offset in bytes, submeshes may mix 16 and 32 bits indices.
+        if (item.ranges.empty()) {
+            glDrawElementsBaseVertex(GL_TRIANGLES, item.length, item.itype, (void*)(uintptr_t)item.ioffset, item.ibase);
+        } else {
+            // surviving clusters of a submesh are submitted as one multi draw
+            std::vector<GLsizei> counts;
+            std::vector<const void*> offsets;
+            std::vector<GLint> bases(item.ranges.size(), static_cast<GLint>(item.ibase));
+            for (auto& [offset, length] : item.ranges) {
+                counts.push_back(static_cast<GLsizei>(length));
+                offsets.push_back((void*)(uintptr_t)offset);
+            }
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), item.itype, offsets.data(), static_cast<GLsizei>(item.ranges.size()), bases.data());
+        }
     } else {
         // std::cout << "Mesh VBO Draw: vertex count " << item.length << " offset " << item.ioffset << std::endl;
         // !WARNING: The second parameter is vertex offset in vertex count, not bytes.
         glDrawArrays(GL_TRIANGLES, item.ioffset, item.length);
     }
 
-    for (auto name : textures) { m_textures[name]->unbind(m_texture2SlotIndexs[name]); }
+    for (auto name : textures) {
+        if (auto texture = lookup(name)) { texture->unbind(m_texture2SlotIndexs[name]); }
+    }
 
     m_drawCall++;
     return;
@@ -1077,14 +1265,10 @@ void Renderer::draw(const RenderItem& item, const std::vector<std::string>& text
 
 void Renderer::draw(const std::shared_ptr<VertexLayout>& layout, const std::vector<std::string>& textures, GLsizei count) {
     layout->bind();
-    for (auto name : textures) {
-        if (m_texture2SlotIndexs.count(name) == 0) { throw std::runtime_error("Renderer::draw: Texture slot index not found: " + name); }
-        if (m_textures.count(name) == 0) { throw std::runtime_error("Renderer::draw: Texture not found: " + name); }
-        m_textures[name]->bind(m_texture2SlotIndexs[name]);
-    }
+    bind(textures);
     // std::cout << "Quad/Skybox VBO Draw: vertex count " << count << std::endl;
     glDrawArrays(GL_TRIANGLES, 0, count);
-    for (auto name : textures) { m_textures[name]->unbind(m_texture2SlotIndexs[name]); }
+    unbind(textures);
 
     m_drawCall++;
     return;
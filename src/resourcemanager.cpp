@@ -1,9 +1,15 @@
 #include "resourcemanager.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 #include <stdexcept>
 #include <format>
 
+#include "memoryregistry.hpp"
+#include "objparser.hpp"
 #include "utils.hpp"
 
 namespace tinyglrenderer {
@@ -15,6 +21,28 @@ std::unordered_map<std::string, std::shared_ptr<VertexLayout>> ResourceManager::
 std::unordered_map<std::string, std::unique_ptr<VertexBuffer>> ResourceManager::m_buffers;
 std::array<glm::mat4, 6> ResourceManager::m_matrixs;
 
+// Float texels bound for shared exponent or half float storage are converted on the CPU, uploads then copy 4(or 6/8) bytes per texel
+// instead of 12/16 and the driver does not convert them on the GL thread
+static std::shared_ptr<Image> convertHDR(const std::shared_ptr<Image>& image, GLenum internalFormat) {
+    GLenum type = Texture::getPixelFormat(internalFormat).second;
+    if (image->getDataType() != GL_FLOAT || (type != GL_UNSIGNED_INT_5_9_9_9_REV && type != GL_HALF_FLOAT)) { return image; }
+    return Image::convert(image, type);
+}
+
+// Create 2d texture from levels staged in one region, the region is fenced and returns to the ring once the GPU has copied it
+static std::shared_ptr<Texture> createTexture(StagingBuffer& staging, const StagingBuffer::Region& region, GLsizei width, GLsizei height, GLenum internalFormat, const std::vector<size_t>& sizes) {
+    auto texture = std::make_shared<Texture>(width, height, GL_TEXTURE_2D, internalFormat, static_cast<GLsizei>(sizes.size()));
+    for (GLint level = 0; level < static_cast<GLint>(sizes.size()); level++) { texture->upload(staging, region.getChunkOffsets()[level], sizes[level], level); }
+    staging.fence(region);
+    return texture;
+}
+
+// Size of the staging ring, large enough for a few 4K textures with mips in flight, larger payloads upload from client memory
+static constexpr GLsizeiptr STAGING_BUFFER_SIZE = 64 << 20;
+static constexpr size_t TEXTURE_BUDGET            = size_t(2) << 30; // default video memory budget of textures
+static constexpr uint64_t TEXTURE_BUDGET_INTERVAL = 30;              // frames between budget checks
+static constexpr GLsizei TEXTURE_TRIM_MIN_SIZE    = 64;              // textures are not trimmed below this size on the shorter side
+
 void ResourceManager::initialize() {
     // 1. Define vertex layouts
     m_layouts["mesh"] = std::make_shared<VertexLayout>();
@@ -39,7 +67,7 @@ void ResourceManager::initialize() {
         },
         VertexAttribute{
             .location   = 2,
-            .size       = 3,
+            .size       = 4,
             .type       = GL_FLOAT,
             .offset     = offsetof(Vertex, tangent),
             .normalized = GL_TRUE,
@@ -57,6 +85,87 @@ void ResourceManager::initialize() {
         },
     });
 
+    m_layouts["mesh_packed"] = std::make_shared<VertexLayout>();
+    m_layouts["mesh_packed"]->initialize({
+        VertexAttribute{
+            .location   = 0,
+            .size       = 4,
+            .type       = GL_UNSIGNED_SHORT,
+            .offset     = offsetof(PackedVertex, position),
+            .normalized = GL_TRUE,
+            .stride     = sizeof(PackedVertex),
+            .slot       = 0,
+        },
+        VertexAttribute{
+            .location   = 1,
+            .size       = 2,
+            .type       = GL_SHORT,
+            .offset     = offsetof(PackedVertex, normal),
+            .normalized = GL_TRUE,
+            .stride     = sizeof(PackedVertex),
+            .slot       = 0,
+        },
+        VertexAttribute{
+            .location   = 2,
+            .size       = 2,
+            .type       = GL_SHORT,
+            .offset     = offsetof(PackedVertex, tangent),
+            .normalized = GL_TRUE,
+            .stride     = sizeof(PackedVertex),
+            .slot       = 0,
+        },
+        VertexAttribute{
+            .location   = 3,
+            .size       = 2,
+            .type       = GL_HALF_FLOAT,
+            .offset     = offsetof(PackedVertex, texcoord),
+            .normalized = GL_FALSE,
+            .stride     = sizeof(PackedVertex),
+            .slot       = 0,
+        },
+    });
+
+    // glTF streams, every attribute reads its own range of the vertex buffer(see Mesh::getStreams)
+    m_layouts["mesh_streams"] = std::make_shared<VertexLayout>();
+    m_layouts["mesh_streams"]->initialize({
+        VertexAttribute{
+            .location   = 0,
+            .size       = 3,
+            .type       = GL_FLOAT,
+            .offset     = 0,
+            .normalized = GL_FALSE,
+            .stride     = sizeof(glm::vec3),
+            .slot       = 0,
+        },
+        VertexAttribute{
+            .location   = 1,
+            .size       = 3,
+            .type       = GL_FLOAT,
+            .offset     = 0,
+            .normalized = GL_FALSE,
+            .stride     = sizeof(glm::vec3),
+            .slot       = 1,
+        },
+        VertexAttribute{
+            .location   = 2,
+            .size       = 4,
+            .type       = GL_FLOAT,
+            .offset     = 0,
+            .normalized = GL_FALSE,
+            .stride     = sizeof(glm::vec4),
+            .slot       = 2,
+        },
+        VertexAttribute{
+            .location   = 3,
+            .size       = 2,
+            .type       = GL_FLOAT,
+            .offset     = 0,
+            .normalized = GL_FALSE,
+            .stride     = sizeof(glm::vec2),
+            .slot       = 3,
+        },
+    });
+
     m_layouts["quad"] = std::make_shared<VertexLayout>();
     m_layouts["quad"]->initialize({
         VertexAttribute{
@@ -102,6 +211,7 @@ void ResourceManager::initialize() {
         {1.0f, -1.0f, 1.0f, 0.0f},
         {1.0f, 1.0f, 1.0f, 1.0f},
     };
+    MemoryRegistry::Scope scope(MemoryTag::MT_MESH, "static_shapes");
     m_buffers["quad"] = std::make_unique<VertexBuffer>(sizeof(quad), quad);
 
     float cube[][18] = {
@@ -135,17 +245,166 @@ void ResourceManager::initialize() {
         int index        = face - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
         m_matrixs[index] = projMatrix * viewMatrixs[index];
     }
+
+    // 6. Map the staging ring of asynchronous texture uploads
+    {
+        MemoryRegistry::Scope scope(MemoryTag::MT_STAGING, "texture_staging");
+        m_staging = std::make_unique<StagingBuffer>(STAGING_BUFFER_SIZE);
+    }
+
+    // 7. Create the texture pool of material textures, and set the default budget of texture memory
+    m_texturePool             = std::make_shared<TexturePool>();
+    m_textureResidency.budget = TEXTURE_BUDGET;
 }
 
 void ResourceManager::destroy() {
+    // Regions held by running tasks are dropped with their uploads, the ring is unmapped after the loader settles
+    m_loader.cancel();
+    while (!m_loader.isIdle()) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+    for (auto& readback : m_readbacks) {
+        if (readback->fence != nullptr) { glDeleteSync(readback->fence); }
+        glUnmapNamedBuffer(readback->buffer->getID());
+        readback->buffer.reset();
+    }
+    m_readbacks.clear();
+    m_staging.reset();
+    m_texturePool.reset();
+    m_pendingTextures.clear();
     m_layouts.clear();
     m_buffers.clear();
     m_materials.clear();
     m_meshes.clear();
     m_textures.clear();
+    m_virtualTextures.clear();
     m_images.clear();
 }
 
+void ResourceManager::update(float budget) {
+    m_staging->retire(); // regions copied by the GPU make room for workers before more uploads are issued
+    m_loader.drain(budget);
+
+    // Cook the levels read back in earlier frames once their copies landed, and release the buffers of cooked ones
+    for (auto it = m_readbacks.begin(); it != m_readbacks.end();) {
+        auto readback = *it;
+        if (readback->cooked) {
+            glUnmapNamedBuffer(readback->buffer->getID());
+            readback->buffer.reset();
+            it = m_readbacks.erase(it);
+            continue;
+        }
+        if (readback->fence != nullptr) {
+            GLenum status = glClientWaitSync(readback->fence, 0, 0); // poll, never block the frame
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+                glDeleteSync(readback->fence);
+                readback->fence = nullptr;
+                m_loader.submit(readback->name + "(cook)", [readback]() -> AsyncLoader::Upload {
+                    std::vector<std::span<const uint8_t>> levels;
+                    for (size_t level = 0, offset = 0; level < readback->sizes.size(); offset += readback->sizes[level++]) { levels.emplace_back(readback->data + offset, readback->sizes[level]); }
+                    TextureCache::save(readback->cachePath, readback->hash, readback->internalFormat, readback->width, readback->height, levels);
+                    readback->cooked = true;
+                    return nullptr;
+                }, [readback](const std::string&) { readback->cooked = true; });
+            }
+        }
+        ++it;
+    }
+
+    // Textures bound from now on record the next frame, the memory budget is checked every few frames
+    Texture::tick();
+    if (Texture::getFrame() % TEXTURE_BUDGET_INTERVAL == 0) { trimTextures(); }
+}
+
+void ResourceManager::readbackTexture(const std::string& texName, const Texture& texture, const fs::path& cachePath, uint64_t hash) {
+    auto readback            = std::make_shared<TextureReadback>();
+    readback->name           = texName;
+    readback->cachePath      = cachePath;
+    readback->hash           = hash;
+    readback->internalFormat = texture.getInternalFormat();
+    readback->width          = texture.getWidth(0);
+    readback->height         = texture.getHeight(0);
+
+    size_t bytes = 0;
+    for (GLint level = 0; level < texture.getMipLevels(); level++) {
+        readback->sizes.push_back(texture.getLevelSize(level));
+        bytes += readback->sizes.back();
+    }
+    {
+        GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        MemoryRegistry::Scope scope(MemoryTag::MT_STAGING, texName + "(readback)");
+        readback->buffer = std::make_unique<GraphicBuffer>(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, flags);
+        readback->data   = static_cast<const uint8_t*>(glMapNamedBufferRange(readback->buffer->getID(), 0, readback->buffer->getSize(), flags));
+    }
+
+    // The copies are queued behind the mip generation, the fence tells update() when they landed
+    size_t offset = 0;
+    for (GLint level = 0; level < texture.getMipLevels(); level++) {
+        texture.download(*readback->buffer, static_cast<GLintptr>(offset), level);
+        offset += readback->sizes[level];
+    }
+    readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_readbacks.push_back(readback);
+}
+
+void ResourceManager::trimTextures() {
+    // 1. Account every live texture once(names may alias one texture), 2d textures with mips above the floor size may be trimmed
+    // Pages of virtual textures are accounted only, their page table and atlas keep their layout
+    std::vector<std::shared_ptr<Texture>> candidates;
+    auto measure = [&]() {
+        std::unordered_set<const Texture*> seen;
+        size_t used = 0;
+        candidates.clear();
+        auto account = [&](const std::shared_ptr<Texture>& texture, bool trimmable) {
+            if (texture == nullptr || !seen.insert(texture.get()).second) { return; }
+            used += texture->getByteSize();
+            bool flat = texture->getTarget() == GL_TEXTURE_2D || texture->getTarget() == GL_TEXTURE_2D_ARRAY;
+            if (trimmable && flat && texture->getMipLevels() > 1 && std::min(texture->getWidth(1), texture->getHeight(1)) >= TEXTURE_TRIM_MIN_SIZE) { candidates.push_back(texture); }
+        };
+        for (auto it = m_textures.begin(); it != m_textures.end();) {
+            if (it->second.expired()) {
+                it = m_textures.erase(it); // names of released textures
+                continue;
+            }
+            account(it->second.lock(), true);
+            it++;
+        }
+        std::vector<std::shared_ptr<Texture>> arrays;
+        if (m_texturePool) { m_texturePool->getArrays(arrays); }
+        for (auto& array : arrays) { account(array, true); }
+        for (auto& [name, weak] : m_virtualTextures) {
+            if (auto texture = weak.lock()) {
+                account(texture->getPageTable(), false);
+                account(texture->getAtlas(), false);
+            }
+        }
+        return used;
+    };
+    size_t used   = measure();
+    size_t budget = m_textureResidency.budget;
+    if (budget == 0 || used <= budget) {
+        m_textureResidency.used = used;
+        return;
+    }
+
+    // 2. Release layers no material samples anymore, the arrays shrink without touching live layers
+    size_t released = m_texturePool ? m_texturePool->compact() : 0;
+    if (released > 0) {
+        m_textureResidency.evictions += released;
+        used = measure();
+    }
+
+    // 3. Drop the top mip of least recently bound textures until within budget, each drop releases about 3/4 of a texture
+    // One level per texture and check, textures keep shrinking over later checks while the pressure lasts
+    std::sort(candidates.begin(), candidates.end(), [](const std::shared_ptr<Texture>& a, const std::shared_ptr<Texture>& b) { return a->getLastUsed() < b->getLastUsed(); });
+    for (auto& texture : candidates) {
+        if (used <= budget) { break; }
+        size_t bytes = texture->getByteSize();
+        texture->trim(1);
+        used -= bytes - texture->getByteSize();
+        m_textureResidency.trims++;
+    }
+    m_textureResidency.used = used;
+}
+
 const GLsizei& ResourceManager::getCount(const std::string& name) {
     if (!m_counts.count(name)) { throw std::runtime_error("ResourceManager::getCount: Vertex count for " + name + " not found in ResourceManager"); }
     return m_counts.at(name);
@@ -210,76 +469,174 @@ void ResourceManager::getAllShaderNames(std::vector<std::string>& names) const {
     }
 }
 
-std::shared_ptr<Model> ResourceManager::loadModel(const std::string& modelName, const fs::path& objPath, const fs::path& mtlDir) {
-    // 1. Load obj model with tinyobj loader
-    tinyobj::attrib_t attributes;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string err;
-    if (!tinyobj::LoadObj(&attributes, &shapes, &materials, &err, objPath.c_str(), mtlDir.c_str(), true)) {
-        throw std::runtime_error("ResourceManager::loadModel: " + err);
-    }
+std::shared_ptr<Model> ResourceManager::loadModel(const std::string& modelName, const fs::path& objPath, const fs::path& mtlDir, const MeshOptions& options) {
+    auto model = std::make_shared<Model>(modelName, nullptr, std::vector<std::shared_ptr<Material>>{});
+    bool gltf  = GltfParser::isGltf(objPath);
+    std::string meshName = objPath.stem().string() + (gltf ? "_gltf" : "") + options.getKey();
+
+    m_loader.submit(meshName, [this, weak = std::weak_ptr<Model>(model), meshName, objPath, mtlDir, options, gltf]() -> AsyncLoader::Upload {
+        // 1. glTF buffers laid out as vertex streams are drawn as they are, meshes cooked with any option go through the cache
+        auto materials = std::make_shared<std::vector<tinyobj::material_t>>();
+        fs::path texDir = gltf ? objPath.parent_path() : mtlDir;
+        std::shared_ptr<GltfParser> parser;
+        std::shared_ptr<MeshCache> cache;
+        std::shared_ptr<MeshData> data;
+        auto start = std::chrono::steady_clock::now();
+        if (gltf) {
+            parser     = std::make_shared<GltfParser>(objPath);
+            *materials = parser->getMaterials();
+        }
+        auto log = [&]() {
+            double seconds   = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            double megabytes = static_cast<double>(parser ? parser->getSize() : fs::file_size(objPath)) / (1024.0 * 1024.0);
+            std::cout << "Loading mesh [" << objPath << "] " << std::format("({:.2f} MB in {:.1f} ms, {:.1f} MB/s)", megabytes, seconds * 1000.0, megabytes / seconds) << "\n";
+        };
+
+        if (parser && parser->isDirect() && options.getKey().empty()) {
+            log();
+        } else {
+            // 2. Load cooked mesh from cache if it is up to date with source files, meshes cooked with different options are cached apart
+            uint64_t hash = parser ? parser->hash() : MeshCache::hash(objPath, mtlDir);
+            cache = std::make_shared<MeshCache>(MeshCache::getCachePath(objPath, options), objPath, hash, options);
+            if (cache->isValid()) {
+                std::cout << "Loading mesh from cache [" << cache->getFilePath() << "]\n";
+                *materials = cache->getMaterials();
+            } else {
+                // 3. Otherwise parse obj model with parallel obj parser(or convert glTF primitives), cook mesh from tinyobj shapes and save it into cache
+                tinyobj::attrib_t attributes;
+                std::vector<tinyobj::shape_t> shapes;
+                std::string err;
+                if (!parser) { start = std::chrono::steady_clock::now(); } // the obj hash is not part of parsing
+                if (parser) {
+                    parser->load(&attributes, &shapes);
+                } else if (!ObjParser::load(&attributes, &shapes, materials.get(), &err, objPath, mtlDir)) {
+                    throw std::runtime_error("ResourceManager::loadModel: " + err);
+                }
+                log();
+                data = std::make_shared<MeshData>(Mesh::cook(attributes, shapes, materials->size(), options));
+                MeshCache::save(cache->getFilePath(), objPath, hash, options, *data, *materials);
+                cache.reset();
+            }
+            parser.reset(); // unmap glTF buffers early
+        }
+
+        // 4. Create mesh on GL thread and convert tinyobj material into self-defined material
+        return [this, weak, meshName, objPath, texDir, parser, cache, data, materials]() {
+            auto model = weak.lock();
+            if (!model) { return; } // scene is gone
+
+            std::shared_ptr<Mesh> mesh = parser ? loadMesh(meshName, *parser) : cache ? loadMesh(meshName, *cache) : loadMesh(meshName, objPath, *data);
+            std::cout << "Loading materials [";
+            std::vector<std::shared_ptr<Material>> nmaterials;
+            for (auto& material : *materials) {
+                std::cout << material.name << ", ";
+                nmaterials.push_back(loadMaterial(material.name, texDir, material));
+            }
+            std::cout << "]\n";
+            model->setMesh(mesh, nmaterials);
+        };
+    });
 
-    // 2. Create mesh from tinyobj shapes
-    std::cout << "Loading mesh [" << objPath << "]\n";
-    std::shared_ptr<Mesh> mesh = loadMesh(objPath.stem().string(), objPath, attributes, shapes, materials.size());
+    return model;
+}
 
-    // 3. Convert tinyobj material into self-defined material
-    std::cout << "Loading materials [";
-    std::vector<std::shared_ptr<Material>> nmaterials;
-    for (auto& material : materials) {
-        std::cout << material.name << ", ";
-        nmaterials.push_back(loadMaterial(material.name, mtlDir, material));
+std::shared_ptr<Mesh> ResourceManager::loadMesh(const std::string& meshName, const fs::path& meshPath, const MeshData& data) {
+    if (m_meshes.count(meshName) && !m_meshes[meshName].expired()) {
+        return m_meshes[meshName].lock();
     }
-    std::cout << "]\n";
 
-    return make_shared<Model>(modelName, mesh, nmaterials);
+    MemoryRegistry::Scope scope(MemoryTag::MT_MESH, meshName);
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(meshPath, data);
+    m_meshes[meshName] = mesh;
+    
+    return mesh;
 }
 
-std::shared_ptr<Mesh> ResourceManager::loadMesh(const std::string& meshName, const fs::path& meshPath, const tinyobj::attrib_t& attributes, const std::vector<tinyobj::shape_t>& shapes, size_t num) {
+std::shared_ptr<Mesh> ResourceManager::loadMesh(const std::string& meshName, const MeshCache& cache) {
     if (m_meshes.count(meshName) && !m_meshes[meshName].expired()) {
         return m_meshes[meshName].lock();
     }
 
-    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(meshPath, attributes, shapes, num);
+    MemoryRegistry::Scope scope(MemoryTag::MT_MESH, meshName);
+    std::shared_ptr<Mesh> mesh = cache.createMesh();
     m_meshes[meshName] = mesh;
     
     return mesh;
 }
 
+std::shared_ptr<Mesh> ResourceManager::loadMesh(const std::string& meshName, const GltfParser& parser) {
+    if (m_meshes.count(meshName) && !m_meshes[meshName].expired()) {
+        return m_meshes[meshName].lock();
+    }
+
+    MemoryRegistry::Scope scope(MemoryTag::MT_MESH, meshName);
+    std::shared_ptr<Mesh> mesh = parser.createMesh();
+    m_meshes[meshName] = mesh;
+
+    return mesh;
+}
+
 std::shared_ptr<Material> ResourceManager::loadMaterial(const std::string& matName, const fs::path& matDir, const tinyobj::material_t& material) {
     if (m_materials.count(matName) && !m_materials[matName].expired()) {
         return m_materials[matName].lock();
     }
 
-    glm::vec4 albedo = glm::vec4(material.diffuse[0], material.diffuse[1], material.diffuse[2], 1.0f);
-    glm::vec4 normal = glm::vec4(0.5f, 0.5f, 1.0f, 1.f);
-    glm::vec4 mrao = glm::vec4(material.metallic, material.roughness, 0.f, 1.f);
-
-    std::unordered_map<std::string, std::shared_ptr<Texture>> textures = {
-        // TODO: fix mip level(when miplevel is more than 1, the render result is wrong, blocking artifacts appear)
-        {"albedo", load2DTexture(std::format("{}_albedo", matName), matDir / material.diffuse_texname, albedo, GL_RGBA32F)},   
-        {"normal", load2DTexture(std::format("{}_normal", matName), matDir / material.normal_texname, normal, GL_RGBA32F)}, 
-        {"mrao", load2DTexture(std::format("{}_mrao", matName), {matDir / material.metallic_texname, matDir / material.roughness_texname, matDir / material.ambient_texname}, mrao, GL_RGBA32F, 1, 1)}
+    MemoryRegistry::Scope scope(MemoryTag::MT_MATERIAL, matName);
+
+    // Textures are decoded asynchronously, the material starts with its factors and samples decoded textures once they are uploaded
+    // Maps without texture are bound to a shared 1x1 texture which shaders never fetch(see Material)
+    auto fallback  = load2DTexture("default_material_2d", fs::path(), glm::vec4(1.f), GL_RGBA8, 1);
+    auto nmaterial = std::make_shared<Material>(matName, material.dissolve, std::unordered_map<std::string, std::shared_ptr<Texture>>{});
+    nmaterial->setFactors(glm::vec3(material.diffuse[0], material.diffuse[1], material.diffuse[2]), material.metallic, material.roughness);
+    // Uploaded textures are copied into the texture pool so passes bind them once, those it can not take are bound per draw
+    auto assign = [pool = m_texturePool](Material& material, const std::string& name, const std::shared_ptr<Texture>& texture) {
+        MemoryRegistry::Scope scope(MemoryTag::MT_MATERIAL, "texture_pool");
+        auto layer = pool ? pool->add(*texture) : nullptr;
+        if (layer) {
+            material.setLayer(name, layer);
+        } else {
+            material.setTexture(name, texture);
+        }
     };
-    auto nmaterial = std::make_shared<Material>(matName, material.dissolve, textures);
+    auto bind = [weak = std::weak_ptr<Material>(nmaterial), assign](const std::string& name) {
+        return [weak, name, assign](const std::shared_ptr<Texture>& texture) { if (auto material = weak.lock()) { assign(*material, name, texture); } };
+    };
+    auto attach = [&](const std::string& name, const std::shared_ptr<Texture>& texture) {
+        if (texture) {
+            assign(*nmaterial, name, texture);
+        } else {
+            nmaterial->setTexture(name, fallback, false);
+        }
+    };
+    attach("albedo", load2DTextureAsync(std::format("{}_albedo", matName), {matDir / material.diffuse_texname}, TextureUsage::TU_COLOR, 0, bind("albedo")));
+    attach("normal", load2DTextureAsync(std::format("{}_normal", matName), {matDir / material.normal_texname}, TextureUsage::TU_NORMAL, 0, bind("normal")));
+    if (!material.metallic_texname.empty() && material.metallic_texname == material.roughness_texname) {
+        // glTF packs metallic into B and roughness into G of one texture, occlusion is R of its own(or the same) texture and stays 1 if absent
+        std::vector<fs::path> paths = {matDir / material.metallic_texname, matDir / material.roughness_texname};
+        if (!material.ambient_texname.empty()) { paths.push_back(matDir / material.ambient_texname); }
+        attach("mrao", load2DTextureAsync(std::format("{}_mrao", matName), paths, TextureUsage::TU_DATA, 4, bind("mrao"), {2, 1, 0}));
+    } else {
+        attach("mrao", load2DTextureAsync(std::format("{}_mrao", matName), {matDir / material.metallic_texname, matDir / material.roughness_texname, matDir / material.ambient_texname}, TextureUsage::TU_DATA, 1, bind("mrao")));
+    }
     m_materials[matName] = nmaterial;
 
     return nmaterial;
 }
 
 std::shared_ptr<Texture> ResourceManager::load2DTexture(const std::string& texName, const fs::path& texPath, const glm::vec4& defaultValue, GLenum internalFormat, GLsizei mipLevels, int desiredChannels, bool verticalFlip) {
-    std::string texAlias = std::format("default_2d_tex_color({:.3f}, {:.3f}, {:.3f}, {:.3f})", defaultValue.x, defaultValue.y, defaultValue.z, defaultValue.w);
+    std::string texAlias = std::format("default_2d_tex_color({:.3f}, {:.3f}, {:.3f}, {:.3f})_{}", defaultValue.x, defaultValue.y, defaultValue.z, defaultValue.w, glMacro2Str(internalFormat));
     if (m_textures.count(texName) && !m_textures[texName].expired()) {
         return m_textures[texName].lock();
     }
+    MemoryRegistry::Scope scope(texName); // tagged by the caller, e.g. skybox or ibl
     
     std::shared_ptr<Texture> texture;
     if (fs::is_regular_file(texPath)) {
         std::cout << "Loading texture(GL_TEXTURE_2D) from file [" << texPath << "]\n";
         std::shared_ptr<Image> image = loadImage(texName, texPath, desiredChannels, verticalFlip);
         texture = std::make_shared<Texture>(image->getWidth(), image->getHeight(), GL_TEXTURE_2D, internalFormat, mipLevels);
-        texture->upload(image);
+        texture->upload(convertHDR(image, internalFormat));
+        texture->generate();
     } else {
         if (m_textures.count(texAlias) && !m_textures[texAlias].expired()) {
             m_textures[texName] = m_textures[texAlias];
@@ -287,7 +644,7 @@ std::shared_ptr<Texture> ResourceManager::load2DTexture(const std::string& texNa
         }
 
         std::cout << "Loading texture(GL_TEXTURE_2D) from value [" << defaultValue << "]\n";
-        texture = std::make_shared<Texture>(m_textureDefaultWidth, m_textureDefaultHeight, GL_TEXTURE_2D, internalFormat, mipLevels);
+        texture = std::make_shared<Texture>(m_textureDefaultWidth, m_textureDefaultHeight, GL_TEXTURE_2D, internalFormat, std::min(mipLevels, Texture::getMaxMipLevels(m_textureDefaultWidth, m_textureDefaultHeight)));
         texture->clear(glm::value_ptr(defaultValue), GL_RGBA, GL_FLOAT); // GL_RGBA and GL_FLOAT indicate the format of defaultValue is RGBA float
         m_textures[texAlias] = texture;
     }
@@ -306,24 +663,22 @@ bool is_all_regular_file(const std::vector<fs::path>& paths) {
 }
 
 std::shared_ptr<Texture> ResourceManager::load2DTexture(const std::string& texName, const std::vector<fs::path>& texPaths, const glm::vec4& defaultValue, GLenum internalFormat, GLsizei mipLevels, int desiredChannels, bool verticalFlip) {
-    std::string texAlias = std::format("default_2d_tex_color({:.3f}, {:.3f}, {:.3f}, {:.3f})", defaultValue.x, defaultValue.y, defaultValue.z, defaultValue.w);
+    std::string texAlias = std::format("default_2d_tex_color({:.3f}, {:.3f}, {:.3f}, {:.3f})_{}", defaultValue.x, defaultValue.y, defaultValue.z, defaultValue.w, glMacro2Str(internalFormat));
     if (m_textures.count(texName) && !m_textures[texName].expired()) {
         return m_textures[texName].lock();
     }
+    MemoryRegistry::Scope scope(texName); // tagged by the caller, e.g. skybox or ibl
     
     std::shared_ptr<Texture> texture;
     if (is_all_regular_file(texPaths)) {
-        std::vector<std::shared_ptr<Image>> images;
         std::cout << "Loading texture(GL_TEXTURE_2D) from file [";
-        for (int i = 0; i < texPaths.size(); i++) {
-            auto& texPath = texPaths[i];
-            std::cout << texPaths[i] << ", ";
-            images.push_back(loadImage(std::format("{}_{}", texName, i), texPath, 1, true));
-        }
+        for (auto& texPath : texPaths) { std::cout << texPath << ", "; }
         std::cout << "]\n";
+        auto images = loadImages(texName, texPaths, 1, true);
         auto mimage = Image::merge(images, 4);
         texture = std::make_shared<Texture>(mimage->getWidth(), mimage->getHeight(), GL_TEXTURE_2D, internalFormat, mipLevels);
         texture->upload(mimage);
+        texture->generate();
     } else {
         if (m_textures.count(texAlias) && !m_textures[texAlias].expired()) {
             m_textures[texName] = m_textures[texAlias];
@@ -331,7 +686,7 @@ std::shared_ptr<Texture> ResourceManager::load2DTexture(const std::string& texNa
         }
         
         std::cout << "Loading texture(GL_TEXTURE_2D) from value [" << defaultValue << "]\n";
-        texture = std::make_shared<Texture>(m_textureDefaultWidth, m_textureDefaultHeight, GL_TEXTURE_2D, internalFormat, mipLevels);
+        texture = std::make_shared<Texture>(m_textureDefaultWidth, m_textureDefaultHeight, GL_TEXTURE_2D, internalFormat, std::min(mipLevels, Texture::getMaxMipLevels(m_textureDefaultWidth, m_textureDefaultHeight)));
         texture->clear(glm::value_ptr(defaultValue), GL_RGBA, GL_FLOAT); // GL_RGBA and GL_FLOAT indicate the format of defaultValue is RGBA float
         m_textures[texAlias] = texture;
     }
@@ -340,24 +695,168 @@ std::shared_ptr<Texture> ResourceManager::load2DTexture(const std::string& texNa
     return texture;
 }
 
+std::shared_ptr<Texture> ResourceManager::load2DTextureAsync(const std::string& texName, const std::vector<fs::path>& texPaths, TextureUsage usage, int desiredChannels,
+                                                             const std::function<void(const std::shared_ptr<Texture>&)>& onReady, const std::vector<int>& texChannels) {
+    if (m_textures.count(texName) && !m_textures[texName].expired()) {
+        return m_textures[texName].lock();
+    }
+
+    if (!is_all_regular_file(texPaths)) { return nullptr; }
+
+    // Several materials may wait for the same texture, only the first request decodes it
+    auto& callbacks = m_pendingTextures[texName];
+    callbacks.push_back(onReady);
+    if (callbacks.size() > 1) { return nullptr; }
+
+    // Hand the uploaded texture to the materials waiting for it, on GL thread
+    auto ready = [this, texName](const std::shared_ptr<Texture>& texture) {
+        m_textures[texName] = texture;
+
+        auto callbacks = std::move(m_pendingTextures[texName]);
+        m_pendingTextures.erase(texName);
+        for (auto& callback : callbacks) { callback(texture); }
+    };
+
+    // Workers and the upload run outside the scope of caller, they take its tag along
+    m_loader.submit(texName, [this, texName, texPaths, texChannels, usage, desiredChannels, ready, compress = m_compressTextures, tag = MemoryRegistry::getTag()]() -> AsyncLoader::Upload {
+        MemoryRegistry::Scope scope(tag, texName);
+
+        // 0. Load cooked texture from cache if it is up to date with source files, textures cooked with different options are cached apart
+        // DDS/KTX2 containers hold GPU payload already and skip the cache
+        bool container = texPaths.size() == 1 && CompressedImage::isCompressed(texPaths[0]);
+        uint64_t hash  = 0;
+        fs::path cachePath;
+        if (!container) {
+            std::string options = std::format("u{}c{}{}", static_cast<uint32_t>(usage), desiredChannels, compress ? "bc" : "");
+            for (int channel : texChannels) { options += std::format("-{}", channel); }
+            hash      = TextureCache::hash(texPaths);
+            cachePath = TextureCache::getCachePath(texPaths, options, hash);
+            auto cache = std::make_shared<TextureCache>(cachePath, hash);
+            if (cache->isValid()) {
+                m_textureCacheStats.hits++;
+                m_textureCacheStats.bytes += cache->getByteSize();
+                std::cout << "Loading texture(GL_TEXTURE_2D) from cache [" << cachePath << "] as " << glMacro2Str(cache->getInternalFormat()) << "\n";
+
+                // Levels are copied from the mapping into the staging ring here, the mapping is released before the upload runs
+                std::vector<std::span<const uint8_t>> levels;
+                std::vector<size_t> sizes;
+                for (GLint level = 0; level < cache->getMipLevels(); level++) {
+                    levels.push_back(cache->getLevel(level));
+                    sizes.push_back(levels.back().size());
+                }
+                auto region = m_staging->stage(levels);
+                if (region == nullptr) {
+                    return [cache, ready, tag, texName]() {
+                        MemoryRegistry::Scope scope(tag, texName);
+                        ready(cache->createTexture());
+                    };
+                }
+                return [this, region, sizes, ready, width = cache->getWidth(), height = cache->getHeight(), internalFormat = cache->getInternalFormat(), tag, texName]() {
+                    MemoryRegistry::Scope scope(tag, texName);
+                    ready(createTexture(*m_staging, *region, width, height, internalFormat, sizes));
+                };
+            }
+            m_textureCacheStats.misses++;
+            m_textureCacheStats.stale += TextureCache::invalidate(cachePath);
+        }
+
+        // 1. Decode images on worker, several images are merged into the channels of one texture(e.g. metallic, roughness and ao)
+        // The distinct images of a texture decode concurrently, an image shared by several channels(e.g. glTF metallicRoughnessTexture)
+        // is decoded once, DDS/KTX2 containers keep their blocks
+        std::shared_ptr<Image> image;
+        std::shared_ptr<CompressedImage> blocks;
+        if (container) {
+            blocks = CompressedImage::create(texPaths[0], true);
+        } else {
+            std::vector<fs::path> paths;
+            std::vector<size_t> sources; // index in paths of each texPath
+            for (auto& texPath : texPaths) {
+                auto it = std::find(paths.begin(), paths.end(), texPath);
+                sources.push_back(it - paths.begin());
+                if (it == paths.end()) { paths.push_back(texPath); }
+            }
+            auto decoded = Image::create(paths, desiredChannels, true);
+
+            // Selected channels are packed straight from the decoded images, without extracting them into images of their own
+            std::vector<std::shared_ptr<Image>> images;
+            for (size_t i = 0; i < texPaths.size(); i++) { images.push_back(decoded[sources[i]]); }
+            bool whole = texChannels.empty() || texChannels[0] < 0;
+            image      = images.size() == 1 ? (whole ? images[0] : Image::extract(images[0], texChannels[0])) : Image::merge(images, 4, texChannels);
+        }
+
+        // 2. Encode into blocks when compression is enabled, HDR images stay uncompressed
+        // Loader workers already decode textures in parallel, so each texture is encoded on its own worker only
+        if (compress && image && image->getDataType() != GL_FLOAT) {
+            blocks = CompressedImage::encode(image, Texture::getCompressedFormat(usage, CompressedImage::hasAlpha(image)), 1);
+            image  = nullptr;
+            TextureCache::save(cachePath, hash, *blocks);
+        }
+        GLenum internalFormat = blocks ? blocks->getInternalFormat() : Texture::getInternalFormat(usage, image->getDataType());
+        if (image) { image = convertHDR(image, internalFormat); } // HDR textures are stored as half floats
+        std::cout << "Loading texture(GL_TEXTURE_2D) from file [" << texPaths[0] << (texPaths.size() > 1 ? ", ..." : "") << "] as " << glMacro2Str(internalFormat) << "\n";
+
+        // 3. Copy the final payload into the staging ring, the GL thread then only issues uploads from buffer offsets
+        // Payloads the ring has no room for are uploaded from client memory instead
+        std::vector<std::span<const uint8_t>> chunks;
+        std::vector<size_t> sizes;
+        if (blocks) {
+            for (GLint level = 0; level < blocks->getMipLevels(); level++) {
+                chunks.emplace_back(blocks->getData(level), blocks->getSize(level));
+                sizes.push_back(blocks->getSize(level));
+            }
+        } else {
+            chunks.emplace_back(static_cast<const uint8_t*>(image->getData()), image->getByteSize());
+        }
+        auto region = m_staging->stage(chunks);
+
+        // 4. Create texture with full mip chain on GL thread, and hand it to the materials waiting for it
+        // Levels of uncompressed textures are filtered by the driver(glGenerateMipmap), which also handles non power of two sizes
+        return [this, texName, image, blocks, region, sizes, internalFormat, ready, cachePath, hash, tag]() {
+            MemoryRegistry::Scope scope(tag, texName);
+            std::shared_ptr<Texture> texture;
+            if (blocks && region) {
+                texture = createTexture(*m_staging, *region, blocks->getWidth(0), blocks->getHeight(0), internalFormat, sizes);
+            } else if (blocks) {
+                texture = std::make_shared<Texture>(blocks->getWidth(0), blocks->getHeight(0), GL_TEXTURE_2D, internalFormat, blocks->getMipLevels());
+                texture->upload(blocks);
+            } else {
+                GLsizei mipLevels = Texture::getMaxMipLevels(image->getWidth(), image->getHeight());
+                texture           = std::make_shared<Texture>(image->getWidth(), image->getHeight(), GL_TEXTURE_2D, internalFormat, mipLevels);
+                if (region) {
+                    texture->upload(*m_staging, region->getChunkOffsets()[0], image->getByteSize(), 0, image->getFormat(), image->getDataType());
+                    m_staging->fence(*region);
+                } else {
+                    texture->upload(image);
+                }
+                texture->generate();
+                readbackTexture(texName, *texture, cachePath, hash); // cook the filtered levels on a later frame
+            }
+            ready(texture);
+        };
+    }, [this, texName](const std::string&) {
+        // A missing or corrupt image drops the request, waiting materials keep their fallback and a later request tries again
+        m_pendingTextures.erase(texName);
+    });
+
+    return nullptr;
+}
+
 std::shared_ptr<Texture> ResourceManager::loadCubeTexture(const std::string& texName, const std::vector<fs::path>& texPaths, const glm::vec4& defaultValue, GLenum internalFormat, GLsizei mipLevels, int desiredChannels, bool verticalFlip) {
-    std::string texAlias = std::format("default_cube_tex_color({:.3f}, {:.3f}, {:.3f}, {:.3f})", defaultValue.x, defaultValue.y, defaultValue.z, defaultValue.w);
+    std::string texAlias = std::format("default_cube_tex_color({:.3f}, {:.3f}, {:.3f}, {:.3f})_{}", defaultValue.x, defaultValue.y, defaultValue.z, defaultValue.w, glMacro2Str(internalFormat));
     if (m_textures.count(texName) && !m_textures[texName].expired()) {
         return m_textures[texName].lock();
     }
+    MemoryRegistry::Scope scope(texName); // tagged by the caller, e.g. skybox or ibl
 
     std::vector<std::shared_ptr<Image>> images;
     GLsizei width = 1, height = 1;
     if (is_all_regular_file(texPaths)) {
         std::cout << "Loading texture(GL_TEXTURE_CUBE_MAP) from file [";
-        for (int i = 0; i < texPaths.size(); i++) {
-            auto& texPath = texPaths[i];
-            std::cout << texPath << ", ";
-            images.push_back(loadImage(std::format("{}_{}", texName, i), texPath, desiredChannels, verticalFlip));
-            width  = images.back()->getWidth();
-            height = images.back()->getHeight();
-        }
+        for (auto& texPath : texPaths) { std::cout << texPath << ", "; }
         std::cout << "]\n";
+        images = loadImages(texName, texPaths, desiredChannels, verticalFlip); // six faces decode concurrently, only uploads stay on GL thread
+        width  = images.back()->getWidth();
+        height = images.back()->getHeight();
     } else {
         if (m_textures.count(texAlias) && !m_textures[texAlias].expired()) {
             m_textures[texName] = m_textures[texAlias];
@@ -371,7 +870,7 @@ std::shared_ptr<Texture> ResourceManager::loadCubeTexture(const std::string& tex
     for (auto face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; face++) {
         GLint index = face - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
         if (index < images.size() && width == images[index]->getWidth() && height == images[index]->getHeight()) {
-            texture->upload(images[index], index, 0);
+            texture->upload(convertHDR(images[index], internalFormat), index, 0);
         } else {
             texture->clear(glm::value_ptr(defaultValue), GL_RGBA, GL_FLOAT); // GL_RGBA and GL_FLOAT indicate the format of defaultValue is RGBA float
         }
@@ -384,6 +883,82 @@ std::shared_ptr<Texture> ResourceManager::loadCubeTexture(const std::string& tex
     return texture;
 }
 
+std::shared_ptr<VirtualTexture> ResourceManager::loadVirtualTexture(const std::string& texName, const fs::path& texPath) {
+    if (m_virtualTextures.count(texName) && !m_virtualTextures[texName].expired()) {
+        return m_virtualTextures[texName].lock();
+    }
+    if (!fs::is_regular_file(texPath)) { return nullptr; }
+    MemoryRegistry::Scope scope(texName);
+
+    // 1. Open the page file of current source contents, cook it when the source is new or changed
+    uint64_t hash      = TextureCache::hash({texPath});
+    fs::path cachePath = VirtualTexture::getCachePath(texPath, hash);
+    auto texture       = std::make_shared<VirtualTexture>(cachePath, hash);
+    if (!texture->isValid()) {
+        m_textureCacheStats.stale += TextureCache::invalidate(cachePath);
+        std::cout << "Cooking virtual texture from file [" << texPath << "] into [" << cachePath << "]\n";
+        if (!VirtualTexture::cook(texPath, cachePath, hash)) { return nullptr; }
+        texture = std::make_shared<VirtualTexture>(cachePath, hash);
+        if (!texture->isValid()) { return nullptr; }
+    }
+
+    // 2. Only the coarsest page is resident so far, the others are streamed as feedback requests them
+    std::cout << "Loading virtual texture(GL_TEXTURE_2D) from pages [" << cachePath << "] as " << glMacro2Str(texture->getInternalFormat()) << ", "
+              << texture->getPageCountX() * VirtualTexture::PAGE_SIZE << "x" << texture->getPageCountY() * VirtualTexture::PAGE_SIZE << "\n";
+    m_virtualTextures[texName] = texture;
+    return texture;
+}
+
+void ResourceManager::streamVirtualTexture(const std::string& texName, const std::shared_ptr<VirtualTexture>& texture, const std::vector<uint32_t>& pages) {
+    if (pages.empty()) { return; }
+
+    // Reading the mapped page file faults it in on the worker, the GL thread only copies the pages from the staging ring
+    std::weak_ptr<VirtualTexture> weak = texture;
+    m_loader.submit(std::format("{}({} pages)", texName, pages.size()), [this, weak, pages]() -> AsyncLoader::Upload {
+        auto texture = weak.lock();
+        if (texture == nullptr) { return nullptr; }
+
+        std::vector<std::span<const uint8_t>> chunks;
+        for (uint32_t page : pages) { chunks.push_back(texture->getPage(page)); }
+        auto region = m_staging->stage(chunks);
+        return [this, weak, pages, region]() {
+            auto texture = weak.lock();
+            if (texture == nullptr) { return; }
+            for (size_t i = 0; i < pages.size(); i++) {
+                if (region) {
+                    texture->map(pages[i], reinterpret_cast<const void*>(region->getChunkOffsets()[i]), m_staging.get());
+                } else {
+                    texture->map(pages[i], texture->getPage(pages[i]).data());
+                }
+            }
+            if (region) { m_staging->fence(*region); }
+        };
+    });
+}
+
+std::vector<std::shared_ptr<Image>> ResourceManager::loadImages(const std::string& texName, const std::vector<fs::path>& imagePaths, int desiredChannels, bool verticalFlip) {
+    // Images are named after the texture and their index, those still alive are reused and the rest are decoded concurrently
+    std::vector<std::shared_ptr<Image>> images(imagePaths.size());
+    std::vector<fs::path> paths;
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < imagePaths.size(); i++) {
+        auto it = m_images.find(std::format("{}_{}", texName, i));
+        if (it != m_images.end() && !it->second.expired()) {
+            images[i] = it->second.lock();
+        } else {
+            paths.push_back(imagePaths[i]);
+            indices.push_back(i);
+        }
+    }
+
+    auto decoded = Image::create(paths, desiredChannels, verticalFlip);
+    for (size_t j = 0; j < indices.size(); j++) {
+        images[indices[j]] = decoded[j];
+        m_images[std::format("{}_{}", texName, indices[j])] = decoded[j];
+    }
+    return images;
+}
+
 std::shared_ptr<Image> ResourceManager::loadImage(const std::string& imageName, const fs::path& imagePath, int desiredChannels, bool verticalFlip) {
     if (m_images.count(imageName) && !m_images[imageName].expired()) {
         return m_images[imageName].lock();
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <filesystem>
 
+#include "memoryregistry.hpp"
 #include "utils.hpp"
 
 namespace tinyglrenderer {
@@ -28,14 +29,18 @@ void Scene::getModelBlocks(std::vector<ModelBlock>& blocks) const {
     for (auto& model : m_models) { if (model->isVisible()) { blocks.emplace_back(model->getModelBlock()); } }
 }
 
-void Scene::getRenderQueue(std::vector<RenderItem>& queue, bool opaque, bool reset) const {
+void Scene::getRenderQueue(std::vector<RenderItem>& queue, bool opaque, bool reset, RenderView* view) const {
     if (reset) { queue.clear(); } // reset draw command queue by default
+    if (view) {
+        view->viewProjMatrix = m_camera->getProjMatrix() * m_camera->getViewMatrix();
+        view->eye            = m_camera->getEye();
+    }
 
     int vi = 0;
     for (int i = 0; i < m_models.size(); i++) {
         std::vector<RenderItem> subQueue;
         if (!m_models[i]->isVisible()) { continue; }
-        m_models[i]->getRenderQueue(subQueue, opaque);
+        m_models[i]->getRenderQueue(subQueue, opaque, view);
         auto xyz       = m_models[i]->getBoundingBox();
         float distance = m_camera->getDistance((xyz.first + xyz.second) / 2.f);
         for (auto& item : subQueue) {
@@ -47,6 +52,27 @@ void Scene::getRenderQueue(std::vector<RenderItem>& queue, bool opaque, bool res
     }
 }
 
+void Scene::update() {
+    // 1. Models are loaded asynchronously, refresh bounds whenever more of them are ready
+    size_t ready = std::count_if(m_models.begin(), m_models.end(), [](const auto& model) { return model->isReady(); });
+    if (ready != m_readyModelCount) {
+        m_readyModelCount = ready;
+        updateBounds();
+    }
+
+    // 2. Projected radius in half screen heights is radius * cot(fov / 2) / distance, orthographic projection does not shrink with distance
+    const glm::mat4& proj = m_camera->getProjMatrix();
+    bool orthographic     = proj[3][3] == 1.f;
+    for (auto& model : m_models) {
+        if (!model->isVisible()) { continue; }
+
+        auto xyz       = model->getBoundingBox();
+        float radius   = glm::length(xyz.second - xyz.first) / 2.f;
+        float distance = m_camera->getDistance((xyz.first + xyz.second) / 2.f);
+        model->selectLod(radius * proj[1][1] / (orthographic ? 1.f : std::max(distance, 1e-4f)));
+    }
+}
+
 void Scene::initialize(const std::string& json, ResourceManager& manager) {
     rapidjson::Document doc;
     if (doc.Parse(json.c_str()).HasParseError()) { throw std::runtime_error("Scene::initialize: Error parsing JSON"); }
@@ -56,15 +82,32 @@ void Scene::initialize(const std::string& json, ResourceManager& manager) {
         return glm::vec3{arr[0].GetFloat(), arr[1].GetFloat(), arr[2].GetFloat()};
     };
 
+    // texture compression optional, applies to the materials of models below
+    manager.setTextureCompressed(doc.HasMember("compress_textures") && doc["compress_textures"].GetBool());
+    // texture memory budget in MB optional, 0 means unlimited
+    if (doc.HasMember("texture_budget")) { manager.setTextureBudget(static_cast<size_t>(doc["texture_budget"].GetUint()) << 20); }
+
     // models
     if (doc.HasMember("models")) {
         for (int i = 0; i < doc["models"].Size(); i++) {
             auto& modelDoc = doc["models"][i];
-            // model base dir and name required
-            fs::path objPath      = modelDoc["obj_path"].GetString();
+            // model path(obj or glTF/glb) required, base dir and name optional
+            fs::path objPath      = modelDoc.HasMember("gltf_path") ? modelDoc["gltf_path"].GetString() : modelDoc["obj_path"].GetString();
             fs::path mtlDir       = modelDoc.HasMember("mtl_dir") ? modelDoc["mtl_dir"].GetString() : objPath.parent_path();
             std::string modelName = modelDoc.HasMember("name") ? modelDoc["name"].GetString() : objPath.stem().string();
-            m_models.emplace_back(manager.loadModel(modelName, objPath, mtlDir));
+            // mesh cooking options optional
+            MeshOptions options;
+            if (modelDoc.HasMember("vertex_format")) {
+                std::string format = modelDoc["vertex_format"].GetString();
+                if (format == "packed") {
+                    options.format = VertexFormat::VF_PACKED;
+                } else if (format != "float") {
+                    throw std::runtime_error("Scene::initialize: Unknown vertex format: " + format);
+                }
+            }
+            if (modelDoc.HasMember("optimize")) { options.optimize = modelDoc["optimize"].GetBool(); }
+            if (modelDoc.HasMember("lods")) { options.lods = std::clamp(modelDoc["lods"].GetInt(), 1, static_cast<int>(Mesh::MAX_LOD_COUNT)); }
+            m_models.emplace_back(manager.loadModel(modelName, objPath, mtlDir, options));
 
             // default material optional
             if (modelDoc.HasMember("default_mat")) {
@@ -96,15 +139,12 @@ void Scene::initialize(const std::string& json, ResourceManager& manager) {
                 scale     = modelDoc["transform"].HasMember("scale") ? getVec3(modelDoc["transform"]["scale"]) : glm::vec3(1.0f);
             }
             m_models.back()->setTransform(translate, rotate, scale);
-
-            auto [xyzi1, xyzi2] = m_models.back()->getBoundingBox();
-            m_bounds.first      = glm::min(m_bounds.first, xyzi1);
-            m_bounds.second     = glm::max(m_bounds.second, xyzi2);
         }
     }
 
     // skybox(environment map)
     if (doc.HasMember("skybox")) {
+        MemoryRegistry::Scope scope(MemoryTag::MT_SKYBOX);
         if (doc["skybox"].HasMember("cubemap")) {
             std::vector<fs::path> imagePaths;
             fs::path skyboxDir = doc["skybox"]["cubemap"]["base_dir"].GetString();
@@ -112,12 +152,19 @@ void Scene::initialize(const std::string& json, ResourceManager& manager) {
                 std::string imageName = doc["skybox"]["cubemap"][face].GetString();
                 imagePaths.push_back(skyboxDir / imageName);
             }
-            m_skyboxCubemap = manager.loadCubeTexture("skybox_cubemap", imagePaths, glm::vec4(0.0f), GL_RGBA32F, 1, 0, false); // flip must set to false
+            // HDR faces are stored in shared exponent rgb, 4 bytes per texel instead of 16 for GL_RGBA32F
+            m_skyboxCubemap = manager.loadCubeTexture("skybox_cubemap", imagePaths, glm::vec4(0.0f), GL_RGB9_E5, 1, 0, false); // flip must set to false
+            m_skyboxPaths   = imagePaths;
         }
         if (doc["skybox"].HasMember("equirect")) {
             fs::path skyboxDir    = doc["skybox"]["equirect"]["base_dir"].GetString();
             fs::path equirectName = doc["skybox"]["equirect"]["name"].GetString();
-            m_skyboxEquirect      = manager.load2DTexture("skybox_equirect", skyboxDir / equirectName, glm::vec4(0.0f), GL_RGBA32F, 1);
+            // virtual optional, very large backgrounds(e.g. 8K) are streamed page by page instead of uploaded whole
+            if (doc["skybox"]["equirect"].HasMember("virtual") && doc["skybox"]["equirect"]["virtual"].GetBool()) {
+                m_skyboxVirtual = manager.loadVirtualTexture("skybox_virtual", skyboxDir / equirectName);
+            }
+            if (m_skyboxVirtual == nullptr) { m_skyboxEquirect = manager.load2DTexture("skybox_equirect", skyboxDir / equirectName, glm::vec4(0.0f), GL_RGB9_E5, 1); }
+            if (m_skyboxCubemap == nullptr) { m_skyboxPaths = {skyboxDir / equirectName}; } // a cube map given as well is the one rendered
         }
     }
 
@@ -143,22 +190,51 @@ void Scene::initialize(const std::string& json, ResourceManager& manager) {
         m_camera->setAspect(cameraDoc["width"].GetInt(), cameraDoc["height"].GetInt());
         m_camera->setSpeed(cameraDoc["speed"].GetFloat());
     } else {
-        const glm::vec3 xyz1 = m_bounds.first, xyz2 = m_bounds.second;
-        glm::vec3 target    = 0.5f * (xyz2 + xyz1);
-        glm::vec3 eye       = target + 1.0f * (xyz2 - xyz1);
-        glm::vec3 direction = glm::normalize(xyz2 - xyz1);
-        glm::vec3 up        = {0.0f, 1.0f, 0.0f};
-        if (std::abs(glm::dot(direction, up)) > 0.99f) { up = {0.0f, 0.0f, 1.0f}; }
-        m_camera = std::make_shared<PerspectiveCamera>();
-        m_camera->setEye(eye);
-        m_camera->setTarget(target);
-        m_camera->setUp(up);
+        m_autoCamera = true;
+        frameCamera();
+    }
+    m_readyModelCount = 0;
+    updateBounds();
+}
+
+void Scene::updateBounds() {
+    m_bounds = {glm::vec3(0.0f), glm::vec3(0.0f)};
+    for (auto& model : m_models) {
+        if (!model->isReady()) { continue; }
+        auto [xyzi1, xyzi2] = model->getBoundingBox();
+        m_bounds.first      = glm::min(m_bounds.first, xyzi1);
+        m_bounds.second     = glm::max(m_bounds.second, xyzi2);
     }
+    for (auto& light : m_lights) { light->setLightSpaceMatrix(m_bounds); }
+
+    // The automatic camera frames the scene once every model is loaded, unless the user moved it while they were loading
+    if (m_autoCamera && m_readyModelCount == m_models.size() && !m_models.empty()) {
+        m_autoCamera = false;
+        if (m_camera->getEye() == m_autoEye && m_camera->getTarget() == m_autoTarget) { frameCamera(); }
+    }
+}
+
+void Scene::frameCamera() {
+    const glm::vec3 xyz1 = m_bounds.first, xyz2 = m_bounds.second;
+    glm::vec3 extent    = glm::length(xyz2 - xyz1) > 0.0f ? xyz2 - xyz1 : glm::vec3(1.0f); // nothing loaded yet
+    glm::vec3 target    = 0.5f * (xyz2 + xyz1);
+    glm::vec3 eye       = target + 1.0f * extent;
+    glm::vec3 direction = glm::normalize(extent);
+    glm::vec3 up        = {0.0f, 1.0f, 0.0f};
+    if (std::abs(glm::dot(direction, up)) > 0.99f) { up = {0.0f, 0.0f, 1.0f}; }
+    m_camera = std::make_shared<PerspectiveCamera>();
+    m_camera->setEye(eye);
+    m_camera->setTarget(target);
+    m_camera->setUp(up);
+    m_autoEye    = eye;
+    m_autoTarget = target;
 }
 
 void Scene::destroy() {
     m_skyboxCubemap.reset();
     m_skyboxEquirect.reset();
+    m_skyboxVirtual.reset();
+    m_skyboxPaths.clear();
     m_camera.reset();
     m_lights.clear();
     m_models.clear();
@@ -0,0 +1,183 @@
+#include "sphericalharmonics.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SH_USE_SSE 1
+#endif
+
+#include "utils.hpp"
+
+namespace tinyglrenderer {
+
+static constexpr float SH_PI         = 3.14159265358979f;
+static constexpr size_t SH_SUM_COUNT = 9 * 3 + 1;                                  // rgb of every coefficient, then the weight
+static constexpr float SH_BAND_SCALE[9] = {1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f}; // A_l / pi
+
+struct IrradianceCacheHeader {
+    char magic[8];    // "TGSH\0\0\0\0"
+    uint32_t version; // bumped when the projection changes
+    uint32_t padding;
+    uint64_t hash;    // content hash of skybox files and shaders
+};
+
+static constexpr char IRRADIANCE_CACHE_MAGIC[8]    = {'T', 'G', 'S', 'H', '\0', '\0', '\0', '\0'};
+static constexpr uint32_t IRRADIANCE_CACHE_VERSION = 1;
+
+namespace {
+// Unnormalized direction of texel (s, t) in [-1, 1] on a face is s * sAxis + t * tAxis + normal, see the cube map table of GL spec
+struct FaceBasis {
+    float sAxis[3];
+    float tAxis[3];
+    float normal[3];
+};
+constexpr FaceBasis FACE_BASES[6] = {
+    {{0.0f, 0.0f, -1.0f}, {0.0f, -1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}},  // +X
+    {{0.0f, 0.0f, 1.0f}, {0.0f, -1.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}},  // -X
+    {{1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 0.0f}},    // +Y
+    {{1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, -1.0f, 0.0f}},  // -Y
+    {{1.0f, 0.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},   // +Z
+    {{-1.0f, 0.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, -1.0f}}, // -Z
+};
+
+using Sums = std::array<double, SH_SUM_COUNT>;
+
+// Accumulate texels [begin, end) of a row, the weight of a texel is proportional to its solid angle 1 / |d|^3
+void projectScalar(const float* row, const FaceBasis& face, float t, float step, GLsizei begin, GLsizei end, Sums& sums) {
+    for (GLsizei i = begin; i < end; i++) {
+        float s    = (static_cast<float>(i) + 0.5f) * step - 1.0f;
+        float dx   = face.sAxis[0] * s + face.tAxis[0] * t + face.normal[0];
+        float dy   = face.sAxis[1] * s + face.tAxis[1] * t + face.normal[1];
+        float dz   = face.sAxis[2] * s + face.tAxis[2] * t + face.normal[2];
+        float inv  = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz);
+        float w    = inv * inv * inv;
+        float x = dx * inv, y = dy * inv, z = dz * inv;
+
+        float basis[9] = {
+            0.282095f, 0.488603f * y, 0.488603f * z, 0.488603f * x,
+            1.092548f * x * y, 1.092548f * y * z, 0.315392f * (3.0f * z * z - 1.0f), 1.092548f * x * z, 0.546274f * (x * x - y * y),
+        };
+        const float* texel = row + static_cast<size_t>(i) * 3;
+        for (int k = 0; k < 9; k++) {
+            for (int c = 0; c < 3; c++) { sums[k * 3 + c] += basis[k] * w * texel[c]; }
+        }
+        sums[27] += w;
+    }
+}
+
+#ifdef SH_USE_SSE
+// Accumulate 4 texels a step, the texels left over go through projectScalar
+// @return The first texel not accumulated.
+GLsizei projectSSE(const float* row, const FaceBasis& face, float t, float step, GLsizei size, Sums& sums) {
+    __m128 acc[SH_SUM_COUNT];
+    for (auto& a : acc) { a = _mm_setzero_ps(); }
+
+    const __m128 one = _mm_set1_ps(1.0f), three = _mm_set1_ps(3.0f);
+    const __m128 c0 = _mm_set1_ps(0.282095f), c1 = _mm_set1_ps(0.488603f), c2 = _mm_set1_ps(1.092548f), c3 = _mm_set1_ps(0.315392f), c4 = _mm_set1_ps(0.546274f);
+    __m128 dir[3];
+    for (int a = 0; a < 3; a++) { dir[a] = _mm_set1_ps(face.tAxis[a] * t + face.normal[a]); } // the part of direction shared by the row
+
+    GLsizei i = 0;
+    for (; i + 4 <= size; i += 4) {
+        __m128 s  = _mm_sub_ps(_mm_mul_ps(_mm_set_ps(i + 3.5f, i + 2.5f, i + 1.5f, i + 0.5f), _mm_set1_ps(step)), one);
+        __m128 dx = _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(face.sAxis[0])), dir[0]);
+        __m128 dy = _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(face.sAxis[1])), dir[1]);
+        __m128 dz = _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(face.sAxis[2])), dir[2]);
+        __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz))));
+        __m128 w   = _mm_mul_ps(_mm_mul_ps(inv, inv), inv);
+        __m128 x = _mm_mul_ps(dx, inv), y = _mm_mul_ps(dy, inv), z = _mm_mul_ps(dz, inv);
+
+        __m128 basis[9] = {
+            c0,
+            _mm_mul_ps(c1, y),
+            _mm_mul_ps(c1, z),
+            _mm_mul_ps(c1, x),
+            _mm_mul_ps(c2, _mm_mul_ps(x, y)),
+            _mm_mul_ps(c2, _mm_mul_ps(y, z)),
+            _mm_mul_ps(c3, _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(z, z)), one)),
+            _mm_mul_ps(c2, _mm_mul_ps(x, z)),
+            _mm_mul_ps(c4, _mm_sub_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))),
+        };
+
+        // Texels are interleaved rgb, gather every channel of the 4 texels into a register
+        const float* p = row + static_cast<size_t>(i) * 3;
+        __m128 color[3];
+        for (int c = 0; c < 3; c++) { color[c] = _mm_mul_ps(w, _mm_set_ps(p[9 + c], p[6 + c], p[3 + c], p[c])); }
+        for (int k = 0; k < 9; k++) {
+            for (int c = 0; c < 3; c++) { acc[k * 3 + c] = _mm_add_ps(acc[k * 3 + c], _mm_mul_ps(basis[k], color[c])); }
+        }
+        acc[27] = _mm_add_ps(acc[27], w);
+    }
+
+    // Rows are summed in float, the whole map in double
+    alignas(16) float lanes[4];
+    for (size_t k = 0; k < SH_SUM_COUNT; k++) {
+        _mm_store_ps(lanes, acc[k]);
+        sums[k] += static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+    return i;
+}
+#endif
+} // namespace
+
+IrradianceBlock SphericalHarmonics::project(const float* texels, GLsizei size, unsigned threads) {
+    IrradianceBlock block{};
+    if (texels == nullptr || size <= 0) { return block; }
+
+    // 1. Project the rows of all faces, every row sums into its own slot so the result does not depend on thread scheduling
+    float step       = 2.0f / static_cast<float>(size);
+    size_t rows      = static_cast<size_t>(size) * 6;
+    size_t rowStride = static_cast<size_t>(size) * 3;
+    std::vector<Sums> partial(rows, Sums{});
+    parallelFor(rows, threads, [&](size_t job) {
+        const FaceBasis& face = FACE_BASES[job / size];
+        float t               = (static_cast<float>(job % size) + 0.5f) * step - 1.0f;
+        const float* row      = texels + job * rowStride;
+        GLsizei begin         = 0;
+#ifdef SH_USE_SSE
+        begin = projectSSE(row, face, t, step, size, partial[job]);
+#endif
+        projectScalar(row, face, t, step, begin, size, partial[job]);
+    });
+
+    // 2. Normalize the weights to the area of sphere(4pi), the discrete solid angles sum slightly off it, then convolve every band
+    Sums sums{};
+    for (const auto& p : partial) {
+        for (size_t k = 0; k < SH_SUM_COUNT; k++) { sums[k] += p[k]; }
+    }
+    double scale = 4.0 * SH_PI / sums[27];
+    for (int k = 0; k < 9; k++) {
+        glm::vec3 rgb(sums[k * 3], sums[k * 3 + 1], sums[k * 3 + 2]);
+        block.coefficients[k] = glm::vec4(rgb * static_cast<float>(scale) * SH_BAND_SCALE[k], 0.0f);
+    }
+    return block;
+}
+
+bool SphericalHarmonics::load(const fs::path& cachePath, uint64_t hash, IrradianceBlock& block) {
+    std::ifstream file{cachePath, std::ios::binary};
+    IrradianceCacheHeader header;
+    IrradianceBlock cached;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(IrradianceCacheHeader)) || !file.read(reinterpret_cast<char*>(&cached), sizeof(IrradianceBlock))) { return false; }
+    if (std::memcmp(header.magic, IRRADIANCE_CACHE_MAGIC, sizeof(IRRADIANCE_CACHE_MAGIC)) != 0 || header.version != IRRADIANCE_CACHE_VERSION || header.hash != hash) { return false; }
+    block = cached;
+    return true;
+}
+
+bool SphericalHarmonics::save(const fs::path& cachePath, uint64_t hash, const IrradianceBlock& block) {
+    IrradianceCacheHeader header{};
+    std::memcpy(header.magic, IRRADIANCE_CACHE_MAGIC, sizeof(IRRADIANCE_CACHE_MAGIC));
+    header.version = IRRADIANCE_CACHE_VERSION;
+    header.hash    = hash;
+    return writeFileAtomically(cachePath, [&](std::ofstream& file) {
+        file.write(reinterpret_cast<const char*>(&header), sizeof(IrradianceCacheHeader));
+        file.write(reinterpret_cast<const char*>(&block), sizeof(IrradianceBlock));
+        return true;
+    });
+}
+
+} // namespace tinyglrenderer
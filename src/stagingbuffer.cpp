@@ -0,0 +1,133 @@
+#include "stagingbuffer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace tinyglrenderer {
+
+static constexpr GLsizeiptr STAGING_ALIGNMENT = 16; // keeps every chunk aligned for texel rows and SIMD copies
+
+StagingBuffer::StagingBuffer(GLsizeiptr size) : GraphicBuffer(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT) {
+    // Map the whole buffer once for its lifetime, coherent mapping makes worker writes visible without explicit flushes
+    //
+    // ┌──────────────────────────────────────────────────────────────────────────────────────────────┐
+    // │                   glTextureSubImage2D(client memory) vs (pixel unpack buffer)                │
+    // ├───────────────────────────────────────────────┬──────────────────────────────────────────────┤
+    // │              client memory                    │              pixel unpack buffer             │
+    // ├───────────────────────────────────────────────┼──────────────────────────────────────────────┤
+    // │ • Driver copies texels before returning       │ • Returns at once, pointer is a buffer offset│
+    // │ • Copy runs on GL thread, stalls the frame    │ • Texels are written by workers beforehand   │
+    // │ • Client memory is free after the call        │ • Region is reusable after its fence signals │
+    // └───────────────────────────────────────────────┴──────────────────────────────────────────────┘
+    m_mapped = static_cast<uint8_t*>(glMapNamedBufferRange(m_id, 0, size, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT));
+    if (m_mapped == nullptr) { throw std::runtime_error("StagingBuffer::StagingBuffer: Failed to map staging buffer persistently"); }
+}
+
+StagingBuffer::~StagingBuffer() {
+    // Regions must be dropped before, loader workers and pending uploads are finished by the owner
+    for (auto& entry : m_entries) { if (entry.fence) { glDeleteSync(entry.fence); } }
+    if (m_mapped) { glUnmapNamedBuffer(m_id); }
+}
+
+std::shared_ptr<StagingBuffer::Region> StagingBuffer::stage(const std::vector<std::span<const uint8_t>>& chunks, int timeout) {
+    // 1. Lay out chunks back to back at aligned offsets
+    auto align = [](GLsizeiptr offset) { return (offset + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT; };
+    std::vector<GLintptr> offsets;
+    GLsizeiptr size = 0;
+    for (auto& chunk : chunks) {
+        offsets.push_back(size);
+        size = align(size + static_cast<GLsizeiptr>(chunk.size()));
+    }
+    if (size == 0) { return nullptr; }
+
+    // 2. Reserve a range, waiting for retired regions while the ring is full
+    std::shared_ptr<Region> region;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        GLintptr offset = -1;
+        if (size <= m_size) {
+            m_retired.wait_for(lock, std::chrono::milliseconds(timeout), [&] { return (offset = reserve(size)) >= 0; });
+        }
+        if (offset < 0) {
+            m_misses++;
+            return nullptr;
+        }
+        m_entries.push_back({m_nextID, offset, size});
+        m_head = offset + size;
+        region = std::make_shared<Region>(*this, m_nextID++, offset, size, m_mapped + offset);
+    }
+
+    // 3. Copy outside the lock, the range belongs to this region only
+    for (size_t i = 0; i < chunks.size(); i++) {
+        region->m_chunks.push_back(region->m_offset + offsets[i]);
+        std::memcpy(region->m_data + offsets[i], chunks[i].data(), chunks[i].size());
+    }
+    return region;
+}
+
+GLintptr StagingBuffer::reserve(GLsizeiptr size) {
+    if (m_entries.empty()) {
+        m_head = 0;
+        return size <= m_size ? 0 : -1;
+    }
+
+    // Free space is [head, end) + [0, tail) while the newest region lies after the oldest, [head, tail) once it wrapped around
+    GLintptr tail = m_entries.front().offset;
+    bool wrapped  = m_entries.back().offset < tail;
+    if (!wrapped) {
+        if (m_head + size <= m_size) { return m_head; }
+        return size <= tail ? 0 : -1;
+    }
+    return m_head + size <= tail ? m_head : -1;
+}
+
+void StagingBuffer::release(uint64_t id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = std::find_if(m_entries.begin(), m_entries.end(), [id](const Entry& entry) { return entry.id == id; });
+    if (it != m_entries.end()) { it->released = true; }
+}
+
+void StagingBuffer::fence(const Region& region) {
+    GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = std::find_if(m_entries.begin(), m_entries.end(), [&region](const Entry& entry) { return entry.id == region.m_id; });
+    if (it == m_entries.end()) {
+        glDeleteSync(sync);
+        return;
+    }
+    if (it->fence) { glDeleteSync(it->fence); } // fenced again after more uploads from the same region
+    it->fence = sync;
+}
+
+void StagingBuffer::retire() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_entries.empty() && m_entries.front().released) {
+            Entry& entry = m_entries.front();
+            if (entry.fence) {
+                GLenum status = glClientWaitSync(entry.fence, 0, 0); // poll, never block the frame
+                if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) { break; }
+                glDeleteSync(entry.fence);
+            }
+            m_entries.pop_front();
+        }
+        if (m_entries.empty()) { m_head = 0; }
+    }
+    m_retired.notify_all();
+}
+
+GLsizeiptr StagingBuffer::getUsedSize() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    GLsizeiptr size = 0;
+    for (auto& entry : m_entries) { size += entry.size; }
+    return size;
+}
+
+size_t StagingBuffer::getMissCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+}
+
+} // namespace tinyglrenderer
@@ -1,9 +1,15 @@
 #include "texture.hpp"
 
+#include <algorithm>
 #include <format>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
+#include <tuple>
+#include <unordered_set>
 
+#include "compressedimage.hpp"
+#include "memoryregistry.hpp"
 #include "utils.hpp"
 
 namespace tinyglrenderer {
@@ -17,7 +23,7 @@ Texture::Texture(GLsizei size, GLenum target, GLenum internalFormat, GLsizei mip
       m_target(target),
       m_internalFormat(internalFormat),
       m_mipLevels(mipLevels) {
-    if (size == 0 || mipLevels > 10 || size < (1 << (mipLevels - 1))) { throw std::runtime_error(std::format("Texture::Texture: Invalid Texture size {} for mip level {}", size, mipLevels)); }
+    if (size <= 0 || mipLevels < 1 || mipLevels > getMaxMipLevels(size)) { throw std::runtime_error(std::format("Texture::Texture: Invalid Texture size {} for mip level {}", size, mipLevels)); }
 
     glCreateTextures(m_target, 1, &m_id);
 
@@ -26,6 +32,7 @@ Texture::Texture(GLsizei size, GLenum target, GLenum internalFormat, GLsizei mip
     } else {
         throw std::runtime_error("Texture::Texture: Texture target is not GL_TEXTURE_1D");
     }
+    MemoryRegistry::track(MemoryKind::MK_TEXTURE, this, getByteSize());
 }
 
 Texture::Texture(GLsizei width, GLsizei height, GLenum target, GLenum internalFormat, GLsizei mipLevels)
@@ -35,7 +42,7 @@ Texture::Texture(GLsizei width, GLsizei height, GLenum target, GLenum internalFo
       m_target(target),
       m_internalFormat(internalFormat),
       m_mipLevels(mipLevels) {
-    if (width == 0 || height == 0 || mipLevels > 10 || width < (1 << (mipLevels - 1)) || height < (1 << (mipLevels - 1))) { throw std::runtime_error(std::format("Texture::Texture: Invalid Texture size {}x{} for mip level {}", width, height, mipLevels)); }
+    if (width <= 0 || height <= 0 || mipLevels < 1 || mipLevels > getMaxMipLevels(width, height)) { throw std::runtime_error(std::format("Texture::Texture: Invalid Texture size {}x{} for mip level {}", width, height, mipLevels)); }
 
     // Create texture handle
     //
@@ -84,6 +91,7 @@ Texture::Texture(GLsizei width, GLsizei height, GLenum target, GLenum internalFo
     } else {
         throw std::runtime_error("Texture::Texture: Texture target is not GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP or GL_TEXTURE_RECTANGLE or GL_TEXTURE_1D_ARRAY");
     }
+    MemoryRegistry::track(MemoryKind::MK_TEXTURE, this, getByteSize());
 }
 
 Texture::Texture(GLsizei width, GLsizei height, GLsizei depth, GLenum target, GLenum internalFormat, GLsizei mipLevels)
@@ -93,7 +101,7 @@ Texture::Texture(GLsizei width, GLsizei height, GLsizei depth, GLenum target, GL
       m_target(target),
       m_mipLevels(mipLevels),
       m_internalFormat(internalFormat) {
-    if (width == 0 || height == 0 || depth == 0 || mipLevels > 10 || width < (1 << (mipLevels - 1)) || height < (1 << (mipLevels - 1)) || depth < (1 << (mipLevels - 1))) { throw std::runtime_error(std::format("Texture::Texture: Invalid Texture size {}x{}x{} for mip level {}", width, height, depth, mipLevels)); }
+    if (width <= 0 || height <= 0 || depth <= 0 || mipLevels < 1 || mipLevels > getMaxMipLevels(width, height, target == GL_TEXTURE_3D ? depth : 1)) { throw std::runtime_error(std::format("Texture::Texture: Invalid Texture size {}x{}x{} for mip level {}", width, height, depth, mipLevels)); }
 
     glCreateTextures(m_target, 1, &m_id);
 
@@ -102,6 +110,7 @@ Texture::Texture(GLsizei width, GLsizei height, GLsizei depth, GLenum target, GL
     } else {
         throw std::runtime_error("Texture::Texture: Texture target is not GL_TEXTURE_3D or GL_TEXTURE_2D_ARRAY or GL_TEXTURE_CUBE_MAP_ARRAY");
     }
+    MemoryRegistry::track(MemoryKind::MK_TEXTURE, this, getByteSize());
 }
 
 Texture::Texture(Texture&& other) {
@@ -112,7 +121,10 @@ Texture::Texture(Texture&& other) {
     m_height         = other.m_height;
     m_depth          = other.m_depth;
     m_internalFormat = other.m_internalFormat;
+    m_mipLevels      = other.m_mipLevels;
+    m_lastUsed       = other.m_lastUsed;
     other.m_id       = 0;
+    MemoryRegistry::transfer(&other, this);
 }
 
 Texture& Texture::operator=(Texture&& other) {
@@ -123,28 +135,33 @@ Texture& Texture::operator=(Texture&& other) {
     m_height         = other.m_height;
     m_depth          = other.m_depth;
     m_internalFormat = other.m_internalFormat;
+    m_mipLevels      = other.m_mipLevels;
+    m_lastUsed       = other.m_lastUsed;
     other.m_id       = 0;
+    MemoryRegistry::transfer(&other, this); // keeps the owner of this texture, e.g. trimmed or grown in place
     return *this;
 }
 
 Texture::~Texture() {
     if (m_id) { glDeleteTextures(1, &m_id); }
+    MemoryRegistry::untrack(this);
 }
 
-GLsizei Texture::getWidth(GLint level) const { return m_width / (1 << level); }
+// Each level halves the previous one rounding down, and never shrinks below 1(e.g. 300x200 -> 150x100 -> 75x50 -> 37x25 -> ... -> 1x1)
+GLsizei Texture::getWidth(GLint level) const { return std::max(m_width >> level, 1); }
 
 GLsizei Texture::getHeight(GLint level) const {
-    if (m_target == GL_TEXTURE_1D) {
-        return m_height; // 1
+    if (m_target == GL_TEXTURE_1D || m_target == GL_TEXTURE_1D_ARRAY) {
+        return m_height; // 1, or layer count
     }
-    return m_height / (1 << level);
+    return std::max(m_height >> level, 1);
 }
 
 GLsizei Texture::getDepth(GLint level) const {
-    if (m_target == GL_TEXTURE_1D || m_target == GL_TEXTURE_2D || m_target == GL_TEXTURE_CUBE_MAP || m_target == GL_TEXTURE_RECTANGLE || m_target == GL_TEXTURE_1D_ARRAY) {
-        return m_depth; // 1
+    if (m_target != GL_TEXTURE_3D) {
+        return m_depth; // 1, or layer count of array textures
     }
-    return m_depth / (1 << level);
+    return std::max(m_depth >> level, 1);
 }
 
 void Texture::bind(GLuint slot) const {
@@ -163,6 +180,7 @@ void Texture::bind(GLuint slot) const {
     // │ • Slower (state validation overhead)          │ • Faster (direct state access)  │
     // └───────────────────────────────────────────────┴─────────────────────────────────┘
     glBindTextureUnit(slot, m_id);
+    m_lastUsed = s_frame;
 }
 
 void Texture::unbind(GLuint slot) const { glBindTextureUnit(slot, 0); }
@@ -210,6 +228,7 @@ void Texture::upload(const std::shared_ptr<Image>& img, GLint level) {
     //
     // Key insight:  glTexImage2D  = "allocate + upload" (once at texture creation)
     //               glTexSubImage2D = "upload only" (update existing texture, e.g., video, dynamic UI)
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // image rows are tightly packed, rows of non power of two RGB images are not 4 bytes aligned
     glTextureSubImage2D(m_id, level, 0, 0, width, height, img->getFormat(), img->getDataType(), img->getData());
 }
 
@@ -226,9 +245,120 @@ void Texture::upload(const std::shared_ptr<Image>& img, GLint pos, GLint level)
     if (width > texWidth || height > texHeight) { throw std::runtime_error(std::format("Texture::upload: image size {}x{} does not match texture size {}x{} at level {}", width, height, texWidth, texHeight, level)); }
 
     // Upload texture data to GPU memory
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glTextureSubImage3D(m_id, level, 0, 0, pos, width, height, 1, img->getFormat(), img->getDataType(), img->getData());
 }
 
+void Texture::upload(const std::shared_ptr<CompressedImage>& img) {
+    if (img == nullptr || img->getMipLevels() == 0) { throw std::runtime_error("Texture::upload: compressed image data is null"); }
+    if (img->getInternalFormat() != m_internalFormat) { throw std::runtime_error(std::format("Texture::upload: compressed image format {} does not match texture format {}", glMacro2Str(img->getInternalFormat()), glMacro2Str(m_internalFormat))); }
+    if (img->getWidth(0) > getWidth(0) || img->getHeight(0) > getHeight(0)) { throw std::runtime_error(std::format("Texture::upload: compressed image size {}x{} does not match texture size {}x{}", img->getWidth(0), img->getHeight(0), getWidth(0), getHeight(0))); }
+
+    // Blocks are copied as they are, the driver neither decodes nor converts them
+    for (GLint level = 0; level < std::min(img->getMipLevels(), m_mipLevels); level++) {
+        glCompressedTextureSubImage2D(m_id, level, 0, 0, img->getWidth(level), img->getHeight(level), m_internalFormat, static_cast<GLsizei>(img->getSize(level)), img->getData(level));
+    }
+}
+
+void Texture::upload(const void* data, size_t size, GLint level) {
+    GLsizei faces = m_target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    if (data == nullptr) { throw std::runtime_error("Texture::upload: texture data is null"); }
+    if (level < 0 || level >= m_mipLevels) { throw std::runtime_error(std::format("Texture::upload: mip level {} out of range [0 - {}]", level, m_mipLevels)); }
+    if (size != getLevelSize(level) * faces) { throw std::runtime_error(std::format("Texture::upload: data size {} does not match level size {} at level {}", size, getLevelSize(level) * faces, level)); }
+
+    // DSA addresses the faces of a cube map as the layers of a 3d image, all of them are uploaded at once
+    if (isCompressed(m_internalFormat)) {
+        if (faces > 1) {
+            glCompressedTextureSubImage3D(m_id, level, 0, 0, 0, getWidth(level), getHeight(level), faces, m_internalFormat, static_cast<GLsizei>(size), data);
+        } else {
+            glCompressedTextureSubImage2D(m_id, level, 0, 0, getWidth(level), getHeight(level), m_internalFormat, static_cast<GLsizei>(size), data);
+        }
+        return;
+    }
+    auto [format, type] = getPixelFormat(m_internalFormat);
+    if (format == 0) { throw std::runtime_error(std::format("Texture::upload: no pixel format matches internal format {}", glMacro2Str(m_internalFormat))); }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (faces > 1) {
+        glTextureSubImage3D(m_id, level, 0, 0, 0, getWidth(level), getHeight(level), faces, format, type, data);
+    } else {
+        glTextureSubImage2D(m_id, level, 0, 0, getWidth(level), getHeight(level), format, type, data);
+    }
+}
+
+void Texture::upload(const GraphicBuffer& buffer, GLintptr offset, size_t size, GLint level, GLenum format, GLenum type) {
+    if (buffer.getTarget() != GL_PIXEL_UNPACK_BUFFER) { throw std::runtime_error("Texture::upload: buffer is not a pixel unpack buffer"); }
+    if (level < 0 || level >= m_mipLevels) { throw std::runtime_error(std::format("Texture::upload: mip level {} out of range [0 - {}]", level, m_mipLevels)); }
+    if (offset < 0 || offset + static_cast<GLsizeiptr>(size) > buffer.getSize()) { throw std::runtime_error("Texture::upload: offset or size out of buffer range"); }
+    if (format == 0 && size != getLevelSize(level)) { throw std::runtime_error(std::format("Texture::upload: data size {} does not match level size {} at level {}", size, getLevelSize(level), level)); }
+
+    // While a buffer is bound to GL_PIXEL_UNPACK_BUFFER, the data pointer of glTextureSubImage* is an offset into it
+    const void* pointer = reinterpret_cast<const void*>(offset);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.getID());
+    if (isCompressed(m_internalFormat)) {
+        glCompressedTextureSubImage2D(m_id, level, 0, 0, getWidth(level), getHeight(level), m_internalFormat, static_cast<GLsizei>(size), pointer);
+    } else {
+        if (format == 0) { std::tie(format, type) = getPixelFormat(m_internalFormat); }
+        if (format == 0) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            throw std::runtime_error(std::format("Texture::upload: no pixel format matches internal format {}", glMacro2Str(m_internalFormat)));
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTextureSubImage2D(m_id, level, 0, 0, getWidth(level), getHeight(level), format, type, pointer);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); // later client memory uploads must not read from the buffer
+}
+
+void Texture::upload(const void* data, GLint x, GLint y, GLsizei width, GLsizei height, GLint level, const GraphicBuffer* buffer) {
+    if (data == nullptr && buffer == nullptr) { throw std::runtime_error("Texture::upload: texture data is null"); }
+    if (level < 0 || level >= m_mipLevels) { throw std::runtime_error(std::format("Texture::upload: mip level {} out of range [0 - {}]", level, m_mipLevels)); }
+    if (x < 0 || y < 0 || x + width > getWidth(level) || y + height > getHeight(level)) { throw std::runtime_error(std::format("Texture::upload: rectangle {}x{} at ({}, {}) out of level {} size {}x{}", width, height, x, y, level, getWidth(level), getHeight(level))); }
+    auto [format, type] = getPixelFormat(m_internalFormat);
+    if (format == 0) { throw std::runtime_error(std::format("Texture::upload: no pixel format matches internal format {}", glMacro2Str(m_internalFormat))); }
+
+    if (buffer) { glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->getID()); }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTextureSubImage2D(m_id, level, x, y, width, height, format, type, data);
+    if (buffer) { glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); }
+}
+
+void Texture::download(std::vector<uint8_t>& data, GLint level, GLenum format, GLenum type) const {
+    if (level < 0 || level >= m_mipLevels) { throw std::runtime_error(std::format("Texture::download: mip level {} out of range [0 - {}]", level, m_mipLevels)); }
+
+    size_t faces = m_target == GL_TEXTURE_CUBE_MAP ? 6 : 1; // the faces of a cube map are read at once
+    size_t size  = getLevelSize(level) * faces;
+    if (format != 0) {
+        size_t channels = format == GL_RED ? 1 : format == GL_RG ? 2 : format == GL_RGB ? 3 : format == GL_RGBA ? 4 : 0;
+        size_t bytes    = type == GL_UNSIGNED_BYTE ? 1 : type == GL_HALF_FLOAT ? 2 : type == GL_FLOAT ? 4 : 0;
+        if (channels == 0 || bytes == 0 || isCompressed(m_internalFormat)) { throw std::runtime_error(std::format("Texture::download: can not convert {} into {}, {}", glMacro2Str(m_internalFormat), glMacro2Str(format), glMacro2Str(type))); }
+        size = static_cast<size_t>(getWidth(level)) * getHeight(level) * faces * channels * bytes;
+    }
+    size_t offset = data.size();
+    data.resize(offset + size);
+    if (isCompressed(m_internalFormat)) {
+        glGetCompressedTextureImage(m_id, level, static_cast<GLsizei>(size), data.data() + offset);
+        return;
+    }
+    if (format == 0) { std::tie(format, type) = getPixelFormat(m_internalFormat); }
+    if (format == 0) { throw std::runtime_error(std::format("Texture::download: no pixel format matches internal format {}", glMacro2Str(m_internalFormat))); }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTextureImage(m_id, level, format, type, static_cast<GLsizei>(size), data.data() + offset);
+}
+
+void Texture::download(const GraphicBuffer& buffer, GLintptr offset, GLint level) const {
+    if (buffer.getTarget() != GL_PIXEL_PACK_BUFFER) { throw std::runtime_error("Texture::download: buffer is not a pixel pack buffer"); }
+    if (level < 0 || level >= m_mipLevels) { throw std::runtime_error(std::format("Texture::download: mip level {} out of range [0 - {}]", level, m_mipLevels)); }
+    size_t size = getLevelSize(level);
+    if (offset < 0 || offset + static_cast<GLsizeiptr>(size) > buffer.getSize()) { throw std::runtime_error("Texture::download: offset or size out of buffer range"); }
+    auto [format, type] = getPixelFormat(m_internalFormat);
+    if (format == 0 || isCompressed(m_internalFormat)) { throw std::runtime_error(std::format("Texture::download: no pixel format matches internal format {}", glMacro2Str(m_internalFormat))); }
+
+    // While a buffer is bound to GL_PIXEL_PACK_BUFFER, the pixels pointer of glGetTextureImage is an offset into it
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.getID());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTextureImage(m_id, level, format, type, static_cast<GLsizei>(size), reinterpret_cast<void*>(offset));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
 void Texture::copy(const Texture& other, GLint srcLevel, GLint srcX, GLint srcY, GLint srcZ, GLint dstLevel, GLint dstX, GLint dstY, GLint dstZ) {
     if (dstLevel < 0 || dstLevel >= m_mipLevels || srcLevel < 0 || srcLevel >= other.m_mipLevels) { throw std::runtime_error(std::format("Texture::copy: dst mip level {} out of range [0 - {}] or src mip level {} out of range [0 - {}]", dstLevel, m_mipLevels - 1, srcLevel, other.m_mipLevels - 1)); }
 
@@ -238,13 +368,14 @@ void Texture::copy(const Texture& other, GLint srcLevel, GLint srcX, GLint srcY,
 
     auto srcTarget = other.m_target;
     auto dstTarget = m_target;
-    if (srcTarget != dstTarget) { throw std::runtime_error("Texture::copy: source texture target does not match destination texture target"); }
+    bool toLayer   = srcTarget == GL_TEXTURE_2D && dstTarget == GL_TEXTURE_2D_ARRAY; // a 2d texture copied into a layer of an array
+    if (srcTarget != dstTarget && !toLayer) { throw std::runtime_error("Texture::copy: source texture target does not match destination texture target"); }
 
     auto srcWidth  = other.getWidth(srcLevel);
     auto srcHeight = other.getHeight(srcLevel);
     auto dstWidth  = getWidth(dstLevel);
     auto dstHeight = getHeight(dstLevel);
-    auto dstDepth  = getDepth(dstLevel);
+    auto dstDepth  = toLayer ? 1 : std::min(other.getDepth(srcLevel), getDepth(dstLevel)); // layers of a smaller array fill the front of a larger one
     if (srcWidth > dstWidth || srcHeight > dstHeight) { throw std::runtime_error(std::format("Texture::copy: source texture size {}x{} does not match destination texture size {}x{} at level {}", srcWidth, srcHeight, dstWidth, dstHeight, dstLevel)); }
 
     // Copy texture data from source to destination
@@ -284,4 +415,183 @@ void Texture::generate() {
     if (m_mipLevels > 1) { glGenerateMipmap(m_id); }
 }
 
-} // namespace tinyglrenderer
\ No newline at end of file
+void Texture::trim(GLint levels) {
+    if (m_target != GL_TEXTURE_2D && m_target != GL_TEXTURE_2D_ARRAY) { throw std::runtime_error("Texture::trim: Texture target is not GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY"); }
+    if (levels <= 0 || levels >= m_mipLevels) { throw std::runtime_error(std::format("Texture::trim: levels {} out of range [1 - {}]", levels, m_mipLevels - 1)); }
+
+    // Immutable storage can not shrink, the remaining levels move into new storage and this object takes it over
+    auto smaller = m_target == GL_TEXTURE_2D ? Texture(getWidth(levels), getHeight(levels), m_target, m_internalFormat, m_mipLevels - levels)
+                                             : Texture(getWidth(levels), getHeight(levels), m_depth, m_target, m_internalFormat, m_mipLevels - levels);
+    for (GLint level = 0; level < smaller.m_mipLevels; level++) { smaller.copy(*this, level + levels, 0, 0, 0, level, 0, 0, 0); }
+    smaller.m_lastUsed = m_lastUsed;
+    *this = std::move(smaller);
+}
+
+size_t Texture::getByteSize() const {
+    size_t bytes = 0;
+    size_t faces = m_target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    bool blocks  = isCompressed(m_internalFormat); // compressed levels are stored in whole 4x4 blocks
+    for (GLint level = 0; level < m_mipLevels; level++) {
+        size_t w = blocks ? (getWidth(level) + 3) / 4 : getWidth(level);
+        size_t h = blocks ? (getHeight(level) + 3) / 4 : getHeight(level);
+        bytes += w * h * getDepth(level) * faces;
+    }
+    return bytes * (blocks ? getBlockSize(m_internalFormat) : getTexelSize(m_internalFormat));
+}
+
+size_t Texture::getLevelSize(GLint level) const {
+    if (isCompressed(m_internalFormat)) { return static_cast<size_t>((getWidth(level) + 3) / 4) * ((getHeight(level) + 3) / 4) * getBlockSize(m_internalFormat); }
+    return static_cast<size_t>(getWidth(level)) * getHeight(level) * getTexelSize(m_internalFormat);
+}
+
+GLsizei Texture::getMaxMipLevels(GLsizei width, GLsizei height, GLsizei depth) {
+    GLsizei size   = std::max({width, height, depth, 1});
+    GLsizei levels = 1;
+    while (size >>= 1) { levels++; }
+    return levels;
+}
+
+GLenum Texture::getInternalFormat(TextureUsage usage, GLenum type) {
+    switch (usage) {
+        case TextureUsage::TU_COLOR: return type == GL_FLOAT ? GL_RGBA16F : GL_SRGB8_ALPHA8;
+        case TextureUsage::TU_NORMAL: return type == GL_FLOAT ? GL_RG16F : (type == GL_UNSIGNED_SHORT ? GL_RG16 : GL_RG8);
+        default: return type == GL_FLOAT ? GL_RGB16F : (type == GL_UNSIGNED_SHORT ? GL_RGB16 : GL_RGB8);
+    }
+}
+
+GLenum Texture::getCompressedFormat(TextureUsage usage, bool alpha) {
+    switch (usage) {
+        case TextureUsage::TU_COLOR: return alpha ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+        case TextureUsage::TU_NORMAL: return GL_COMPRESSED_RG_RGTC2;
+        default: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+}
+
+size_t Texture::getBlockSize(GLenum internalFormat) {
+    switch (internalFormat) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RED_RGTC1:
+        case GL_COMPRESSED_SIGNED_RED_RGTC1: return 8;
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_RG_RGTC2:
+        case GL_COMPRESSED_SIGNED_RG_RGTC2:
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+        case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT: return 16;
+        default: return 0;
+    }
+}
+
+std::pair<GLenum, GLenum> Texture::getPixelFormat(GLenum internalFormat) {
+    switch (internalFormat) {
+        case GL_R8: return {GL_RED, GL_UNSIGNED_BYTE};
+        case GL_RG8: return {GL_RG, GL_UNSIGNED_BYTE};
+        case GL_RGB8:
+        case GL_SRGB8: return {GL_RGB, GL_UNSIGNED_BYTE};
+        case GL_RGBA8:
+        case GL_SRGB8_ALPHA8: return {GL_RGBA, GL_UNSIGNED_BYTE};
+        case GL_RG16: return {GL_RG, GL_UNSIGNED_SHORT};
+        case GL_RGB16: return {GL_RGB, GL_UNSIGNED_SHORT};
+        case GL_RGBA16: return {GL_RGBA, GL_UNSIGNED_SHORT};
+        case GL_R16F: return {GL_RED, GL_HALF_FLOAT};
+        case GL_RG16F: return {GL_RG, GL_HALF_FLOAT};
+        case GL_RGB16F: return {GL_RGB, GL_HALF_FLOAT};
+        case GL_RGBA16F: return {GL_RGBA, GL_HALF_FLOAT};
+        case GL_R32F: return {GL_RED, GL_FLOAT};
+        case GL_RG32F: return {GL_RG, GL_FLOAT};
+        case GL_RGB32F: return {GL_RGB, GL_FLOAT};
+        case GL_RGBA32F: return {GL_RGBA, GL_FLOAT};
+        case GL_RGB9_E5: return {GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV};
+        case GL_R11F_G11F_B10F: return {GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV};
+        default: return {0, 0};
+    }
+}
+
+size_t Texture::getTexelSize(GLenum internalFormat) {
+    switch (internalFormat) {
+        case GL_R8:
+        case GL_R8_SNORM:
+        case GL_R8UI:
+        case GL_R8I:
+        case GL_R3_G3_B2:
+        case GL_STENCIL_INDEX8: return 1;
+        case GL_R16:
+        case GL_R16_SNORM:
+        case GL_R16UI:
+        case GL_R16I:
+        case GL_R16F:
+        case GL_RG8:
+        case GL_RG8_SNORM:
+        case GL_RG8UI:
+        case GL_RG8I:
+        case GL_RGB565:
+        case GL_RGB5_A1:
+        case GL_RGBA4:
+        case GL_DEPTH_COMPONENT16: return 2;
+        case GL_RGB8:
+        case GL_RGB8_SNORM:
+        case GL_RGB8UI:
+        case GL_RGB8I:
+        case GL_SRGB8: return 3;
+        case GL_R32UI:
+        case GL_R32I:
+        case GL_R32F:
+        case GL_RG16:
+        case GL_RG16_SNORM:
+        case GL_RG16UI:
+        case GL_RG16I:
+        case GL_RG16F:
+        case GL_RGBA8:
+        case GL_RGBA8_SNORM:
+        case GL_RGBA8UI:
+        case GL_RGBA8I:
+        case GL_SRGB8_ALPHA8:
+        case GL_RGB10_A2:
+        case GL_RGB10_A2UI:
+        case GL_RGB9_E5:
+        case GL_R11F_G11F_B10F:
+        case GL_DEPTH_COMPONENT24: // stored in 4 bytes by drivers
+        case GL_DEPTH_COMPONENT32:
+        case GL_DEPTH_COMPONENT32F:
+        case GL_DEPTH24_STENCIL8: return 4;
+        case GL_RGB16:
+        case GL_RGB16_SNORM:
+        case GL_RGB16UI:
+        case GL_RGB16I:
+        case GL_RGB16F: return 6;
+        case GL_RG32UI:
+        case GL_RG32I:
+        case GL_RG32F:
+        case GL_RGBA16:
+        case GL_RGBA16_SNORM:
+        case GL_RGBA16UI:
+        case GL_RGBA16I:
+        case GL_RGBA16F:
+        case GL_DEPTH32F_STENCIL8: return 8; // 32 bits depth, 8 bits stencil and 24 bits padding
+        case GL_RGB32UI:
+        case GL_RGB32I:
+        case GL_RGB32F: return 12;
+        case GL_RGBA32UI:
+        case GL_RGBA32I:
+        case GL_RGBA32F: return 16;
+        default: break;
+    }
+
+    // Compressed formats are sized by blocks, any other format would be accounted as 0 bytes
+    if (!isCompressed(internalFormat)) {
+        static std::mutex mutex;
+        static std::unordered_set<GLenum> reported;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (reported.insert(internalFormat).second) { std::cout << "Texture::getTexelSize: unknown internal format " << glMacro2Str(internalFormat) << "(0x" << std::hex << internalFormat << std::dec << "), its size is not accounted\n"; }
+    }
+    return 0;
+}
+
+} // namespace tinyglrenderer
@@ -0,0 +1,193 @@
+#include "texturecache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+
+#include "utils.hpp"
+
+namespace tinyglrenderer {
+
+static constexpr size_t TEXTURE_CACHE_MAX_LEVELS = 16; // up to 32768x32768
+
+struct TextureCacheHeader {
+    char magic[8];          // "TGTEX\0\0\0"
+    uint32_t version;       // bumped when the layout or cooking changes
+    uint32_t internalFormat;
+    uint32_t width;         // size of level 0
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t faces;         // 6 for a cube map, 1 for a 2d texture(0 in files cooked before cube maps were cached)
+    uint64_t hash;          // content hash of source files
+    uint64_t levelOffsets[TEXTURE_CACHE_MAX_LEVELS];
+    uint64_t levelSizes[TEXTURE_CACHE_MAX_LEVELS];
+};
+
+static constexpr char TEXTURE_CACHE_MAGIC[8] = {'T', 'G', 'T', 'E', 'X', '\0', '\0', '\0'};
+static constexpr uint32_t TEXTURE_CACHE_VERSION = 1;
+static constexpr size_t TEXTURE_CACHE_ALIGNMENT = 16;
+static const fs::path TEXTURE_CACHE_DIR = "../cache/texture";
+
+// Expected payload size of a mip level, 0 if the internal format is unknown
+static size_t getLevelSize(GLenum internalFormat, GLsizei width, GLsizei height, GLint level) {
+    size_t w = std::max(width >> level, 1), h = std::max(height >> level, 1);
+    if (Texture::isCompressed(internalFormat)) { return (w + 3) / 4 * ((h + 3) / 4) * Texture::getBlockSize(internalFormat); }
+    return w * h * Texture::getTexelSize(internalFormat);
+}
+
+TextureCache::TextureCache(const fs::path& cachePath, uint64_t hash) : m_filepath(cachePath) {
+    std::error_code ec;
+    if (!fs::is_regular_file(cachePath, ec) || fs::file_size(cachePath, ec) < sizeof(TextureCacheHeader)) { return; }
+
+    m_file.emplace(cachePath);
+    const uint8_t* data = m_file->getData();
+    size_t size = m_file->getSize();
+
+    // 1. Check header against source, format and file size
+    TextureCacheHeader header;
+    std::memcpy(&header, data, sizeof(TextureCacheHeader));
+    auto inside = [size](uint64_t offset, uint64_t length) { return offset <= size && length <= size - offset; };
+    if (std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(TEXTURE_CACHE_MAGIC)) != 0 || header.version != TEXTURE_CACHE_VERSION || header.hash != hash) { return; }
+    if (header.width == 0 || header.height == 0 || header.mipLevels == 0 || header.mipLevels > TEXTURE_CACHE_MAX_LEVELS ||
+        header.mipLevels > static_cast<uint32_t>(Texture::getMaxMipLevels(header.width, header.height))) {
+        return;
+    }
+    if (Texture::getPixelFormat(header.internalFormat).first == 0 && !Texture::isCompressed(header.internalFormat)) { return; }
+    uint32_t faces = std::max(header.faces, 1u);
+    if (faces != 1 && (faces != 6 || header.width != header.height)) { return; }
+
+    // 2. Every level must hold exactly the payload its size takes
+    for (uint32_t level = 0; level < header.mipLevels; level++) {
+        uint64_t expected = getLevelSize(header.internalFormat, header.width, header.height, level) * faces;
+        if (header.levelSizes[level] != expected || !inside(header.levelOffsets[level], header.levelSizes[level])) { return; }
+        m_levels.push_back({header.levelOffsets[level], header.levelSizes[level]});
+    }
+
+    m_internalFormat = header.internalFormat;
+    m_width          = static_cast<GLsizei>(header.width);
+    m_height         = static_cast<GLsizei>(header.height);
+    m_faces          = static_cast<GLsizei>(faces);
+    m_valid          = true;
+}
+
+size_t TextureCache::getByteSize() const {
+    size_t bytes = 0;
+    for (auto& level : m_levels) { bytes += level.size; }
+    return bytes;
+}
+
+std::span<const uint8_t> TextureCache::getLevel(GLint level) const {
+    if (!m_valid || level < 0 || level >= static_cast<GLint>(m_levels.size())) { throw std::runtime_error(std::format("TextureCache::getLevel: mip level {} out of range [0 - {}]", level, m_levels.size())); }
+    return {m_file->getData() + m_levels[level].offset, m_levels[level].size};
+}
+
+std::shared_ptr<Texture> TextureCache::createTexture() const {
+    if (!m_valid) { throw std::runtime_error("TextureCache::createTexture: Invalid texture cache: " + m_filepath.string()); }
+
+    auto texture = std::make_shared<Texture>(m_width, m_height, getTarget(), m_internalFormat, static_cast<GLsizei>(m_levels.size()));
+    upload(*texture);
+    return texture;
+}
+
+void TextureCache::upload(Texture& texture) const {
+    if (!m_valid) { throw std::runtime_error("TextureCache::upload: Invalid texture cache: " + m_filepath.string()); }
+    if (texture.getTarget() != getTarget() || texture.getInternalFormat() != m_internalFormat || texture.getWidth(0) != m_width || texture.getHeight(0) != m_height || texture.getMipLevels() != getMipLevels()) {
+        throw std::runtime_error("TextureCache::upload: Texture does not match texture cache: " + m_filepath.string());
+    }
+    for (GLint level = 0; level < static_cast<GLint>(m_levels.size()); level++) {
+        texture.upload(m_file->getData() + m_levels[level].offset, m_levels[level].size, level);
+    }
+}
+
+bool TextureCache::save(const fs::path& cachePath, uint64_t hash, GLenum internalFormat, GLsizei width, GLsizei height, const std::vector<std::span<const uint8_t>>& levels, GLenum target) {
+    if (levels.empty() || levels.size() > TEXTURE_CACHE_MAX_LEVELS) { return false; }
+
+    // 1. Lay out levels after header
+    auto align = [](uint64_t offset) { return (offset + TEXTURE_CACHE_ALIGNMENT - 1) / TEXTURE_CACHE_ALIGNMENT * TEXTURE_CACHE_ALIGNMENT; };
+
+    TextureCacheHeader header = {};
+    std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(TEXTURE_CACHE_MAGIC));
+    header.version        = TEXTURE_CACHE_VERSION;
+    header.internalFormat = internalFormat;
+    header.width          = static_cast<uint32_t>(width);
+    header.height         = static_cast<uint32_t>(height);
+    header.mipLevels      = static_cast<uint32_t>(levels.size());
+    header.faces          = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    header.hash           = hash;
+    uint64_t offset       = align(sizeof(TextureCacheHeader));
+    for (size_t level = 0; level < levels.size(); level++) {
+        header.levelOffsets[level] = offset;
+        header.levelSizes[level]   = levels[level].size();
+        offset                     = align(offset + levels[level].size());
+    }
+
+    // 2. Write the header and every level at its aligned offset
+    return writeFileAtomically(cachePath, [&](std::ofstream& file) {
+        auto writeAt = [&file](uint64_t offset, const void* bytes, uint64_t length) {
+            static const char zeros[TEXTURE_CACHE_ALIGNMENT] = {};
+            file.write(zeros, offset - static_cast<uint64_t>(file.tellp())); // padding up to aligned offset
+            file.write(static_cast<const char*>(bytes), length);
+        };
+        writeAt(0, &header, sizeof(TextureCacheHeader));
+        for (size_t level = 0; level < levels.size(); level++) { writeAt(header.levelOffsets[level], levels[level].data(), levels[level].size()); }
+        return true;
+    });
+}
+
+bool TextureCache::save(const fs::path& cachePath, uint64_t hash, const CompressedImage& image) {
+    std::vector<std::span<const uint8_t>> levels;
+    for (GLint level = 0; level < image.getMipLevels(); level++) { levels.emplace_back(image.getData(level), image.getSize(level)); }
+    return save(cachePath, hash, image.getInternalFormat(), image.getWidth(0), image.getHeight(0), levels);
+}
+
+bool TextureCache::save(const fs::path& cachePath, uint64_t hash, const Texture& texture) {
+    if (texture.getTarget() != GL_TEXTURE_2D && texture.getTarget() != GL_TEXTURE_CUBE_MAP) { return false; }
+
+    std::vector<uint8_t> payload;
+    std::vector<size_t> sizes;
+    for (GLint level = 0; level < texture.getMipLevels(); level++) {
+        size_t offset = payload.size();
+        texture.download(payload, level);
+        sizes.push_back(payload.size() - offset);
+    }
+    std::vector<std::span<const uint8_t>> levels;
+    for (size_t level = 0, offset = 0; level < sizes.size(); offset += sizes[level++]) { levels.emplace_back(payload.data() + offset, sizes[level]); }
+    return save(cachePath, hash, texture.getInternalFormat(), texture.getWidth(0), texture.getHeight(0), levels, texture.getTarget());
+}
+
+uint64_t TextureCache::hash(const std::vector<fs::path>& texPaths) {
+    uint64_t hash = MappedFile::hash(nullptr, 0);
+    for (auto& texPath : texPaths) {
+        MappedFile file(texPath);
+        hash = MappedFile::hash(file.getData(), file.getSize(), hash);
+    }
+    return hash;
+}
+
+fs::path TextureCache::getCachePath(const std::vector<fs::path>& texPaths, const std::string& options, uint64_t hash) {
+    std::string key = options;
+    for (auto& texPath : texPaths) { key += "|" + fs::weakly_canonical(texPath).string(); }
+    std::string stem = texPaths.empty() ? "texture" : texPaths[0].stem().string();
+    return TEXTURE_CACHE_DIR / std::format("{}-{:016x}-{:016x}.tgtex", stem, MappedFile::hash(key.data(), key.size()), hash);
+}
+
+size_t TextureCache::invalidate(const fs::path& cachePath) {
+    // Cooked files of the same key share the name up to the content hash
+    std::string name   = cachePath.filename().string();
+    std::string prefix = name.substr(0, name.find_last_of('-') + 1);
+
+    std::error_code ec;
+    size_t removed = 0;
+    for (auto it = fs::directory_iterator(cachePath.parent_path(), ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        std::string other = it->path().filename().string();
+        if (other != name && other.starts_with(prefix) && it->path().extension() == cachePath.extension()) {
+            std::error_code removeError;
+            if (fs::remove(it->path(), removeError)) { removed++; }
+        }
+    }
+    return removed;
+}
+
+} // namespace tinyglrenderer
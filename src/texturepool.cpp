@@ -0,0 +1,119 @@
+#include "texturepool.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace tinyglrenderer {
+
+static constexpr GLsizei TEXTURE_POOL_INITIAL_LAYERS = 4; // layers of a new bucket, doubled when it is full
+
+TexturePool::Layer::~Layer() { m_bucket->free.push_back(m_index); }
+
+std::shared_ptr<TexturePool::Layer> TexturePool::add(const Texture& texture) {
+    if (texture.getTarget() != GL_TEXTURE_2D) { throw std::runtime_error("TexturePool::add: Texture target is not GL_TEXTURE_2D"); }
+    GLsizei width     = texture.getWidth(0);
+    GLsizei height    = texture.getHeight(0);
+    GLenum format     = texture.getInternalFormat();
+    GLsizei mipLevels = texture.getMipLevels();
+
+    // 1. Find the bucket of the texture, or create one(in an empty bucket first) while texture units are left
+    auto it = std::find_if(m_buckets.begin(), m_buckets.end(), [&](const std::shared_ptr<Bucket>& bucket) {
+        return bucket->array && bucket->width == width && bucket->height == height && bucket->format == format && bucket->mipLevels == mipLevels;
+    });
+    if (it == m_buckets.end()) {
+        it = std::find_if(m_buckets.begin(), m_buckets.end(), [](const std::shared_ptr<Bucket>& bucket) { return bucket->array == nullptr; });
+        if (it == m_buckets.end()) {
+            if (m_buckets.size() >= MAX_BUCKETS) { return nullptr; }
+            m_buckets.push_back(nullptr);
+            it = m_buckets.end() - 1;
+        }
+        // An empty bucket holds no layer anymore, it takes the new key with fresh state
+        *it          = std::make_shared<Bucket>(Bucket{width, height, format, mipLevels});
+        (*it)->array = std::make_shared<Texture>(width, height, TEXTURE_POOL_INITIAL_LAYERS, GL_TEXTURE_2D_ARRAY, format, mipLevels);
+    }
+    auto& bucket  = *it;
+    GLint trimmed = mipLevels - bucket->array->getMipLevels(); // top levels dropped from the array under memory budget
+
+    // 2. Take a released layer, or the next one, doubling the array when all layers are taken
+    GLint index = -1;
+    if (!bucket->free.empty()) {
+        index = bucket->free.back();
+        bucket->free.pop_back();
+    } else {
+        GLsizei layers = bucket->array->getDepth(0);
+        if (bucket->next == layers) {
+            static GLint maxLayers = 0;
+            if (maxLayers == 0) { glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers); }
+            if (layers >= std::min(maxLayers, 0x10000)) { return nullptr; } // layer must fit the low 16 bits of handle
+
+            auto& old = *bucket->array;
+            Texture array(old.getWidth(0), old.getHeight(0), std::min(layers * 2, maxLayers), GL_TEXTURE_2D_ARRAY, format, old.getMipLevels());
+            for (GLint level = 0; level < old.getMipLevels(); level++) { array.copy(old, level, 0, 0, 0, level, 0, 0, 0); }
+            old = std::move(array); // the array object is shared with the budget of resource manager, keep it and swap its storage
+        }
+        index = bucket->next++;
+    }
+
+    // 3. Copy every mip level the array keeps into the layer, texels never leave video memory
+    for (GLint level = 0; level < bucket->array->getMipLevels(); level++) { bucket->array->copy(texture, level + trimmed, 0, 0, 0, level, 0, 0, index); }
+    return std::make_shared<Layer>(bucket, static_cast<uint32_t>(it - m_buckets.begin()), index);
+}
+
+size_t TexturePool::compact() {
+    size_t released = 0;
+    for (auto& bucket : m_buckets) {
+        if (bucket->array == nullptr) { continue; }
+
+        // 1. Drop free layers at the end, an empty bucket releases its array and its texture unit is taken by the next new key
+        auto& free = bucket->free;
+        for (auto it = std::find(free.begin(), free.end(), bucket->next - 1); it != free.end(); it = std::find(free.begin(), free.end(), bucket->next - 1)) {
+            free.erase(it);
+            bucket->next--;
+            released++;
+        }
+        if (bucket->next == 0) {
+            bucket->array = nullptr;
+            continue;
+        }
+
+        // 2. Halve the array while the used layers fit, they are the front layers
+        auto& old      = *bucket->array;
+        GLsizei layers = old.getDepth(0);
+        while (layers / 2 >= std::max(bucket->next, TEXTURE_POOL_INITIAL_LAYERS)) { layers /= 2; }
+        if (layers == old.getDepth(0)) { continue; }
+        Texture array(old.getWidth(0), old.getHeight(0), layers, GL_TEXTURE_2D_ARRAY, old.getInternalFormat(), old.getMipLevels());
+        for (GLint level = 0; level < old.getMipLevels(); level++) { array.copy(old, level, 0, 0, 0, level, 0, 0, 0); }
+        old = std::move(array);
+    }
+    return released;
+}
+
+void TexturePool::bind(GLuint slot) const {
+    for (size_t i = 0; i < m_buckets.size(); i++) {
+        if (m_buckets[i]->array) { m_buckets[i]->array->bind(slot + static_cast<GLuint>(i)); }
+    }
+}
+
+void TexturePool::getArrays(std::vector<std::shared_ptr<Texture>>& arrays) const {
+    for (auto& bucket : m_buckets) {
+        if (bucket->array) { arrays.push_back(bucket->array); }
+    }
+}
+
+size_t TexturePool::getBucketCount() const {
+    return std::count_if(m_buckets.begin(), m_buckets.end(), [](const std::shared_ptr<Bucket>& bucket) { return bucket->array != nullptr; });
+}
+
+size_t TexturePool::getLayerCount() const {
+    size_t count = 0;
+    for (auto& bucket : m_buckets) { count += bucket->next - bucket->free.size(); }
+    return count;
+}
+
+size_t TexturePool::getByteSize() const {
+    size_t size = 0;
+    for (auto& bucket : m_buckets) { size += bucket->array ? bucket->array->getByteSize() : 0; }
+    return size;
+}
+
+} // namespace tinyglrenderer
@@ -1,14 +1,25 @@
 #include "utils.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "texture.hpp" // S3TC formats
+
 namespace tinyglrenderer {
 
+// Cap of parallelFor threads on this thread, 0 means none
+static thread_local unsigned t_parallelLimit = 0;
+
 std::ostream& operator<<(std::ostream& stream, const glm::vec3& vec) {
     stream << vec.x << ' ' << vec.y << ' ' << vec.z;
     return stream;
@@ -50,6 +61,8 @@ const char* glMacro2Str(GLenum value) {
         case GL_UNSIGNED_SHORT_5_6_5:   return "GL_UNSIGNED_SHORT_5_6_5";
         case GL_UNSIGNED_SHORT_4_4_4_4: return "GL_UNSIGNED_SHORT_4_4_4_4";
         case GL_UNSIGNED_SHORT_5_5_5_1: return "GL_UNSIGNED_SHORT_5_5_5_1";
+        case GL_UNSIGNED_INT_5_9_9_9_REV:      return "GL_UNSIGNED_INT_5_9_9_9_REV";
+        case GL_UNSIGNED_INT_10F_11F_11F_REV:  return "GL_UNSIGNED_INT_10F_11F_11F_REV";
         // format 
         case GL_RED:                    return "GL_RED";
         case GL_RG:                     return "GL_RG";
@@ -65,14 +78,36 @@ const char* glMacro2Str(GLenum value) {
         case GL_R16F:                   return "GL_R16F";
         case GL_R32F:                   return "GL_R32F";
         case GL_RG8:                    return "GL_RG8";
+        case GL_RG16:                   return "GL_RG16";
         case GL_RG16F:                  return "GL_RG16F";
         case GL_RG32F:                  return "GL_RG32F";
         case GL_RGB8:                   return "GL_RGB8";
+        case GL_RGB16:                  return "GL_RGB16";
         case GL_RGB16F:                 return "GL_RGB16F";
         case GL_RGB32F:                 return "GL_RGB32F";
+        case GL_RGB9_E5:                return "GL_RGB9_E5";
+        case GL_R11F_G11F_B10F:         return "GL_R11F_G11F_B10F";
         case GL_RGBA8:                  return "GL_RGBA8";
+        case GL_SRGB8_ALPHA8:           return "GL_SRGB8_ALPHA8";
+        case GL_RGBA16:                 return "GL_RGBA16";
         case GL_RGBA16F:                return "GL_RGBA16F";
         case GL_RGBA32F:                return "GL_RGBA32F";
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:         return "GL_COMPRESSED_RGB_S3TC_DXT1_EXT";
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:        return "GL_COMPRESSED_RGBA_S3TC_DXT1_EXT";
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:        return "GL_COMPRESSED_RGBA_S3TC_DXT3_EXT";
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:        return "GL_COMPRESSED_RGBA_S3TC_DXT5_EXT";
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:        return "GL_COMPRESSED_SRGB_S3TC_DXT1_EXT";
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:  return "GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT";
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:  return "GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT";
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:  return "GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT";
+        case GL_COMPRESSED_RED_RGTC1:                 return "GL_COMPRESSED_RED_RGTC1";
+        case GL_COMPRESSED_SIGNED_RED_RGTC1:          return "GL_COMPRESSED_SIGNED_RED_RGTC1";
+        case GL_COMPRESSED_RG_RGTC2:                  return "GL_COMPRESSED_RG_RGTC2";
+        case GL_COMPRESSED_SIGNED_RG_RGTC2:           return "GL_COMPRESSED_SIGNED_RG_RGTC2";
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:           return "GL_COMPRESSED_RGBA_BPTC_UNORM";
+        case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:     return "GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM";
+        case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:     return "GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT";
+        case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:   return "GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT";
         case GL_DEPTH_COMPONENT16:      return "GL_DEPTH_COMPONENT16";
         case GL_DEPTH_COMPONENT24:      return "GL_DEPTH_COMPONENT24";
         case GL_DEPTH_COMPONENT32F:     return "GL_DEPTH_COMPONENT32F";
@@ -93,4 +128,61 @@ const char* glMacro2Str(GLenum value) {
     }
 }
 
+unsigned getParallelThreads(unsigned threads) {
+    unsigned count = threads ? threads : std::thread::hardware_concurrency();
+    if (t_parallelLimit != 0) { count = std::min(count, t_parallelLimit); }
+    return std::max(count, 1u);
+}
+
+unsigned setParallelLimit(unsigned threads) { return std::exchange(t_parallelLimit, threads); }
+
+void parallelFor(size_t count, unsigned threads, const std::function<void(size_t item)>& body) {
+    std::atomic<size_t> next = 0;
+    std::exception_ptr error;
+    std::mutex mutex;
+    auto work = [&]() {
+        unsigned limit = setParallelLimit(1); // body runs in parallel already, its own fan-outs stay on this thread
+        for (size_t i = next++; i < count; i = next++) {
+            try {
+                body(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) { error = std::current_exception(); }
+                next = count;
+            }
+        }
+        setParallelLimit(limit);
+    };
+
+    unsigned helpers = static_cast<unsigned>(std::min<size_t>(getParallelThreads(threads), std::max<size_t>(count, 1))) - 1;
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < helpers; i++) { workers.emplace_back(work); }
+    work();
+    for (auto& worker : workers) { worker.join(); }
+    if (error) { std::rethrow_exception(error); }
+}
+
+bool writeFileAtomically(const std::filesystem::path& path, const std::function<bool(std::ofstream& file)>& writer) {
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream file{tmpPath, std::ios::binary | std::ios::trunc};
+        if (!file.is_open()) {
+            std::cout << "Could not write file [" << path << "]\n";
+            return false;
+        }
+        bool written = writer(file);
+        if (written && !file.good()) { std::cout << "Could not write file [" << path << "]\n"; }
+        if (!written || !file.good()) {
+            file.close();
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
 }  // namespace tinyglrenderer
@@ -0,0 +1,254 @@
+#include "virtualtexture.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+
+#include "image.hpp"
+#include "utils.hpp"
+
+namespace tinyglrenderer {
+
+struct VirtualTextureHeader {
+    char magic[8];           // "TGVT\0\0\0\0"
+    uint32_t version;        // bumped when the layout or cooking changes
+    uint32_t internalFormat;
+    uint32_t pageCountX;     // pages of level 0
+    uint32_t pageCountY;
+    uint32_t mipLevels;
+    uint32_t pageSize;       // texels of a page without border
+    uint32_t pageBorder;
+    uint32_t reserved;
+    uint64_t hash;           // content hash of source image
+};
+
+static constexpr char VIRTUAL_TEXTURE_MAGIC[8] = {'T', 'G', 'V', 'T', '\0', '\0', '\0', '\0'};
+static constexpr uint32_t VIRTUAL_TEXTURE_VERSION = 1;
+static constexpr size_t VIRTUAL_TEXTURE_ALIGNMENT = 16;
+static constexpr GLsizei VIRTUAL_TEXTURE_MAX_PAGES = 256; // page coordinates are stored in 8 bits
+static constexpr size_t VIRTUAL_TEXTURE_TEXEL_SIZE = 4;   // GL_RGB9_E5 or GL_SRGB8_ALPHA8
+static const fs::path VIRTUAL_TEXTURE_DIR = "../cache/vtex";
+
+static uint64_t alignOffset(uint64_t offset) { return (offset + VIRTUAL_TEXTURE_ALIGNMENT - 1) / VIRTUAL_TEXTURE_ALIGNMENT * VIRTUAL_TEXTURE_ALIGNMENT; }
+
+size_t VirtualTexture::getPageByteSize() {
+    size_t size = PAGE_SIZE + 2 * PAGE_BORDER;
+    return size * size * VIRTUAL_TEXTURE_TEXEL_SIZE;
+}
+
+VirtualTexture::VirtualTexture(const fs::path& cachePath, uint64_t hash, GLsizei atlasSlots) : m_filepath(cachePath), m_atlasSlots(std::clamp(atlasSlots, 1, VIRTUAL_TEXTURE_MAX_PAGES)) {
+    std::error_code ec;
+    if (!fs::is_regular_file(cachePath, ec) || fs::file_size(cachePath, ec) < sizeof(VirtualTextureHeader)) { return; }
+
+    m_file.emplace(cachePath);
+    VirtualTextureHeader header;
+    std::memcpy(&header, m_file->getData(), sizeof(VirtualTextureHeader));
+
+    // 1. Check header against source, page layout and file size
+    if (std::memcmp(header.magic, VIRTUAL_TEXTURE_MAGIC, sizeof(VIRTUAL_TEXTURE_MAGIC)) != 0 || header.version != VIRTUAL_TEXTURE_VERSION || header.hash != hash) { return; }
+    if (header.pageSize != PAGE_SIZE || header.pageBorder != PAGE_BORDER || (header.internalFormat != GL_RGB9_E5 && header.internalFormat != GL_SRGB8_ALPHA8)) { return; }
+    if (header.pageCountX == 0 || header.pageCountY == 0 || header.pageCountX > VIRTUAL_TEXTURE_MAX_PAGES || header.pageCountY > VIRTUAL_TEXTURE_MAX_PAGES) { return; }
+    m_internalFormat = header.internalFormat;
+    m_pageCountX     = static_cast<GLsizei>(header.pageCountX);
+    m_pageCountY     = static_cast<GLsizei>(header.pageCountY);
+    m_mipLevels      = Texture::getMaxMipLevels(m_pageCountX, m_pageCountY);
+    if (header.mipLevels != static_cast<uint32_t>(m_mipLevels)) { return; }
+
+    size_t pages = 0;
+    for (GLint level = 0; level < m_mipLevels; level++) {
+        m_levelPages.push_back(pages);
+        pages += static_cast<size_t>(getPageCountX(level)) * getPageCountY(level);
+    }
+    m_dataOffset = alignOffset(sizeof(VirtualTextureHeader));
+    if (m_file->getSize() != m_dataOffset + pages * getPageByteSize()) { return; }
+    m_valid = true;
+
+    // 2. Create page table(one texel per page of each level) and atlas(slots of pages with their borders)
+    GLsizei slotSize = PAGE_SIZE + 2 * PAGE_BORDER;
+    m_pageTable      = std::make_shared<Texture>(m_pageCountX, m_pageCountY, GL_TEXTURE_2D, GL_RGBA8, m_mipLevels);
+    m_atlas          = std::make_shared<Texture>(m_atlasSlots * slotSize, m_atlasSlots * slotSize, GL_TEXTURE_2D, m_internalFormat, 1);
+    m_slots.resize(static_cast<size_t>(m_atlasSlots) * m_atlasSlots);
+
+    // 3. Pin the single page of the coarsest level, every page falls back to it until a finer one is resident
+    uint32_t root = makePage(m_mipLevels - 1, 0, 0);
+    map(root, getPage(root).data());
+    m_slots[m_resident[root]].pinned = true;
+    commit();
+}
+
+size_t VirtualTexture::getPageIndex(uint32_t page) const {
+    GLint level = getPageLevel(page), x = getPageX(page), y = getPageY(page);
+    if (level >= m_mipLevels || x >= getPageCountX(level) || y >= getPageCountY(level)) { throw std::runtime_error(std::format("VirtualTexture::getPageIndex: page ({}, {}) of level {} out of range", x, y, level)); }
+    return m_levelPages[level] + static_cast<size_t>(y) * getPageCountX(level) + x;
+}
+
+std::span<const uint8_t> VirtualTexture::getPage(uint32_t page) const {
+    if (!m_valid) { throw std::runtime_error("VirtualTexture::getPage: Invalid page file: " + m_filepath.string()); }
+    return {m_file->getData() + m_dataOffset + getPageIndex(page) * getPageByteSize(), getPageByteSize()};
+}
+
+void VirtualTexture::touch(uint32_t page) {
+    for (GLint level = getPageLevel(page), x = getPageX(page), y = getPageY(page); level < m_mipLevels; level++, x >>= 1, y >>= 1) {
+        x        = std::min(x, getPageCountX(level) - 1);
+        y        = std::min(y, getPageCountY(level) - 1);
+        auto it  = m_resident.find(makePage(level, x, y));
+        if (it != m_resident.end()) { m_slots[it->second].lastUsed = m_frame; }
+    }
+}
+
+std::vector<uint32_t> VirtualTexture::request(const uint8_t* feedback, size_t count, size_t limit) {
+    m_frame++;
+
+    // 1. Gather requested pages and their ancestors, so coarser fallbacks arrive before the finest pages
+    std::unordered_set<uint32_t> requested;
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* texel = feedback + i * 4;
+        if (texel[3] == 0) { continue; } // nothing sampled behind this feedback texel
+        GLint x = texel[0], y = texel[1], level = texel[2];
+        if (level >= m_mipLevels || x >= getPageCountX(level) || y >= getPageCountY(level)) { continue; }
+        if (!requested.insert(makePage(level, x, y)).second) { continue; }
+        touch(makePage(level, x, y));
+        for (level++, x >>= 1, y >>= 1; level < m_mipLevels; level++, x >>= 1, y >>= 1) {
+            if (!requested.insert(makePage(level, std::min(x, getPageCountX(level) - 1), std::min(y, getPageCountY(level) - 1))).second) { break; }
+        }
+    }
+
+    // 2. Pages neither resident nor being read are streamed, coarser levels first
+    std::vector<uint32_t> missing;
+    for (uint32_t page : requested) {
+        if (!m_resident.count(page) && !m_pending.count(page)) { missing.push_back(page); }
+    }
+    std::sort(missing.begin(), missing.end(), [](uint32_t a, uint32_t b) { return getPageLevel(a) != getPageLevel(b) ? getPageLevel(a) > getPageLevel(b) : a < b; });
+    if (missing.size() > limit) { missing.resize(limit); }
+    m_pending.insert(missing.begin(), missing.end());
+    return missing;
+}
+
+void VirtualTexture::map(uint32_t page, const void* data, const GraphicBuffer* buffer) {
+    m_pending.erase(page);
+    if (m_resident.count(page)) { return; }
+
+    // 1. Take a free slot, or evict the least recently used page not sampled in current frame
+    // When every slot is in use the page is dropped, it is requested again by later feedback
+    size_t best = m_slots.size();
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        const Slot& slot = m_slots[i];
+        if (slot.pinned) { continue; }
+        if (slot.page == UINT32_MAX) {
+            best = i;
+            break;
+        }
+        if (slot.lastUsed < m_frame && (best == m_slots.size() || slot.lastUsed < m_slots[best].lastUsed)) { best = i; }
+    }
+    if (best == m_slots.size()) { return; }
+    if (m_slots[best].page != UINT32_MAX) { m_resident.erase(m_slots[best].page); }
+
+    // 2. Copy the page with its border into the slot
+    GLsizei slotSize = PAGE_SIZE + 2 * PAGE_BORDER;
+    m_atlas->upload(data, static_cast<GLint>(best % m_atlasSlots) * slotSize, static_cast<GLint>(best / m_atlasSlots) * slotSize, slotSize, slotSize, 0, buffer);
+    m_slots[best]   = Slot{.page = page, .lastUsed = m_frame};
+    m_resident[page] = best;
+    m_dirty          = true;
+}
+
+void VirtualTexture::commit() {
+    if (!m_dirty) { return; }
+    m_dirty = false;
+
+    // Coarsest level first, a page not resident takes the entry of its parent(slot x, slot y, resident level, valid)
+    std::vector<uint8_t> parent, entries;
+    for (GLint level = m_mipLevels - 1; level >= 0; level--) {
+        GLsizei countX = getPageCountX(level), countY = getPageCountY(level);
+        GLsizei parentX = level + 1 < m_mipLevels ? getPageCountX(level + 1) : 1, parentY = level + 1 < m_mipLevels ? getPageCountY(level + 1) : 1;
+        entries.assign(static_cast<size_t>(countX) * countY * 4, 0);
+        for (GLint y = 0; y < countY; y++) {
+            for (GLint x = 0; x < countX; x++) {
+                uint8_t* entry = entries.data() + (static_cast<size_t>(y) * countX + x) * 4;
+                auto it        = m_resident.find(makePage(level, x, y));
+                if (it != m_resident.end()) {
+                    entry[0] = static_cast<uint8_t>(it->second % m_atlasSlots);
+                    entry[1] = static_cast<uint8_t>(it->second / m_atlasSlots);
+                    entry[2] = static_cast<uint8_t>(level);
+                    entry[3] = 255;
+                } else if (!parent.empty()) {
+                    std::memcpy(entry, parent.data() + (static_cast<size_t>(std::min(y >> 1, parentY - 1)) * parentX + std::min(x >> 1, parentX - 1)) * 4, 4);
+                }
+            }
+        }
+        m_pageTable->upload(entries.data(), entries.size(), level);
+        std::swap(parent, entries);
+    }
+}
+
+bool VirtualTexture::cook(const fs::path& imagePath, const fs::path& cachePath, uint64_t hash, bool flip) {
+    // 1. Decode image, HDR texels stay float and the rest are expanded to rgba
+    auto image = Image::create(imagePath, 0, flip);
+    bool hdr   = image->getDataType() == GL_FLOAT;
+    if (!hdr && image->getDataType() != GL_UNSIGNED_BYTE) {
+        std::cout << "Could not cook virtual texture [" << imagePath << "], only 8 bits and HDR images are supported\n";
+        return false;
+    }
+    if (!hdr && image->getChannels() != 4) { image = Image::merge({image}, 4); }
+
+    VirtualTextureHeader header = {};
+    std::memcpy(header.magic, VIRTUAL_TEXTURE_MAGIC, sizeof(VIRTUAL_TEXTURE_MAGIC));
+    header.version        = VIRTUAL_TEXTURE_VERSION;
+    header.internalFormat = hdr ? GL_RGB9_E5 : Texture::getInternalFormat(TextureUsage::TU_COLOR, GL_UNSIGNED_BYTE);
+    header.pageCountX     = static_cast<uint32_t>((image->getWidth() + PAGE_SIZE - 1) / PAGE_SIZE);
+    header.pageCountY     = static_cast<uint32_t>((image->getHeight() + PAGE_SIZE - 1) / PAGE_SIZE);
+    header.mipLevels      = static_cast<uint32_t>(Texture::getMaxMipLevels(header.pageCountX, header.pageCountY));
+    header.pageSize       = PAGE_SIZE;
+    header.pageBorder     = PAGE_BORDER;
+    header.hash           = hash;
+    if (header.pageCountX > VIRTUAL_TEXTURE_MAX_PAGES || header.pageCountY > VIRTUAL_TEXTURE_MAX_PAGES) {
+        std::cout << "Could not cook virtual texture [" << imagePath << "], larger than " << VIRTUAL_TEXTURE_MAX_PAGES * PAGE_SIZE << " texels\n";
+        return false;
+    }
+
+    // 2. Write the header, then the pages of every level
+    return writeFileAtomically(cachePath, [&](std::ofstream& file) {
+        static const char zeros[VIRTUAL_TEXTURE_ALIGNMENT] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(VirtualTextureHeader));
+        file.write(zeros, alignOffset(sizeof(VirtualTextureHeader)) - sizeof(VirtualTextureHeader));
+
+        // 3. Each level is resampled from the previous one to a whole count of pages, then cut into pages
+        // Borders wrap around the image edges, which suits both equirect maps and repeated material textures
+        GLsizei slotSize = PAGE_SIZE + 2 * PAGE_BORDER;
+        std::vector<uint32_t> page(static_cast<size_t>(slotSize) * slotSize);
+        std::vector<GLsizei> columns(slotSize);
+        std::shared_ptr<Image> levelImage = image;
+        for (GLint level = 0; level < static_cast<GLint>(header.mipLevels); level++) {
+            GLsizei countX = std::max(static_cast<GLsizei>(header.pageCountX) >> level, 1), countY = std::max(static_cast<GLsizei>(header.pageCountY) >> level, 1);
+            GLsizei width = countX * PAGE_SIZE, height = countY * PAGE_SIZE;
+            if (levelImage->getWidth() != width || levelImage->getHeight() != height) { levelImage = Image::resize(levelImage, width, height); }
+            if (levelImage == nullptr) {
+                std::cout << "Could not resize virtual texture [" << imagePath << "] at level " << level << "\n";
+                return false;
+            }
+            auto texels         = hdr ? Image::convert(levelImage, GL_UNSIGNED_INT_5_9_9_9_REV) : levelImage; // 4 bytes per texel either way
+            const uint32_t* src = static_cast<const uint32_t*>(texels->getData());
+
+            for (GLsizei py = 0; py < countY; py++) {
+                for (GLsizei px = 0; px < countX; px++) {
+                    for (GLsizei c = 0; c < slotSize; c++) { columns[c] = (px * PAGE_SIZE + c - PAGE_BORDER + width) % width; }
+                    for (GLsizei r = 0; r < slotSize; r++) {
+                        const uint32_t* row = src + static_cast<size_t>((py * PAGE_SIZE + r - PAGE_BORDER + height) % height) * width;
+                        uint32_t* dst       = page.data() + static_cast<size_t>(r) * slotSize;
+                        for (GLsizei c = 0; c < slotSize; c++) { dst[c] = row[columns[c]]; }
+                    }
+                    file.write(reinterpret_cast<const char*>(page.data()), page.size() * sizeof(uint32_t));
+                }
+            }
+        }
+        return true;
+    });
+}
+
+fs::path VirtualTexture::getCachePath(const fs::path& imagePath, uint64_t hash) {
+    std::string key = std::format("p{}b{}|{}", PAGE_SIZE, PAGE_BORDER, fs::weakly_canonical(imagePath).string());
+    return VIRTUAL_TEXTURE_DIR / std::format("{}-{:016x}-{:016x}.tgvt", imagePath.stem().string(), MappedFile::hash(key.data(), key.size()), hash);
+}
+
+} // namespace tinyglrenderer